@@ -5,6 +5,118 @@
 /// with Shape
 /// </summary>
 namespace ShapeController {
+  /// <summary>
+  /// Bounds of what the current interaction draws on top of
+  /// the scene: the shape being drawn or moved, or the selection.
+  /// </summary>
+  /// <returns>Empty when nothing is drawn on top.</returns>
+  RECT interactionBounds() {
+    RECT bounds;
+    SetRectEmpty(&bounds);
+
+    if (programStatus & IS_DRAWING) {
+      bounds = IShape::boundsOf(
+        topLeft,
+        rightBottom,
+        defaultShapeGraphic.lineWidth()
+      );
+    }
+
+    if ((programStatus & IS_MOVING) && selectedShape) {
+      bounds = selectedShape->bounds();
+    }
+
+    if (programStatus & IS_SELECTING) {
+      bounds = IShape::boundsOf(
+        topLeft,
+        rightBottom,
+        selectionShapeGraphic.lineWidth()
+      );
+    }
+
+    return bounds;
+  }
+
+  /// <summary>
+  /// Shape dragged on top of the scene, kept out of the scene layer
+  /// while it moves. NULL when none, or when other shapes lie over it.
+  /// </summary>
+  /// <returns></returns>
+  std::shared_ptr<IShape> floatingShape() {
+    if ((programStatus & IS_MOVING) && (programStatus & IS_STARTED) &&
+      selectedShape && !shapesVector.empty() &&
+      shapesVector.back() == selectedShape) {
+      return selectedShape;
+    }
+
+    return NULL;
+  }
+
+  /// <summary>
+  /// Shapes of the document: the records left in the paged scene,
+  /// then shapesVector. The journal counts positions among them.
+  /// </summary>
+  /// <returns></returns>
+  size_t documentSize() {
+    return (pagedScene ? pagedScene->shapeCount() : 0) + shapesVector.size();
+  }
+
+  /// <summary>
+  /// Find the topmost shape inside a selection and raise it to the top
+  /// of shapesVector, taking it out of the paged scene if it lies
+  /// there: every shape of shapesVector is above the paged ones.
+  /// </summary>
+  /// <param name="topLeft"></param>
+  /// <param name="rightBottom"></param>
+  /// <returns>Its position in the document before, -1 if none.</returns>
+  int64_t selectTopmost(const Point& topLeft, const Point& rightBottom) {
+    size_t below = pagedScene ? pagedScene->shapeCount() : 0;
+
+    // Found among the shapes near the selection only.
+    int i = shapeIndex.topmost(shapesVector, topLeft, rightBottom);
+
+    if (i >= 0) {
+      selectedShape = shapesVector[i];
+      shapesVector.erase(shapesVector.begin() + i);
+      shapesVector.push_back(selectedShape);
+      shapeIndex.raise(selectedShape.get());
+
+      return (int64_t)(below + i);
+    }
+
+    int64_t record = pagedScene ? pagedScene->topmost(topLeft, rightBottom) : -1;
+
+    if (record < 0) {
+      return -1;
+    }
+
+    size_t position = pagedScene->positionOf((uint32_t)record);
+
+    selectedShape = pagedScene->take((uint32_t)record);
+    shapesVector.push_back(selectedShape);
+    shapeIndex.insert(selectedShape.get());
+
+    return (int64_t)position;
+  }
+
+  /// <summary>
+  /// Repaint only what changed: the union of the old
+  /// and the new bounds of what moved.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  /// <param name="before"></param>
+  /// <param name="after"></param>
+  void invalidateChange(HWND hwnd, const RECT& before, const RECT& after) {
+    RECT dirty;
+    UnionRect(&dirty, &before, &after);
+
+    if (!IsRectEmpty(&dirty)) {
+      // Bounds are in the document, the window shows it zoomed.
+      RECT shown = viewport.toClient(dirty);
+      InvalidateRect(hwnd, &shown, false);
+    }
+  }
+
   /// <summary>
   /// Reset shape drawing.
   /// aka reset all shapes.
@@ -14,12 +126,17 @@ namespace ShapeController {
     // Reset untouch status.
     programStatus &= ~IS_CHANGED;
 
+    // The new scene is what its file holds, nothing to autosave.
+    savingEdits = autosavedEdits = sceneEdits;
+
     // Prevent drawing last shape and last selection.
     programStatus &= ~IS_DRAWING;
     programStatus &= ~IS_SELECTING;
 
     // Reset all shapes.
     shapesVector.clear();
+    shapeIndex.clear();
+    sceneLayer.invalidateAll();
   }
 
   /// <summary>
@@ -32,11 +149,18 @@ namespace ShapeController {
       throw std::length_error("Shape vector is empty.");
     }
 
+    RECT bounds = shapesVector.back()->bounds();
+
     // Remove current selected shape.
+    shapeIndex.remove(shapesVector.back().get());
     shapesVector.pop_back();
+    sceneJournal.recordDelete();
+    ++sceneEdits;
+    sceneLayer.invalidate(bounds);
 
-    // Notify to redraw the screen.
-    InvalidateRect(hwnd, NULL, false);
+    // Notify to redraw where it was.
+    RECT shown = viewport.toClient(bounds);
+    InvalidateRect(hwnd, &shown, false);
   }
 
   /// <summary>
@@ -82,12 +206,19 @@ namespace ShapeController {
 
       // Add the newly-cloned shape to shapes vector.
       shapesVector.push_back(cloneShape);
+      shapeIndex.insert(cloneShape.get());
+      sceneJournal.recordCreate(*cloneShape);
+      ++sceneEdits;
 
       // And copy the newly-created pointer.
       copyShapeDrawing(hwnd);
 
-      // Redraw the screen.
-      InvalidateRect(hwnd, NULL, false);
+      // Redraw where it lands.
+      RECT bounds = cloneShape->bounds();
+      sceneLayer.invalidate(bounds);
+
+      RECT shown = viewport.toClient(bounds);
+      InvalidateRect(hwnd, &shown, false);
     }
 
     else {
@@ -101,6 +232,9 @@ namespace ShapeController {
   /// <param name="hwnd"></param>
   /// <param name="id"></param>
   void handleShapeActions(HWND hwnd, int id) {
+    // What the old mode drew on top of the scene.
+    RECT before = interactionBounds();
+
     // Reset all status.
     programStatus &= ~programStatus;
 
@@ -284,6 +418,9 @@ namespace ShapeController {
       break;
     }
     }
+
+    // Clear what the old mode drew, show what the new one draws.
+    invalidateChange(hwnd, before, interactionBounds());
   }
 }
 
@@ -300,6 +437,11 @@ namespace FileController {
     // Reset screen.
     ShapeController::resetShapeDrawing(hwnd);
 
+    // A new scene has no file, hence no journal.
+    currentFilePath.clear();
+    sceneJournal.detach();
+    pagedScene.reset();
+
     // Call for clear screen.
     RedrawWindow(hwnd, NULL, NULL,
       RDW_ERASE | RDW_INVALIDATE | RDW_ERASENOW | RDW_UPDATENOW);
@@ -329,23 +471,72 @@ namespace FileController {
     try {
       // Open file dialog and get file path.
       std::wstring filePath = FileDialog::openFileDialog(hwnd);
-      std::ifstream in(filePath.c_str());
-      std::string buffer;
+
+      // An autosave newer than the file holds edits never saved to it
+      // (the program was closed or crashed first): offer to open it.
+      // It is a whole snapshot, the journal is already in it.
+      bool isRecovered = BackgroundSaver::hasNewerAutosave(filePath) &&
+        IDYES == NotificationDialog::recoverConfirmation(hwnd);
+      std::wstring sourcePath = isRecovered ?
+        BackgroundSaver::autosavePath(filePath) : filePath;
+
+      // Loading into a local vector keeps the screen untouched
+      // if the file turns out to be malformed.
+      std::vector<std::shared_ptr<IShape>> loadedShapes;
+      std::shared_ptr<PagedScene> loadedPages;
+
+      // Huge indexed scenes without pending edits are paged:
+      // only the tiles around the viewport get decoded.
+      bool isBinary = BinaryScene::isBinaryFile(sourcePath);
+      bool hasJournal = GetFileAttributesW(
+        SceneJournal::journalPath(filePath).c_str()
+      ) != INVALID_FILE_ATTRIBUTES;
+
+      if (isBinary && !hasJournal && !isRecovered &&
+        PagedScene::shouldPage(filePath)) {
+        loadedPages = std::make_shared<PagedScene>(filePath);
+      }
+
+      // Binary scenes are mapped and read record by record.
+      else if (isBinary) {
+        BinaryScene::load(sourcePath, loadedShapes);
+      }
+
+      // Compact scenes are decoded as they stream in.
+      else if (CompactScene::isCompactFile(sourcePath)) {
+        CompactScene::load(sourcePath, loadedShapes);
+      }
+
+      // Text scenes are mapped, then parsed in chunks on every core.
+      else {
+        ParallelSceneLoader::load(sourcePath, loadedShapes);
+      }
+
+      // Apply edits saved after the snapshot.
+      size_t journalRecords = loadedPages || isRecovered ? 0 :
+        SceneJournal::replay(filePath, loadedShapes);
 
       // Clear all shapes on screen and in vectors.
       ShapeController::resetShapeDrawing(hwnd);
 
-      // Read shapes to a vector.
-      while (std::getline(in, buffer)) {
-        std::vector<std::string>tokens = Tokeniser::split(buffer, ": ");
-        shapesVector.push_back(ShapeFactory::getInstance()->parse(
-          tokens.at(0),
-          tokens.at(1)
-        ));
+      // Take the loaded shapes.
+      shapesVector.swap(loadedShapes);
+      shapeIndex.rebuild(shapesVector);
+      pagedScene = loadedPages;
+
+      // Later saves go to the same file.
+      // A recovered scene is not what the file holds: the next save
+      // writes it whole, and closing asks to save it.
+      if (isRecovered) {
+        currentFilePath = filePath;
+        sceneJournal.detach();
+        programStatus |= IS_CHANGED;
       }
 
-      // Close file open handle.
-      in.close();
+      else {
+        currentFilePath = filePath;
+        sceneJournal.attach(filePath, journalRecords);
+      }
 
       // Call redraw screen.
       RedrawWindow(hwnd, NULL, NULL,
@@ -369,39 +560,174 @@ namespace FileController {
     }
  
     // Throw exception for error while opening.
-    catch (const std::underflow_error& e) {
-      throw e;
+    catch (const std::underflow_error&) {
+      throw;
     }
     
-    catch (const std::exception& e) {
+    // Rethrow as-is, so parse errors keep their line and column.
+    catch (const std::exception&) {
       // Do nothing.
       // Since the screen remains same.
-      throw e;
+      throw;
     }
   }
 
+  /// <summary>
+  /// Start writing the whole scene (a snapshot) on the background
+  /// saver: the paged base layer if any, then shapesVector.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  /// <param name="filePath"></param>
+  void saveInBackground(HWND hwnd, const std::wstring& filePath) {
+    // Copy first, the document may change while the file is written.
+    savingEdits = sceneEdits;
+    backgroundSaver.start(
+      hwnd,
+      filePath,
+      SceneSnapshot(pagedScene, shapesVector),
+      false
+    );
+
+    // Edits made so far are in the snapshot; journal the next ones
+    // against it.
+    currentFilePath = filePath;
+    sceneJournal.attach(filePath);
+
+    // Set statusbar
+    SendMessage(
+      hStatusBarWnd,
+      SB_SETTEXTW,
+      (WPARAM)2,
+      (LPARAM)L"Đang lưu..."
+    );
+  }
+
   /// <summary>
   /// Open FileSaveDialog, user choose a path and a name,
-  /// then write shapesVector to it.
+  /// then write the scene to it in the background.
   /// </summary>
   /// <param name="hwnd"></param>
   void handleFileSaveAs(HWND hwnd) {
     try {
+      if (backgroundSaver.isBusy()) {
+        throw std::runtime_error("(FileController) A save is still running.");
+      }
+
       std::wstring filePath = FileDialog::saveFileDialog(hwnd);
-      std::ofstream out(filePath);
 
-      for (int i = 0; i < shapesVector.size(); ++i) {
-        out << shapesVector[i]->toString() << '\n';
-      }
+      saveInBackground(hwnd, filePath);
+    }
+
+    catch (const std::underflow_error& e) {
+      throw e;
+    }
+
+    catch (const std::exception& e) {
+      throw e;
+    }
+  }
 
-      out.close();
+  /// <summary>
+  /// Save the current scene.
+  /// Once the scene has a file, only the edits made since the last
+  /// save are appended to its journal; a full snapshot is written
+  /// again (in the background) when the journal gets too long, or
+  /// when the scene was recovered from an autosave.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  void handleFileSave(HWND hwnd) {
+    if (currentFilePath.empty()) {
+      handleFileSaveAs(hwnd);
+      return;
+    }
+
+    // The running save deletes the journal it replaces.
+    if (backgroundSaver.isBusy()) {
+      throw std::runtime_error("(FileController) A save is still running.");
+    }
+
+    if (!sceneJournal.isAttached() ||
+      sceneJournal.needsCompaction(ShapeController::documentSize())) {
+      saveInBackground(hwnd, currentFilePath);
+      return;
+    }
+
+    sceneJournal.flush();
+
+    // The file and its journal hold every edit now, an older autosave
+    // would only offer them again.
+    DeleteFileW(BackgroundSaver::autosavePath(currentFilePath).c_str());
+    autosavedEdits = sceneEdits;
+
+    // Set statusbar
+    SendMessage(
+      hStatusBarWnd,
+      SB_SETTEXT,
+      (WPARAM)2,
+      (LPARAM)currentFilePath.c_str()
+    );
+
+    // Send messege box to inform.
+    MessageBox(
+      hwnd,
+      L"Đã lưu trang vẽ thành công!",
+      L"Ê!",
+      64
+    );
+  }
+
+  /// <summary>
+  /// Autosave the current scene next to its file, if it changed since
+  /// it was last saved or autosaved, and no other save is running.
+  /// The scene file itself is untouched; opening it offers the
+  /// autosave back while it is the newer one.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  void handleAutosave(HWND hwnd) {
+    if (currentFilePath.empty() || sceneEdits == autosavedEdits ||
+      backgroundSaver.isBusy()) {
+      return;
+    }
+
+    savingEdits = sceneEdits;
+    backgroundSaver.start(
+      hwnd,
+      BackgroundSaver::autosavePath(currentFilePath),
+      SceneSnapshot(pagedScene, shapesVector),
+      true
+    );
+  }
+
+  /// <summary>
+  /// The background saver is done: report how it went.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  void handleSaveCompleted(HWND hwnd) {
+    try {
+      backgroundSaver.finish();
+
+      // A save leaves no autosave behind, an autosave is the latest
+      // copy: either way there is nothing to autosave until the next
+      // edit.
+      autosavedEdits = savingEdits;
+
+      if (backgroundSaver.isAutosave()) {
+        SendMessage(
+          hStatusBarWnd,
+          SB_SETTEXTW,
+          (WPARAM)2,
+          (LPARAM)L"Đã tự động lưu"
+        );
+
+        return;
+      }
 
       // Set statusbar
       SendMessage(
         hStatusBarWnd,
         SB_SETTEXT,
         (WPARAM)2,
-        (LPARAM)filePath.c_str()
+        (LPARAM)backgroundSaver.filePath().c_str()
       );
 
       // Send messege box to inform.
@@ -413,12 +739,21 @@ namespace FileController {
       );
     }
 
-    catch (const std::underflow_error& e) {
-      throw e;
-    }
-
     catch (const std::exception& e) {
-      throw e;
+      // The old snapshot (and journal) are left as they were, but the
+      // edits journalled since are not in them: save everything again.
+      if (!backgroundSaver.isAutosave() &&
+        backgroundSaver.filePath() == currentFilePath) {
+        currentFilePath.clear();
+        sceneJournal.detach();
+      }
+
+      MessageBoxA(
+        hwnd,
+        e.what(),
+        "Error",
+        MB_ICONERROR
+      );
     }
   }
 
@@ -526,7 +861,7 @@ namespace FileController {
 
           // Trigger file saving when user press Yes.
           if (IDYES == notificationReturn) {
-            handleFileSaveAs(hwnd);
+            handleFileSave(hwnd);
           }
         }
 
@@ -547,7 +882,7 @@ namespace FileController {
 
           // Yes hit.
           if (IDYES == notificationReturn) {
-            handleFileSaveAs(hwnd);
+            handleFileSave(hwnd);
           }
         }
 
@@ -559,7 +894,7 @@ namespace FileController {
       case ID_FILE_SAVE:
       case ID_HOTKEY_SAVE: {
         // Call controller handle file save.
-        handleFileSaveAs(hwnd);
+        handleFileSave(hwnd);
 
         break;
       }
@@ -743,6 +1078,95 @@ namespace PenstyleController {
   }
 }
 
+/// <summary>
+/// Handling rendering options.
+/// </summary>
+namespace RenderController {
+  /// <summary>
+  /// Switch between GDI and the software renderer.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  void handleToggleSoftwareRendering(HWND hwnd) {
+    isSoftwareRendering = !isSoftwareRendering;
+    sceneLayer.invalidateAll();
+
+    // Tick the menu item when the software renderer is on.
+    CheckMenuItem(
+      GetMenu(hwnd),
+      ID_CONFIG_SOFTWARERENDER,
+      MF_BYCOMMAND | (isSoftwareRendering ? MF_CHECKED : MF_UNCHECKED)
+    );
+
+    InvalidateRect(hwnd, NULL, FALSE);
+  }
+
+  /// <summary>
+  /// Switch anti-aliasing of the software renderer.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  void handleToggleAntialiasing(HWND hwnd) {
+    isAntialiasing = !isAntialiasing;
+    tileRenderer.setAntialiasing(isAntialiasing);
+    sceneLayer.invalidateAll();
+
+    CheckMenuItem(
+      GetMenu(hwnd),
+      ID_CONFIG_ANTIALIAS,
+      MF_BYCOMMAND | (isAntialiasing ? MF_CHECKED : MF_UNCHECKED)
+    );
+
+    InvalidateRect(hwnd, NULL, FALSE);
+  }
+
+  /// <summary>
+  /// Zoom in (steps above 0) or out around a point of the client area.
+  /// Shapes are left as they are; the scene layer re-renders on paint.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  /// <param name="x"></param>
+  /// <param name="y"></param>
+  /// <param name="steps"></param>
+  void handleZoom(HWND hwnd, int x, int y, int steps) {
+    viewport.zoomBy(x, y, steps);
+    InvalidateRect(hwnd, NULL, FALSE);
+  }
+
+  /// <summary>
+  /// Move the document by some pixels of the client area.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  /// <param name="dx"></param>
+  /// <param name="dy"></param>
+  void handlePan(HWND hwnd, int dx, int dy) {
+    viewport.pan(dx, dy);
+    InvalidateRect(hwnd, NULL, FALSE);
+  }
+
+  /// <summary>
+  /// Handle the view menu: zoom around the centre of the client
+  /// area, or back to 1:1.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  /// <param name="id"></param>
+  void handleViewActions(HWND hwnd, int id) {
+    int x = (hClientRect.left + hClientRect.right) / 2;
+    int y = (hClientRect.top + hClientRect.bottom) / 2;
+
+    switch (id) {
+    case ID_VIEW_ZOOMIN:
+      handleZoom(hwnd, x, y, 1);
+      break;
+    case ID_VIEW_ZOOMOUT:
+      handleZoom(hwnd, x, y, -1);
+      break;
+    case ID_VIEW_ZOOMRESET:
+      viewport.reset();
+      InvalidateRect(hwnd, NULL, FALSE);
+      break;
+    }
+  }
+}
+
 /// <summary>
 /// Handling Toolbar actions.
 /// </summary>
@@ -20,7 +20,10 @@ namespace FileDialog {
     hOpenFile.lpstrFile = szOpenFile;
     hOpenFile.lpstrFile[0] = '\0';
     hOpenFile.nMaxFile = sizeof(szOpenFile);
-    hOpenFile.lpstrFilter = L"Text (*.txt)\0*.txt\0";
+    hOpenFile.lpstrFilter = L"Scene (*.txt, *.psb, *.psz)\0*.txt;*.psb;*.psz\0"
+      L"Text (*.txt)\0*.txt\0"
+      L"Binary (*.psb)\0*.psb\0"
+      L"Compact (*.psz)\0*.psz\0";
     hOpenFile.nFilterIndex = 1;
     hOpenFile.lpstrFileTitle = NULL;
     hOpenFile.nMaxFileTitle = 0;
@@ -57,7 +60,9 @@ namespace FileDialog {
     hSaveFile.lpstrFile = szSaveFile;
     hSaveFile.lpstrFile[0] = '\0';
     hSaveFile.nMaxFile = sizeof(szSaveFile);
-    hSaveFile.lpstrFilter = L"Text (*.txt)\0*.txt\0";
+    hSaveFile.lpstrFilter = L"Text (*.txt)\0*.txt\0"
+      L"Binary (*.psb)\0*.psb\0"
+      L"Compact (*.psz)\0*.psz\0";
     hSaveFile.lpstrDefExt = L"txt";
     hSaveFile.nFilterIndex = 1;
     hSaveFile.lpstrFileTitle = NULL;
@@ -178,4 +183,20 @@ namespace NotificationDialog {
 
     return messageReturn;
   }
+
+  /// <summary>
+  /// Ask if user want to open the autosave, newer than the file.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  /// <returns></returns>
+  int recoverConfirmation(HWND hwnd) {
+    int messageReturn = MessageBox(
+      hwnd,
+      L"Có bản tự động lưu mới hơn, chưa được lưu vào file. Mở bản đó ha?",
+      L"Ê!",
+      MB_YESNO | MB_ICONQUESTION
+    );
+
+    return messageReturn;
+  }
 }
\ No newline at end of file
@@ -33,6 +33,9 @@ namespace EventHandler {
     // Register hotkeys
     HotkeyController::createHotkey(hwnd);
 
+    // Start autosaving.
+    SetTimer(hwnd, AUTOSAVE_TIMER, AUTOSAVE_INTERVAL, NULL);
+
     return true;
   }
 
@@ -45,6 +48,10 @@ namespace EventHandler {
     // Unregister all hotkeys
     HotkeyController::destroyHotkey(hwnd);
 
+    // Let a running save reach the disk.
+    KillTimer(hwnd, AUTOSAVE_TIMER);
+    backgroundSaver.wait();
+
     // Post quit message.
     PostQuitMessage(0);
   }
@@ -120,7 +127,181 @@ namespace EventHandler {
     case ID_PENSTYLE_DASH_DOT_DOT:
       PenstyleController::handlePenstyleActions(hwnd, id);
       break;
+
+    // Renderer switch.
+    case ID_CONFIG_SOFTWARERENDER:
+      RenderController::handleToggleSoftwareRendering(hwnd);
+      break;
+
+    case ID_CONFIG_ANTIALIAS:
+      RenderController::handleToggleAntialiasing(hwnd);
+      break;
+
+    // Zoom.
+    case ID_VIEW_ZOOMIN:
+    case ID_VIEW_ZOOMOUT:
+    case ID_VIEW_ZOOMRESET:
+      RenderController::handleViewActions(hwnd, id);
+      break;
+    }
+  }
+
+  /// <summary>
+  /// Part of the client area the toolbar and the status bar leave visible.
+  /// </summary>
+  /// <returns></returns>
+  RECT visibleCanvas() {
+    RECT canvas = hClientRect;
+    RECT bar;
+
+    if (hToolbarWnd && GetWindowRect(hToolbarWnd, &bar)) {
+      canvas.top += bar.bottom - bar.top;
+    }
+
+    if (hStatusBarWnd && GetWindowRect(hStatusBarWnd, &bar)) {
+      canvas.bottom -= bar.bottom - bar.top;
+    }
+
+    return canvas;
+  }
+
+  /// <summary>
+  /// Shapes of the committed scene, in painting order: the visible
+  /// part of the paged scene, then shapesVector.
+  /// </summary>
+  /// <param name="floating">Shape kept out, may be NULL.</param>
+  /// <returns></returns>
+  std::vector<std::shared_ptr<IShape>> collectLayerShapes(const IShape* floating) {
+    std::vector<std::shared_ptr<IShape>> shapes;
+
+    // The part of a paged scene around the client area.
+    if (pagedScene) {
+      RECT area = hClientRect;
+      InflateRect(&area, PAGED_SCENE_MARGIN, PAGED_SCENE_MARGIN);
+
+      shapes = pagedScene->visible(viewport.toDocument(area));
+    }
+
+    shapes.reserve(shapes.size() + shapesVector.size());
+
+    // List of shapes.
+    for (int i = 0; i < shapesVector.size(); ++i) {
+      if (shapesVector[i].get() != floating) {
+        shapes.push_back(shapesVector[i]);
+      }
+    }
+
+    return shapes;
+  }
+
+  /// <summary>
+  /// Shapes drawn over the scene layer every frame: the shape being
+  /// dragged, the shape being drawn and the selection rectangle.
+  /// </summary>
+  /// <param name="preview">Keeps the shape being drawn alive.</param>
+  /// <param name="floating">Shape kept out of the layer, may be NULL.</param>
+  /// <returns></returns>
+  std::vector<IShape*> collectOverlayShapes(std::shared_ptr<IShape>& preview,
+    const std::shared_ptr<IShape>& floating) {
+    std::vector<IShape*> shapes;
+
+    if (floating) {
+      shapes.push_back(floating.get());
+    }
+
+    // Temporary review shape when drawing a new shape.
+    if (programStatus & IS_DRAWING) {
+      preview = ShapeFactory::getInstance()->create(
+        shapeType,
+        topLeft,
+        rightBottom,
+        defaultShapeGraphic
+      );
+
+      shapes.push_back(preview.get());
     }
+
+    // Current selection shape.
+    if (programStatus & IS_SELECTING) {
+      selectionShape->setTopLeft(topLeft);
+      selectionShape->setRightBottom(rightBottom);
+      shapes.push_back(selectionShape.get());
+    }
+
+    return shapes;
+  }
+
+  /// <summary>
+  /// Re-render the dirty area of the scene layer.
+  /// </summary>
+  void renderSceneLayer() {
+    // Shapes under the toolbar or the status bar are never seen.
+    RECT area;
+    RECT canvas = visibleCanvas();
+
+    if (!IntersectRect(&area, &sceneLayer.dirtyArea(), &canvas)) {
+      sceneLayer.validate();
+      return;
+    }
+
+    // Only shapes new or changed since the last time get recorded.
+    sceneDisplayList.sync(collectLayerShapes(sceneLayer.floating().get()));
+
+    renderStats.addArea(area);
+
+    if (isSoftwareRendering) {
+      // GDI may still be writing to the bitmap.
+      GdiFlush();
+
+      Framebuffer framebuffer(
+        sceneLayer.pixels(),
+        sceneLayer.width(),
+        sceneLayer.height()
+      );
+
+      tileRenderer.render(
+        framebuffer,
+        sceneDisplayList,
+        Framebuffer::toPixel(GetSysColor(COLOR_BTNFACE)),
+        area,
+        viewport.toDetailLength(levelOfDetailSize),
+        viewport
+      );
+
+      size_t drawn = tileRenderer.drawnCount();
+      renderStats.addShapes(drawn, sceneDisplayList.size() - drawn);
+    }
+
+    else {
+      HDC hdc = sceneLayer.hdc();
+      int savedDC = SaveDC(hdc);
+
+      // Fill that area with the background, shapes only draw inside it.
+      FillRect(hdc, &area, (HBRUSH)(COLOR_BTNFACE + 1));
+      IntersectClipRect(hdc, area.left, area.top, area.right, area.bottom);
+
+      // Select the null brush.
+      SelectObject(hdc, GetStockObject(NULL_BRUSH));
+
+      {
+        // Shapes draw through GDI; the target restores the pen and brush.
+        GdiRenderTarget target(hdc, gdiStyleCache);
+        ViewportRenderTarget view(target, viewport);
+
+        // Shapes out of the area are culled before any GDI call,
+        // and tiny ones only set a pixel.
+        size_t drawn = sceneDisplayList.replay(
+          view,
+          viewport.toDocument(area),
+          viewport.toDetailLength(levelOfDetailSize)
+        );
+        renderStats.addShapes(drawn, sceneDisplayList.size() - drawn);
+      }
+
+      RestoreDC(hdc, savedDC);
+    }
+
+    sceneLayer.validate();
   }
 
   /// <summary>
@@ -135,57 +316,136 @@ namespace EventHandler {
 
     PAINTSTRUCT ps;
 
+    int width = hClientRect.right - hClientRect.left;
+    int height = hClientRect.bottom - hClientRect.top;
+
+    renderStats.beginFrame();
+
+    // Bring the committed scene up to date; the shape being
+    // dragged on top of it stays out.
+    sceneLayer.resize(hdcScreen, width, height);
+    sceneLayer.setViewport(viewport);
+    sceneLayer.setFloating(ShapeController::floatingShape());
+
+    if (sceneLayer.isDirty() && sceneLayer.hdc()) {
+      renderSceneLayer();
+    }
+
     // Create paint graphic area.
     hdcPaint = BeginPaint(hwnd, &ps);
     hdcCompatible = CreateCompatibleDC(hdcPaint);
-    hBitmap = CreateCompatibleBitmap(
-      hdcScreen,
-      hClientRect.right - hClientRect.left,
-      hClientRect.bottom - hClientRect.top
+
+    // Only the invalid area is composed and copied.
+    RECT dirty = ps.rcPaint;
+    renderStats.addArea(dirty);
+
+    // Overlays which cannot show in it are culled.
+    RECT canvas = visibleCanvas();
+    RECT visible;
+    IntersectRect(&visible, &dirty, &canvas);
+
+    std::shared_ptr<IShape> preview;
+    std::vector<IShape*> candidates = collectOverlayShapes(
+      preview,
+      sceneLayer.floating()
     );
+    std::vector<IShape*> overlays;
+
+    for (IShape* shape : candidates) {
+      RECT bounds = viewport.toClient(shape->bounds());
+      RECT shown;
+
+      if (IntersectRect(&shown, &bounds, &visible)) {
+        overlays.push_back(shape);
+      }
+    }
+
+    renderStats.addShapes(overlays.size(), candidates.size() - overlays.size());
+
+    // Software rendering: overlays are drawn into the pixels of a DIB section.
+    void* bits = NULL;
+
+    if (isSoftwareRendering) {
+      BITMAPINFO bitmapInfo;
+      ZeroMemory(&bitmapInfo, sizeof(bitmapInfo));
+      bitmapInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+      bitmapInfo.bmiHeader.biWidth = width;
+      bitmapInfo.bmiHeader.biHeight = -height;  // Top-down rows.
+      bitmapInfo.bmiHeader.biPlanes = 1;
+      bitmapInfo.bmiHeader.biBitCount = 32;
+      bitmapInfo.bmiHeader.biCompression = BI_RGB;
+
+      hBitmap = CreateDIBSection(
+        hdcScreen,
+        &bitmapInfo,
+        DIB_RGB_COLORS,
+        &bits,
+        NULL,
+        0
+      );
+    }
+
+    else {
+      hBitmap = CreateCompatibleBitmap(hdcScreen, width, height);
+    }
 
     hOldObject = SelectObject(hdcCompatible, hBitmap);
 
-    // Fill that area with the background.
-    FillRect(
+    // Start from the committed scene.
+    BitBlt(
       hdcCompatible,
-      &hClientRect,
-      (HBRUSH)(COLOR_BTNFACE + 1)
+      dirty.left, dirty.top,
+      dirty.right - dirty.left,
+      dirty.bottom - dirty.top,
+      sceneLayer.hdc(),
+      dirty.left, dirty.top,
+      SRCCOPY
     );
 
-    // Select the null brush.
-    SelectObject(hdcCompatible, GetStockObject(NULL_BRUSH));
+    if (isSoftwareRendering) {
+      if (bits) {
+        GdiFlush();
 
-    // Draw list of shapes.
-    for (int i = 0; i < shapesVector.size(); ++i) {
-      shapesVector[i]->draw(hdcCompatible);
-    }
+        Framebuffer framebuffer((uint32_t*)bits, width, height);
+        SoftwareRenderTarget target(framebuffer);
+        target.setClip(dirty.left, dirty.top, dirty.right, dirty.bottom);
+        target.setAntialiasing(isAntialiasing);
+        ViewportRenderTarget view(target, viewport);
 
-    // Draw temporary review shape when drawing a new shape.
-    if (programStatus & IS_DRAWING) {
-      ShapeFactory::getInstance()->create(
-        shapeType,
-        topLeft,
-        rightBottom,
-        defaultShapeGraphic
-      )->draw(hdcCompatible);
+        for (IShape* shape : overlays) {
+          shape->draw(view);
+        }
+      }
     }
 
-    // Draw current selection shape.
-    if (programStatus & IS_SELECTING) {
-      selectionShape->setTopLeft(topLeft);
-      selectionShape->setRightBottom(rightBottom);
-      selectionShape->draw(hdcCompatible);
+    else {
+      // Shapes only draw inside the invalid area.
+      IntersectClipRect(
+        hdcCompatible,
+        dirty.left, dirty.top,
+        dirty.right, dirty.bottom
+      );
+
+      // Select the null brush.
+      SelectObject(hdcCompatible, GetStockObject(NULL_BRUSH));
+
+      // Shapes draw through GDI; the target restores the pen and brush.
+      GdiRenderTarget target(hdcCompatible, gdiStyleCache);
+      ViewportRenderTarget view(target, viewport);
+
+      for (IShape* shape : overlays) {
+        shape->draw(view);
+      }
     }
 
     // Copy bits from the buffer to the screen.
     BitBlt(
       hdcPaint,
-      0, 0,
-      hClientRect.right - hClientRect.left,
-      hClientRect.bottom - hClientRect.top,
+      dirty.left, dirty.top,
+      dirty.right - dirty.left,
+      dirty.bottom - dirty.top,
       hdcCompatible,
-      0, 0,
+      dirty.left, dirty.top,
       SRCCOPY
     );
 
@@ -197,6 +457,9 @@ namespace EventHandler {
     EndPaint(hwnd, &ps);
     ReleaseDC(hwnd, hdcScreen);
     ReleaseDC(hwnd, hdcPaint);
+
+    // No pen is selected anymore.
+    gdiStyleCache.trim();
   }
 
   /// <summary>
@@ -207,7 +470,13 @@ namespace EventHandler {
   /// <param name="y"></param>
   /// <param name="keyFlags"></param>
   void OnMouseMove(HWND hwnd, int x, int y, UINT keyFlags) {
+    // Shapes are edited in document coordinates.
+    x = viewport.toDocumentX(x);
+    y = viewport.toDocumentY(y);
+
     if (programStatus & IS_STARTED) {
+      RECT before = ShapeController::interactionBounds();
+
       // Moving when is on drawing mode.
       if (programStatus & IS_DRAWING) {
         // With a normal shape, you can draw wherever you like.
@@ -242,8 +511,20 @@ namespace EventHandler {
         int dx = secondPosition.x() - firstPosition.x();
         int dy = secondPosition.y() - firstPosition.y();
 
+        RECT from = selectedShape->bounds();
+
         // Move the shape.
         selectedShape->move(dx, dy);
+        shapeIndex.update(selectedShape.get());
+
+        // A shape with others over it moves inside the scene layer.
+        if (selectedShape != ShapeController::floatingShape()) {
+          RECT to = selectedShape->bounds();
+
+          sceneLayer.invalidate(from);
+          sceneLayer.invalidate(to);
+          sceneDisplayList.invalidate(selectedShape.get());
+        }
 
         // Update current position
         firstPosition = secondPosition;
@@ -262,8 +543,12 @@ namespace EventHandler {
         );
       }
 
-      // Send notify to clear the screen.
-      InvalidateRect(hwnd, NULL, false);
+      // Repaint where the shape (or selection) was and now is.
+      ShapeController::invalidateChange(
+        hwnd,
+        before,
+        ShapeController::interactionBounds()
+      );
     }
 
     StatusbarController::onMouseMove(hStatusBarWnd, x, y);
@@ -278,6 +563,10 @@ namespace EventHandler {
   /// <param name="y"></param>
   /// <param name="keyFlags"></param>
   void OnLButtonDown(HWND hwnd, BOOL fDoubleClick, int x, int y, UINT keyFlags) {
+    // Shapes are edited in document coordinates.
+    x = viewport.toDocumentX(x);
+    y = viewport.toDocumentY(y);
+
     // Tell that the user started.
     programStatus |= IS_STARTED;
 
@@ -294,6 +583,11 @@ namespace EventHandler {
       topLeft = firstPosition;
     }
 
+    if (programStatus & IS_MOVING) {
+      // Remember where the move started.
+      moveStartPosition = firstPosition;
+    }
+
     // Get device context to move.
     HDC hdc = GetDC(hwnd);
 
@@ -311,6 +605,10 @@ namespace EventHandler {
   /// <param name="y"></param>
   /// <param name="keyFlags"></param>
   void OnLButtonUp(HWND hwnd, int x, int y, UINT keyFlags) {
+    // Shapes are edited in document coordinates.
+    x = viewport.toDocumentX(x);
+    y = viewport.toDocumentY(y);
+
     if (programStatus & IS_STARTED) {
       // Release started status.
       programStatus &= ~IS_STARTED;
@@ -318,6 +616,10 @@ namespace EventHandler {
       // Officialy this workspace has been painted.
       programStatus |= IS_CHANGED;
 
+      // Shape brought to the front by the selection, if any.
+      RECT raised;
+      SetRectEmpty(&raised);
+
       // Things to do after draw
       if (programStatus & IS_DRAWING) {
         std::shared_ptr<IShape> newShape = ShapeFactory::getInstance()->create(
@@ -329,6 +631,10 @@ namespace EventHandler {
 
         // Add shape to shapes vector.
         shapesVector.push_back(newShape);
+        shapeIndex.insert(newShape.get());
+        sceneJournal.recordCreate(*newShape);
+        ++sceneEdits;
+        sceneLayer.invalidate(newShape->bounds());
 
         // Write to statusbar.
         StatusbarController::onCreateShape(hStatusBarWnd, newShape);
@@ -336,32 +642,25 @@ namespace EventHandler {
 
       // Things to do after select.
       if (programStatus & IS_SELECTING) {
+        // Push the topmost shape inside the selection zone
+        // to the back, from wherever it was in the document.
+        int64_t i = ShapeController::selectTopmost(
+          selectionShape->topLeft(),
+          selectionShape->rightBottom()
+        );
+
         // Flags marked that is there any shapes
         // fits inside selection zone or not.
-        bool hasSelected = false;
-
-        // Index of selected shape.
-        int i = (int)shapesVector.size() - 1;
-
-        // Iterates through the vector to find
-        // who's the millionare.
-        for (; i >= 0; --i) {
-          if (shapesVector[i]->in(
-            selectionShape->topLeft(),
-            selectionShape->rightBottom()
-          )) {
-            // Found, then break.
-            selectedShape = shapesVector[i];
-            hasSelected = true;
-            break;
-          }
-        }
+        bool hasSelected = i >= 0;
 
-        // Push the selected shape to the back,
-        // then remove it from the original position.
         if (hasSelected) {
-          shapesVector.erase(shapesVector.begin() + i);
-          shapesVector.push_back(selectedShape);
+          if (i != (int64_t)ShapeController::documentSize() - 1) {
+            sceneJournal.recordRaise((size_t)i);
+            ++sceneEdits;
+          }
+
+          raised = selectedShape->bounds();
+          sceneLayer.invalidate(raised);
 
           // Set statusbar text.
           StatusbarController::onSelectShape(hStatusBarWnd, selectedShape);
@@ -370,11 +669,58 @@ namespace EventHandler {
 
       // Things to do after move.
       if (programStatus & IS_MOVING) {
+        // The whole drag is one journal record.
+        int dx = firstPosition.x() - moveStartPosition.x();
+        int dy = firstPosition.y() - moveStartPosition.y();
+
+        if (dx || dy) {
+          sceneJournal.recordMove(dx, dy);
+          ++sceneEdits;
+        }
+
         StatusbarController::onMoveShape(hStatusBarWnd, selectedShape);
       }
 
-      // Redraw window.
-      InvalidateRect(hwnd, NULL, false);
+      // Redraw the shape just drawn or moved, the selection
+      // and the shape it raised.
+      ShapeController::invalidateChange(
+        hwnd,
+        ShapeController::interactionBounds(),
+        raised
+      );
+    }
+  }
+
+  /// <summary>
+  /// Handle the mouse wheel: zoom around the cursor with Ctrl,
+  /// pan sideways with Shift, pan up and down otherwise.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  /// <param name="x">Cursor, in screen coordinates.</param>
+  /// <param name="y"></param>
+  /// <param name="zDelta"></param>
+  /// <param name="fwKeys"></param>
+  void OnMouseWheel(HWND hwnd, int x, int y, int zDelta, UINT fwKeys) {
+    if (fwKeys & MK_CONTROL) {
+      POINT cursor = { x, y };
+      ScreenToClient(hwnd, &cursor);
+
+      // At least a step, even for the small deltas of touchpads.
+      int steps = zDelta / WHEEL_DELTA;
+
+      if (0 == steps) {
+        steps = zDelta > 0 ? 1 : -1;
+      }
+
+      RenderController::handleZoom(hwnd, cursor.x, cursor.y, steps);
+    }
+
+    else if (fwKeys & MK_SHIFT) {
+      RenderController::handlePan(hwnd, zDelta * VIEW_PAN_STEP / WHEEL_DELTA, 0);
+    }
+
+    else {
+      RenderController::handlePan(hwnd, 0, zDelta * VIEW_PAN_STEP / WHEEL_DELTA);
     }
   }
 
@@ -403,4 +749,23 @@ namespace EventHandler {
   void OnHotKey(HWND hwnd, int idHotKey, UINT fuModifiers, UINT vk) {
     HotkeyController::handleHotkey(hwnd, idHotKey);
   }
+
+  /// <summary>
+  /// Handle timers.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  /// <param name="id"></param>
+  void OnTimer(HWND hwnd, UINT id) {
+    if (AUTOSAVE_TIMER == id) {
+      FileController::handleAutosave(hwnd);
+    }
+  }
+
+  /// <summary>
+  /// Handle the end of a background save.
+  /// </summary>
+  /// <param name="hwnd"></param>
+  void OnSceneSaved(HWND hwnd) {
+    FileController::handleSaveCompleted(hwnd);
+  }
 }
\ No newline at end of file
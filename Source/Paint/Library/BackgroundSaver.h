@@ -0,0 +1,227 @@
+#pragma once
+
+/// <summary>
+/// Writes scene snapshots on a worker thread.
+///
+/// The UI thread takes a SceneSnapshot and hands it over; the worker
+/// writes it to a temporary file, moves it over the target and posts
+/// COMPLETED to the window (without a window, isDone() is polled). The
+/// window then calls finish(), which reports the outcome. One save runs
+/// at a time.
+/// </summary>
+class BackgroundSaver {
+public:
+  /// <summary>
+  /// Posted to the window once the worker is done.
+  /// </summary>
+  static constexpr UINT COMPLETED = WM_APP + 1;
+
+private:
+  std::thread _worker;
+  bool _isBusy;
+  bool _isAutosave;
+  std::atomic<bool> _isDone;
+  std::wstring _filePath;
+  std::exception_ptr _error;
+
+  /// <summary>
+  /// Write the file next to the target, then replace the target,
+  /// so a failed save never leaves a half-written scene behind.
+  /// </summary>
+  /// <param name="write">Writes the file at the path it is given.</param>
+  /// <param name="filePath"></param>
+  /// <param name="isAutosave"></param>
+  static void save(const std::function<void(const std::wstring&)>& write,
+    const std::wstring& filePath, bool isAutosave) {
+    // Keep the extension, it decides the format.
+    size_t slash = filePath.find_last_of(L"\\/");
+    size_t start = (slash == std::wstring::npos) ? 0 : slash + 1;
+    std::wstring tempPath = filePath.substr(0, start) + L"~" +
+      filePath.substr(start);
+
+    try {
+      write(tempPath);
+    }
+
+    catch (...) {
+      DeleteFileW(tempPath.c_str());
+      throw;
+    }
+
+    if (!MoveFileExW(tempPath.c_str(), filePath.c_str(),
+      MOVEFILE_REPLACE_EXISTING) && !replaceMapped(tempPath, filePath)) {
+      DeleteFileW(tempPath.c_str());
+      throw std::runtime_error("(BackgroundSaver) Cannot replace file.");
+    }
+
+    // The new snapshot holds every journalled edit, and is newer
+    // than any autosave of it.
+    if (!isAutosave) {
+      DeleteFileW(SceneJournal::journalPath(filePath).c_str());
+      DeleteFileW(autosavePath(filePath).c_str());
+    }
+  }
+
+  /// <summary>
+  /// Replace a file a view still maps (a paged scene saved over
+  /// itself). Windows may refuse to replace it, but lets it be renamed:
+  /// it is moved aside, and deleted once the view is closed.
+  /// </summary>
+  /// <param name="tempPath"></param>
+  /// <param name="filePath"></param>
+  /// <returns>False if the file could not be replaced either way.</returns>
+  static bool replaceMapped(const std::wstring& tempPath, const std::wstring& filePath) {
+    std::wstring asidePath = tempPath + L".old";
+
+    // Left over by the last save, if its view is closed by now.
+    DeleteFileW(asidePath.c_str());
+
+    if (!MoveFileExW(filePath.c_str(), asidePath.c_str(), 0)) {
+      return false;
+    }
+
+    if (!MoveFileExW(tempPath.c_str(), filePath.c_str(), 0)) {
+      MoveFileExW(asidePath.c_str(), filePath.c_str(), 0);
+      return false;
+    }
+
+    DeleteFileW(asidePath.c_str());
+
+    return true;
+  }
+
+public:
+  BackgroundSaver() {
+    _isBusy = false;
+    _isAutosave = false;
+    _isDone = false;
+  }
+
+  BackgroundSaver(const BackgroundSaver&) = delete;
+  BackgroundSaver& operator=(const BackgroundSaver&) = delete;
+
+  ~BackgroundSaver() {
+    wait();
+  }
+
+public:
+  /// <summary>
+  /// Path autosaves of a scene are written to.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <returns></returns>
+  static std::wstring autosavePath(const std::wstring& filePath) {
+    return filePath + L".autosave";
+  }
+
+  /// <summary>
+  /// Was a scene autosaved after its file was written? The autosave
+  /// then holds edits the file lacks (the program was closed or
+  /// crashed first), and is offered back when the scene is opened.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <returns>False if there is no autosave.</returns>
+  static bool hasNewerAutosave(const std::wstring& filePath) {
+    uint64_t autosaveTime, fileTime;
+
+    if (!Platform::lastWriteTime(autosavePath(filePath), autosaveTime)) {
+      return false;
+    }
+
+    return !Platform::lastWriteTime(filePath, fileTime) || autosaveTime > fileTime;
+  }
+
+  /// <summary>
+  /// Is a save running (or its outcome not yet collected)?
+  /// </summary>
+  /// <returns></returns>
+  bool isBusy() const { return _isBusy; }
+
+  /// <summary>
+  /// Has the worker finished (finish() then returns at once)?
+  /// </summary>
+  /// <returns></returns>
+  bool isDone() const { return _isDone; }
+
+  bool isAutosave() const { return _isAutosave; }
+
+  const std::wstring& filePath() const { return _filePath; }
+
+  /// <summary>
+  /// Start writing a snapshot.
+  /// </summary>
+  /// <param name="hwnd">Window notified with COMPLETED, may be NULL.</param>
+  /// <param name="filePath"></param>
+  /// <param name="snapshot"></param>
+  /// <param name="isAutosave"></param>
+  void start(HWND hwnd, const std::wstring& filePath,
+    SceneSnapshot&& snapshot, bool isAutosave) {
+    start(hwnd, filePath, [snapshot = std::move(snapshot)](const std::wstring& tempPath) {
+      snapshot.write(tempPath);
+    }, isAutosave);
+  }
+
+  /// <summary>
+  /// Start writing a file with any function, which the worker calls
+  /// with the temporary path to write to.
+  /// </summary>
+  /// <param name="hwnd">Window notified with COMPLETED, may be NULL.</param>
+  /// <param name="filePath"></param>
+  /// <param name="write"></param>
+  /// <param name="isAutosave"></param>
+  void start(HWND hwnd, const std::wstring& filePath,
+    std::function<void(const std::wstring&)> write, bool isAutosave) {
+    if (_isBusy) {
+      throw std::runtime_error("(BackgroundSaver) A save is still running.");
+    }
+
+    wait();
+
+    _isBusy = true;
+    _isAutosave = isAutosave;
+    _filePath = filePath;
+    _error = NULL;
+    _isDone = false;
+
+    _worker = std::thread(
+      [this, hwnd, filePath, isAutosave, write = std::move(write)]() {
+      try {
+        save(write, filePath, isAutosave);
+      }
+
+      catch (...) {
+        _error = std::current_exception();
+      }
+
+      _isDone = true;
+
+      if (hwnd) {
+        PostMessage(hwnd, COMPLETED, 0, 0);
+      }
+    });
+  }
+
+  /// <summary>
+  /// Block until the worker is done.
+  /// </summary>
+  void wait() {
+    if (_worker.joinable()) {
+      _worker.join();
+    }
+  }
+
+  /// <summary>
+  /// Collect the outcome of the save; rethrows its error, if any.
+  /// </summary>
+  void finish() {
+    wait();
+    _isBusy = false;
+
+    if (_error) {
+      std::exception_ptr error = _error;
+      _error = NULL;
+
+      std::rethrow_exception(error);
+    }
+  }
+};
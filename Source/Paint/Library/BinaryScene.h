@@ -0,0 +1,600 @@
+#pragma once
+
+/// <summary>
+/// Versioned binary scene format.
+///
+/// Layout (little-endian):
+///   Header
+///   TileIndex              - spatial index header
+///   Style[styleCount]      - deduplicated ShapeGraphic table
+///   padding                - up to 8-byte alignment
+///   Record[shapeCount]     - one fixed-size record per shape, in z-order
+///   uint64_t[buckets + 1]  - start of each bucket's entries
+///   uint32_t[entries]      - record indices, ascending per bucket
+///
+/// Loading maps the file and walks the records directly,
+/// there is no per-shape text parsing. The tile index lets a
+/// PagedScene decode only the records around the visible area.
+///
+/// There is a bucket per tile, then one more for the shapes spanning more than MAX_TILES_PER_SHAPE tiles: those are
+/// listed once and shown with any area, so the index grows linearly
+/// with the shapes whatever their size.
+/// </summary>
+namespace BinaryScene {
+  /// <summary>
+  /// File signature and current version.
+  /// </summary>
+  const char MAGIC[4] = { 'P', 'S', 'C', 'N' };
+  const uint32_t VERSION = 1;
+
+  /// <summary>
+  /// The tile grid is at most this many tiles wide (and high).
+  /// </summary>
+  const int64_t MAX_TILES_PER_SIDE = 256;
+
+  /// <summary>
+  /// Smallest tile, in pixels.
+  /// </summary>
+  const int64_t MIN_TILE_SIZE = 256;
+
+  /// <summary>
+  /// Shapes spanning more tiles go to the bucket of large shapes.
+  /// </summary>
+  const int64_t MAX_TILES_PER_SHAPE = 64;
+
+  /// <summary>
+  /// Alignment of the records, hence of the tile cells after them.
+  /// </summary>
+  const uint64_t TABLE_ALIGNMENT = 8;
+
+  /// <summary>
+  /// Default extension of binary scenes.
+  /// </summary>
+  const wchar_t EXTENSION[] = L".psb";
+
+  /// <summary>
+  /// File header.
+  /// </summary>
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t shapeCount;
+    uint32_t styleCount;
+
+    // Bounds of every shape point in the scene.
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+
+    // Offsets (from the beginning of the file) of both tables.
+    uint64_t styleOffset;
+    uint64_t recordOffset;
+  };
+
+  /// <summary>
+  /// One entry of the style table (a ShapeGraphic).
+  /// </summary>
+  struct Style {
+    int32_t lineStyle;
+    int32_t lineWidth;
+    uint32_t lineColour;
+    int32_t backgroundBrush;
+    uint32_t backgroundColour;
+
+    bool operator==(const Style& other) const {
+      return lineStyle == other.lineStyle &&
+        lineWidth == other.lineWidth &&
+        lineColour == other.lineColour &&
+        backgroundBrush == other.backgroundBrush &&
+        backgroundColour == other.backgroundColour;
+    }
+  };
+
+  /// <summary>
+  /// One shape: type tag (ShapeFactory prototype index),
+  /// its two points and an index into the style table.
+  /// </summary>
+  struct Record {
+    uint32_t type;
+    int32_t x1;
+    int32_t y1;
+    int32_t x2;
+    int32_t y2;
+    uint32_t style;
+  };
+
+  /// <summary>
+  /// Spatial index over the records.
+  /// Tile (column, row) covers
+  /// [originX + column * tileSize, originX + (column + 1) * tileSize)
+  /// horizontally, and the same vertically.
+  /// </summary>
+  struct TileIndex {
+    int32_t originX;
+    int32_t originY;
+    uint32_t tileSize;
+    uint32_t columns;
+    uint32_t rows;
+    uint32_t entryCount;
+
+    // Offsets (from the beginning of the file) of both arrays.
+    uint64_t cellOffset;
+    uint64_t entryOffset;
+  };
+
+  static_assert(sizeof(Header) == 48, "BinaryScene::Header must be packed");
+  static_assert(sizeof(TileIndex) == 40, "BinaryScene::TileIndex must be packed");
+  static_assert(sizeof(Style) == 20, "BinaryScene::Style must be packed");
+  static_assert(sizeof(Record) == 24, "BinaryScene::Record must be packed");
+  static_assert(sizeof(Record) % TABLE_ALIGNMENT == 0,
+    "BinaryScene::Record must keep the tile cells aligned");
+
+  /// <summary>
+  /// Hash of a style, used to deduplicate the style table.
+  /// </summary>
+  struct StyleHash {
+    size_t operator()(const Style& style) const {
+      size_t seed = 0;
+      std::hash<uint32_t> hasher;
+
+      seed ^= hasher((uint32_t)style.lineStyle) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+      seed ^= hasher((uint32_t)style.lineWidth) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+      seed ^= hasher(style.lineColour) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+      seed ^= hasher((uint32_t)style.backgroundBrush) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+      seed ^= hasher(style.backgroundColour) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+
+      return seed;
+    }
+  };
+
+  /// <summary>
+  /// Convert a ShapeGraphic to a style entry.
+  /// </summary>
+  /// <param name="graphic"></param>
+  /// <returns></returns>
+  Style toStyle(const ShapeGraphic& graphic) {
+    Style style;
+
+    style.lineStyle = graphic.lineStyle();
+    style.lineWidth = graphic.lineWidth();
+    style.lineColour = (uint32_t)graphic.lineColour();
+    style.backgroundBrush = graphic.backgroundBrush();
+    style.backgroundColour = (uint32_t)graphic.backgroundColour();
+
+    return style;
+  }
+
+  /// <summary>
+  /// Convert a style entry back to a ShapeGraphic.
+  /// </summary>
+  /// <param name="style"></param>
+  /// <returns></returns>
+  ShapeGraphic toGraphic(const Style& style) {
+    return ShapeGraphic(
+      style.lineStyle,
+      style.lineWidth,
+      (COLORREF)style.lineColour,
+      style.backgroundBrush,
+      (COLORREF)style.backgroundColour
+    );
+  }
+
+  /// <summary>
+  /// Check if a path ends with the binary scene extension.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <returns></returns>
+  bool hasExtension(const std::wstring& filePath) {
+    size_t length = wcslen(EXTENSION);
+
+    if (filePath.size() < length) {
+      return false;
+    }
+
+    return 0 == _wcsicmp(
+      filePath.c_str() + filePath.size() - length,
+      EXTENSION
+    );
+  }
+
+  /// <summary>
+  /// Check if a file starts with the binary scene signature.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <returns></returns>
+  bool isBinaryFile(const std::wstring& filePath) {
+    std::ifstream in(Platform::streamPath(filePath), std::ios::binary);
+    char magic[4] = { 0 };
+
+    in.read(magic, sizeof(magic));
+
+    return in.gcount() == sizeof(magic) &&
+      0 == memcmp(magic, MAGIC, sizeof(MAGIC));
+  }
+
+  /// <summary>
+  /// Bounds a record covers on screen, pen width included.
+  /// </summary>
+  /// <param name="record"></param>
+  /// <param name="style"></param>
+  /// <param name="left"></param>
+  /// <param name="top"></param>
+  /// <param name="right"></param>
+  /// <param name="bottom"></param>
+  void recordBounds(const Record& record, const Style& style,
+    int64_t& left, int64_t& top, int64_t& right, int64_t& bottom) {
+    int64_t pad = max(style.lineWidth, 1) / 2 + 1;
+
+    left = (int64_t)min(record.x1, record.x2) - pad;
+    top = (int64_t)min(record.y1, record.y2) - pad;
+    right = (int64_t)max(record.x1, record.x2) + pad;
+    bottom = (int64_t)max(record.y1, record.y2) + pad;
+  }
+
+  /// <summary>
+  /// Collects shapes, then writes them as a binary scene.
+  /// </summary>
+  class Writer {
+  private:
+    std::vector<Style> _styles;
+    std::unordered_map<Style, uint32_t, StyleHash> _styleIndex;
+    std::vector<Record> _records;
+
+  public:
+    /// <summary>
+    /// Add a shape given by its parts.
+    /// </summary>
+    /// <param name="type">ShapeFactory tag.</param>
+    /// <param name="first"></param>
+    /// <param name="second"></param>
+    /// <param name="graphic"></param>
+    void add(uint32_t type, const Point& first, const Point& second,
+      const ShapeGraphic& graphic) {
+      Style style = toStyle(graphic);
+      auto found = _styleIndex.find(style);
+
+      Record record;
+      record.type = type;
+
+      if (found == _styleIndex.end()) {
+        record.style = (uint32_t)_styles.size();
+        _styleIndex.emplace(style, record.style);
+        _styles.push_back(style);
+      }
+
+      else {
+        record.style = found->second;
+      }
+
+      record.x1 = first.x();
+      record.y1 = first.y();
+      record.x2 = second.x();
+      record.y2 = second.y();
+      _records.push_back(record);
+    }
+
+    /// <summary>
+    /// Add a shape.
+    /// </summary>
+    /// <param name="factory"></param>
+    /// <param name="shape"></param>
+    void add(ShapeFactory& factory, IShape& shape) {
+      add(
+        (uint32_t)factory.tagOf(shape),
+        shape.firstPoint(),
+        shape.secondPoint(),
+        shape.graphic()
+      );
+    }
+
+    /// <summary>
+    /// Write the scene, with its tile index.
+    /// </summary>
+    /// <param name="filePath"></param>
+    void save(const std::wstring& filePath) {
+      Header header;
+      memcpy(header.magic, MAGIC, sizeof(MAGIC));
+      header.version = VERSION;
+      header.left = header.top = INT32_MAX;
+      header.right = header.bottom = INT32_MIN;
+
+      // Bounds of the points, and of what the shapes cover.
+      int64_t coverLeft = INT64_MAX, coverTop = INT64_MAX;
+      int64_t coverRight = INT64_MIN, coverBottom = INT64_MIN;
+
+      for (const Record& record : _records) {
+        header.left = min(header.left, min(record.x1, record.x2));
+        header.top = min(header.top, min(record.y1, record.y2));
+        header.right = max(header.right, max(record.x1, record.x2));
+        header.bottom = max(header.bottom, max(record.y1, record.y2));
+
+        int64_t left, top, right, bottom;
+        recordBounds(record, _styles[record.style], left, top, right, bottom);
+
+        coverLeft = min(coverLeft, left);
+        coverTop = min(coverTop, top);
+        coverRight = max(coverRight, right);
+        coverBottom = max(coverBottom, bottom);
+      }
+
+      // Empty scene has empty bounds.
+      if (_records.empty()) {
+        header.left = header.top = header.right = header.bottom = 0;
+        coverLeft = coverTop = 0;
+        coverRight = coverBottom = 1;
+      }
+
+      // Square tiles, the grid at most MAX_TILES_PER_SIDE on a side.
+      int64_t extent = max(coverRight - coverLeft, coverBottom - coverTop) + 1;
+      int64_t tileSize = max(
+        MIN_TILE_SIZE,
+        (extent + MAX_TILES_PER_SIDE - 1) / MAX_TILES_PER_SIDE
+      );
+
+      // Keep the origin inside int32, the grid then covers the rest.
+      coverLeft = max(coverLeft, (int64_t)INT32_MIN);
+      coverTop = max(coverTop, (int64_t)INT32_MIN);
+
+      TileIndex tiles;
+      tiles.originX = (int32_t)coverLeft;
+      tiles.originY = (int32_t)coverTop;
+      tiles.tileSize = (uint32_t)tileSize;
+      tiles.columns = (uint32_t)((coverRight - coverLeft) / tileSize + 1);
+      tiles.rows = (uint32_t)((coverBottom - coverTop) / tileSize + 1);
+
+      if (_records.size() > UINT32_MAX) {
+        throw std::runtime_error("(BinaryScene) Too many shapes.");
+      }
+
+      // Bucket the records by tile, in two passes (count, then fill).
+      // The last bucket holds the large shapes.
+      size_t tileCount = (size_t)tiles.columns * tiles.rows;
+      std::vector<uint64_t> cells(tileCount + 2, 0);
+
+      auto forEachTile = [&](const Record& record, auto&& action) {
+        int64_t left, top, right, bottom;
+        recordBounds(record, _styles[record.style], left, top, right, bottom);
+
+        int64_t firstColumn = max((int64_t)0, (left - coverLeft) / tileSize);
+        int64_t lastColumn = min((int64_t)tiles.columns - 1, (right - coverLeft) / tileSize);
+        int64_t firstRow = max((int64_t)0, (top - coverTop) / tileSize);
+        int64_t lastRow = min((int64_t)tiles.rows - 1, (bottom - coverTop) / tileSize);
+
+        if ((lastColumn - firstColumn + 1) * (lastRow - firstRow + 1) >
+          MAX_TILES_PER_SHAPE) {
+          action(tileCount);
+          return;
+        }
+
+        for (int64_t row = firstRow; row <= lastRow; ++row) {
+          for (int64_t column = firstColumn; column <= lastColumn; ++column) {
+            action((size_t)(row * tiles.columns + column));
+          }
+        }
+      };
+
+      for (const Record& record : _records) {
+        forEachTile(record, [&cells](size_t tile) {
+          ++cells[tile + 1];
+        });
+      }
+
+      for (size_t tile = 0; tile <= tileCount; ++tile) {
+        cells[tile + 1] += cells[tile];
+      }
+
+      // At most MAX_TILES_PER_SHAPE entries per shape, but the count
+      // must still fit the header.
+      if (cells[tileCount + 1] > UINT32_MAX) {
+        throw std::runtime_error("(BinaryScene) Tile index is too large.");
+      }
+
+      std::vector<uint32_t> entries((size_t)cells[tileCount + 1]);
+      std::vector<uint64_t> cursor(cells.begin(), cells.end() - 1);
+
+      // Records are visited in order, so each tile lists them ascending.
+      for (uint32_t i = 0; i < (uint32_t)_records.size(); ++i) {
+        forEachTile(_records[i], [&entries, &cursor, i](size_t tile) {
+          entries[(size_t)cursor[tile]++] = i;
+        });
+      }
+
+      header.shapeCount = (uint32_t)_records.size();
+      header.styleCount = (uint32_t)_styles.size();
+      header.styleOffset = sizeof(Header) + sizeof(TileIndex);
+      header.recordOffset = header.styleOffset + _styles.size() * sizeof(Style);
+
+      // Pad the odd sized style table, so records and cells are aligned.
+      uint64_t padding = (TABLE_ALIGNMENT - header.recordOffset % TABLE_ALIGNMENT) %
+        TABLE_ALIGNMENT;
+      header.recordOffset += padding;
+
+      tiles.entryCount = (uint32_t)entries.size();
+      tiles.cellOffset = header.recordOffset + _records.size() * sizeof(Record);
+      tiles.entryOffset = tiles.cellOffset + cells.size() * sizeof(uint64_t);
+
+      std::ofstream out(Platform::streamPath(filePath), std::ios::binary | std::ios::trunc);
+
+      if (!out) {
+        throw std::runtime_error("(BinaryScene) Cannot create file.");
+      }
+
+      out.write((const char*)&header, sizeof(header));
+      out.write((const char*)&tiles, sizeof(tiles));
+      out.write((const char*)_styles.data(), _styles.size() * sizeof(Style));
+
+      const char zeros[TABLE_ALIGNMENT] = { 0 };
+      out.write(zeros, (std::streamsize)padding);
+      out.write((const char*)_records.data(), _records.size() * sizeof(Record));
+      out.write((const char*)cells.data(), cells.size() * sizeof(uint64_t));
+      out.write((const char*)entries.data(), entries.size() * sizeof(uint32_t));
+
+      if (!out) {
+        throw std::runtime_error("(BinaryScene) Cannot write file.");
+      }
+    }
+  };
+
+  /// <summary>
+  /// Write shapes to a binary scene file.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <param name="shapes"></param>
+  void save(const std::wstring& filePath,
+    const std::vector<std::shared_ptr<IShape>>& shapes) {
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+    Writer writer;
+
+    for (const std::shared_ptr<IShape>& shape : shapes) {
+      writer.add(*factory, *shape);
+    }
+
+    writer.save(filePath);
+  }
+
+  /// <summary>
+  /// Does a table of count items of a size, at an offset, lie inside
+  /// the file? Computed so that no product or sum overflows.
+  /// </summary>
+  /// <param name="file"></param>
+  /// <param name="offset"></param>
+  /// <param name="count"></param>
+  /// <param name="size"></param>
+  /// <returns></returns>
+  bool fits(const MappedFile& file, uint64_t offset, uint64_t count,
+    uint64_t size) {
+    return offset <= file.size() && count <= (file.size() - offset) / size;
+  }
+
+  /// <summary>
+  /// Buckets of a tile index: one per tile, then the large shapes.
+  /// </summary>
+  /// <param name="tiles"></param>
+  /// <returns></returns>
+  uint64_t bucketCount(const TileIndex& tiles) {
+    return (uint64_t)tiles.columns * tiles.rows + 1;
+  }
+
+  /// <summary>
+  /// Check the header of a mapped binary scene and its tables.
+  /// </summary>
+  /// <param name="file"></param>
+  /// <returns>The header.</returns>
+  const Header* validate(const MappedFile& file) {
+    if (file.size() < sizeof(Header)) {
+      throw std::runtime_error("(BinaryScene) File is too small.");
+    }
+
+    const Header* header = (const Header*)file.data();
+
+    if (0 != memcmp(header->magic, MAGIC, sizeof(MAGIC))) {
+      throw std::runtime_error("(BinaryScene) Not a binary scene.");
+    }
+
+    if (header->version != VERSION) {
+      throw std::runtime_error("(BinaryScene) Unsupported version.");
+    }
+
+    if (file.size() < sizeof(Header) + sizeof(TileIndex) ||
+      !fits(file, header->styleOffset, header->styleCount, sizeof(Style)) ||
+      !fits(file, header->recordOffset, header->shapeCount, sizeof(Record))) {
+      throw std::runtime_error("(BinaryScene) File is truncated.");
+    }
+
+    if (0 != header->styleOffset % alignof(Style) ||
+      0 != header->recordOffset % alignof(Record)) {
+      throw std::runtime_error("(BinaryScene) Misaligned table.");
+    }
+
+    return header;
+  }
+
+  /// <summary>
+  /// Tile index of a validated scene.
+  /// </summary>
+  /// <param name="file"></param>
+  /// <returns></returns>
+  const TileIndex* tileIndex(const MappedFile& file) {
+    const TileIndex* tiles = (const TileIndex*)(file.data() + sizeof(Header));
+
+    if (0 == tiles->tileSize ||
+      0 != tiles->cellOffset % alignof(uint64_t) ||
+      0 != tiles->entryOffset % alignof(uint32_t) ||
+      !fits(file, tiles->cellOffset, bucketCount(*tiles) + 1, sizeof(uint64_t)) ||
+      !fits(file, tiles->entryOffset, tiles->entryCount, sizeof(uint32_t))) {
+      throw std::runtime_error("(BinaryScene) Corrupted tile index.");
+    }
+
+    return tiles;
+  }
+
+  /// <summary>
+  /// Load shapes from a binary scene file, appending them
+  /// (in z-order) to the given vector.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <param name="shapes"></param>
+  void load(const std::wstring& filePath,
+    std::vector<std::shared_ptr<IShape>>& shapes) {
+    MappedFile file(filePath);
+    const Header* header = validate(file);
+
+    const Style* styles = (const Style*)(file.data() + header->styleOffset);
+    const Record* records = (const Record*)(file.data() + header->recordOffset);
+
+    // Resolve the style table once.
+    std::vector<ShapeGraphic> graphics;
+    graphics.reserve(header->styleCount);
+
+    for (uint32_t i = 0; i < header->styleCount; ++i) {
+      graphics.push_back(toGraphic(styles[i]));
+    }
+
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+    uint32_t typeCount = (uint32_t)factory->prototypeSize();
+
+    shapes.reserve(shapes.size() + header->shapeCount);
+
+    for (uint32_t i = 0; i < header->shapeCount; ++i) {
+      const Record& record = records[i];
+
+      if (record.type >= typeCount || record.style >= header->styleCount) {
+        throw std::runtime_error("(BinaryScene) Corrupted shape record.");
+      }
+
+      shapes.push_back(factory->create(
+        (int)record.type,
+        Point(record.x1, record.y1),
+        Point(record.x2, record.y2),
+        graphics[record.style]
+      ));
+    }
+  }
+
+  /// <summary>
+  /// Convert a text scene to a binary scene.
+  /// </summary>
+  /// <param name="textPath"></param>
+  /// <param name="binaryPath"></param>
+  void convertTextToBinary(const std::wstring& textPath,
+    const std::wstring& binaryPath) {
+    std::vector<std::shared_ptr<IShape>> shapes;
+
+    ParallelSceneLoader::load(textPath, shapes);
+    save(binaryPath, shapes);
+  }
+
+  /// <summary>
+  /// Convert a binary scene to a text scene.
+  /// </summary>
+  /// <param name="binaryPath"></param>
+  /// <param name="textPath"></param>
+  void convertBinaryToText(const std::wstring& binaryPath,
+    const std::wstring& textPath) {
+    std::vector<std::shared_ptr<IShape>> shapes;
+
+    load(binaryPath, shapes);
+    SceneWriter::save(textPath, shapes);
+  }
+}
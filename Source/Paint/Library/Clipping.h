@@ -0,0 +1,131 @@
+#pragma once
+
+/// <summary>
+/// Clipping of segments to rectangles before they are drawn, so far
+/// away parts of a shape cost nothing and never reach coordinates
+/// the drawing code cannot handle.
+/// </summary>
+namespace Clipping {
+  /// <summary>
+  /// Narrow the part [enter, exit] of a segment, as a fraction of its
+  /// length, to where p * t <= q holds (one side of a box).
+  /// </summary>
+  /// <returns>False if nothing is left.</returns>
+  inline bool clipSide(double p, double q, double& enter, double& exit) {
+    if (0 == p) {
+      return q >= 0;
+    }
+
+    double t = q / p;
+
+    if (p < 0) {
+      enter = max(enter, t);
+    }
+
+    else {
+      exit = min(exit, t);
+    }
+
+    return enter <= exit;
+  }
+
+  /// <summary>
+  /// Part of the segment from (x1, y1) to (x2, y2) inside a box
+  /// (inclusive), Liang-Barsky: as fractions of the segment, from
+  /// enter to exit.
+  /// </summary>
+  /// <returns>False if the segment misses the box.</returns>
+  inline bool clipSegment(double x1, double y1, double x2, double y2,
+    double left, double top, double right, double bottom,
+    double& enter, double& exit) {
+    double dx = x2 - x1;
+    double dy = y2 - y1;
+
+    enter = 0;
+    exit = 1;
+
+    return clipSide(-dx, x1 - left, enter, exit) &&
+      clipSide(dx, right - x1, enter, exit) &&
+      clipSide(-dy, y1 - top, enter, exit) &&
+      clipSide(dy, bottom - y1, enter, exit);
+  }
+
+  /// <summary>
+  /// Greatest common divisor of two numbers, at least one not zero.
+  /// </summary>
+  inline int64_t commonDivisor(int64_t first, int64_t second) {
+    first = std::abs(first);
+    second = std::abs(second);
+
+    while (second != 0) {
+      int64_t rest = first % second;
+      first = second;
+      second = rest;
+    }
+
+    return first;
+  }
+
+  /// <summary>
+  /// Steps of a line from (0, 0) to (dx, dy), counted along its major
+  /// axis, to keep of the part [enter, exit] clipSegment found. The
+  /// ends are moved outwards to steps where the line crosses a whole
+  /// pixel, at multiples of period, so the shorter line goes through
+  /// the same pixels (and dashes) as the whole one. When there is no
+  /// such step in between, nothing is cut.
+  /// </summary>
+  inline void latticeSteps(int64_t dx, int64_t dy, double enter, double exit,
+    int64_t period, int64_t& from, int64_t& to) {
+    int64_t length = max(std::abs(dx), std::abs(dy));
+    from = 0;
+    to = length;
+
+    if (0 == length) {
+      return;
+    }
+
+    // The line is on a whole pixel every lattice steps.
+    int64_t lattice = length / commonDivisor(dx, dy);
+    int64_t step = lattice / commonDivisor(lattice, period) * period;
+
+    from = (int64_t)std::floor(enter * length / step) * step;
+    to = min((int64_t)std::ceil(exit * length / step) * step, length);
+  }
+
+  /// <summary>
+  /// Is the point inside the box (inclusive)?
+  /// </summary>
+  inline bool contains(const RECT& box, int x, int y) {
+    return x >= box.left && x <= box.right && y >= box.top && y <= box.bottom;
+  }
+
+  /// <summary>
+  /// Does the box (inclusive) lie inside the ellipse in the box from
+  /// (left, top) to (right, bottom), shrunk by inset on every side?
+  /// The ellipse is convex: if it holds the corners, it holds the box.
+  /// </summary>
+  inline bool insideEllipse(const RECT& box, double left, double top,
+    double right, double bottom, double inset) {
+    double centreX = (left + right) / 2;
+    double centreY = (top + bottom) / 2;
+    double radiusX = (right - left) / 2 - inset;
+    double radiusY = (bottom - top) / 2 - inset;
+
+    if (radiusX <= 0 || radiusY <= 0) {
+      return false;
+    }
+
+    for (double x : { (double)box.left, (double)box.right }) {
+      for (double y : { (double)box.top, (double)box.bottom }) {
+        double u = (x - centreX) / radiusX;
+        double v = (y - centreY) / radiusY;
+
+        if (u * u + v * v >= 1) {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+}
@@ -0,0 +1,441 @@
+#pragma once
+
+/// <summary>
+/// Compact scene format, for archiving.
+///
+/// Layout:
+///   "PSHZ" version        - 4 bytes signature, then a varint
+///   shape*                - see below, in z-order
+///   0                     - end of scene
+///
+/// Every number is a LEB128 varint; signed ones are zigzag encoded.
+/// A shape is:
+///   type + 1              - ShapeFactory tag, 0 ends the scene
+///   style                 - index into the style table built so far;
+///                           the next free index is followed by the
+///                           new style (5 numbers) inline
+///   dx1 dy1               - first point minus the previous first point
+///   dx2 dy2               - second point minus the first point
+///
+/// Both sides build the style table as they go, so shapes are
+/// encoded and decoded one by one through a small buffer.
+/// </summary>
+namespace CompactScene {
+  /// <summary>
+  /// File signature and current version.
+  /// </summary>
+  const char MAGIC[4] = { 'P', 'S', 'H', 'Z' };
+  const uint32_t VERSION = 1;
+
+  /// <summary>
+  /// Default extension of compact scenes.
+  /// </summary>
+  const wchar_t EXTENSION[] = L".psz";
+
+  /// <summary>
+  /// Buffer is handed to (or refilled from) the file in blocks this big.
+  /// </summary>
+  const size_t BLOCK_SIZE = 1 << 16;
+
+  /// <summary>
+  /// Upper bound of one encoded shape:
+  /// 11 numbers of at most 5 bytes (or 10 for 64-bit deltas).
+  /// </summary>
+  const size_t MAX_SHAPE_SIZE = 11 * 10;
+
+  /// <summary>
+  /// Zigzag: small negative numbers become small unsigned ones.
+  /// </summary>
+  /// <param name="value"></param>
+  /// <returns></returns>
+  inline uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+  }
+
+  inline int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+  }
+
+  /// <summary>
+  /// Check if a file path ends with the compact extension.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <returns></returns>
+  bool hasExtension(const std::wstring& filePath) {
+    size_t length = wcslen(EXTENSION);
+
+    if (filePath.size() < length) {
+      return false;
+    }
+
+    return 0 == _wcsicmp(
+      filePath.c_str() + filePath.size() - length,
+      EXTENSION
+    );
+  }
+
+  /// <summary>
+  /// Check if a file starts with the compact scene signature.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <returns></returns>
+  bool isCompactFile(const std::wstring& filePath) {
+    std::ifstream in(Platform::streamPath(filePath), std::ios::binary);
+    char magic[4] = { 0 };
+
+    in.read(magic, sizeof(magic));
+
+    return in.gcount() == sizeof(magic) &&
+      0 == memcmp(magic, MAGIC, sizeof(MAGIC));
+  }
+
+  /// <summary>
+  /// Streaming encoder.
+  /// </summary>
+  class Writer {
+  private:
+    std::ofstream _out;
+    std::vector<uint8_t> _buffer;
+    size_t _used;
+
+    std::unordered_map<BinaryScene::Style, uint32_t, BinaryScene::StyleHash> _styles;
+    int64_t _lastX;
+    int64_t _lastY;
+
+    void putNumber(uint64_t value) {
+      while (value >= 0x80) {
+        _buffer[_used++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+      }
+
+      _buffer[_used++] = (uint8_t)value;
+    }
+
+    void putSigned(int64_t value) {
+      putNumber(zigzag(value));
+    }
+
+  public:
+    /// <summary>
+    /// Open (and truncate) a compact scene for writing.
+    /// </summary>
+    /// <param name="filePath"></param>
+    Writer(const std::wstring& filePath)
+      : _out(Platform::streamPath(filePath), std::ios::binary | std::ios::trunc) {
+      if (!_out) {
+        throw std::runtime_error("(CompactScene) Cannot create file.");
+      }
+
+      _buffer.resize(BLOCK_SIZE + MAX_SHAPE_SIZE);
+      _used = 0;
+      _lastX = 0;
+      _lastY = 0;
+
+      memcpy(_buffer.data(), MAGIC, sizeof(MAGIC));
+      _used = sizeof(MAGIC);
+      putNumber(VERSION);
+    }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    ~Writer() {
+      // Best effort, errors are reported by close().
+      try {
+        flush();
+      }
+
+      catch (const std::exception&) {
+        // Do nothing.
+      }
+    }
+
+  public:
+    /// <summary>
+    /// Append a shape given by its parts.
+    /// </summary>
+    /// <param name="type">ShapeFactory tag.</param>
+    /// <param name="first"></param>
+    /// <param name="second"></param>
+    /// <param name="graphic"></param>
+    void write(uint32_t type, const Point& first, const Point& second,
+      const ShapeGraphic& graphic) {
+      BinaryScene::Style style = BinaryScene::toStyle(graphic);
+      auto found = _styles.find(style);
+
+      putNumber((uint64_t)type + 1);
+
+      if (found != _styles.end()) {
+        putNumber(found->second);
+      }
+
+      // New style: its index is the next free one, the style follows.
+      else {
+        uint32_t index = (uint32_t)_styles.size();
+        _styles.emplace(style, index);
+
+        putNumber(index);
+        putSigned(style.lineStyle);
+        putSigned(style.lineWidth);
+        putNumber(style.lineColour);
+        putSigned(style.backgroundBrush);
+        putNumber(style.backgroundColour);
+      }
+
+      putSigned(first.x() - _lastX);
+      putSigned(first.y() - _lastY);
+      putSigned((int64_t)second.x() - first.x());
+      putSigned((int64_t)second.y() - first.y());
+
+      _lastX = first.x();
+      _lastY = first.y();
+
+      if (_used >= BLOCK_SIZE) {
+        flush();
+      }
+    }
+
+    /// <summary>
+    /// Append a shape.
+    /// </summary>
+    /// <param name="factory"></param>
+    /// <param name="shape"></param>
+    void write(ShapeFactory& factory, IShape& shape) {
+      write(
+        (uint32_t)factory.tagOf(shape),
+        shape.firstPoint(),
+        shape.secondPoint(),
+        shape.graphic()
+      );
+    }
+
+    /// <summary>
+    /// Hand the buffered bytes to the file.
+    /// </summary>
+    void flush() {
+      if (_used > 0) {
+        _out.write((const char*)_buffer.data(), _used);
+        _used = 0;
+      }
+
+      if (!_out) {
+        throw std::runtime_error("(CompactScene) Cannot write file.");
+      }
+    }
+
+    /// <summary>
+    /// Write the end marker, flush and close the file.
+    /// </summary>
+    void close() {
+      putNumber(0);
+      flush();
+      _out.close();
+    }
+  };
+
+  /// <summary>
+  /// Streaming decoder.
+  /// </summary>
+  class Reader {
+  private:
+    std::ifstream _in;
+    std::vector<uint8_t> _buffer;
+    size_t _position;
+    size_t _size;
+    bool _isEnd;
+
+    std::vector<ShapeGraphic> _styles;
+    int64_t _lastX;
+    int64_t _lastY;
+
+    /// <summary>
+    /// Make sure a whole shape is buffered (unless the file ends first).
+    /// </summary>
+    void refill() {
+      if (_size - _position >= MAX_SHAPE_SIZE || !_in) {
+        return;
+      }
+
+      memmove(_buffer.data(), _buffer.data() + _position, _size - _position);
+      _size -= _position;
+      _position = 0;
+
+      _in.read((char*)_buffer.data() + _size, _buffer.size() - _size);
+      _size += (size_t)_in.gcount();
+    }
+
+    uint64_t getNumber() {
+      uint64_t value = 0;
+
+      for (int shift = 0; shift < 64; shift += 7) {
+        if (_position >= _size) {
+          throw std::runtime_error("(CompactScene) File is truncated.");
+        }
+
+        uint8_t byte = _buffer[_position++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+
+        if (0 == (byte & 0x80)) {
+          return value;
+        }
+      }
+
+      throw std::runtime_error("(CompactScene) Corrupted number.");
+    }
+
+    int64_t getSigned() {
+      return unzigzag(getNumber());
+    }
+
+    /// <summary>
+    /// Read a coordinate, which must fit in an int.
+    /// </summary>
+    /// <param name="value"></param>
+    /// <returns></returns>
+    static int toCoordinate(int64_t value) {
+      if (value < INT32_MIN || value > INT32_MAX) {
+        throw std::runtime_error("(CompactScene) Coordinate out of range.");
+      }
+
+      return (int)value;
+    }
+
+  public:
+    /// <summary>
+    /// Open a compact scene and check its signature.
+    /// </summary>
+    /// <param name="filePath"></param>
+    Reader(const std::wstring& filePath)
+      : _in(Platform::streamPath(filePath), std::ios::binary) {
+      if (!_in) {
+        throw std::runtime_error("(CompactScene) Cannot open file.");
+      }
+
+      _buffer.resize(BLOCK_SIZE + MAX_SHAPE_SIZE);
+      _position = 0;
+      _size = 0;
+      _isEnd = false;
+      _lastX = 0;
+      _lastY = 0;
+
+      refill();
+
+      if (_size < sizeof(MAGIC) || 0 != memcmp(_buffer.data(), MAGIC, sizeof(MAGIC))) {
+        throw std::runtime_error("(CompactScene) Not a compact scene.");
+      }
+
+      _position = sizeof(MAGIC);
+
+      if (getNumber() != VERSION) {
+        throw std::runtime_error("(CompactScene) Unsupported version.");
+      }
+    }
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+  public:
+    /// <summary>
+    /// Decode the next shape.
+    /// </summary>
+    /// <param name="type">ShapeFactory tag.</param>
+    /// <param name="first"></param>
+    /// <param name="second"></param>
+    /// <param name="graphic"></param>
+    /// <returns>False at the end of the scene.</returns>
+    bool next(uint32_t& type, Point& first, Point& second,
+      ShapeGraphic& graphic) {
+      if (_isEnd) {
+        return false;
+      }
+
+      refill();
+
+      uint64_t tag = getNumber();
+
+      if (0 == tag) {
+        _isEnd = true;
+        return false;
+      }
+
+      if (tag - 1 > UINT32_MAX) {
+        throw std::runtime_error("(CompactScene) Corrupted shape type.");
+      }
+
+      type = (uint32_t)(tag - 1);
+
+      uint64_t style = getNumber();
+
+      if (style == _styles.size()) {
+        BinaryScene::Style entry;
+        entry.lineStyle = (int32_t)getSigned();
+        entry.lineWidth = (int32_t)getSigned();
+        entry.lineColour = (uint32_t)getNumber();
+        entry.backgroundBrush = (int32_t)getSigned();
+        entry.backgroundColour = (uint32_t)getNumber();
+
+        _styles.push_back(BinaryScene::toGraphic(entry));
+      }
+
+      else if (style > _styles.size()) {
+        throw std::runtime_error("(CompactScene) Corrupted style index.");
+      }
+
+      graphic = _styles[(size_t)style];
+
+      int64_t x1 = _lastX + getSigned();
+      int64_t y1 = _lastY + getSigned();
+      int64_t x2 = x1 + getSigned();
+      int64_t y2 = y1 + getSigned();
+
+      first = Point(toCoordinate(x1), toCoordinate(y1));
+      second = Point(toCoordinate(x2), toCoordinate(y2));
+
+      _lastX = x1;
+      _lastY = y1;
+
+      return true;
+    }
+  };
+
+  /// <summary>
+  /// Write shapes to a compact scene file.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <param name="shapes"></param>
+  void save(const std::wstring& filePath,
+    const std::vector<std::shared_ptr<IShape>>& shapes) {
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+    Writer writer(filePath);
+
+    for (const std::shared_ptr<IShape>& shape : shapes) {
+      writer.write(*factory, *shape);
+    }
+
+    writer.close();
+  }
+
+  /// <summary>
+  /// Load shapes from a compact scene file, appending them to the vector.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <param name="shapes"></param>
+  void load(const std::wstring& filePath,
+    std::vector<std::shared_ptr<IShape>>& shapes) {
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+    uint32_t typeCount = (uint32_t)factory->prototypeSize();
+    Reader reader(filePath);
+
+    uint32_t type;
+    Point first, second;
+    ShapeGraphic graphic;
+
+    while (reader.next(type, first, second, graphic)) {
+      if (type >= typeCount) {
+        throw std::runtime_error("(CompactScene) Corrupted shape type.");
+      }
+
+      shapes.push_back(factory->create((int)type, first, second, graphic));
+    }
+  }
+}
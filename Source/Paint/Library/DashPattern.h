@@ -0,0 +1,142 @@
+#pragma once
+
+/// <summary>
+/// Dashes and gaps of a pen style, in pixels along the stroke, as GDI
+/// draws them with a one pixel pen.
+///
+/// The pattern is unrolled into tables indexed by the phase (the pixel
+/// within the period): whether it is on, and how many pixels are left
+/// until it flips. Walking a stroke advances the phase by a table read
+/// per pixel, and a straight run of pixels goes dash by dash.
+/// </summary>
+class DashPattern {
+public:
+  /// <summary>
+  /// Longest period of a pattern.
+  /// </summary>
+  static constexpr int MAX_PERIOD = 32;
+
+private:
+  int _period;
+  bool _solid;
+
+  // Per phase: on or off, pixels left until the next flip (this one
+  // included), and the next phase.
+  uint8_t _on[MAX_PERIOD];
+  uint8_t _run[MAX_PERIOD];
+  uint8_t _next[MAX_PERIOD];
+
+  /// <summary>
+  /// Unroll a pattern.
+  /// </summary>
+  /// <param name="lengths">Dash, gap, dash, gap... (empty: solid).</param>
+  DashPattern(std::initializer_list<int> lengths) {
+    _solid = 0 == lengths.size();
+    _period = 0;
+
+    bool on = true;
+
+    for (int length : lengths) {
+      for (int i = 0; i < length; ++i) {
+        _on[_period] = on;
+        _run[_period] = (uint8_t)(length - i);
+        ++_period;
+      }
+
+      on = !on;
+    }
+
+    if (_solid) {
+      _on[0] = true;
+      _run[0] = 1;
+      _period = 1;
+    }
+
+    for (int phase = 0; phase < _period; ++phase) {
+      _next[phase] = (uint8_t)((phase + 1) % _period);
+    }
+  }
+
+public:
+  /// <summary>
+  /// Pattern of a pen style (PS_SOLID and unknown styles are solid).
+  /// </summary>
+  /// <param name="lineStyle"></param>
+  /// <returns></returns>
+  static const DashPattern& of(int lineStyle) {
+    static const DashPattern solid({});
+    static const DashPattern dash({ 18, 6 });
+    static const DashPattern dot({ 3, 3 });
+    static const DashPattern dashDot({ 9, 6, 3, 6 });
+    static const DashPattern dashDotDot({ 9, 3, 3, 3, 3, 3 });
+
+    switch (lineStyle) {
+    case PS_DASH:
+      return dash;
+    case PS_DOT:
+      return dot;
+    case PS_DASHDOT:
+      return dashDot;
+    case PS_DASHDOTDOT:
+      return dashDotDot;
+    default:
+      return solid;
+    }
+  }
+
+  bool isSolid() const { return _solid; }
+  int period() const { return _period; }
+
+  bool isOn(int phase) const { return 0 != _on[phase]; }
+
+  /// <summary>
+  /// Phase of the next pixel.
+  /// </summary>
+  /// <param name="phase"></param>
+  /// <returns></returns>
+  int next(int phase) const { return _next[phase]; }
+
+  /// <summary>
+  /// Phase count pixels further.
+  /// </summary>
+  /// <param name="phase"></param>
+  /// <param name="count"></param>
+  /// <returns></returns>
+  int advance(int phase, int64_t count) const {
+    return (int)((phase + count) % _period);
+  }
+
+  /// <summary>
+  /// Walk a straight run of pixels from a phase, dash by dash.
+  /// </summary>
+  /// <param name="phase">Phase of the first pixel.</param>
+  /// <param name="count">Pixels in the run.</param>
+  /// <param name="segment">
+  /// Called as segment(offset, length, on) for every dash and gap,
+  /// offset being from the first pixel.
+  /// </param>
+  /// <returns>Phase of the pixel after the run.</returns>
+  template <typename Segment>
+  int walk(int phase, int64_t count, Segment&& segment) const {
+    if (_solid) {
+      if (count > 0) {
+        segment((int64_t)0, count, true);
+      }
+
+      return 0;
+    }
+
+    int64_t offset = 0;
+
+    while (offset < count) {
+      int64_t length = min((int64_t)_run[phase], count - offset);
+
+      segment(offset, length, isOn(phase));
+
+      offset += length;
+      phase = advance(phase, length);
+    }
+
+    return phase;
+  }
+};
@@ -0,0 +1,521 @@
+#pragma once
+
+/// <summary>
+/// Flat list of draw commands, recorded from shapes and replayed
+/// into any render target.
+///
+/// Every command holds resolved coordinates and the index of its style
+/// in a table of distinct styles, so replaying never touches the shapes.
+/// Its bounds are computed once, when it is recorded, so commands out
+/// of view are rejected without a draw call, and so is its size, so
+/// commands too small to show their shape can be drawn as one pixel.
+/// The list remembers which commands every shape recorded: syncing it
+/// with a new list of shapes keeps the unchanged leading shapes in place,
+/// copies the commands of shapes it already knows and only records the
+/// new (or invalidated) ones.
+/// </summary>
+class DisplayList {
+public:
+  /// <summary>
+  /// Kind of primitive.
+  /// </summary>
+  enum Opcode : uint8_t {
+    LINE = 0,
+    RECTANGLE = 1,
+    ELLIPSE = 2,
+    DOT = 3
+  };
+
+  /// <summary>
+  /// Largest size a command records; bigger ones record this.
+  /// </summary>
+  static constexpr int MAX_EXTENT = 255;
+
+  /// <summary>
+  /// One primitive: a segment (x1, y1)-(x2, y2) or a box,
+  /// as IRenderTarget takes them (a dot is at (x1, y1)).
+  /// Its extent is the side, in pixels, of the square its pixels fit
+  /// in (0 if it draws none), at most MAX_EXTENT.
+  /// </summary>
+  struct Command {
+    uint8_t opcode;
+    uint8_t extent;
+    uint8_t reserved[2];
+    uint32_t style;
+    int32_t x1;
+    int32_t y1;
+    int32_t x2;
+    int32_t y2;
+  };
+
+  /// <summary>
+  /// Saved display lists start with this.
+  /// </summary>
+  static constexpr char MAGIC[4] = { 'P', 'S', 'D', 'L' };
+  static constexpr uint32_t VERSION = 1;
+
+private:
+  /// <summary>
+  /// File header.
+  /// </summary>
+  struct Header {
+    char magic[4];
+    uint32_t version;
+    uint32_t styleCount;
+    uint32_t commandCount;
+  };
+
+  /// <summary>
+  /// One entry of the saved style table (a ShapeGraphic).
+  /// </summary>
+  struct Style {
+    int32_t lineStyle;
+    int32_t lineWidth;
+    uint32_t lineColour;
+    int32_t backgroundBrush;
+    uint32_t backgroundColour;
+  };
+
+  struct StyleHash {
+    size_t operator()(const ShapeGraphic& graphic) const {
+      uint64_t bits = ((uint64_t)graphic.lineColour() << 32) ^
+        graphic.backgroundColour() ^
+        ((uint64_t)(uint32_t)graphic.lineStyle() << 8) ^
+        ((uint64_t)(uint32_t)graphic.lineWidth() << 16) ^
+        ((uint64_t)(uint32_t)graphic.backgroundBrush() << 24);
+
+      return std::hash<uint64_t>()(bits);
+    }
+  };
+
+  /// <summary>
+  /// Render target appending what shapes draw to a list.
+  /// </summary>
+  class Recorder : public IRenderTarget {
+  private:
+    DisplayList& _list;
+    uint32_t _style;
+    int _lineWidth;
+
+    void add(Opcode opcode, int x1, int y1, int x2, int y2) {
+      Command command;
+      command.opcode = opcode;
+      command.extent = extentOf(x1, y1, x2, y2, _lineWidth);
+      command.reserved[0] = command.reserved[1] = 0;
+      command.style = _style;
+      command.x1 = x1;
+      command.y1 = y1;
+      command.x2 = x2;
+      command.y2 = y2;
+
+      _list._commands.push_back(command);
+      _list._bounds.push_back(
+        IShape::boundsOf(Point(x1, y1), Point(x2, y2), _lineWidth)
+      );
+    }
+
+  public:
+    Recorder(DisplayList& list) : _list(list) {
+      _style = 0;
+      _lineWidth = 1;
+    }
+
+    void setStyle(const ShapeGraphic& graphic) override {
+      _style = _list.styleIndex(graphic);
+      _lineWidth = graphic.lineWidth();
+    }
+
+    void line(int x1, int y1, int x2, int y2) override {
+      add(LINE, x1, y1, x2, y2);
+    }
+
+    void rectangle(int left, int top, int right, int bottom) override {
+      add(RECTANGLE, left, top, right, bottom);
+    }
+
+    void ellipse(int left, int top, int right, int bottom) override {
+      add(ELLIPSE, left, top, right, bottom);
+    }
+
+    void dot(int x, int y) override {
+      add(DOT, x, y, x + 1, y + 1);
+    }
+  };
+
+  std::vector<Command> _commands;
+
+  // Bounds of every command (right and bottom excluded).
+  std::vector<RECT> _bounds;
+
+  std::vector<ShapeGraphic> _styles;
+  std::unordered_map<ShapeGraphic, uint32_t, StyleHash> _styleIndex;
+
+  // Shapes recorded, in order, and where their commands start
+  // (one more entry: the end of the last one). The list holds them,
+  // so a shape address is never reused while it is known.
+  std::vector<std::shared_ptr<IShape>> _sources;
+  std::vector<size_t> _firstCommand;
+
+  // Shapes changed in place since the last sync.
+  std::vector<const IShape*> _invalid;
+
+  /// <summary>
+  /// Index of a style in the table, added if new.
+  /// </summary>
+  /// <param name="graphic"></param>
+  /// <returns></returns>
+  uint32_t styleIndex(const ShapeGraphic& graphic) {
+    auto found = _styleIndex.find(graphic);
+
+    if (found != _styleIndex.end()) {
+      return found->second;
+    }
+
+    uint32_t index = (uint32_t)_styles.size();
+    _styles.push_back(graphic);
+    _styleIndex.emplace(graphic, index);
+
+    return index;
+  }
+
+  /// <summary>
+  /// Extent of a primitive drawn with a pen of some width. Boxes
+  /// exclude their right and bottom edges, and lines their end point.
+  /// </summary>
+  /// <returns></returns>
+  static uint8_t extentOf(int x1, int y1, int x2, int y2, int lineWidth) {
+    int64_t side = max(
+      std::abs((int64_t)x2 - x1),
+      std::abs((int64_t)y2 - y1)
+    );
+
+    if (side > 0) {
+      side += max(lineWidth, 1) - 1;
+    }
+
+    return (uint8_t)min(side, (int64_t)MAX_EXTENT);
+  }
+
+  bool isInvalid(const IShape* shape) const {
+    return std::find(_invalid.begin(), _invalid.end(), shape) != _invalid.end();
+  }
+
+public:
+  DisplayList() {
+    _firstCommand.push_back(0);
+  }
+
+  DisplayList(const DisplayList&) = delete;
+  DisplayList& operator=(const DisplayList&) = delete;
+
+public:
+  /// <summary>
+  /// Number of commands.
+  /// </summary>
+  /// <returns></returns>
+  size_t size() const { return _commands.size(); }
+
+  const std::vector<Command>& commands() const { return _commands; }
+  const std::vector<ShapeGraphic>& styles() const { return _styles; }
+
+  const ShapeGraphic& style(const Command& command) const {
+    return _styles[command.style];
+  }
+
+  /// <summary>
+  /// Box of the pixels a command may touch (right and bottom excluded).
+  /// </summary>
+  /// <param name="index"></param>
+  /// <returns></returns>
+  const RECT& bounds(size_t index) const {
+    return _bounds[index];
+  }
+
+  /// <summary>
+  /// Can a command touch a pixel of an area?
+  /// </summary>
+  /// <param name="index"></param>
+  /// <param name="area">Right and bottom excluded.</param>
+  /// <returns></returns>
+  bool intersects(size_t index, const RECT& area) const {
+    const RECT& bounds = _bounds[index];
+
+    return bounds.left < area.right && bounds.right > area.left &&
+      bounds.top < area.bottom && bounds.bottom > area.top;
+  }
+
+  /// <summary>
+  /// Forget every shape and command.
+  /// </summary>
+  void clear() {
+    _commands.clear();
+    _bounds.clear();
+    _styles.clear();
+    _styleIndex.clear();
+    _sources.clear();
+    _firstCommand.assign(1, 0);
+    _invalid.clear();
+  }
+
+  /// <summary>
+  /// A shape already recorded changed in place (e.g. moved);
+  /// the next sync records it again.
+  /// </summary>
+  /// <param name="shape"></param>
+  void invalidate(const IShape* shape) {
+    if (!isInvalid(shape)) {
+      _invalid.push_back(shape);
+    }
+  }
+
+  /// <summary>
+  /// Make the list draw these shapes, in this order.
+  /// </summary>
+  /// <param name="shapes"></param>
+  void sync(const std::vector<std::shared_ptr<IShape>>& shapes) {
+    // Leading shapes which did not change keep their commands in place.
+    size_t prefix = 0;
+    size_t limit = min(shapes.size(), _sources.size());
+
+    while (prefix < limit && shapes[prefix] == _sources[prefix] &&
+      (_invalid.empty() || !isInvalid(shapes[prefix].get()))) {
+      ++prefix;
+    }
+
+    if (prefix == shapes.size() && prefix == _sources.size()) {
+      _invalid.clear();
+      return;
+    }
+
+    // Commands of the other known shapes, to copy rather than record.
+    size_t keep = _firstCommand[prefix];
+    std::vector<Command> tail(_commands.begin() + keep, _commands.end());
+    std::vector<RECT> tailBounds(_bounds.begin() + keep, _bounds.end());
+    std::unordered_map<const IShape*, std::pair<size_t, size_t>> known;
+
+    for (size_t i = prefix; i < _sources.size(); ++i) {
+      if (!isInvalid(_sources[i].get())) {
+        known[_sources[i].get()] = std::make_pair(
+          _firstCommand[i] - keep,
+          _firstCommand[i + 1] - keep
+        );
+      }
+    }
+
+    _commands.resize(keep);
+    _bounds.resize(keep);
+    _sources.resize(prefix);
+    _firstCommand.resize(prefix + 1);
+
+    Recorder recorder(*this);
+
+    for (size_t i = prefix; i < shapes.size(); ++i) {
+      auto found = known.find(shapes[i].get());
+
+      if (found != known.end()) {
+        _commands.insert(
+          _commands.end(),
+          tail.begin() + found->second.first,
+          tail.begin() + found->second.second
+        );
+        _bounds.insert(
+          _bounds.end(),
+          tailBounds.begin() + found->second.first,
+          tailBounds.begin() + found->second.second
+        );
+      }
+
+      else {
+        shapes[i]->draw(recorder);
+      }
+
+      _sources.push_back(shapes[i]);
+      _firstCommand.push_back(_commands.size());
+    }
+
+    _invalid.clear();
+  }
+
+  /// <summary>
+  /// Replay one command.
+  /// </summary>
+  /// <param name="target"></param>
+  /// <param name="index"></param>
+  void replay(IRenderTarget& target, size_t index) const {
+    const Command& command = _commands[index];
+
+    target.setStyle(_styles[command.style]);
+
+    switch (command.opcode) {
+    case LINE:
+      target.line(command.x1, command.y1, command.x2, command.y2);
+      break;
+    case RECTANGLE:
+      target.rectangle(command.x1, command.y1, command.x2, command.y2);
+      break;
+    case ELLIPSE:
+      target.ellipse(command.x1, command.y1, command.x2, command.y2);
+      break;
+    case DOT:
+      target.dot(command.x1, command.y1);
+      break;
+    }
+  }
+
+  /// <summary>
+  /// Replay one command, as a single pixel at its centre if it is
+  /// no larger than the detail size: below a few pixels a shape
+  /// cannot be told apart from a dot, and a dot is one write.
+  /// </summary>
+  /// <param name="target"></param>
+  /// <param name="index"></param>
+  /// <param name="detailSize">Largest extent drawn as a dot, 0 for none.</param>
+  void replay(IRenderTarget& target, size_t index, int detailSize) const {
+    const Command& command = _commands[index];
+
+    // An empty primitive stays empty.
+    if (command.extent > detailSize || 0 == command.extent) {
+      replay(target, index);
+      return;
+    }
+
+    target.setStyle(_styles[command.style]);
+    target.dot(
+      (int)(((int64_t)command.x1 + command.x2) / 2),
+      (int)(((int64_t)command.y1 + command.y2) / 2)
+    );
+  }
+
+  /// <summary>
+  /// Replay every command, in order.
+  /// </summary>
+  /// <param name="target"></param>
+  void replay(IRenderTarget& target) const {
+    for (size_t i = 0; i < _commands.size(); ++i) {
+      replay(target, i);
+    }
+  }
+
+  /// <summary>
+  /// Replay, in order, the commands which can touch an area.
+  /// </summary>
+  /// <param name="target"></param>
+  /// <param name="area">Right and bottom excluded.</param>
+  /// <param name="detailSize">Largest extent drawn as a dot, 0 for none.</param>
+  /// <returns>Number of commands replayed, the others were culled.</returns>
+  size_t replay(IRenderTarget& target, const RECT& area, int detailSize = 0) const {
+    size_t drawn = 0;
+
+    for (size_t i = 0; i < _commands.size(); ++i) {
+      if (intersects(i, area)) {
+        replay(target, i, detailSize);
+        ++drawn;
+      }
+    }
+
+    return drawn;
+  }
+
+  /// <summary>
+  /// Write the commands and their styles to a file.
+  /// </summary>
+  /// <param name="filePath"></param>
+  void save(const std::wstring& filePath) const {
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.styleCount = (uint32_t)_styles.size();
+    header.commandCount = (uint32_t)_commands.size();
+
+    std::vector<Style> styles(_styles.size());
+
+    for (size_t i = 0; i < _styles.size(); ++i) {
+      styles[i].lineStyle = _styles[i].lineStyle();
+      styles[i].lineWidth = _styles[i].lineWidth();
+      styles[i].lineColour = _styles[i].lineColour();
+      styles[i].backgroundBrush = _styles[i].backgroundBrush();
+      styles[i].backgroundColour = _styles[i].backgroundColour();
+    }
+
+    std::ofstream out(Platform::streamPath(filePath), std::ios::binary | std::ios::trunc);
+
+    if (!out) {
+      throw std::runtime_error("(DisplayList) Cannot create file.");
+    }
+
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)styles.data(), styles.size() * sizeof(Style));
+    out.write((const char*)_commands.data(), _commands.size() * sizeof(Command));
+
+    if (!out) {
+      throw std::runtime_error("(DisplayList) Cannot write file.");
+    }
+  }
+
+  /// <summary>
+  /// Replace the list by one saved to a file. It knows no shapes:
+  /// the next sync records them all.
+  /// </summary>
+  /// <param name="filePath"></param>
+  void load(const std::wstring& filePath) {
+    MappedFile file(filePath);
+
+    if (file.size() < sizeof(Header)) {
+      throw std::runtime_error("(DisplayList) File is too small.");
+    }
+
+    const Header* header = (const Header*)file.data();
+
+    if (0 != memcmp(header->magic, MAGIC, sizeof(MAGIC))) {
+      throw std::runtime_error("(DisplayList) Not a display list.");
+    }
+
+    if (header->version != VERSION) {
+      throw std::runtime_error("(DisplayList) Unsupported version.");
+    }
+
+    uint64_t end = sizeof(Header) +
+      (uint64_t)header->styleCount * sizeof(Style) +
+      (uint64_t)header->commandCount * sizeof(Command);
+
+    if (end > file.size()) {
+      throw std::runtime_error("(DisplayList) File is truncated.");
+    }
+
+    const Style* styles = (const Style*)(file.data() + sizeof(Header));
+    const Command* commands = (const Command*)(styles + header->styleCount);
+
+    clear();
+
+    // Keep the saved order, commands refer to it.
+    for (uint32_t i = 0; i < header->styleCount; ++i) {
+      ShapeGraphic graphic(
+        styles[i].lineStyle,
+        styles[i].lineWidth,
+        styles[i].lineColour,
+        styles[i].backgroundBrush,
+        styles[i].backgroundColour
+      );
+
+      _styles.push_back(graphic);
+      _styleIndex.emplace(graphic, i);
+    }
+
+    for (uint32_t i = 0; i < header->commandCount; ++i) {
+      if (commands[i].style >= header->styleCount || commands[i].opcode > DOT) {
+        clear();
+        throw std::runtime_error("(DisplayList) Corrupted command.");
+      }
+    }
+
+    _commands.assign(commands, commands + header->commandCount);
+
+    for (const Command& command : _commands) {
+      _bounds.push_back(IShape::boundsOf(
+        Point(command.x1, command.y1),
+        Point(command.x2, command.y2),
+        _styles[command.style].lineWidth()
+      ));
+    }
+  }
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+/// <summary>
+/// In-memory image of 32-bit pixels (0xAARRGGBB, the layout of a
+/// 32 bpp DIB), rows top-down. It owns its pixels, or views
+/// someone else's (a DIB section).
+/// </summary>
+class Framebuffer {
+private:
+  int _width;
+  int _height;
+  std::vector<uint32_t> _storage;
+  uint32_t* _pixels;
+
+public:
+  /// <summary>
+  /// Create a framebuffer, every pixel set to colour.
+  /// </summary>
+  /// <param name="width"></param>
+  /// <param name="height"></param>
+  /// <param name="colour">Pixel value (see toPixel).</param>
+  Framebuffer(int width, int height, uint32_t colour = 0xFFFFFFFF) {
+    if (width < 0 || height < 0) {
+      throw std::length_error("(Framebuffer) Negative size.");
+    }
+
+    _width = width;
+    _height = height;
+    _storage.assign((size_t)width * height, colour);
+    _pixels = _storage.data();
+  }
+
+  /// <summary>
+  /// View pixels owned elsewhere, which must outlive the framebuffer.
+  /// </summary>
+  /// <param name="pixels">width * height pixels, rows top-down.</param>
+  /// <param name="width"></param>
+  /// <param name="height"></param>
+  Framebuffer(uint32_t* pixels, int width, int height) {
+    if (width < 0 || height < 0) {
+      throw std::length_error("(Framebuffer) Negative size.");
+    }
+
+    _width = width;
+    _height = height;
+    _pixels = pixels;
+  }
+
+  Framebuffer(const Framebuffer&) = delete;
+  Framebuffer& operator=(const Framebuffer&) = delete;
+
+public:
+  int width() const { return _width; }
+  int height() const { return _height; }
+
+  uint32_t* row(int y) { return _pixels + (size_t)y * _width; }
+  const uint32_t* row(int y) const { return _pixels + (size_t)y * _width; }
+
+  uint32_t pixel(int x, int y) const { return row(y)[x]; }
+
+  const uint32_t* data() const { return _pixels; }
+
+  /// <summary>
+  /// Set every pixel.
+  /// </summary>
+  /// <param name="colour"></param>
+  void clear(uint32_t colour) {
+    SpanKernels::fill(_pixels, (size_t)_width * _height, colour);
+  }
+
+  /// <summary>
+  /// Set count pixels of row y from x on. The caller clips.
+  /// </summary>
+  /// <param name="x"></param>
+  /// <param name="y"></param>
+  /// <param name="count"></param>
+  /// <param name="colour"></param>
+  void fillSpan(int x, int y, int count, uint32_t colour) {
+    SpanKernels::fill(row(y) + x, count, colour);
+  }
+
+  /// <summary>
+  /// Blend a colour (its alpha being the opacity) over count pixels
+  /// of row y from x on. The caller clips.
+  /// </summary>
+  /// <param name="x"></param>
+  /// <param name="y"></param>
+  /// <param name="count"></param>
+  /// <param name="colour"></param>
+  void blendSpan(int x, int y, int count, uint32_t colour) {
+    SpanKernels::blend(row(y) + x, count, colour);
+  }
+
+  /// <summary>
+  /// Blend an opaque colour over count pixels of row y from x on,
+  /// pixel i with opacity coverage[i] (0 to 255). The caller clips.
+  /// </summary>
+  /// <param name="x"></param>
+  /// <param name="y"></param>
+  /// <param name="coverage"></param>
+  /// <param name="count"></param>
+  /// <param name="colour"></param>
+  void blendMaskSpan(int x, int y, const uint8_t* coverage, int count, uint32_t colour) {
+    SpanKernels::blendMask(row(y) + x, coverage, count, colour);
+  }
+
+  /// <summary>
+  /// Blend an opaque colour over count pixels of rows y and mirrorY
+  /// (which may be the same) from x on, and over their mirrors: pixels
+  /// x + i and x + span - i with opacity coverage[i] (0 to 255).
+  /// The caller clips.
+  /// </summary>
+  /// <param name="x"></param>
+  /// <param name="y"></param>
+  /// <param name="mirrorY"></param>
+  /// <param name="span"></param>
+  /// <param name="coverage"></param>
+  /// <param name="count"></param>
+  /// <param name="colour"></param>
+  void blendMirroredSpans(int x, int y, int mirrorY, int span, const uint8_t* coverage,
+    int count, uint32_t colour) {
+    SpanKernels::blendMirrored(row(y) + x, row(mirrorY) + x, span, coverage, count, colour);
+  }
+
+  /// <summary>
+  /// Offset of pixel (x, y) from the first one, for blendScattered.
+  /// </summary>
+  size_t offset(int x, int y) const { return (size_t)y * _width + x; }
+
+  /// <summary>
+  /// Blend an opaque colour over count pixels anywhere, pixel
+  /// offsets[i] with opacity coverage[i] (0 to 255). No pixel may
+  /// come twice. The caller clips.
+  /// </summary>
+  /// <param name="offsets"></param>
+  /// <param name="coverage"></param>
+  /// <param name="count"></param>
+  /// <param name="colour"></param>
+  void blendScattered(const size_t* offsets, const uint8_t* coverage, size_t count,
+    uint32_t colour) {
+    SpanKernels::blendScattered(_pixels, offsets, coverage, count, colour);
+  }
+
+public:
+  /// <summary>
+  /// Pixel value of an (opaque) COLORREF.
+  /// </summary>
+  /// <param name="colour"></param>
+  /// <returns></returns>
+  static uint32_t toPixel(COLORREF colour) {
+    uint32_t red = colour & 0xFF;
+    uint32_t green = (colour >> 8) & 0xFF;
+    uint32_t blue = (colour >> 16) & 0xFF;
+
+    return 0xFF000000 | (red << 16) | (green << 8) | blue;
+  }
+};
@@ -0,0 +1,303 @@
+#pragma once
+
+/// <summary>
+/// Creates GDI pens for a StyleCache.
+/// </summary>
+class GdiStyleFactory : public IStyleFactory {
+public:
+  void* createPen(const ShapeGraphic& graphic) override {
+    return CreatePen(
+      graphic.lineStyle(),
+      graphic.lineWidth(),
+      graphic.lineColour()
+    );
+  }
+
+  void deletePen(void* pen) override {
+    DeleteObject((HPEN)pen);
+  }
+};
+
+/// <summary>
+/// Render target drawing on a device context with GDI.
+///
+/// Pens come from a StyleCache, and the pen, brush and brush colour
+/// are only changed when a shape needs other ones than the previous
+/// shape did. Lines and rectangles reaching far out of the clip box
+/// of the context are cut down before GDI sees them, and outlines
+/// that cannot show in it are skipped.
+/// </summary>
+class GdiRenderTarget : public IRenderTarget {
+private:
+  /// <summary>
+  /// Pixels kept beyond the clip box (besides the pen width), so the
+  /// cut ends never show.
+  /// </summary>
+  static constexpr int64_t CLIP_MARGIN = 1024;
+
+  /// <summary>
+  /// Every dash pattern of a one pixel pen repeats within this many
+  /// pixels; cuts are made by whole periods to keep the dashes where
+  /// they were.
+  /// </summary>
+  static constexpr int64_t DASH_PERIOD = 24;
+
+  /// <summary>
+  /// GDI draws nothing past coordinates of 27 bits.
+  /// </summary>
+  static constexpr int64_t GDI_LIMIT = ((int64_t)1 << 27) - 1;
+
+  HDC _hdc;
+  StyleCache& _styles;
+
+  // Clip box of the context, when it has one.
+  bool _hasClip;
+  RECT _clip;
+
+  // Style the context is set up for.
+  bool _hasStyle;
+  ShapeGraphic _style;
+  HGDIOBJ _pen;
+
+  HGDIOBJ _oldPen;
+  HGDIOBJ _oldBrush;
+
+public:
+  /// <summary>
+  /// Draw on a device context; its pen and brush are restored
+  /// when the target goes away.
+  /// </summary>
+  /// <param name="hdc"></param>
+  /// <param name="styles">Pens to use, they outlive the target.</param>
+  GdiRenderTarget(HDC hdc, StyleCache& styles) : _styles(styles) {
+    _hdc = hdc;
+    _hasStyle = false;
+    _pen = NULL;
+    _oldPen = NULL;
+    _oldBrush = NULL;
+
+    int region = GetClipBox(hdc, &_clip);
+    _hasClip = NULLREGION == region || SIMPLEREGION == region || COMPLEXREGION == region;
+  }
+
+  GdiRenderTarget(const GdiRenderTarget&) = delete;
+  GdiRenderTarget& operator=(const GdiRenderTarget&) = delete;
+
+  ~GdiRenderTarget() {
+    if (_oldPen) {
+      SelectObject(_hdc, _oldPen);
+    }
+
+    if (_oldBrush) {
+      SelectObject(_hdc, _oldBrush);
+    }
+  }
+
+public:
+  HDC hdc() const { return _hdc; }
+
+  void setStyle(const ShapeGraphic& graphic) override {
+    // Same style as the previous shape: nothing to change.
+    if (_hasStyle && graphic == _style) {
+      return;
+    }
+
+    HGDIOBJ pen = (HGDIOBJ)_styles.pen(graphic);
+
+    if (pen != _pen) {
+      HGDIOBJ oldPen = SelectObject(_hdc, pen);
+
+      // Remember what the context held before the first style.
+      if (!_oldPen) {
+        _oldPen = oldPen;
+      }
+
+      _pen = pen;
+    }
+
+    if (!_hasStyle || graphic.backgroundBrush() != _style.backgroundBrush()) {
+      HGDIOBJ oldBrush = SelectObject(
+        _hdc,
+        GetStockObject(graphic.backgroundBrush())
+      );
+
+      if (!_oldBrush) {
+        _oldBrush = oldBrush;
+      }
+    }
+
+    if (!_hasStyle || graphic.backgroundColour() != _style.backgroundColour()) {
+      SetDCBrushColor(_hdc, graphic.backgroundColour());
+    }
+
+    _style = graphic;
+    _hasStyle = true;
+  }
+
+  void line(int x1, int y1, int x2, int y2) override {
+    if (_hasClip && !clipLine(x1, y1, x2, y2)) {
+      return;
+    }
+
+    MoveToEx(_hdc, x1, y1, NULL);
+    LineTo(_hdc, x2, y2);
+  }
+
+  void rectangle(int left, int top, int right, int bottom) override {
+    if (_hasClip && (
+      !clipRange(left, right, _clip.left, _clip.right) ||
+      !clipRange(top, bottom, _clip.top, _clip.bottom))) {
+      return;
+    }
+
+    Rectangle(_hdc, left, top, right, bottom);
+  }
+
+  /// <summary>
+  /// GDI draws an ellipse from its whole bounding box, so a cut box
+  /// would draw another curve: ellipses are never cut, only skipped
+  /// when they miss the clip box, or when they are outlines around it.
+  /// </summary>
+  void ellipse(int left, int top, int right, int bottom) override {
+    if (_hasClip && !ellipseShows(left, top, right, bottom)) {
+      return;
+    }
+
+    Ellipse(_hdc, left, top, right, bottom);
+  }
+
+  void dot(int x, int y) override {
+    // No style yet: no pen or brush to take the colour of.
+    if (!_hasStyle) {
+      return;
+    }
+
+    COLORREF colour = _style.lineColour();
+
+    if (PS_NULL == _style.lineStyle() && !_style.brushColour(colour)) {
+      return;
+    }
+
+    SetPixelV(_hdc, x, y, colour);
+  }
+
+private:
+  /// <summary>
+  /// Pixels a shape may reach out of the clip box and still show.
+  /// </summary>
+  int64_t clipMargin() const {
+    return CLIP_MARGIN + (_hasStyle ? _style.lineWidth() : 0);
+  }
+
+  /// <summary>
+  /// Can any of the ellipse show in the clip box?
+  /// </summary>
+  bool ellipseShows(int left, int top, int right, int bottom) const {
+    int64_t margin = clipMargin();
+    RECT box = {
+      (LONG)(_clip.left - margin),
+      (LONG)(_clip.top - margin),
+      (LONG)(_clip.right + margin),
+      (LONG)(_clip.bottom + margin)
+    };
+
+    if (max(left, right) < box.left || min(left, right) > box.right ||
+      max(top, bottom) < box.top || min(top, bottom) > box.bottom) {
+      return false;
+    }
+
+    // An outline around the whole box, with nothing inside it drawn.
+    return !_hasStyle || _style.backgroundBrush() != NULL_BRUSH ||
+      !Clipping::insideEllipse(box, min(left, right), min(top, bottom),
+        max(left, right), max(top, bottom), (double)margin);
+  }
+
+  /// <summary>
+  /// Cut a line reaching far out of the clip box down to the part
+  /// near it. The cut ends are on whole pixels of the line, so it
+  /// keeps its pixels and dashes.
+  /// </summary>
+  /// <returns>False if the line misses the clip box.</returns>
+  bool clipLine(int& x1, int& y1, int& x2, int& y2) const {
+    int64_t margin = clipMargin();
+    RECT box = {
+      (LONG)(_clip.left - margin),
+      (LONG)(_clip.top - margin),
+      (LONG)(_clip.right + margin),
+      (LONG)(_clip.bottom + margin)
+    };
+
+    if (Clipping::contains(box, x1, y1) && Clipping::contains(box, x2, y2)) {
+      return true;
+    }
+
+    double enter, exit;
+
+    if (!Clipping::clipSegment(x1, y1, x2, y2,
+      box.left, box.top, box.right, box.bottom, enter, exit)) {
+      return false;
+    }
+
+    // Steps along the major axis.
+    int64_t dx = (int64_t)x2 - x1;
+    int64_t dy = (int64_t)y2 - y1;
+    int64_t length = max(std::abs(dx), std::abs(dy));
+    int64_t period = _hasStyle && PS_SOLID == _style.lineStyle() ? 1 : DASH_PERIOD;
+    int64_t from, to;
+
+    Clipping::latticeSteps(dx, dy, enter, exit, period, from, to);
+
+    // No whole pixel of the line near the box, and its ends out of
+    // reach of GDI: better drawn a little off (rounded ends, the
+    // start moved by whole periods) than not at all.
+    if (!reachable(x1 + dx * (double)from / length, y1 + dy * (double)from / length) ||
+      !reachable(x1 + dx * (double)to / length, y1 + dy * (double)to / length)) {
+      from = (int64_t)std::floor(enter * length / period) * period;
+      to = min((int64_t)std::ceil(exit * length) + 1, length);
+    }
+
+    int startX = x1, startY = y1;
+    x1 = (int)(startX + std::llround((double)dx * from / length));
+    y1 = (int)(startY + std::llround((double)dy * from / length));
+    x2 = (int)(startX + std::llround((double)dx * to / length));
+    y2 = (int)(startY + std::llround((double)dy * to / length));
+
+    return true;
+  }
+
+  /// <summary>
+  /// Can GDI draw to the point?
+  /// </summary>
+  static bool reachable(double x, double y) {
+    return std::abs(x) <= GDI_LIMIT && std::abs(y) <= GDI_LIMIT;
+  }
+
+  /// <summary>
+  /// Cut the sides of a rectangle far out of the clip box along one
+  /// axis, by whole dash periods.
+  /// </summary>
+  /// <returns>False if the rectangle misses the clip box.</returns>
+  bool clipRange(int& low, int& high, LONG clipLow, LONG clipHigh) const {
+    if (low > high) {
+      std::swap(low, high);
+    }
+
+    int64_t margin = clipMargin();
+    int64_t lowest = clipLow - margin;
+    int64_t highest = clipHigh + margin;
+
+    if (high < lowest || low > highest) {
+      return false;
+    }
+
+    if (low < lowest) {
+      low = (int)(low + (lowest - low) / DASH_PERIOD * DASH_PERIOD);
+    }
+
+    if (high > highest) {
+      high = (int)(high - (high - highest) / DASH_PERIOD * DASH_PERIOD);
+    }
+
+    return true;
+  }
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+/// <summary>
+/// Read-only memory-mapped file.
+/// The view is released when the object goes out of scope.
+/// </summary>
+class MappedFile {
+private:
+#ifdef _WIN32
+  HANDLE _file;
+  HANDLE _mapping;
+#else
+  int _file;
+#endif
+  const char* _data;
+  size_t _size;
+
+  /// <summary>
+  /// Release every handle held.
+  /// </summary>
+  void close() {
+#ifdef _WIN32
+    if (_data) {
+      UnmapViewOfFile(_data);
+    }
+
+    if (_mapping) {
+      CloseHandle(_mapping);
+    }
+
+    if (_file != INVALID_HANDLE_VALUE) {
+      CloseHandle(_file);
+    }
+
+    _file = INVALID_HANDLE_VALUE;
+    _mapping = NULL;
+#else
+    if (_data) {
+      munmap((void*)_data, _size);
+    }
+
+    if (_file >= 0) {
+      ::close(_file);
+    }
+
+    _file = -1;
+#endif
+    _data = NULL;
+    _size = 0;
+  }
+
+public:
+  /// <summary>
+  /// Map a whole file into memory.
+  /// </summary>
+  /// <param name="filePath"></param>
+  MappedFile(const std::wstring& filePath) {
+#ifdef _WIN32
+    _file = INVALID_HANDLE_VALUE;
+    _mapping = NULL;
+    _data = NULL;
+    _size = 0;
+
+    // Others may still rename or replace the file (a paged scene
+    // saved over itself); the view keeps the old content.
+    _file = CreateFileW(
+      filePath.c_str(),
+      GENERIC_READ,
+      FILE_SHARE_READ | FILE_SHARE_DELETE,
+      NULL,
+      OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL,
+      NULL
+    );
+
+    if (INVALID_HANDLE_VALUE == _file) {
+      throw std::runtime_error("(MappedFile) CreateFile");
+    }
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx(_file, &fileSize)) {
+      close();
+      throw std::runtime_error("(MappedFile) GetFileSizeEx");
+    }
+
+    _size = (size_t)fileSize.QuadPart;
+
+    // Mapping an empty file fails, an empty view is fine though.
+    if (0 == _size) {
+      return;
+    }
+
+    _mapping = CreateFileMappingW(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (!_mapping) {
+      close();
+      throw std::runtime_error("(MappedFile) CreateFileMapping");
+    }
+
+    _data = (const char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (!_data) {
+      close();
+      throw std::runtime_error("(MappedFile) MapViewOfFile");
+    }
+#else
+    _data = NULL;
+    _size = 0;
+
+    _file = open(Platform::streamPath(filePath).c_str(), O_RDONLY);
+
+    if (_file < 0) {
+      throw std::runtime_error("(MappedFile) open");
+    }
+
+    struct stat status;
+
+    if (fstat(_file, &status) != 0) {
+      close();
+      throw std::runtime_error("(MappedFile) fstat");
+    }
+
+    // Mapping an empty file fails, an empty view is fine though.
+    if (0 == status.st_size) {
+      return;
+    }
+
+    void* view = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, _file, 0);
+
+    if (MAP_FAILED == view) {
+      close();
+      throw std::runtime_error("(MappedFile) mmap");
+    }
+
+    _data = (const char*)view;
+    _size = (size_t)status.st_size;
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    close();
+  }
+
+public:
+  const char* data() const { return _data; }
+  size_t size() const { return _size; }
+
+  /// <summary>
+  /// The whole file as a string view.
+  /// </summary>
+  /// <returns></returns>
+  std::string_view view() const {
+    return std::string_view(_data, _size);
+  }
+};
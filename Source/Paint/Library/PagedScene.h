@@ -0,0 +1,546 @@
+#pragma once
+
+/// <summary>
+/// Base layer of a huge binary scene, decoded lazily from its file.
+///
+/// The file stays mapped; only the records of the tiles around the
+/// viewport are turned into shapes. Tiles are loaded on demand and the
+/// least recently used ones are dropped once the resident shapes go
+/// over the memory budget, so opening costs O(1) whatever the size
+/// of the board, and boards larger than RAM can be viewed.
+///
+/// The records are edited by taking them out into the document above
+/// the layer: selecting one hands its shape over, raised on top as any
+/// selected shape is, and the layer no longer shows, hits or saves it.
+/// Untaken records keep their place: the document is the untaken
+/// records in file order, then the shapes above.
+/// </summary>
+class PagedScene {
+public:
+  /// <summary>
+  /// Scenes with fewer shapes are loaded into shapesVector instead.
+  /// </summary>
+  static constexpr uint32_t MIN_SHAPES = 1 << 20;
+
+  /// <summary>
+  /// Default memory budget of the resident shapes.
+  /// </summary>
+  static constexpr size_t DEFAULT_BUDGET = (size_t)256 << 20;
+
+  /// <summary>
+  /// Rough cost of a resident shape (object, control block, bookkeeping).
+  /// </summary>
+  static constexpr size_t BYTES_PER_SHAPE = 128;
+
+private:
+  /// <summary>
+  /// A decoded record, shared by every loaded tile it spans.
+  /// </summary>
+  struct Resident {
+    std::shared_ptr<IShape> shape;
+    uint32_t tileCount;
+  };
+
+  /// <summary>
+  /// Inclusive range of tiles.
+  /// </summary>
+  struct TileRange {
+    int64_t firstColumn;
+    int64_t firstRow;
+    int64_t lastColumn;
+    int64_t lastRow;
+
+    bool operator==(const TileRange& other) const {
+      return firstColumn == other.firstColumn &&
+        firstRow == other.firstRow &&
+        lastColumn == other.lastColumn &&
+        lastRow == other.lastRow;
+    }
+
+    bool contains(int64_t column, int64_t row) const {
+      return column >= firstColumn && column <= lastColumn &&
+        row >= firstRow && row <= lastRow;
+    }
+
+    bool isEmpty() const {
+      return firstColumn > lastColumn || firstRow > lastRow;
+    }
+  };
+
+  std::wstring _filePath;
+  MappedFile _file;
+
+  const BinaryScene::Header* _header;
+  const BinaryScene::TileIndex* _tiles;
+  const BinaryScene::Record* _records;
+  const uint64_t* _cells;
+  const uint32_t* _entries;
+
+  // Bucket of the shapes shown with any area.
+  uint32_t _largeBucket;
+
+  std::vector<ShapeGraphic> _graphics;
+
+  // Record index -> decoded shape.
+  std::unordered_map<uint32_t, Resident> _resident;
+
+  // Loaded tiles, most recently used first.
+  std::list<uint32_t> _lru;
+  std::unordered_map<uint32_t, std::list<uint32_t>::iterator> _loaded;
+
+  size_t _budget;
+
+  // Shapes of the last requested area, in z-order.
+  TileRange _visibleRange;
+  std::vector<std::shared_ptr<IShape>> _visible;
+
+  // Records taken into the document, ascending.
+  std::vector<uint32_t> _taken;
+
+  bool isTaken(uint32_t index) const {
+    return std::binary_search(_taken.begin(), _taken.end(), index);
+  }
+
+  /// <summary>
+  /// Decode one record.
+  /// </summary>
+  /// <param name="index"></param>
+  /// <returns></returns>
+  std::shared_ptr<IShape> decode(uint32_t index) const {
+    const BinaryScene::Record& record = _records[index];
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+
+    if (record.type >= (uint32_t)factory->prototypeSize() ||
+      record.style >= _header->styleCount) {
+      throw std::runtime_error("(PagedScene) Corrupted shape record.");
+    }
+
+    return factory->create(
+      (int)record.type,
+      Point(record.x1, record.y1),
+      Point(record.x2, record.y2),
+      _graphics[record.style]
+    );
+  }
+
+  /// <summary>
+  /// Record indices listed by a tile.
+  /// </summary>
+  /// <param name="tile"></param>
+  /// <param name="begin"></param>
+  /// <param name="end"></param>
+  void tileEntries(uint32_t tile, const uint32_t*& begin,
+    const uint32_t*& end) const {
+    uint64_t first = min(_cells[tile], (uint64_t)_tiles->entryCount);
+    uint64_t last = min(_cells[tile + 1], (uint64_t)_tiles->entryCount);
+
+    begin = _entries + first;
+    end = _entries + max(first, last);
+  }
+
+  /// <summary>
+  /// Make a tile resident (or mark it as just used).
+  /// </summary>
+  /// <param name="tile"></param>
+  void loadTile(uint32_t tile) {
+    auto found = _loaded.find(tile);
+
+    if (found != _loaded.end()) {
+      _lru.splice(_lru.begin(), _lru, found->second);
+      return;
+    }
+
+    const uint32_t* begin;
+    const uint32_t* end;
+    tileEntries(tile, begin, end);
+
+    for (const uint32_t* entry = begin; entry != end; ++entry) {
+      if (*entry >= _header->shapeCount) {
+        throw std::runtime_error("(PagedScene) Corrupted tile index.");
+      }
+
+      if (isTaken(*entry)) {
+        continue;
+      }
+
+      Resident& resident = _resident[*entry];
+
+      if (!resident.shape) {
+        resident.shape = decode(*entry);
+        resident.tileCount = 0;
+      }
+
+      ++resident.tileCount;
+    }
+
+    _lru.push_front(tile);
+    _loaded.emplace(tile, _lru.begin());
+  }
+
+  /// <summary>
+  /// Drop a tile, and the shapes no other loaded tile holds.
+  /// </summary>
+  /// <param name="tile"></param>
+  void unloadTile(uint32_t tile) {
+    const uint32_t* begin;
+    const uint32_t* end;
+    tileEntries(tile, begin, end);
+
+    for (const uint32_t* entry = begin; entry != end; ++entry) {
+      auto found = _resident.find(*entry);
+
+      if (found != _resident.end() && 0 == --found->second.tileCount) {
+        _resident.erase(found);
+      }
+    }
+
+    auto found = _loaded.find(tile);
+    _lru.erase(found->second);
+    _loaded.erase(found);
+  }
+
+  /// <summary>
+  /// Evict least recently used tiles outside the visible range
+  /// until the resident shapes fit in the budget.
+  /// </summary>
+  void evict() {
+    size_t maxShapes = _budget / BYTES_PER_SHAPE;
+    auto tile = _lru.end();
+
+    while (_resident.size() > maxShapes && tile != _lru.begin()) {
+      --tile;
+
+      uint32_t current = *tile;
+      int64_t column = current % _tiles->columns;
+      int64_t row = current / _tiles->columns;
+
+      if (_visibleRange.contains(column, row) || current == _largeBucket) {
+        continue;
+      }
+
+      // Step past it before it is erased.
+      ++tile;
+      unloadTile(current);
+    }
+  }
+
+  /// <summary>
+  /// Tiles overlapping an area.
+  /// </summary>
+  /// <param name="area"></param>
+  /// <returns></returns>
+  TileRange rangeOf(const RECT& area) const {
+    int64_t size = _tiles->tileSize;
+
+    auto tileOf = [size](int64_t value, int64_t origin) {
+      int64_t offset = value - origin;
+
+      // Floor division, the area may start left of the origin.
+      return offset >= 0 ? offset / size : -((-offset + size - 1) / size);
+    };
+
+    TileRange range;
+    range.firstColumn = max((int64_t)0, tileOf(area.left, _tiles->originX));
+    range.firstRow = max((int64_t)0, tileOf(area.top, _tiles->originY));
+    range.lastColumn = min((int64_t)_tiles->columns - 1,
+      tileOf(area.right, _tiles->originX));
+    range.lastRow = min((int64_t)_tiles->rows - 1,
+      tileOf(area.bottom, _tiles->originY));
+
+    return range;
+  }
+
+public:
+  /// <summary>
+  /// Map a binary scene. Nothing is decoded yet.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <param name="budget">Memory budget of the resident shapes, in bytes.</param>
+  PagedScene(const std::wstring& filePath, size_t budget = DEFAULT_BUDGET)
+    : _filePath(filePath), _file(filePath) {
+    _header = BinaryScene::validate(_file);
+    _tiles = BinaryScene::tileIndex(_file);
+
+    _records = (const BinaryScene::Record*)(_file.data() + _header->recordOffset);
+    _cells = (const uint64_t*)(_file.data() + _tiles->cellOffset);
+    _entries = (const uint32_t*)(_file.data() + _tiles->entryOffset);
+
+    _largeBucket = _tiles->columns * _tiles->rows;
+
+    const BinaryScene::Style* styles =
+      (const BinaryScene::Style*)(_file.data() + _header->styleOffset);
+
+    _graphics.reserve(_header->styleCount);
+
+    for (uint32_t i = 0; i < _header->styleCount; ++i) {
+      _graphics.push_back(BinaryScene::toGraphic(styles[i]));
+    }
+
+    _budget = budget;
+    _visibleRange = { 0, 0, -1, -1 };
+  }
+
+  PagedScene(const PagedScene&) = delete;
+  PagedScene& operator=(const PagedScene&) = delete;
+
+  ~PagedScene() {
+    // Do nothing.
+  }
+
+public:
+  /// <summary>
+  /// Should a binary scene be opened paged rather than loaded whole?
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <returns></returns>
+  static bool shouldPage(const std::wstring& filePath) {
+    MappedFile file(filePath);
+    const BinaryScene::Header* header = BinaryScene::validate(file);
+
+    return header->shapeCount >= MIN_SHAPES;
+  }
+
+  const std::wstring& filePath() const { return _filePath; }
+
+  /// <summary>
+  /// Records in the file, taken ones included.
+  /// </summary>
+  /// <returns></returns>
+  size_t recordCount() const { return _header->shapeCount; }
+
+  /// <summary>
+  /// Shapes still in the layer, the ones taken out left aside.
+  /// </summary>
+  /// <returns></returns>
+  size_t shapeCount() const { return _header->shapeCount - _taken.size(); }
+
+  /// <summary>
+  /// Records taken into the document, ascending.
+  /// </summary>
+  /// <returns></returns>
+  const std::vector<uint32_t>& taken() const { return _taken; }
+
+  size_t residentCount() const { return _resident.size(); }
+
+  size_t loadedTileCount() const { return _loaded.size(); }
+
+  /// <summary>
+  /// Shapes that may cover an area, in z-order.
+  /// Tiles are loaded as needed; the result stays valid
+  /// until the next call.
+  /// </summary>
+  /// <param name="area"></param>
+  /// <returns></returns>
+  const std::vector<std::shared_ptr<IShape>>& visible(const RECT& area) {
+    TileRange range = rangeOf(area);
+
+    if (range == _visibleRange) {
+      return _visible;
+    }
+
+    _visibleRange = range;
+    _visible.clear();
+
+    if (range.isEmpty()) {
+      evict();
+      return _visible;
+    }
+
+    // Gather the records of every tile; each list is ascending,
+    // so sorting the union gives back the file (z-) order.
+    std::vector<uint32_t> indices;
+
+    for (int64_t row = range.firstRow; row <= range.lastRow; ++row) {
+      for (int64_t column = range.firstColumn; column <= range.lastColumn; ++column) {
+        uint32_t tile = (uint32_t)(row * _tiles->columns + column);
+        const uint32_t* begin;
+        const uint32_t* end;
+
+        loadTile(tile);
+        tileEntries(tile, begin, end);
+        indices.insert(indices.end(), begin, end);
+      }
+    }
+
+    // Large shapes are listed once, for every area.
+    const uint32_t* begin;
+    const uint32_t* end;
+
+    loadTile(_largeBucket);
+    tileEntries(_largeBucket, begin, end);
+    indices.insert(indices.end(), begin, end);
+
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+    _visible.reserve(indices.size());
+
+    for (uint32_t index : indices) {
+      auto found = _resident.find(index);
+
+      // Taken records are not loaded.
+      if (found != _resident.end()) {
+        _visible.push_back(found->second.shape);
+      }
+    }
+
+    evict();
+
+    return _visible;
+  }
+
+  /// <summary>
+  /// Topmost record still in the layer lying inside a selection, as
+  /// IShape::in tells. Only the records the tiles under the selection
+  /// list are tested, unless it spans more entries than there are
+  /// records.
+  /// </summary>
+  /// <param name="topLeft"></param>
+  /// <param name="rightBottom"></param>
+  /// <returns>Its index, -1 if none.</returns>
+  int64_t topmost(const Point& topLeft, const Point& rightBottom) {
+    if (topLeft.x() > rightBottom.x() || topLeft.y() > rightBottom.y()) {
+      return -1;
+    }
+
+    auto isInside = [&](uint32_t index) {
+      if (isTaken(index)) {
+        return false;
+      }
+
+      auto found = _resident.find(index);
+      std::shared_ptr<IShape> shape = found != _resident.end() ?
+        found->second.shape : decode(index);
+
+      return shape->in(topLeft, rightBottom);
+    };
+
+    RECT area;
+    area.left = topLeft.x();
+    area.top = topLeft.y();
+    area.right = rightBottom.x();
+    area.bottom = rightBottom.y();
+
+    TileRange range = rangeOf(area);
+    int64_t tileCount = range.isEmpty() ? 0 :
+      (range.lastColumn - range.firstColumn + 1) * (range.lastRow - range.firstRow + 1);
+
+    // As many entries as records: every record is tested from the
+    // top down instead, the topmost ones are the most likely inside.
+    uint64_t perTile = (uint64_t)_tiles->entryCount / ((uint64_t)_largeBucket + 1) + 1;
+
+    if ((uint64_t)tileCount * perTile >= _header->shapeCount) {
+      for (uint32_t i = _header->shapeCount; i-- > 0;) {
+        if (isInside(i)) {
+          return i;
+        }
+      }
+
+      return -1;
+    }
+
+    // A shape inside has its points in the selection, and so in
+    // the tiles under it, or else in the bucket of large shapes.
+    std::vector<uint32_t> indices;
+    const uint32_t* begin;
+    const uint32_t* end;
+
+    for (int64_t row = range.firstRow; row <= range.lastRow; ++row) {
+      for (int64_t column = range.firstColumn; column <= range.lastColumn; ++column) {
+        tileEntries((uint32_t)(row * _tiles->columns + column), begin, end);
+        indices.insert(indices.end(), begin, end);
+      }
+    }
+
+    tileEntries(_largeBucket, begin, end);
+    indices.insert(indices.end(), begin, end);
+
+    std::sort(indices.begin(), indices.end(), std::greater<uint32_t>());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+    for (uint32_t index : indices) {
+      if (index >= _header->shapeCount) {
+        throw std::runtime_error("(PagedScene) Corrupted tile index.");
+      }
+
+      if (isInside(index)) {
+        return index;
+      }
+    }
+
+    return -1;
+  }
+
+  /// <summary>
+  /// Position of a record in the document: among the records still in
+  /// the layer, below every shape above it.
+  /// </summary>
+  /// <param name="index"></param>
+  /// <returns></returns>
+  size_t positionOf(uint32_t index) const {
+    return index - (size_t)(std::lower_bound(_taken.begin(), _taken.end(), index) - _taken.begin());
+  }
+
+  /// <summary>
+  /// Take a record out of the layer, to edit its shape in the document.
+  /// </summary>
+  /// <param name="index"></param>
+  /// <returns>Its shape, decoded if it was not resident.</returns>
+  std::shared_ptr<IShape> take(uint32_t index) {
+    if (index >= _header->shapeCount || isTaken(index)) {
+      throw std::runtime_error("(PagedScene) Record already taken.");
+    }
+
+    std::shared_ptr<IShape> shape;
+    auto found = _resident.find(index);
+
+    if (found != _resident.end()) {
+      shape = found->second.shape;
+      _resident.erase(found);
+    }
+
+    else {
+      shape = decode(index);
+    }
+
+    _taken.insert(std::upper_bound(_taken.begin(), _taken.end(), index), index);
+
+    // The shapes of the area are gathered again without it.
+    _visibleRange = { 0, 0, -1, -1 };
+    _visible.clear();
+
+    return shape;
+  }
+
+  /// <summary>
+  /// Visit every record in z-order without decoding it into a shape.
+  /// </summary>
+  /// <param name="skipped">Records left out, ascending (taken ones, as
+  /// a snapshot copied them).</param>
+  /// <param name="visitor">(type, first, second, graphic)</param>
+  template <typename Visitor>
+  void forEachRecord(const std::vector<uint32_t>& skipped, Visitor&& visitor) const {
+    uint32_t typeCount = (uint32_t)ShapeFactory::getInstance()->prototypeSize();
+    auto next = skipped.begin();
+
+    for (uint32_t i = 0; i < _header->shapeCount; ++i) {
+      if (next != skipped.end() && *next == i) {
+        ++next;
+        continue;
+      }
+
+      const BinaryScene::Record& record = _records[i];
+
+      if (record.type >= typeCount || record.style >= _header->styleCount) {
+        throw std::runtime_error("(PagedScene) Corrupted shape record.");
+      }
+
+      visitor(
+        record.type,
+        Point(record.x1, record.y1),
+        Point(record.x2, record.y2),
+        _graphics[record.style]
+      );
+    }
+  }
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+/// <summary>
+/// Parallel loader for text scenes.
+///
+/// The buffer is cut into newline-aligned chunks, a pool of workers
+/// parses them into per-chunk shape buffers, and the buffers are then
+/// concatenated in chunk order - so the resulting z-order is exactly
+/// the one a sequential load would give.
+/// </summary>
+namespace ParallelSceneLoader {
+  /// <summary>
+  /// Below this size the buffer is parsed on the calling thread.
+  /// </summary>
+  const size_t MIN_PARALLEL_SIZE = 1 << 20;
+
+  /// <summary>
+  /// Chunks handed out per worker, so faster workers can pick up more.
+  /// </summary>
+  const size_t CHUNKS_PER_THREAD = 4;
+
+  /// <summary>
+  /// Result of parsing one chunk.
+  /// </summary>
+  struct Chunk {
+    std::string_view text;
+    std::vector<std::shared_ptr<IShape>> shapes;
+    size_t lineCount = 0;
+    std::exception_ptr error;
+  };
+
+  /// <summary>
+  /// Default number of workers.
+  /// </summary>
+  /// <returns></returns>
+  unsigned int defaultThreadCount() {
+    unsigned int count = std::thread::hardware_concurrency();
+
+    return count ? count : 1;
+  }
+
+  /// <summary>
+  /// Cut a buffer into (at most) chunkCount pieces,
+  /// each one ending right after a '\n' (except the last).
+  /// </summary>
+  /// <param name="buffer"></param>
+  /// <param name="chunkCount"></param>
+  /// <returns></returns>
+  std::vector<std::string_view> split(std::string_view buffer,
+    size_t chunkCount) {
+    std::vector<std::string_view> chunks;
+    size_t chunkSize = buffer.size() / max(chunkCount, (size_t)1) + 1;
+    size_t begin = 0;
+
+    while (begin < buffer.size()) {
+      size_t end = min(begin + chunkSize, buffer.size());
+
+      // Move the cut to the end of the current line.
+      if (end < buffer.size()) {
+        size_t newline = buffer.find('\n', end - 1);
+        end = (newline == std::string_view::npos) ? buffer.size() : newline + 1;
+      }
+
+      chunks.push_back(buffer.substr(begin, end - begin));
+      begin = end;
+    }
+
+    return chunks;
+  }
+
+  /// <summary>
+  /// Parse a whole scene buffer, appending the shapes (in file order)
+  /// to the given vector.
+  /// </summary>
+  /// <param name="buffer"></param>
+  /// <param name="shapes"></param>
+  /// <param name="threadCount">0 means one worker per core.</param>
+  void parse(std::string_view buffer,
+    std::vector<std::shared_ptr<IShape>>& shapes,
+    unsigned int threadCount = 0) {
+    if (0 == threadCount) {
+      threadCount = defaultThreadCount();
+    }
+
+    // Not worth spinning threads for small scenes.
+    if (threadCount == 1 || buffer.size() < MIN_PARALLEL_SIZE) {
+      SceneParser::parse(buffer, shapes);
+      return;
+    }
+
+    std::vector<std::string_view> pieces = split(
+      buffer,
+      threadCount * CHUNKS_PER_THREAD
+    );
+
+    std::vector<Chunk> chunks(pieces.size());
+
+    for (size_t i = 0; i < pieces.size(); ++i) {
+      chunks[i].text = pieces[i];
+    }
+
+    // Workers take the next unparsed chunk until none is left.
+    std::atomic<size_t> nextChunk(0);
+
+    auto worker = [&chunks, &nextChunk]() {
+      size_t i;
+
+      while ((i = nextChunk.fetch_add(1)) < chunks.size()) {
+        try {
+          chunks[i].lineCount = SceneParser::parse(
+            chunks[i].text,
+            chunks[i].shapes
+          );
+        }
+
+        catch (...) {
+          chunks[i].error = std::current_exception();
+        }
+      }
+    };
+
+    std::vector<std::thread> workers;
+    threadCount = (unsigned int)min((size_t)threadCount, chunks.size());
+
+    for (unsigned int i = 1; i < threadCount; ++i) {
+      workers.emplace_back(worker);
+    }
+
+    // The calling thread works too.
+    worker();
+
+    for (std::thread& thread : workers) {
+      thread.join();
+    }
+
+    // Report the first error in file order, with its real line number.
+    size_t lineOffset = 0;
+    size_t shapeCount = 0;
+
+    for (Chunk& chunk : chunks) {
+      if (chunk.error) {
+        try {
+          std::rethrow_exception(chunk.error);
+        }
+
+        catch (const SceneParseError& e) {
+          throw e.rebased(lineOffset);
+        }
+      }
+
+      lineOffset += chunk.lineCount;
+      shapeCount += chunk.shapes.size();
+    }
+
+    // Concatenate in chunk order to keep the z-order.
+    shapes.reserve(shapes.size() + shapeCount);
+
+    for (Chunk& chunk : chunks) {
+      shapes.insert(
+        shapes.end(),
+        std::make_move_iterator(chunk.shapes.begin()),
+        std::make_move_iterator(chunk.shapes.end())
+      );
+    }
+  }
+
+  /// <summary>
+  /// Map a text scene file and parse it in parallel.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <param name="shapes"></param>
+  /// <param name="threadCount">0 means one worker per core.</param>
+  void load(const std::wstring& filePath,
+    std::vector<std::shared_ptr<IShape>>& shapes,
+    unsigned int threadCount = 0) {
+    MappedFile file(filePath);
+
+    parse(file.view(), shapes, threadCount);
+  }
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+/// <summary>
+/// The part of Win32 the shapes, the scene files and the software
+/// renderer use. On Windows it is windows.h itself; elsewhere the few
+/// types, constants and calls involved are defined here, so those
+/// headers build (and are tested) without Windows. GDI, windows and
+/// DIB sections stay Windows only.
+/// </summary>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <string>
+
+// Memory-mapped files.
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::max;
+using std::min;
+
+typedef int32_t LONG;
+typedef uint32_t DWORD;
+typedef uint16_t WORD;
+typedef uint8_t BYTE;
+typedef unsigned int UINT;
+typedef int BOOL;
+typedef DWORD COLORREF;
+typedef uintptr_t WPARAM;
+typedef intptr_t LPARAM;
+typedef struct HWND__* HWND;
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define RGB(r, g, b) ((COLORREF)(((BYTE)(r) | ((WORD)((BYTE)(g)) << 8)) | \
+  (((DWORD)(BYTE)(b)) << 16)))
+#define GetRValue(rgb) ((BYTE)(rgb))
+#define GetGValue(rgb) ((BYTE)(((WORD)(rgb)) >> 8))
+#define GetBValue(rgb) ((BYTE)((rgb) >> 16))
+
+// Pen styles.
+#define PS_SOLID 0
+#define PS_DASH 1
+#define PS_DOT 2
+#define PS_DASHDOT 3
+#define PS_DASHDOTDOT 4
+#define PS_NULL 5
+
+// Stock brushes.
+#define WHITE_BRUSH 0
+#define LTGRAY_BRUSH 1
+#define GRAY_BRUSH 2
+#define DKGRAY_BRUSH 3
+#define BLACK_BRUSH 4
+#define NULL_BRUSH 5
+#define DC_BRUSH 18
+
+#define WM_APP 0x8000
+#define MOVEFILE_REPLACE_EXISTING 0x1
+
+struct RECT {
+  LONG left;
+  LONG top;
+  LONG right;
+  LONG bottom;
+};
+
+inline BOOL IsRectEmpty(const RECT* rect) {
+  return rect->left >= rect->right || rect->top >= rect->bottom;
+}
+
+inline int _wcsicmp(const wchar_t* first, const wchar_t* second) {
+  for (;; ++first, ++second) {
+    std::wint_t a = std::towlower(*first);
+    std::wint_t b = std::towlower(*second);
+
+    if (a != b || 0 == a) {
+      return a < b ? -1 : (a > b ? 1 : 0);
+    }
+  }
+}
+#endif
+
+namespace Platform {
+#ifdef _WIN32
+  /// <summary>
+  /// Path as the fstream constructors take it: wide on Windows.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <returns></returns>
+  inline const std::wstring& streamPath(const std::wstring& filePath) {
+    return filePath;
+  }
+#else
+  /// <summary>
+  /// Path as the fstream constructors take it: UTF-8 off Windows.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <returns></returns>
+  inline std::string streamPath(const std::wstring& filePath) {
+    std::string path;
+    path.reserve(filePath.size());
+
+    for (wchar_t c : filePath) {
+      uint32_t code = (uint32_t)c;
+
+      if (code < 0x80) {
+        path += (char)code;
+      }
+
+      else if (code < 0x800) {
+        path += (char)(0xC0 | (code >> 6));
+        path += (char)(0x80 | (code & 0x3F));
+      }
+
+      else if (code < 0x10000) {
+        path += (char)(0xE0 | (code >> 12));
+        path += (char)(0x80 | ((code >> 6) & 0x3F));
+        path += (char)(0x80 | (code & 0x3F));
+      }
+
+      else {
+        path += (char)(0xF0 | (code >> 18));
+        path += (char)(0x80 | ((code >> 12) & 0x3F));
+        path += (char)(0x80 | ((code >> 6) & 0x3F));
+        path += (char)(0x80 | (code & 0x3F));
+      }
+    }
+
+    return path;
+  }
+#endif
+
+  /// <summary>
+  /// When a file was last written, in units only good for comparing
+  /// with other files.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <param name="time"></param>
+  /// <returns>False if the file does not exist.</returns>
+  inline bool lastWriteTime(const std::wstring& filePath, uint64_t& time) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+
+    if (!GetFileAttributesExW(filePath.c_str(), GetFileExInfoStandard, &data)) {
+      return false;
+    }
+
+    time = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) |
+      data.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat data;
+
+    if (0 != stat(streamPath(filePath).c_str(), &data)) {
+      return false;
+    }
+
+    time = (uint64_t)data.st_mtim.tv_sec * 1000000000 + (uint64_t)data.st_mtim.tv_nsec;
+#endif
+
+    return true;
+  }
+}
+
+#ifndef _WIN32
+inline BOOL DeleteFileW(const wchar_t* filePath) {
+  return 0 == std::remove(Platform::streamPath(filePath).c_str());
+}
+
+/// <summary>
+/// rename() always replaces the target, as MOVEFILE_REPLACE_EXISTING.
+/// </summary>
+inline BOOL MoveFileExW(const wchar_t* from, const wchar_t* to, DWORD) {
+  return 0 == std::rename(
+    Platform::streamPath(from).c_str(),
+    Platform::streamPath(to).c_str()
+  );
+}
+
+/// <summary>
+/// There is no window to notify off Windows; callers poll instead.
+/// </summary>
+inline BOOL PostMessage(HWND, UINT, WPARAM, LPARAM) {
+  return FALSE;
+}
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+
+/// <summary>
+/// Counters of the work done by painting, to compare how much
+/// a change of the renderer saves over the same interaction.
+/// </summary>
+class RenderStats {
+private:
+  uint64_t _frames;
+  uint64_t _framePixels;
+  uint64_t _totalPixels;
+
+  // Shapes (draw commands) of the last frame drawn, and culled
+  // because they could not touch the area being rendered.
+  uint64_t _frameDrawn;
+  uint64_t _frameCulled;
+
+public:
+  RenderStats() {
+    reset();
+  }
+
+public:
+  /// <summary>
+  /// Number of frames painted.
+  /// </summary>
+  /// <returns></returns>
+  uint64_t frames() const { return _frames; }
+
+  /// <summary>
+  /// Pixels rendered by the last frame.
+  /// </summary>
+  /// <returns></returns>
+  uint64_t framePixels() const { return _framePixels; }
+
+  /// <summary>
+  /// Pixels rendered by every frame so far.
+  /// </summary>
+  /// <returns></returns>
+  uint64_t totalPixels() const { return _totalPixels; }
+
+  /// <summary>
+  /// Shapes the last frame drew, and culled.
+  /// </summary>
+  /// <returns></returns>
+  uint64_t frameDrawn() const { return _frameDrawn; }
+  uint64_t frameCulled() const { return _frameCulled; }
+
+  /// <summary>
+  /// Start counting a new frame.
+  /// </summary>
+  void beginFrame() {
+    ++_frames;
+    _framePixels = 0;
+    _frameDrawn = 0;
+    _frameCulled = 0;
+  }
+
+  /// <summary>
+  /// Count an area rendered by the current frame.
+  /// </summary>
+  /// <param name="area"></param>
+  void addArea(const RECT& area) {
+    int64_t width = max((int64_t)area.right - area.left, (int64_t)0);
+    int64_t height = max((int64_t)area.bottom - area.top, (int64_t)0);
+
+    _framePixels += (uint64_t)(width * height);
+    _totalPixels += (uint64_t)(width * height);
+  }
+
+  /// <summary>
+  /// Count shapes the current frame went through.
+  /// </summary>
+  /// <param name="drawn"></param>
+  /// <param name="culled"></param>
+  void addShapes(uint64_t drawn, uint64_t culled) {
+    _frameDrawn += drawn;
+    _frameCulled += culled;
+  }
+
+  void reset() {
+    _frames = 0;
+    _framePixels = 0;
+    _totalPixels = 0;
+    _frameDrawn = 0;
+    _frameCulled = 0;
+  }
+};
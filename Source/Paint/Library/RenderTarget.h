@@ -0,0 +1,47 @@
+#pragma once
+
+/// <summary>
+/// Surface shapes draw themselves into.
+///
+/// Primitives follow GDI conventions: the bounding box of a rectangle
+/// or an ellipse excludes its right and bottom edges, and a line does
+/// not draw its end point. Outline and fill come from the last style set.
+/// </summary>
+class IRenderTarget {
+public:
+  IRenderTarget() {
+    // Do nothing.
+  }
+
+  virtual ~IRenderTarget() {
+    // Do nothing.
+  }
+
+public:
+  /// <summary>
+  /// Pen and brush used by the next primitives.
+  /// </summary>
+  /// <param name="graphic"></param>
+  virtual void setStyle(const ShapeGraphic& graphic) = 0;
+
+  /// <summary>
+  /// Outline a segment from (x1, y1) to (x2, y2).
+  /// </summary>
+  virtual void line(int x1, int y1, int x2, int y2) = 0;
+
+  /// <summary>
+  /// Fill and outline a rectangle.
+  /// </summary>
+  virtual void rectangle(int left, int top, int right, int bottom) = 0;
+
+  /// <summary>
+  /// Fill and outline the ellipse inscribed in a rectangle.
+  /// </summary>
+  virtual void ellipse(int left, int top, int right, int bottom) = 0;
+
+  /// <summary>
+  /// Set one pixel to the colour a shape of the style mostly shows:
+  /// its pen, or its fill if it has no pen.
+  /// </summary>
+  virtual void dot(int x, int y) = 0;
+};
@@ -0,0 +1,373 @@
+#pragma once
+
+/// <summary>
+/// Append-only edit journal of a saved scene.
+///
+/// Next to a snapshot file (the full scene, text or binary) lives
+/// "snapshot.journal": every edit made since the snapshot was written,
+/// one compact record per line.
+///
+///   j size hash  header, stamp of the snapshot it belongs to: its
+///                byte size and a hash of its first and last blocks
+///   + line       create (draw, paste) - the shape in text format
+///   m dx dy      move the last shape by (dx, dy)
+///   d            delete the last shape
+///   r index      raise the shape at index to the back (select)
+///
+/// Saving only appends the pending records, so it costs O(1) I/O per
+/// edit. Once the journal grows too long compared to the scene,
+/// the caller writes a fresh snapshot and the journal is dropped.
+/// </summary>
+class SceneJournal {
+private:
+  /// <summary>
+  /// Never compact before this many records.
+  /// </summary>
+  static constexpr size_t MIN_COMPACTION_RECORDS = 1024;
+
+  /// <summary>
+  /// Bytes hashed at each end of a snapshot for its stamp.
+  /// </summary>
+  static constexpr long long STAMP_BLOCK = 64 * 1024;
+
+  std::wstring _snapshotPath;
+  std::string _pending;
+  size_t _pendingCount;
+  size_t _recordCount;
+
+  /// <summary>
+  /// Queue one record.
+  /// </summary>
+  /// <param name="record"></param>
+  void append(const std::string& record) {
+    if (!isAttached()) {
+      return;
+    }
+
+    _pending += record;
+    _pending += '\n';
+    ++_pendingCount;
+  }
+
+  /// <summary>
+  /// Byte size of a file, -1 if it does not exist.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <returns></returns>
+  static long long fileSize(const std::wstring& filePath) {
+    std::ifstream in(Platform::streamPath(filePath), std::ios::binary | std::ios::ate);
+
+    if (!in) {
+      return -1;
+    }
+
+    return (long long)in.tellg();
+  }
+
+  /// <summary>
+  /// Stamp tying a journal to its snapshot: the byte size of the
+  /// snapshot, then an FNV-1a hash of its first and last blocks, so a
+  /// rewrite of the same size does not pass for it either.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <returns>Empty if the snapshot does not exist.</returns>
+  static std::string stamp(const std::wstring& filePath) {
+    std::ifstream in(Platform::streamPath(filePath), std::ios::binary | std::ios::ate);
+
+    if (!in) {
+      return "";
+    }
+
+    long long size = (long long)in.tellg();
+    long long headEnd = min(size, STAMP_BLOCK);
+    long long tailBegin = max(headEnd, size - STAMP_BLOCK);
+
+    std::vector<char> block((size_t)STAMP_BLOCK);
+    uint64_t hash = 14695981039346656037ull;
+
+    for (long long begin : { 0LL, tailBegin }) {
+      long long length = (0 == begin ? headEnd : size) - begin;
+
+      in.seekg(begin);
+
+      if (!in.read(block.data(), length)) {
+        return "";
+      }
+
+      for (long long i = 0; i < length; ++i) {
+        hash ^= (unsigned char)block[(size_t)i];
+        hash *= 1099511628211ull;
+      }
+    }
+
+    char digits[16];
+    std::to_chars_result result = std::to_chars(digits, digits + 16, hash, 16);
+
+    return std::to_string(size) + " " + std::string(digits, result.ptr);
+  }
+
+  /// <summary>
+  /// Read an integer from the front of a view, then skip one separator.
+  /// </summary>
+  /// <param name="view"></param>
+  /// <returns></returns>
+  static long long readNumber(std::string_view& view) {
+    long long value = 0;
+    std::from_chars_result result = std::from_chars(
+      view.data(),
+      view.data() + view.size(),
+      value
+    );
+
+    if (result.ec != std::errc()) {
+      throw std::runtime_error("(SceneJournal) Corrupted record.");
+    }
+
+    view.remove_prefix(result.ptr - view.data());
+
+    if (!view.empty()) {
+      view.remove_prefix(1);
+    }
+
+    return value;
+  }
+
+public:
+  SceneJournal() {
+    _pendingCount = 0;
+    _recordCount = 0;
+  }
+
+  ~SceneJournal() {
+    // Do nothing.
+  }
+
+public:
+  /// <summary>
+  /// Path of the journal that belongs to a snapshot.
+  /// </summary>
+  /// <param name="snapshotPath"></param>
+  /// <returns></returns>
+  static std::wstring journalPath(const std::wstring& snapshotPath) {
+    return snapshotPath + L".journal";
+  }
+
+  /// <summary>
+  /// Is the journal bound to a snapshot file?
+  /// </summary>
+  /// <returns></returns>
+  bool isAttached() const {
+    return !_snapshotPath.empty();
+  }
+
+  /// <summary>
+  /// Are there edits not written to disk yet?
+  /// </summary>
+  /// <returns></returns>
+  bool hasPending() const {
+    return _pendingCount > 0;
+  }
+
+  const std::wstring& snapshotPath() const { return _snapshotPath; }
+
+  /// <summary>
+  /// Bind the journal to a snapshot.
+  /// </summary>
+  /// <param name="snapshotPath"></param>
+  /// <param name="recordCount">Records already in the journal file.</param>
+  void attach(const std::wstring& snapshotPath, size_t recordCount = 0) {
+    _snapshotPath = snapshotPath;
+    _pending.clear();
+    _pendingCount = 0;
+    _recordCount = recordCount;
+  }
+
+  /// <summary>
+  /// Unbind the journal (new or unsaved document).
+  /// </summary>
+  void detach() {
+    attach(L"");
+  }
+
+  /// <summary>
+  /// A fresh snapshot has been written: drop the journal file.
+  /// </summary>
+  void reset() {
+    if (isAttached()) {
+      DeleteFileW(journalPath(_snapshotPath).c_str());
+    }
+
+    attach(_snapshotPath);
+  }
+
+  //
+  // Recording edits.
+  //
+
+  void recordCreate(IShape& shape) {
+    if (!isAttached()) {
+      return;
+    }
+
+    _pending += "+ ";
+    SceneWriter::format(*ShapeFactory::getInstance(), shape, _pending);
+    _pending += '\n';
+    ++_pendingCount;
+  }
+
+  void recordMove(int dx, int dy) {
+    append("m " + std::to_string(dx) + " " + std::to_string(dy));
+  }
+
+  void recordDelete() {
+    append("d");
+  }
+
+  void recordRaise(size_t index) {
+    append("r " + std::to_string(index));
+  }
+
+  /// <summary>
+  /// Append pending records to the journal file.
+  /// </summary>
+  void flush() {
+    if (!isAttached() || !hasPending()) {
+      return;
+    }
+
+    std::wstring path = journalPath(_snapshotPath);
+    bool isNew = fileSize(path) < 0;
+    std::string header = isNew ? stamp(_snapshotPath) : "";
+
+    std::ofstream out(Platform::streamPath(path), std::ios::binary | std::ios::app);
+
+    if (!out) {
+      throw std::runtime_error("(SceneJournal) Cannot open journal.");
+    }
+
+    // Tie a new journal to the snapshot it extends.
+    if (isNew) {
+      out << "j " << header << '\n';
+    }
+
+    out.write(_pending.data(), _pending.size());
+
+    if (!out) {
+      throw std::runtime_error("(SceneJournal) Cannot write journal.");
+    }
+
+    _recordCount += _pendingCount;
+    _pending.clear();
+    _pendingCount = 0;
+  }
+
+  /// <summary>
+  /// Is the journal long enough to be worth a new snapshot?
+  /// Compacting once the journal outgrows half the scene keeps
+  /// the snapshot cost amortised to O(1) per edit.
+  /// </summary>
+  /// <param name="shapeCount"></param>
+  /// <returns></returns>
+  bool needsCompaction(size_t shapeCount) const {
+    return _recordCount + _pendingCount >=
+      max(MIN_COMPACTION_RECORDS, shapeCount / 2);
+  }
+
+  /// <summary>
+  /// Replay the journal of a snapshot onto its (already loaded) shapes.
+  /// A journal whose stamp does not match the snapshot (written for
+  /// another version of it, or without a stamp) is not replayed, and
+  /// is dropped.
+  /// </summary>
+  /// <param name="snapshotPath"></param>
+  /// <param name="shapes"></param>
+  /// <returns>Number of records replayed.</returns>
+  static size_t replay(const std::wstring& snapshotPath,
+    std::vector<std::shared_ptr<IShape>>& shapes) {
+    std::ifstream in(Platform::streamPath(journalPath(snapshotPath)), std::ios::binary);
+
+    if (!in) {
+      return 0;
+    }
+
+    std::string buffer;
+    size_t count = 0;
+    size_t lineNumber = 0;
+    bool isStamped = false;
+
+    while (std::getline(in, buffer)) {
+      std::string_view record(buffer);
+      ++lineNumber;
+
+      if (!record.empty() && record.back() == '\r') {
+        record.remove_suffix(1);
+      }
+
+      if (record.size() < 1) {
+        continue;
+      }
+
+      char kind = record[0];
+      record.remove_prefix(min(record.size(), (size_t)2));
+
+      // Stale journal: the snapshot was rewritten after it. Checked
+      // before any record is applied.
+      if (!isStamped) {
+        std::string expected = stamp(snapshotPath);
+
+        if (kind != 'j' || expected.empty() || record != expected) {
+          in.close();
+          DeleteFileW(journalPath(snapshotPath).c_str());
+          return 0;
+        }
+
+        isStamped = true;
+        continue;
+      }
+
+      switch (kind) {
+      case '+': {
+        shapes.push_back(SceneParser::parseLine(record, lineNumber));
+        break;
+      }
+      case 'm': {
+        int dx = (int)readNumber(record);
+        int dy = (int)readNumber(record);
+
+        if (shapes.empty()) {
+          throw std::runtime_error("(SceneJournal) Move without shape.");
+        }
+
+        shapes.back()->move(dx, dy);
+        break;
+      }
+      case 'd': {
+        if (shapes.empty()) {
+          throw std::runtime_error("(SceneJournal) Delete without shape.");
+        }
+
+        shapes.pop_back();
+        break;
+      }
+      case 'r': {
+        size_t index = (size_t)readNumber(record);
+
+        if (index >= shapes.size()) {
+          throw std::runtime_error("(SceneJournal) Raise out of range.");
+        }
+
+        std::shared_ptr<IShape> raised = shapes[index];
+        shapes.erase(shapes.begin() + index);
+        shapes.push_back(raised);
+        break;
+      }
+      default:
+        throw std::runtime_error("(SceneJournal) Unknown record.");
+      }
+
+      ++count;
+    }
+
+    return count;
+  }
+};
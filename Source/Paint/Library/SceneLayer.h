@@ -0,0 +1,273 @@
+#pragma once
+
+/// <summary>
+/// Retained bitmap of the committed scene: the background and every
+/// shape of the document, but nothing of the interaction going on.
+///
+/// Painting copies it and draws the preview and selection over the
+/// copy, so showing them does not re-draw the document. The layer
+/// only re-renders what the document changes mark dirty.
+///
+/// A shape being dragged on top of the scene can float out of the
+/// layer while it moves, and is then drawn over it every frame.
+///
+/// The layer shows the document through a viewport: invalidated areas
+/// are in document coordinates. Panning scrolls the pixels already
+/// rendered and only marks what comes into view dirty; zooming marks
+/// everything.
+/// </summary>
+class SceneLayer {
+private:
+  HDC _hdc;
+  HBITMAP _bitmap;
+  HGDIOBJ _oldBitmap;
+  uint32_t* _pixels;
+  int _width;
+  int _height;
+
+  // Area to re-render (right and bottom excluded), in the layer.
+  RECT _dirty;
+
+  Viewport _viewport;
+
+  std::shared_ptr<IShape> _floating;
+
+  /// <summary>
+  /// Move the pixels by (dx, dy); what the move uncovers gets dirty.
+  /// </summary>
+  void scroll(int dx, int dy) {
+    if (std::abs(dx) >= _width || std::abs(dy) >= _height) {
+      invalidateAll();
+      return;
+    }
+
+    // GDI may still be writing to the bitmap.
+    GdiFlush();
+
+    size_t count = (size_t)(_width - std::abs(dx));
+    int fromX = max(-dx, 0);
+    int toX = max(dx, 0);
+
+    // Rows go the way that never reads a row already moved.
+    for (int i = 0; i < _height - std::abs(dy); ++i) {
+      int y = dy > 0 ? _height - 1 - i : i;
+      uint32_t* row = _pixels + (size_t)_width * y;
+      uint32_t* source = _pixels + (size_t)_width * (y - dy);
+
+      memmove(row + toX, source + fromX, count * sizeof(uint32_t));
+    }
+
+    if (!IsRectEmpty(&_dirty)) {
+      OffsetRect(&_dirty, dx, dy);
+    }
+
+    RECT uncovered;
+
+    if (dx) {
+      SetRect(&uncovered, dx > 0 ? 0 : _width + dx, 0, dx > 0 ? dx : _width, _height);
+      invalidateLayer(uncovered);
+    }
+
+    if (dy) {
+      SetRect(&uncovered, 0, dy > 0 ? 0 : _height + dy, _width, dy > 0 ? dy : _height);
+      invalidateLayer(uncovered);
+    }
+  }
+
+  /// <summary>
+  /// Mark an area of the layer itself dirty.
+  /// </summary>
+  void invalidateLayer(const RECT& area) {
+    RECT dirty = _dirty;
+    UnionRect(&_dirty, &dirty, &area);
+  }
+
+  /// <summary>
+  /// Free the bitmap and its DC.
+  /// </summary>
+  void release() {
+    if (_hdc) {
+      SelectObject(_hdc, _oldBitmap);
+      DeleteObject(_bitmap);
+      DeleteDC(_hdc);
+    }
+
+    _hdc = NULL;
+    _bitmap = NULL;
+    _oldBitmap = NULL;
+    _pixels = NULL;
+    _width = 0;
+    _height = 0;
+  }
+
+public:
+  SceneLayer() {
+    _hdc = NULL;
+    _bitmap = NULL;
+    _oldBitmap = NULL;
+    _pixels = NULL;
+    _width = 0;
+    _height = 0;
+    SetRectEmpty(&_dirty);
+  }
+
+  SceneLayer(const SceneLayer&) = delete;
+  SceneLayer& operator=(const SceneLayer&) = delete;
+
+  ~SceneLayer() {
+    release();
+  }
+
+public:
+  /// <summary>
+  /// DC the layer is selected into.
+  /// </summary>
+  /// <returns></returns>
+  HDC hdc() const { return _hdc; }
+
+  /// <summary>
+  /// Top-down 32-bit pixels of the layer, NULL before the first resize.
+  /// </summary>
+  /// <returns></returns>
+  uint32_t* pixels() const { return _pixels; }
+
+  int width() const { return _width; }
+  int height() const { return _height; }
+
+  /// <summary>
+  /// Area to re-render before the layer is up to date.
+  /// </summary>
+  /// <returns></returns>
+  const RECT& dirtyArea() const { return _dirty; }
+
+  bool isDirty() const { return !IsRectEmpty(&_dirty); }
+
+  /// <summary>
+  /// Shape currently kept out of the layer, may be NULL.
+  /// </summary>
+  /// <returns></returns>
+  const std::shared_ptr<IShape>& floating() const { return _floating; }
+
+  /// <summary>
+  /// Viewport the layer is rendered through.
+  /// </summary>
+  /// <returns></returns>
+  const Viewport& viewport() const { return _viewport; }
+
+  /// <summary>
+  /// Match the size of the client area. A new size starts
+  /// a new bitmap, dirty everywhere.
+  /// </summary>
+  /// <param name="reference">DC the layer has to be compatible with.</param>
+  /// <param name="width"></param>
+  /// <param name="height"></param>
+  void resize(HDC reference, int width, int height) {
+    if (_hdc && width == _width && height == _height) {
+      return;
+    }
+
+    release();
+
+    if (width <= 0 || height <= 0) {
+      return;
+    }
+
+    BITMAPINFO bitmapInfo;
+    ZeroMemory(&bitmapInfo, sizeof(bitmapInfo));
+    bitmapInfo.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bitmapInfo.bmiHeader.biWidth = width;
+    bitmapInfo.bmiHeader.biHeight = -height;  // Top-down rows.
+    bitmapInfo.bmiHeader.biPlanes = 1;
+    bitmapInfo.bmiHeader.biBitCount = 32;
+    bitmapInfo.bmiHeader.biCompression = BI_RGB;
+
+    void* bits = NULL;
+    HBITMAP bitmap = CreateDIBSection(
+      reference,
+      &bitmapInfo,
+      DIB_RGB_COLORS,
+      &bits,
+      NULL,
+      0
+    );
+
+    if (!bitmap) {
+      throw std::runtime_error("(SceneLayer) Cannot create the layer bitmap.");
+    }
+
+    _hdc = CreateCompatibleDC(reference);
+    _bitmap = bitmap;
+    _oldBitmap = SelectObject(_hdc, _bitmap);
+    _pixels = (uint32_t*)bits;
+    _width = width;
+    _height = height;
+
+    invalidateAll();
+  }
+
+  /// <summary>
+  /// The document changed inside an area.
+  /// </summary>
+  /// <param name="area">In document coordinates.</param>
+  void invalidate(const RECT& area) {
+    invalidateLayer(_viewport.toClient(area));
+  }
+
+  /// <summary>
+  /// Show the document through another viewport.
+  /// </summary>
+  /// <param name="viewport"></param>
+  void setViewport(const Viewport& viewport) {
+    if (viewport == _viewport) {
+      return;
+    }
+
+    int dx, dy;
+    bool shifted = _pixels && viewport.shiftFrom(_viewport, dx, dy);
+
+    _viewport = viewport;
+
+    if (shifted) {
+      scroll(dx, dy);
+    }
+
+    else {
+      invalidateAll();
+    }
+  }
+
+  /// <summary>
+  /// The whole document changed (or how it is rendered).
+  /// </summary>
+  void invalidateAll() {
+    SetRect(&_dirty, 0, 0, max(_width, 1), max(_height, 1));
+  }
+
+  /// <summary>
+  /// Keep a shape out of the layer (NULL puts it back).
+  /// Where it was and where it goes are re-rendered.
+  /// </summary>
+  /// <param name="shape"></param>
+  void setFloating(const std::shared_ptr<IShape>& shape) {
+    if (shape == _floating) {
+      return;
+    }
+
+    if (_floating) {
+      invalidate(_floating->bounds());
+    }
+
+    if (shape) {
+      invalidate(shape->bounds());
+    }
+
+    _floating = shape;
+  }
+
+  /// <summary>
+  /// The dirty area has been re-rendered.
+  /// </summary>
+  void validate() {
+    SetRectEmpty(&_dirty);
+  }
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+/// <summary>
+/// Exception thrown when a scene line cannot be parsed.
+/// Carries the (1-based) line and column of the offending character.
+/// </summary>
+class SceneParseError : public std::runtime_error {
+private:
+  std::string _message;
+  size_t _line;
+  size_t _column;
+
+public:
+  SceneParseError(const std::string& message, size_t line, size_t column)
+    : std::runtime_error(
+      "(SceneParser) Line " + std::to_string(line) +
+      ", column " + std::to_string(column) + ": " + message
+    ) {
+    _message = message;
+    _line = line;
+    _column = column;
+  }
+
+public:
+  const std::string& message() const { return _message; }
+  size_t line() const { return _line; }
+  size_t column() const { return _column; }
+
+  /// <summary>
+  /// Same error, with the line number shifted by an offset.
+  /// Used when a buffer was parsed in several chunks.
+  /// </summary>
+  /// <param name="lineOffset"></param>
+  /// <returns></returns>
+  SceneParseError rebased(size_t lineOffset) const {
+    return SceneParseError(_message, _line + lineOffset, _column);
+  }
+};
+
+/// <summary>
+/// Single-pass scene parser.
+///
+/// Walks each line once over a std::string_view, reading numbers
+/// with std::from_chars and building shapes straight through the
+/// ShapeFactory - no token vectors, no intermediate Point pointers.
+///
+/// Line format (same as IShape::toString):
+///   type: x,y x,y lineStyle,lineWidth,lineColour,brush,backgroundColour
+/// </summary>
+class SceneParser {
+private:
+  ShapeFactory& _factory;
+  std::string_view _buffer;
+  size_t _position;
+  size_t _lineNumber;
+
+  SceneParser(ShapeFactory& factory, std::string_view buffer,
+    size_t lineNumber) : _factory(factory) {
+    _buffer = buffer;
+    _position = 0;
+    _lineNumber = lineNumber;
+  }
+
+  /// <summary>
+  /// Throw a SceneParseError at the current position.
+  /// </summary>
+  /// <param name="message"></param>
+  [[noreturn]] void fail(const std::string& message) {
+    throw SceneParseError(message, _lineNumber, _position + 1);
+  }
+
+  /// <summary>
+  /// Consume an expected character.
+  /// </summary>
+  /// <param name="expected"></param>
+  void expect(char expected) {
+    if (_position >= _buffer.size() || _buffer[_position] != expected) {
+      fail(std::string("expected '") + expected + "'");
+    }
+
+    ++_position;
+  }
+
+  /// <summary>
+  /// Read a number of type T at the current position.
+  /// </summary>
+  /// <returns></returns>
+  template <typename T>
+  T readNumber() {
+    const char* first = _buffer.data() + _position;
+    const char* last = _buffer.data() + _buffer.size();
+
+    T value = 0;
+    std::from_chars_result result = std::from_chars(first, last, value);
+
+    if (result.ec == std::errc::result_out_of_range) {
+      fail("number out of range");
+    }
+
+    if (result.ec != std::errc()) {
+      fail("expected a number");
+    }
+
+    _position += result.ptr - first;
+
+    return value;
+  }
+
+  /// <summary>
+  /// Read a "x,y" pair.
+  /// </summary>
+  /// <returns></returns>
+  Point readPoint() {
+    int x = readNumber<int>();
+    expect(',');
+    int y = readNumber<int>();
+
+    return Point(x, y);
+  }
+
+  /// <summary>
+  /// Read the five comma-separated ShapeGraphic fields.
+  /// </summary>
+  /// <returns></returns>
+  ShapeGraphic readGraphic() {
+    int lineStyle = readNumber<int>();
+    expect(',');
+    int lineWidth = readNumber<int>();
+    expect(',');
+    COLORREF lineColour = readNumber<COLORREF>();
+    expect(',');
+    int backgroundBrush = readNumber<int>();
+    expect(',');
+    COLORREF backgroundColour = readNumber<COLORREF>();
+
+    return ShapeGraphic(
+      lineStyle,
+      lineWidth,
+      lineColour,
+      backgroundBrush,
+      backgroundColour
+    );
+  }
+
+  /// <summary>
+  /// Parse the whole (single) line held by this parser.
+  /// </summary>
+  /// <returns></returns>
+  std::shared_ptr<IShape> parseShape() {
+    size_t separator = _buffer.find(':');
+
+    if (separator == std::string_view::npos) {
+      fail("missing shape type");
+    }
+
+    int shapeType = _factory.find(
+      _buffer.substr(0, separator)
+    );
+
+    if (shapeType < 0) {
+      fail("unknown shape type");
+    }
+
+    _position = separator + 1;
+    expect(' ');
+    Point first = readPoint();
+    expect(' ');
+    Point second = readPoint();
+    expect(' ');
+    ShapeGraphic graphic = readGraphic();
+
+    if (_position != _buffer.size()) {
+      fail("unexpected trailing characters");
+    }
+
+    return _factory.create(
+      shapeType,
+      first,
+      second,
+      graphic
+    );
+  }
+
+public:
+  /// <summary>
+  /// Parse a single line into a shape.
+  /// A trailing '\r' (CRLF files) is ignored.
+  /// </summary>
+  /// <param name="line"></param>
+  /// <param name="lineNumber">Used for error reporting.</param>
+  /// <returns></returns>
+  static std::shared_ptr<IShape> parseLine(std::string_view line,
+    size_t lineNumber = 1) {
+    return parseLine(*ShapeFactory::getInstance(), line, lineNumber);
+  }
+
+  /// <summary>
+  /// Parse a single line into a shape, using the given factory.
+  /// </summary>
+  /// <param name="factory"></param>
+  /// <param name="line"></param>
+  /// <param name="lineNumber"></param>
+  /// <returns></returns>
+  static std::shared_ptr<IShape> parseLine(ShapeFactory& factory,
+    std::string_view line, size_t lineNumber) {
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+
+    SceneParser parser(factory, line, lineNumber);
+
+    return parser.parseShape();
+  }
+
+  /// <summary>
+  /// Parse every line of a buffer and append the shapes, in order,
+  /// to the given vector. Empty lines are skipped.
+  /// </summary>
+  /// <param name="buffer"></param>
+  /// <param name="shapes"></param>
+  /// <param name="firstLine">Line number of the first line in buffer.</param>
+  /// <returns>Number of lines consumed.</returns>
+  static size_t parse(std::string_view buffer,
+    std::vector<std::shared_ptr<IShape>>& shapes, size_t firstLine = 1) {
+    // Hold the factory once, instead of copying its pointer per line.
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+    size_t lineNumber = firstLine;
+    size_t begin = 0;
+
+    while (begin < buffer.size()) {
+      size_t end = buffer.find('\n', begin);
+
+      if (end == std::string_view::npos) {
+        end = buffer.size();
+      }
+
+      std::string_view line = buffer.substr(begin, end - begin);
+
+      if (!line.empty() && line != "\r") {
+        shapes.push_back(parseLine(*factory, line, lineNumber));
+      }
+
+      begin = end + 1;
+      ++lineNumber;
+    }
+
+    return lineNumber - firstLine;
+  }
+
+  /// <summary>
+  /// Read a whole file into memory in one go.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <returns></returns>
+  static std::string readFile(const std::wstring& filePath) {
+    std::ifstream in(Platform::streamPath(filePath), std::ios::binary);
+
+    if (!in) {
+      throw std::runtime_error("(SceneParser) Cannot open file.");
+    }
+
+    in.seekg(0, std::ios::end);
+    std::streamoff size = in.tellg();
+    in.seekg(0, std::ios::beg);
+
+    std::string content((size_t)size, '\0');
+    in.read(&content[0], size);
+
+    return content;
+  }
+};
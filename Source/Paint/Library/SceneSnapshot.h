@@ -0,0 +1,118 @@
+#pragma once
+
+/// <summary>
+/// Frozen copy of a scene, taken for saving.
+///
+/// Shapes are copied by value into flat entries (no allocation per
+/// shape), so taking a snapshot is cheap and the copy stays consistent
+/// while the document keeps changing. The records of the paged base
+/// layer are read from its file, which never changes while mapped: only
+/// which of them were taken out is copied.
+/// </summary>
+class SceneSnapshot {
+public:
+  /// <summary>
+  /// One shape: its ShapeFactory tag and its parts.
+  /// </summary>
+  struct Entry {
+    uint32_t type;
+    Point first;
+    Point second;
+    ShapeGraphic graphic;
+  };
+
+private:
+  std::shared_ptr<PagedScene> _base;
+  std::vector<uint32_t> _taken;
+  std::vector<Entry> _entries;
+
+public:
+  /// <summary>
+  /// Copy a scene.
+  /// </summary>
+  /// <param name="base">Paged base layer, may be NULL.</param>
+  /// <param name="shapes">Shapes on top of it.</param>
+  SceneSnapshot(const std::shared_ptr<PagedScene>& base,
+    const std::vector<std::shared_ptr<IShape>>& shapes) : _base(base) {
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+
+    if (_base) {
+      _taken = _base->taken();
+    }
+
+    _entries.resize(shapes.size());
+
+    for (size_t i = 0; i < shapes.size(); ++i) {
+      Entry& entry = _entries[i];
+
+      entry.type = (uint32_t)factory->tagOf(*shapes[i]);
+      entry.first = shapes[i]->firstPoint();
+      entry.second = shapes[i]->secondPoint();
+      entry.graphic = shapes[i]->graphic();
+    }
+  }
+
+public:
+  /// <summary>
+  /// Number of shapes, base layer included.
+  /// </summary>
+  /// <returns></returns>
+  size_t size() const {
+    return (_base ? _base->recordCount() - _taken.size() : 0) + _entries.size();
+  }
+
+  /// <summary>
+  /// Visit every shape in z-order.
+  /// </summary>
+  /// <param name="visitor">(type, first, second, graphic)</param>
+  template <typename Visitor>
+  void forEach(Visitor&& visitor) const {
+    if (_base) {
+      _base->forEachRecord(_taken, visitor);
+    }
+
+    for (const Entry& entry : _entries) {
+      visitor(entry.type, entry.first, entry.second, entry.graphic);
+    }
+  }
+
+  /// <summary>
+  /// Write the snapshot to a file, the extension decides the format.
+  /// </summary>
+  /// <param name="filePath"></param>
+  void write(const std::wstring& filePath) const {
+    if (BinaryScene::hasExtension(filePath)) {
+      BinaryScene::Writer writer;
+
+      forEach([&writer](uint32_t type, const Point& first,
+        const Point& second, const ShapeGraphic& graphic) {
+        writer.add(type, first, second, graphic);
+      });
+
+      writer.save(filePath);
+    }
+
+    else if (CompactScene::hasExtension(filePath)) {
+      CompactScene::Writer writer(filePath);
+
+      forEach([&writer](uint32_t type, const Point& first,
+        const Point& second, const ShapeGraphic& graphic) {
+        writer.write(type, first, second, graphic);
+      });
+
+      writer.close();
+    }
+
+    else {
+      std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+      SceneWriter writer(filePath);
+
+      forEach([&writer, &factory](uint32_t type, const Point& first,
+        const Point& second, const ShapeGraphic& graphic) {
+        writer.write(factory->typeName((int)type), first, second, graphic);
+      });
+
+      writer.close();
+    }
+  }
+};
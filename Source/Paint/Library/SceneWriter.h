@@ -0,0 +1,224 @@
+#pragma once
+
+/// <summary>
+/// Buffered text scene serializer.
+///
+/// Writes every shape straight into one output buffer with
+/// std::to_chars and hands it to the file in large blocks.
+/// The output is byte-identical to streaming IShape::toString()
+/// and '\n' through a text-mode std::ofstream, as saving used to do.
+/// </summary>
+class SceneWriter {
+private:
+  /// <summary>
+  /// Buffer is written out once it holds this many bytes.
+  /// </summary>
+  static constexpr size_t FLUSH_SIZE = 1 << 20;
+
+  /// <summary>
+  /// Upper bound of a line without its type name:
+  /// 9 numbers of at most 11 characters, plus separators.
+  /// </summary>
+  static constexpr size_t MAX_LINE_TAIL = 9 * 11 + 16;
+
+  /// <summary>
+  /// Line break a text-mode stream writes for '\n'.
+  /// </summary>
+#ifdef _WIN32
+  static constexpr std::string_view NEWLINE = "\r\n";
+#else
+  static constexpr std::string_view NEWLINE = "\n";
+#endif
+
+  std::ofstream _out;
+  std::vector<char> _buffer;
+  size_t _used;
+
+  /// <summary>
+  /// Write a number, return the end of it.
+  /// </summary>
+  /// <param name="cursor"></param>
+  /// <param name="value"></param>
+  /// <returns></returns>
+  template <typename T>
+  static char* putNumber(char* cursor, T value) {
+    return std::to_chars(cursor, cursor + 11, value).ptr;
+  }
+
+  /// <summary>
+  /// Format one shape line (with its line break) at cursor.
+  /// Needs room for name.size() + MAX_LINE_TAIL bytes.
+  /// </summary>
+  /// <param name="cursor"></param>
+  /// <param name="name"></param>
+  /// <param name="first"></param>
+  /// <param name="second"></param>
+  /// <param name="graphic"></param>
+  /// <returns>End of the written line.</returns>
+  static char* formatLine(char* cursor, std::string_view name,
+    const Point& first, const Point& second, const ShapeGraphic& graphic) {
+    memcpy(cursor, name.data(), name.size());
+    cursor += name.size();
+    *cursor++ = ':';
+    *cursor++ = ' ';
+
+    cursor = putNumber(cursor, first.x());
+    *cursor++ = ',';
+    cursor = putNumber(cursor, first.y());
+    *cursor++ = ' ';
+
+    cursor = putNumber(cursor, second.x());
+    *cursor++ = ',';
+    cursor = putNumber(cursor, second.y());
+    *cursor++ = ' ';
+
+    cursor = putNumber(cursor, graphic.lineStyle());
+    *cursor++ = ',';
+    cursor = putNumber(cursor, graphic.lineWidth());
+    *cursor++ = ',';
+    cursor = putNumber(cursor, graphic.lineColour());
+    *cursor++ = ',';
+    cursor = putNumber(cursor, graphic.backgroundBrush());
+    *cursor++ = ',';
+    cursor = putNumber(cursor, graphic.backgroundColour());
+    memcpy(cursor, NEWLINE.data(), NEWLINE.size());
+    cursor += NEWLINE.size();
+
+    return cursor;
+  }
+
+public:
+  /// <summary>
+  /// Open (and truncate) a scene file for writing.
+  /// </summary>
+  /// <param name="filePath"></param>
+  SceneWriter(const std::wstring& filePath)
+    : _out(Platform::streamPath(filePath), std::ios::binary | std::ios::trunc) {
+    if (!_out) {
+      throw std::runtime_error("(SceneWriter) Cannot create file.");
+    }
+
+    _buffer.resize(FLUSH_SIZE + 4096);
+    _used = 0;
+  }
+
+  SceneWriter(const SceneWriter&) = delete;
+  SceneWriter& operator=(const SceneWriter&) = delete;
+
+  ~SceneWriter() {
+    // Best effort, errors are reported by close().
+    try {
+      flush();
+    }
+
+    catch (const std::exception&) {
+      // Do nothing.
+    }
+  }
+
+public:
+  /// <summary>
+  /// Append a shape given by its parts.
+  /// </summary>
+  /// <param name="name"></param>
+  /// <param name="first"></param>
+  /// <param name="second"></param>
+  /// <param name="graphic"></param>
+  void write(std::string_view name, const Point& first,
+    const Point& second, const ShapeGraphic& graphic) {
+    size_t needed = name.size() + MAX_LINE_TAIL;
+
+    if (_used + needed > _buffer.size()) {
+      flush();
+
+      if (needed > _buffer.size()) {
+        _buffer.resize(needed);
+      }
+    }
+
+    char* end = formatLine(_buffer.data() + _used, name, first, second, graphic);
+    _used = end - _buffer.data();
+
+    if (_used >= FLUSH_SIZE) {
+      flush();
+    }
+  }
+
+  /// <summary>
+  /// Append a shape.
+  /// </summary>
+  /// <param name="factory"></param>
+  /// <param name="shape"></param>
+  void write(ShapeFactory& factory, IShape& shape) {
+    write(
+      factory.typeName(factory.tagOf(shape)),
+      shape.firstPoint(),
+      shape.secondPoint(),
+      shape.graphic()
+    );
+  }
+
+  /// <summary>
+  /// Hand the buffered bytes to the file.
+  /// </summary>
+  void flush() {
+    if (_used > 0) {
+      _out.write(_buffer.data(), _used);
+      _used = 0;
+    }
+
+    if (!_out) {
+      throw std::runtime_error("(SceneWriter) Cannot write file.");
+    }
+  }
+
+  /// <summary>
+  /// Flush and close the file.
+  /// </summary>
+  void close() {
+    flush();
+    _out.close();
+  }
+
+public:
+  /// <summary>
+  /// Append one shape line (without line break) to a string.
+  /// </summary>
+  /// <param name="factory"></param>
+  /// <param name="shape"></param>
+  /// <param name="result"></param>
+  static void format(ShapeFactory& factory, IShape& shape,
+    std::string& result) {
+    const std::string& name = factory.typeName(factory.tagOf(shape));
+    size_t start = result.size();
+
+    result.resize(start + name.size() + MAX_LINE_TAIL);
+
+    char* end = formatLine(
+      &result[start],
+      name,
+      shape.firstPoint(),
+      shape.secondPoint(),
+      shape.graphic()
+    );
+
+    result.resize(end - result.data() - NEWLINE.size());
+  }
+
+  /// <summary>
+  /// Write every shape to a text scene file.
+  /// </summary>
+  /// <param name="filePath"></param>
+  /// <param name="shapes"></param>
+  static void save(const std::wstring& filePath,
+    const std::vector<std::shared_ptr<IShape>>& shapes) {
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+    SceneWriter writer(filePath);
+
+    for (const std::shared_ptr<IShape>& shape : shapes) {
+      writer.write(*factory, *shape);
+    }
+
+    writer.close();
+  }
+};
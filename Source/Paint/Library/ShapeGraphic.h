@@ -20,8 +20,15 @@ private:
 
 
 public:
+  /// <summary>
+  /// A thin solid black pen, no fill.
+  /// </summary>
   ShapeGraphic() {
-    // Do nothing.
+    _lineStyle = PS_SOLID;
+    _lineWidth = 1;
+    _lineColour = RGB(0, 0, 0);
+    _backgroundBrush = NULL_BRUSH;
+    _backgroundColour = RGB(0, 0, 0);
   }
 
   ShapeGraphic(int lineStyle, int lineWidth, COLORREF lineColour,
@@ -38,12 +45,12 @@ public:
   }
 
 public:
-  int lineStyle() { return _lineStyle; }
-  int lineWidth() { return _lineWidth; }
-  COLORREF lineColour() { return _lineColour; }
+  int lineStyle() const { return _lineStyle; }
+  int lineWidth() const { return _lineWidth; }
+  COLORREF lineColour() const { return _lineColour; }
 
-  int backgroundBrush() { return _backgroundBrush; }
-  COLORREF backgroundColour() { return _backgroundColour; }
+  int backgroundBrush() const { return _backgroundBrush; }
+  COLORREF backgroundColour() const { return _backgroundColour; }
 
   void setLineStyle(int lineStyle) {
     _lineStyle = lineStyle;
@@ -58,7 +65,54 @@ public:
     _backgroundColour = backgroundColour;
   }
 
+  /// <summary>
+  /// Colour the background brush fills with.
+  /// </summary>
+  /// <param name="colour"></param>
+  /// <returns>False if the brush fills nothing (e.g. NULL_BRUSH).</returns>
+  bool brushColour(COLORREF& colour) const {
+    switch (_backgroundBrush) {
+    case DC_BRUSH:
+      colour = _backgroundColour;
+      return true;
+    case WHITE_BRUSH:
+      colour = RGB(255, 255, 255);
+      return true;
+    case LTGRAY_BRUSH:
+      colour = RGB(192, 192, 192);
+      return true;
+    case GRAY_BRUSH:
+      colour = RGB(128, 128, 128);
+      return true;
+    case DKGRAY_BRUSH:
+      colour = RGB(64, 64, 64);
+      return true;
+    case BLACK_BRUSH:
+      colour = RGB(0, 0, 0);
+      return true;
+    default:
+      return false;
+    }
+  }
+
 public:
+  /// <summary>
+  /// Two graphics are equal when every attribute is.
+  /// </summary>
+  /// <param name="other"></param>
+  /// <returns></returns>
+  bool operator==(const ShapeGraphic& other) const {
+    return _lineStyle == other._lineStyle &&
+      _lineWidth == other._lineWidth &&
+      _lineColour == other._lineColour &&
+      _backgroundBrush == other._backgroundBrush &&
+      _backgroundColour == other._backgroundColour;
+  }
+
+  bool operator!=(const ShapeGraphic& other) const {
+    return !(*this == other);
+  }
+
   /// <summary>
   /// Output overload.
   /// </summary>
@@ -159,10 +159,54 @@ public:
   virtual std::shared_ptr<IShape> createShape(const Point&, const Point&,
   const ShapeGraphic&) = 0;
   virtual std::shared_ptr<IShape> cloneShape() = 0;
-  virtual void draw(HDC& hdc) = 0;
+  virtual void draw(IRenderTarget& target) = 0;
   virtual void move(int, int) = 0;
   virtual bool in(const Point&, const Point&) = 0;
   virtual std::string toString() = 0;
+
+  /// <summary>
+  /// Raw geometry of the shape: the two defining points
+  /// (start and end for a line, topLeft and rightBottom otherwise)
+  /// and its graphic.
+  /// </summary>
+  virtual Point firstPoint() = 0;
+  virtual Point secondPoint() = 0;
+  virtual ShapeGraphic graphic() = 0;
+
+  /// <summary>
+  /// Box of the pixels a shape spanning two points may touch
+  /// with a pen of the given width (right and bottom excluded).
+  /// </summary>
+  /// <param name="first"></param>
+  /// <param name="second"></param>
+  /// <param name="lineWidth"></param>
+  /// <returns></returns>
+  static RECT boundsOf(const Point& first, const Point& second, int lineWidth) {
+    int64_t pad = max(lineWidth, 1) / 2 + 1;
+
+    // Held at the ends of int rather than wrapping round, for shapes
+    // reaching out there.
+    auto clamp = [](int64_t value) {
+      return (LONG)max(min(value, (int64_t)INT_MAX), (int64_t)INT_MIN);
+    };
+
+    RECT bounds;
+
+    bounds.left = clamp((int64_t)min(first.x(), second.x()) - pad);
+    bounds.top = clamp((int64_t)min(first.y(), second.y()) - pad);
+    bounds.right = clamp((int64_t)max(first.x(), second.x()) + pad + 1);
+    bounds.bottom = clamp((int64_t)max(first.y(), second.y()) + pad + 1);
+
+    return bounds;
+  }
+
+  /// <summary>
+  /// Bounding box of the shape, pen included (right and bottom excluded).
+  /// </summary>
+  /// <returns></returns>
+  virtual RECT bounds() {
+    return boundsOf(firstPoint(), secondPoint(), graphic().lineWidth());
+  }
 };
 
 class LineShape : public IShape {
@@ -200,6 +244,11 @@ public:
     // Do nothing.
   }
 
+public:
+  Point firstPoint() override { return _start; }
+  Point secondPoint() override { return _end; }
+  ShapeGraphic graphic() override { return _graphic; }
+
 public:
   /// <summary>
   /// Type of line: line.
@@ -263,22 +312,12 @@ public:
   }
 
   /// <summary>
-  /// Draw a line to screen.
+  /// Draw a line to a render target.
   /// </summary>
-  /// <param name="hdc"></param>
-  void draw(HDC& hdc) override {
-    HPEN hPen = CreatePen(
-      _graphic.lineStyle(),
-      _graphic.lineWidth(),
-      _graphic.lineColour()
-    );
-    SelectObject(hdc, hPen);
-    
-    MoveToEx(hdc, _start.x(), _start.y(), NULL);
-    LineTo(hdc, _end.x(), _end.y());
-
-    // Delete pen object, otherwise this can cause GDI memory leak.
-    DeleteObject(hPen);
+  /// <param name="target"></param>
+  void draw(IRenderTarget& target) override {
+    target.setStyle(_graphic);
+    target.line(_start.x(), _start.y(), _end.x(), _end.y());
   }
 
   /// <summary>
@@ -379,6 +418,10 @@ public:
   void setRightBottom(const Point& rightBottom) {
     _rightBottom = rightBottom;
   }
+
+  Point firstPoint() override { return _topLeft; }
+  Point secondPoint() override { return _rightBottom; }
+  ShapeGraphic graphic() override { return _graphic; }
 public:
   /// <summary>
   /// Rectangle type.
@@ -444,27 +487,15 @@ public:
   }
 
   /// <summary>
-  /// Draw a rectangle to the screen.
+  /// Draw a rectangle to a render target.
   /// </summary>
-  /// <param name="hdc"></param>
-  void draw(HDC& hdc) override {
-    // Create a pen (outside border)
-    HPEN hPen = CreatePen(
-      _graphic.lineStyle(),
-      _graphic.lineWidth(),
-      _graphic.lineColour()
-    );
-    SelectObject(hdc, hPen);
-
-    // Fill inside shape.
-    SelectObject(hdc, GetStockObject(_graphic.backgroundBrush()));
-    SetDCBrushColor(hdc, _graphic.backgroundColour());
+  /// <param name="target"></param>
+  void draw(IRenderTarget& target) override {
+    // Border pen and inside brush.
+    target.setStyle(_graphic);
 
     // And draw.
-    MoveToEx(hdc, _topLeft.x(), _topLeft.y(), NULL);
-    Rectangle(hdc, _topLeft.x(), _topLeft.y(), _rightBottom.x(), _rightBottom.y());
-
-    DeleteObject(hPen);
+    target.rectangle(_topLeft.x(), _topLeft.y(), _rightBottom.x(), _rightBottom.y());
   }
 
   /// <summary>
@@ -653,6 +684,11 @@ public:
     // Do nothing.
   }
 
+public:
+  Point firstPoint() override { return _topLeft; }
+  Point secondPoint() override { return _rightBottom; }
+  ShapeGraphic graphic() override { return _graphic; }
+
 public:
   /// <summary>
   /// Ellipse type.
@@ -714,24 +750,12 @@ public:
   }
     
   /// <summary>
-  /// Draw an ellipse to the screen.
+  /// Draw an ellipse to a render target.
   /// </summary>
-  /// <param name="hdc"></param>
-  void draw(HDC& hdc) override {
-    HPEN hPen = CreatePen(
-      _graphic.lineStyle(),
-      _graphic.lineWidth(),
-      _graphic.lineColour()
-    );
-    SelectObject(hdc, hPen);
-    
-    SelectObject(hdc, GetStockObject(_graphic.backgroundBrush()));
-    SetDCBrushColor(hdc, _graphic.backgroundColour());
-
-    MoveToEx(hdc, _topLeft.x(), _topLeft.y(), NULL);
-    Ellipse(hdc, _topLeft.x(), _topLeft.y(), _rightBottom.x(), _rightBottom.y());
-
-    DeleteObject(hPen);
+  /// <param name="target"></param>
+  void draw(IRenderTarget& target) override {
+    target.setStyle(_graphic);
+    target.ellipse(_topLeft.x(), _topLeft.y(), _rightBottom.x(), _rightBottom.y());
   }
 
   /// <summary>
@@ -886,14 +910,73 @@ public:
 /// </summary>
 class ShapeFactory {
 private:
+  /// <summary>
+  /// Prototypes, indexed by their tag.
+  /// </summary>
   std::vector<std::shared_ptr<IShape>> _prototype;
 
+  /// <summary>
+  /// Type names, indexed by tag.
+  /// </summary>
+  std::vector<std::string> _names;
+
+  /// <summary>
+  /// Open-addressing table from type name hash to tag (-1 is empty).
+  /// Its size is a power of two, at least twice the number of types.
+  /// </summary>
+  std::vector<int> _slots;
+
+  /// <summary>
+  /// Tag of each registered dynamic type.
+  /// </summary>
+  std::unordered_map<std::type_index, int> _tags;
+
   ShapeFactory() {
-    _prototype.push_back(std::make_shared<LineShape>());
-    _prototype.push_back(std::make_shared<RectangleShape>());
-    _prototype.push_back(std::make_shared<SquareShape>());
-    _prototype.push_back(std::make_shared<EllipseShape>());
-    _prototype.push_back(std::make_shared<CircleShape>());
+    // Registration order gives the tags used by LINE_SHAPE ... CIRCLE_SHAPE.
+    registerShape(std::make_shared<LineShape>());
+    registerShape(std::make_shared<RectangleShape>());
+    registerShape(std::make_shared<SquareShape>());
+    registerShape(std::make_shared<EllipseShape>());
+    registerShape(std::make_shared<CircleShape>());
+  }
+
+  /// <summary>
+  /// FNV-1a hash of a type name.
+  /// </summary>
+  /// <param name="name"></param>
+  /// <returns></returns>
+  static uint32_t hash(std::string_view name) {
+    uint32_t result = 2166136261u;
+
+    for (char c : name) {
+      result ^= (unsigned char)c;
+      result *= 16777619u;
+    }
+
+    return result;
+  }
+
+  /// <summary>
+  /// Rebuild the name table after a registration.
+  /// </summary>
+  void rebuildSlots() {
+    size_t size = 8;
+
+    while (size < _names.size() * 2) {
+      size <<= 1;
+    }
+
+    _slots.assign(size, -1);
+
+    for (int tag = 0; tag < (int)_names.size(); ++tag) {
+      size_t slot = hash(_names[tag]) & (size - 1);
+
+      while (_slots[slot] != -1) {
+        slot = (slot + 1) & (size - 1);
+      }
+
+      _slots[slot] = tag;
+    }
   }
 
 public:
@@ -914,6 +997,78 @@ public:
     return instance;
   }
 
+  /// <summary>
+  /// Register a new kind of shape by its prototype.
+  /// The prototype's type() is the name used in saved scenes.
+  ///
+  /// Every scene format saves a shape as its type, its two points and
+  /// its graphic, and loads it back through createShape(): a shape must
+  /// be whole with these, and createShape() must make shapes of the
+  /// prototype's own type, holding the points and graphic it is given.
+  /// </summary>
+  /// <param name="prototype"></param>
+  /// <returns>Tag of the new type.</returns>
+  int registerShape(const std::shared_ptr<IShape>& prototype) {
+    std::string name = prototype->type();
+
+    if (find(name) >= 0) {
+      throw std::invalid_argument(
+        "(ShapeFactory) Shape type already registered: " + name
+      );
+    }
+
+    ShapeGraphic graphic(PS_DASH, 3, RGB(1, 2, 3), DC_BRUSH, RGB(4, 5, 6));
+    std::shared_ptr<IShape> shape = prototype->createShape(Point(1, 2), Point(31, 32), graphic);
+
+    if (!shape || typeid(*shape) != typeid(*prototype) ||
+      shape->firstPoint().x() != 1 || shape->firstPoint().y() != 2 ||
+      shape->secondPoint().x() != 31 || shape->secondPoint().y() != 32 ||
+      !(shape->graphic() == graphic)) {
+      throw std::invalid_argument(
+        "(ShapeFactory) Shape type is not made of two points and a graphic: " + name
+      );
+    }
+
+    int tag = (int)_prototype.size();
+
+    _prototype.push_back(prototype);
+    _names.push_back(name);
+    _tags[std::type_index(typeid(*prototype))] = tag;
+    rebuildSlots();
+
+    return tag;
+  }
+
+  /// <summary>
+  /// Name of a registered type.
+  /// </summary>
+  /// <param name="tag"></param>
+  /// <returns></returns>
+  const std::string& typeName(int tag) {
+    if (tag < 0 || tag >= (int)_names.size()) {
+      throw std::invalid_argument("(ShapeFactory) Unknown shape tag.");
+    }
+
+    return _names[tag];
+  }
+
+  /// <summary>
+  /// Tag of a shape, from its dynamic type (no allocation).
+  /// Shapes of a type never registered (such as a subclass of a
+  /// registered one) cannot be saved: they throw.
+  /// </summary>
+  /// <param name="shape"></param>
+  /// <returns>Tag of the shape.</returns>
+  int tagOf(const IShape& shape) {
+    auto found = _tags.find(std::type_index(typeid(shape)));
+
+    if (found == _tags.end()) {
+      throw std::invalid_argument("(ShapeFactory) Shape type not registered.");
+    }
+
+    return found->second;
+  }
+
   /// <summary>
   /// Get prototype size.
   /// </summary>
@@ -941,6 +1096,32 @@ public:
     );
   }
 
+  /// <summary>
+  /// Find the tag (prototype index) of a shape type name.
+  /// Constant time and allocation-free.
+  /// </summary>
+  /// <param name="type"></param>
+  /// <returns>Tag of the type, -1 if not found.</returns>
+  int find(std::string_view type) {
+    if (_slots.empty()) {
+      return -1;
+    }
+
+    size_t mask = _slots.size() - 1;
+    size_t slot = hash(type) & mask;
+
+    // The table is at most half full, so this always hits an empty slot.
+    while (_slots[slot] != -1) {
+      if (_names[_slots[slot]] == type) {
+        return _slots[slot];
+      }
+
+      slot = (slot + 1) & mask;
+    }
+
+    return -1;
+  }
+
   /// <summary>
   /// Create a shape from a parsed string.
   /// </summary>
@@ -950,11 +1131,10 @@ public:
   std::shared_ptr<IShape> parse(const std::string& type, const std::string& value) {
     std::shared_ptr<IShape> result = NULL;
 
-    for (int i = 0; i < _prototype.size(); ++i) {
-      if (_prototype[i]->type() == type) {
-        result = _prototype[i]->parse(value);
-        break;
-      }
+    int index = find(type);
+
+    if (index >= 0) {
+      result = _prototype[index]->parse(value);
     }
 
     return result;
@@ -0,0 +1,1664 @@
+#pragma once
+
+/// <summary>
+/// Render target rasterizing into a Framebuffer, in plain C++.
+///
+/// Lines are Bresenham, rectangles and ellipses are filled and
+/// outlined row by row as horizontal spans; ellipse rows come from an
+/// integer midpoint walk, each one drawn with its mirror row.
+/// Wide pens are spans too: the bands of a rectangle, the ring between
+/// two ellipses, and one span per row of a line, so a stroke costs the
+/// pixels it covers.
+/// Everything is clipped to the framebuffer (or a smaller clip
+/// rectangle) before any pixel work: lines only walk the steps inside
+/// it, found directly from the end points, so coordinates anywhere in
+/// the int range cost no more than the visible pixels.
+///
+/// Dashed and dotted pens (one pixel wide, as in GDI) walk the stroke
+/// with a DashPattern: lines pixel by pixel, rectangle edges and the
+/// rows of an ellipse outline dash by dash, in the order of the outline.
+/// Gaps get the background colour of a DC, GDI being opaque by default.
+///
+/// With anti-aliasing on, thin lines and ellipses are drawn with the
+/// exact share of every pixel they cover, computed in 16.16 fixed
+/// point: per column for lines (Wu), per row for ellipses, where the
+/// runs of equal coverage between the two edges are filled or blended
+/// as whole spans and only the edge pixels one by one.
+/// </summary>
+class SoftwareRenderTarget : public IRenderTarget {
+private:
+  Framebuffer& _framebuffer;
+
+  // Clip rectangle, right and bottom excluded.
+  int _clipLeft;
+  int _clipTop;
+  int _clipRight;
+  int _clipBottom;
+
+  // Current style, and what it resolves to.
+  ShapeGraphic _style;
+  bool _hasPen;
+  int _penWidth;
+  uint32_t _penColour;
+  bool _hasBrush;
+  uint32_t _brushColour;
+  const DashPattern* _dash;
+
+  /// <summary>
+  /// Pixel value of the gaps of dashed pens (white, the default
+  /// background colour of a DC).
+  /// </summary>
+  static constexpr uint32_t GAP_COLOUR = 0xFFFFFFFF;
+
+  /// <summary>
+  /// Pixels of one row of an ellipse outline: its left part, then its
+  /// right part (both inclusive, empty if from > to). The inside of
+  /// the row is what lies between them.
+  /// </summary>
+  struct OutlineRow {
+    int64_t y;
+    int64_t leftFrom;
+    int64_t leftTo;
+    int64_t rightFrom;
+    int64_t rightTo;
+  };
+
+  /// <summary>
+  /// Pixels of a thin line on one row (inclusive).
+  /// </summary>
+  struct LineRun {
+    int64_t left;
+    int64_t right;
+  };
+
+  // Runs of the thin line under a wide pen, from the top row down.
+  std::vector<LineRun> _lineRuns;
+
+  // Rows of the dashed ellipse outline being stroked.
+  std::vector<OutlineRow> _outlineRows;
+
+  bool _antialiasing;
+
+  // Coverage of the run of pixels being anti-aliased, two rows of it.
+  std::vector<uint8_t> _mask;
+  std::vector<uint8_t> _maskBelow;
+
+  // Pixels apart being anti-aliased (offsets into the framebuffer),
+  // and their coverage.
+  std::vector<size_t> _scattered;
+  std::vector<uint8_t> _scatteredCoverage;
+
+  // 16.16 fixed point.
+  static constexpr int FIXED_SHIFT = 16;
+  static constexpr int64_t FIXED_ONE = (int64_t)1 << FIXED_SHIFT;
+
+  /// <summary>
+  /// Anti-aliased ellipses keep their squared radii in 32.32 fixed
+  /// point within 64 bits up to this radius; bigger ones are aliased.
+  /// </summary>
+  static constexpr int64_t MAX_ANTIALIAS_RADIUS = 16384;
+
+  /// <summary>
+  /// Aliased ellipses keep the terms of their midpoint walk within
+  /// 64 bits up to this radius; bigger ones use the reference rows.
+  /// </summary>
+  static constexpr int64_t MAX_MIDPOINT_RADIUS = 16384;
+
+  /// <summary>
+  /// The dashes of an ellipse follow its whole outline, clipped or
+  /// not; past this radius, walking it all would stall every redraw,
+  /// so bigger ellipses are drawn with a solid pen.
+  /// </summary>
+  static constexpr int64_t MAX_DASHED_RADIUS = (int64_t)1 << 16;
+
+  /// <summary>
+  /// Runs of one coverage at least this long are filled as spans
+  /// rather than gathered in the mask.
+  /// </summary>
+  static constexpr int64_t MIN_SPAN = 16;
+
+  /// <summary>
+  /// Masks at least this long are blended by a span kernel rather than
+  /// pixel by pixel.
+  /// </summary>
+  static constexpr int64_t MIN_MASK = 8;
+
+  /// <summary>
+  /// Where an edge crosses a pixel row (from lo to hi), 16.16,
+  /// and 2^48 / (hi - lo) to divide by its width.
+  /// </summary>
+  struct Edge {
+    int64_t lo;
+    int64_t hi;
+    int64_t inverseWidth;
+
+    void set(int64_t from, int64_t to) {
+      lo = from;
+      hi = to;
+
+      // In floating point: a 64-bit integer division costs far more.
+      inverseWidth = hi - lo < FIXED_ONE / 256 ? 0 :
+        (int64_t)((double)((int64_t)1 << 48) / (hi - lo));
+    }
+  };
+
+  /// <summary>
+  /// Part of one pixel row inside an ellipse: its height (16.16)
+  /// and its left edge; the right edge mirrors it.
+  /// </summary>
+  struct CoverageRow {
+    int64_t height;
+    Edge left;
+  };
+
+  /// <summary>
+  /// Rows of an ellipse for anti-aliasing, all 16.16. Going down, the
+  /// bottom of a row is the top of the next, so the half width where
+  /// the ellipse crosses a row boundary is worked out once.
+  /// </summary>
+  struct EllipseRows {
+    int64_t cy;
+    int64_t rx;
+    int64_t ry;
+    double ratio;
+
+    // Last boundary worked out, and the half width there.
+    int64_t boundary;
+    int64_t half;
+
+    void start(int64_t centreY, int64_t radiusX, int64_t radiusY) {
+      cy = centreY;
+      rx = radiusX;
+      ry = radiusY;
+      ratio = ry > 0 ? (double)rx / ry : 0;
+      boundary = INT64_MIN;
+      half = 0;
+    }
+
+    /// <summary>
+    /// Part of pixel row y inside the ellipse, with pixel x covering
+    /// [x, x + 1), the centre at cx.
+    /// </summary>
+    /// <returns>False if the row misses the ellipse.</returns>
+    bool row(int64_t cx, int64_t y, CoverageRow& row) {
+      if (rx <= 0 || ry <= 0) {
+        return false;
+      }
+
+      int64_t top = max(y << FIXED_SHIFT, cy - ry);
+      int64_t bottom = min((y + 1) << FIXED_SHIFT, cy + ry);
+
+      if (top >= bottom) {
+        return false;
+      }
+
+      int64_t topHalf = halfWidth(top);
+      int64_t bottomHalf = halfWidth(bottom);
+
+      // The widest point of the ellipse may lie inside the row.
+      int64_t widest = top < cy && cy < bottom ? rx : max(topHalf, bottomHalf);
+      int64_t narrowest = min(topHalf, bottomHalf);
+
+      row.height = bottom - top;
+      row.left.set(cx - widest, cx - narrowest);
+
+      return true;
+    }
+
+    /// <summary>
+    /// Half the width of the ellipse at a row boundary: the square
+    /// root of the 32.32 ry² - dy², scaled to the ellipse.
+    /// </summary>
+    int64_t halfWidth(int64_t at) {
+      if (at != boundary) {
+        int64_t squared = ry * ry - (at - cy) * (at - cy);
+
+        boundary = at;
+        half = squared > 0 ? (int64_t)(std::sqrt((double)squared) * ratio) : 0;
+      }
+
+      return half;
+    }
+  };
+
+  /// <summary>
+  /// Rows of an ellipse from its top down to its centre, in integers.
+  /// Coordinates are doubled, so centres and radii on half pixels are
+  /// whole: a pixel at offset (x, y) from the centre is inside when
+  /// x² b² + y² a² &lt;= a² b². Going down a row, the half width only
+  /// grows, by as many steps as the midpoint error allows.
+  /// </summary>
+  struct EllipseWalk {
+    // Doubled radii, and their squares.
+    int64_t a = 0;
+    int64_t b = 0;
+    int64_t aa = 0;
+    int64_t bb = 0;
+
+    // Doubled offset of the row from the centre (at most 0), widest
+    // offset inside on it (-1: the row misses), and the error
+    // half² bb + y² aa - aa bb.
+    int64_t y = 0;
+    int64_t half = -1;
+    int64_t error = 0;
+
+    /// <summary>
+    /// Start at a row, with its half width computed directly.
+    /// </summary>
+    void start(int64_t radiusX, int64_t radiusY, int64_t offset) {
+      a = radiusX;
+      b = radiusY;
+      aa = a * a;
+      bb = b * b;
+      y = offset;
+      restart();
+    }
+
+    void restart() {
+      half = -1;
+
+      if (a < 0 || b < 0 || y < -b) {
+        return;
+      }
+
+      if (0 == b) {
+        half = a;
+        error = 0;
+        return;
+      }
+
+      int64_t squared = aa * (bb - y * y) / bb;
+      half = (int64_t)std::sqrt((double)squared);
+
+      while (half * half > squared) {
+        --half;
+      }
+
+      while ((half + 1) * (half + 1) <= squared) {
+        ++half;
+      }
+
+      error = half * half * bb + y * y * aa - aa * bb;
+    }
+
+    /// <summary>
+    /// Move to the next row down.
+    /// </summary>
+    void next() {
+      if (half < 0) {
+        y += 2;
+        restart();
+        return;
+      }
+
+      error += (4 * y + 4) * aa;
+      y += 2;
+
+      while (error + (2 * half + 1) * bb <= 0) {
+        error += (2 * half + 1) * bb;
+        ++half;
+      }
+    }
+
+    /// <summary>
+    /// Pixels of the row, around a doubled centre.
+    /// </summary>
+    /// <returns>False if the row misses the ellipse.</returns>
+    bool span(int64_t centre, int64_t& left, int64_t& right) const {
+      if (half < 0) {
+        return false;
+      }
+
+      left = (centre - half + 1) >> 1;
+      right = (centre + half) >> 1;
+
+      return left <= right;
+    }
+  };
+
+  /// <summary>
+  /// Pixels of a thin line, as Bresenham steps through them (end point
+  /// excluded): step k is k pixels from the start along the major
+  /// axis, and k * minor / major (halves rounded up) along the other.
+  /// Any step, and the steps inside a box, are computed directly in
+  /// unsigned 64 bits, so clipping a line costs nothing however far
+  /// its ends are.
+  /// </summary>
+  struct LineSteps {
+    int64_t startX;
+    int64_t startY;
+    bool steep;
+    int64_t signX;
+    int64_t signY;
+
+    // Lengths along the major and the minor axis.
+    uint64_t major;
+    uint64_t minor;
+
+    void set(int x1, int y1, int x2, int y2) {
+      int64_t dx = (int64_t)x2 - x1;
+      int64_t dy = (int64_t)y2 - y1;
+
+      startX = x1;
+      startY = y1;
+      signX = dx < 0 ? -1 : 1;
+      signY = dy < 0 ? -1 : 1;
+      steep = std::abs(dy) > std::abs(dx);
+      major = (uint64_t)(steep ? std::abs(dy) : std::abs(dx));
+      minor = (uint64_t)(steep ? std::abs(dx) : std::abs(dy));
+    }
+
+    /// <summary>
+    /// Offset along the minor axis at a step, and the remainder of
+    /// its division (what the next steps add minor to).
+    /// </summary>
+    uint64_t minorOffset(uint64_t step, uint64_t& remainder) const {
+      uint64_t numerator = step * minor + major / 2;
+
+      remainder = numerator % major;
+      return numerator / major;
+    }
+
+    /// <summary>
+    /// Clip to the steps whose pixel is inside a box (inclusive);
+    /// the pixels along a line only move one way on each axis, so
+    /// these steps are a single range.
+    /// </summary>
+    /// <returns>False if no step is inside.</returns>
+    bool clip(int64_t left, int64_t top, int64_t right, int64_t bottom,
+      uint64_t& first, uint64_t& last) const {
+      if (0 == major) {
+        return false;
+      }
+
+      int64_t majorStart = steep ? startY : startX;
+      int64_t minorStart = steep ? startX : startY;
+      int64_t majorSign = steep ? signY : signX;
+      int64_t minorSign = steep ? signX : signY;
+
+      // Offsets from the start, along each axis, inside the box.
+      int64_t majorLow, majorHigh, minorLow, minorHigh;
+      offsets(majorStart, majorSign, steep ? top : left, steep ? bottom : right,
+        majorLow, majorHigh);
+      offsets(minorStart, minorSign, steep ? left : top, steep ? right : bottom,
+        minorLow, minorHigh);
+
+      majorLow = max(majorLow, (int64_t)0);
+      majorHigh = min(majorHigh, (int64_t)(major - 1));
+      minorLow = max(minorLow, (int64_t)0);
+      minorHigh = min(minorHigh, (int64_t)minor);
+
+      if (majorLow > majorHigh || minorLow > minorHigh) {
+        return false;
+      }
+
+      first = (uint64_t)majorLow;
+      last = (uint64_t)majorHigh;
+
+      if (minor > 0) {
+        // First step reaching minorLow, last one before minorHigh + 1.
+        if (minorLow > 0) {
+          first = max(first, firstReaching((uint64_t)minorLow));
+        }
+
+        if ((uint64_t)minorHigh < minor) {
+          last = min(last, firstReaching((uint64_t)minorHigh + 1) - 1);
+        }
+      }
+
+      return first <= last;
+    }
+
+    /// <summary>
+    /// Offsets from start (going sign) to low..high.
+    /// </summary>
+    static void offsets(int64_t start, int64_t sign, int64_t low, int64_t high,
+      int64_t& from, int64_t& to) {
+      from = sign > 0 ? low - start : start - high;
+      to = sign > 0 ? high - start : start - low;
+    }
+
+    /// <summary>
+    /// First step whose minor offset is at least offset (1..minor).
+    /// </summary>
+    uint64_t firstReaching(uint64_t offset) const {
+      // step * minor + major / 2 >= offset * major.
+      uint64_t needed = offset * major - major / 2;
+
+      return (needed + minor - 1) / minor;
+    }
+  };
+
+  /// <summary>
+  /// Offset along the minor axis of a Wu line, in 16.16 pixels, at a
+  /// step along the major one: exactly step * minor / major rounded
+  /// down, however long the line. Any step is computed directly, and
+  /// the next or previous one from a remainder, as Bresenham does.
+  /// </summary>
+  struct WuSteps {
+    uint64_t major;
+    uint64_t minor;
+
+    // 16.16 pixels per step, and the remainder (in 1 / major).
+    uint64_t gradient;
+    uint64_t rest;
+
+    void set(uint64_t majorLength, uint64_t minorLength) {
+      major = majorLength;
+      minor = minorLength;
+      gradient = (minor << FIXED_SHIFT) / major;
+      rest = (minor << FIXED_SHIFT) % major;
+    }
+
+    /// <summary>
+    /// Offset at a step, and the remainder of its division.
+    /// </summary>
+    uint64_t at(uint64_t step, uint64_t& stepRemainder) const {
+      // step * minor fits in 64 bits; its remainder shifted does too.
+      uint64_t moved = step * minor;
+      uint64_t part = (moved % major) << FIXED_SHIFT;
+
+      stepRemainder = part % major;
+      return ((moved / major) << FIXED_SHIFT) + part / major;
+    }
+
+    // Without branches: the carries come as often as not.
+    void next(uint64_t& offset, uint64_t& remainder) const {
+      remainder += rest;
+
+      uint64_t carry = remainder >= major;
+      offset += gradient + carry;
+      remainder -= major & (0 - carry);
+    }
+
+    void previous(uint64_t& offset, uint64_t& remainder) const {
+      uint64_t borrow = remainder < rest;
+      offset -= gradient + borrow;
+      remainder += (major & (0 - borrow)) - rest;
+    }
+  };
+
+  /// <summary>
+  /// Fill pixels left..right (inclusive) of row y, clipped.
+  /// </summary>
+  /// <param name="y"></param>
+  /// <param name="left"></param>
+  /// <param name="right"></param>
+  /// <param name="colour"></param>
+  void span(int64_t y, int64_t left, int64_t right, uint32_t colour) {
+    if (y < _clipTop || y >= _clipBottom) {
+      return;
+    }
+
+    left = max(left, (int64_t)_clipLeft);
+    right = min(right, (int64_t)_clipRight - 1);
+
+    if (left <= right) {
+      _framebuffer.fillSpan((int)left, (int)y, (int)(right - left + 1), colour);
+    }
+  }
+
+  /// <summary>
+  /// Fill a rectangle, every bound inclusive, clipped.
+  /// </summary>
+  void block(int64_t left, int64_t top, int64_t right, int64_t bottom,
+    uint32_t colour) {
+    top = max(top, (int64_t)_clipTop);
+    bottom = min(bottom, (int64_t)_clipBottom - 1);
+
+    for (int64_t y = top; y <= bottom; ++y) {
+      span(y, left, right, colour);
+    }
+  }
+
+  /// <summary>
+  /// Pixels of row y inside the ellipse of centre (cx, cy) and
+  /// radii (rx, ry), reference version: one sqrt per row.
+  /// </summary>
+  /// <returns>False if the row misses the ellipse.</returns>
+  static bool ellipseSpan(double cx, double cy, double rx, double ry,
+    int64_t y, int64_t& left, int64_t& right) {
+    if (rx < 0 || ry < 0) {
+      return false;
+    }
+
+    double dy = y - cy;
+
+    if (dy < -ry || dy > ry) {
+      return false;
+    }
+
+    double half = rx;
+
+    if (ry > 0) {
+      double t = dy / ry;
+      half = rx * std::sqrt(max(0.0, 1.0 - t * t));
+    }
+
+    left = (int64_t)std::ceil(cx - half - 1e-9);
+    right = (int64_t)std::floor(cx + half + 1e-9);
+
+    return left <= right;
+  }
+
+  /// <summary>
+  /// Opacity (0 to 255) of a 16.16 coverage.
+  /// </summary>
+  static uint8_t toAlpha(int64_t coverage) {
+    return (uint8_t)((max((int64_t)0, min(coverage, FIXED_ONE)) * 255 + FIXED_ONE / 2) >> FIXED_SHIFT);
+  }
+
+  /// <summary>
+  /// Blend an opaque colour over count pixels of row y from x on,
+  /// pixel i with opacity alphas[i], clipped.
+  /// </summary>
+  void coverMask(int64_t y, int64_t x, const uint8_t* alphas, int64_t count,
+    uint32_t colour) {
+    if (y < _clipTop || y >= _clipBottom) {
+      return;
+    }
+
+    int64_t left = max(x, (int64_t)_clipLeft);
+    int64_t right = min(x + count, (int64_t)_clipRight);
+
+    // A few pixels cost less blended in place than through a kernel;
+    // those fully covered, or not at all, need no blending.
+    if (right - left < MIN_MASK) {
+      uint32_t* row = _framebuffer.row((int)y);
+      uint32_t opaque = colour | 0xFF000000;
+
+      for (int64_t i = left; i < right; ++i) {
+        uint32_t alpha = alphas[i - x];
+
+        if (255 == alpha) {
+          row[i] = opaque;
+        }
+
+        else if (alpha > 0) {
+          row[i] = SpanKernels::blendPixel(row[i], colour, alpha);
+        }
+      }
+    }
+
+    else {
+      _framebuffer.blendMaskSpan(
+        (int)left,
+        (int)y,
+        alphas + (left - x),
+        (int)(right - left),
+        colour
+      );
+    }
+  }
+
+  /// <summary>
+  /// Make room for count pixels in the scattered buffers.
+  /// </summary>
+  void reserveScattered(size_t count) {
+    if (_scattered.size() < count) {
+      _scattered.resize(count);
+      _scatteredCoverage.resize(count);
+    }
+  }
+
+  /// <summary>
+  /// Blend a colour over pixels left..right (inclusive) of row y,
+  /// all covered alike. The caller clips.
+  /// </summary>
+  void coverSpan(int64_t y, int64_t left, int64_t right, uint32_t colour,
+    int64_t coverage) {
+    uint32_t alpha = toAlpha(coverage);
+
+    if (0 == alpha || left > right) {
+      return;
+    }
+
+    if (255 == alpha) {
+      _framebuffer.fillSpan((int)left, (int)y, (int)(right - left + 1), colour);
+    }
+
+    else {
+      _framebuffer.blendSpan(
+        (int)left,
+        (int)y,
+        (int)(right - left + 1),
+        (colour & 0x00FFFFFF) | (alpha << 24)
+      );
+    }
+  }
+
+  /// <summary>
+  /// Integral of clamp(s, 0, 1) for s from 0 to z, 16.16.
+  /// </summary>
+  static int64_t rampArea(int64_t z) {
+    if (z <= 0) {
+      return 0;
+    }
+
+    if (z <= FIXED_ONE) {
+      return (z * z) >> (FIXED_SHIFT + 1);
+    }
+
+    return z - FIXED_ONE / 2;
+  }
+
+  /// <summary>
+  /// Share of column [column, column + 1) right of an edge going
+  /// straight across the row, averaged over the row.
+  /// </summary>
+  static int64_t edgeCoverage(int64_t column, const Edge& edge) {
+    int64_t end = (column + 1) << FIXED_SHIFT;
+
+    if (end <= edge.lo) {
+      return 0;
+    }
+
+    if (end - FIXED_ONE >= edge.hi) {
+      return FIXED_ONE;
+    }
+
+    // Close to vertical: the edge crosses the column at its middle.
+    if (0 == edge.inverseWidth) {
+      return max((int64_t)0, min(end - (edge.lo + edge.hi) / 2, FIXED_ONE));
+    }
+
+    // The area is at most the width plus a pixel: the product fits.
+    return ((rampArea(end - edge.lo) - rampArea(end - edge.hi)) *
+      edge.inverseWidth) >> 32;
+  }
+
+  /// <summary>
+  /// Draw a row of an ellipse with a colour, anti-aliased, on each of
+  /// the given pixel rows (a row and its mirror cut the ellipse alike).
+  /// Column x mirrors column mirror - x, so only the left half is
+  /// worked out, and past the edges the row is of one coverage up to
+  /// where the mirrored edges start. Without a hole, pixels get what
+  /// the shape covers less what the cut covers; with one, pixels the
+  /// cut covers whole are left to be drawn later.
+  /// </summary>
+  /// <param name="rows"></param>
+  /// <param name="rowCount"></param>
+  /// <param name="mirror"></param>
+  /// <param name="shape"></param>
+  /// <param name="cut">Part to leave out, may be NULL.</param>
+  /// <param name="colour"></param>
+  /// <param name="hole">Leave the cut as a hole rather than subtract it.</param>
+  void coverEllipseRow(const int64_t* rows, int rowCount, int64_t mirror,
+    const CoverageRow& shape, const CoverageRow* cut, uint32_t colour, bool hole) {
+    hole = hole && cut;
+
+    // Columns from first to settled (excluded) have an edge in
+    // transition; from there, the shape less the cut covers them all.
+    int64_t first = shape.left.lo >> FIXED_SHIFT;
+    int64_t settled = (shape.left.hi + FIXED_ONE - 1) >> FIXED_SHIFT;
+    int64_t inside = shape.height;
+
+    if (cut) {
+      settled = max(settled, (cut->left.hi + FIXED_ONE - 1) >> FIXED_SHIFT);
+      inside -= hole ? 0 : cut->height;
+    }
+
+    // Opacity of a column from its shares right of the left edges of
+    // the shape and of the cut.
+    int64_t cutHeight = cut ? cut->height : 0;
+
+    auto alphaOf = [&](int64_t share, int64_t cutShare) {
+      int64_t covered = shape.height * share;
+
+      if (!hole) {
+        covered -= cutHeight * cutShare;
+      }
+
+      else if (FIXED_ONE == (cutHeight * cutShare) >> FIXED_SHIFT) {
+        covered = 0;
+      }
+
+      return toAlpha(covered >> FIXED_SHIFT);
+    };
+
+    // The mask holds the whole row; its right part mirrors the left.
+    int64_t end = min(settled, (mirror + 1) >> 1);
+    int64_t width = mirror - 2 * first + 1;
+
+    if (end < first || width <= 0) {
+      return;
+    }
+
+    if (_mask.size() < (size_t)width) {
+      _mask.resize((size_t)width);
+    }
+
+    uint8_t* mask = _mask.data();
+
+    for (int64_t x = first; x < end; ++x) {
+      mask[x - first] = mask[mirror - x - first] = alphaOf(
+        edgeCoverage(x, shape.left),
+        cut ? edgeCoverage(x, cut->left) : 0
+      );
+    }
+
+    // The run between the edges and their mirrors. Where the edges
+    // reach the centre column, it is that column, worked out alone:
+    // the right edges leave of it what the left ones take.
+    int64_t runLength = mirror - 2 * end + 1;
+    uint8_t alpha = toAlpha(inside);
+
+    if (settled > end) {
+      alpha = runLength > 0 ? alphaOf(
+        2 * edgeCoverage(end, shape.left) - FIXED_ONE,
+        cut ? max(2 * edgeCoverage(end, cut->left) - FIXED_ONE, (int64_t)0) : 0
+      ) : 0;
+    }
+
+    bool skipped = 0 == alpha || (hole && settled <= end && FIXED_ONE == cut->height);
+    int64_t edgeLength = end - first;
+
+    // Edges inside the clip rectangle: each coverage goes to its four
+    // pixels (both rows, both sides) at once, and the run between the
+    // edges to one blend per row, rather than a few pixels to a call.
+    if (first >= _clipLeft && mirror - first < _clipRight) {
+      _framebuffer.blendMirroredSpans((int)first, (int)rows[0], (int)rows[rowCount - 1],
+        (int)(width - 1), mask, (int)edgeLength, colour);
+
+      for (int r = 0; r < rowCount && !skipped && runLength > 0; ++r) {
+        _framebuffer.blendSpan((int)end, (int)rows[r], (int)runLength,
+          (colour & 0x00FFFFFF) | ((uint32_t)alpha << 24));
+      }
+
+      return;
+    }
+
+    for (int r = 0; r < rowCount; ++r) {
+      if (skipped) {
+        coverMask(rows[r], first, mask, edgeLength, colour);
+        coverMask(rows[r], mirror - end + 1, mask + (width - edgeLength), edgeLength, colour);
+      }
+
+      else if (runLength < MIN_SPAN) {
+        if (0 == r && runLength > 0) {
+          memset(mask + edgeLength, alpha, (size_t)runLength);
+        }
+
+        coverMask(rows[r], first, mask, width, colour);
+      }
+
+      else {
+        coverMask(rows[r], first, mask, edgeLength, colour);
+        coverSpan(
+          rows[r],
+          max(end, (int64_t)_clipLeft),
+          min(mirror - end, (int64_t)_clipRight - 1),
+          colour,
+          inside
+        );
+        coverMask(rows[r], mirror - end + 1, mask + (width - edgeLength), edgeLength, colour);
+      }
+    }
+  }
+
+  /// <summary>
+  /// First step from first to last (excluded) meeting a condition that,
+  /// once met, stays met; last if none does. The ends are tried before
+  /// bisecting: most lines cross the clip rectangle whole.
+  /// </summary>
+  template <typename Condition>
+  static int64_t firstStep(int64_t first, int64_t last, Condition&& condition) {
+    if (first >= last || condition(first)) {
+      return first;
+    }
+
+    if (!condition(last - 1)) {
+      return last;
+    }
+
+    while (first < last) {
+      int64_t middle = first + (last - first) / 2;
+
+      if (condition(middle)) {
+        last = middle;
+      }
+
+      else {
+        first = middle + 1;
+      }
+    }
+
+    return first;
+  }
+
+  /// <summary>
+  /// Steps first to last (excluded) of a solid Wu line, clipped along
+  /// its major axis: the pixel pairs inside the clip rectangle go to
+  /// the kernel at once, four pixels to a vector; the few it cuts,
+  /// where the line leaves it across the minor axis, are blended alone.
+  /// </summary>
+  void antialiasedPairs(const WuSteps& steps, bool steep, int64_t u1, int64_t v1,
+    int64_t direction, int64_t minorSign, int64_t first, int64_t last) {
+    reserveScattered(2 * (size_t)(last - first));
+
+    size_t* offsets = _scattered.data();
+    uint8_t* coverage = _scatteredCoverage.data();
+    size_t count = 0;
+
+    int64_t low = steep ? _clipLeft : _clipTop;
+    int64_t high = (int64_t)(steep ? _clipRight : _clipBottom) - 1;
+    size_t across = steep ? 1 : (size_t)_framebuffer.width();
+
+    uint64_t remainder = 0;
+    uint64_t offset = steps.at((uint64_t)((first - u1) * direction), remainder);
+
+    for (int64_t u = first; u < last; ++u) {
+      int64_t v = (v1 << FIXED_SHIFT) + minorSign * (int64_t)offset;
+      int64_t fraction = v & (FIXED_ONE - 1);
+      int64_t pair = v >> FIXED_SHIFT;
+      uint8_t alphas[2] = { toAlpha(FIXED_ONE - fraction), toAlpha(fraction) };
+
+      if (direction > 0) {
+        steps.next(offset, remainder);
+      }
+
+      else {
+        steps.previous(offset, remainder);
+      }
+
+      if (pair >= low && pair < high) {
+        offsets[count] = steep ? _framebuffer.offset((int)pair, (int)u) :
+          _framebuffer.offset((int)u, (int)pair);
+        coverage[count++] = alphas[0];
+        offsets[count] = offsets[count - 1] + across;
+        coverage[count++] = alphas[1];
+      }
+
+      else if (steep) {
+        coverMask(u, pair, alphas, 2, _penColour);
+      }
+
+      else {
+        coverMask(pair, u, alphas, 1, _penColour);
+        coverMask(pair + 1, u, alphas + 1, 1, _penColour);
+      }
+    }
+
+    _framebuffer.blendScattered(offsets, coverage, count, _penColour);
+  }
+
+  /// <summary>
+  /// Wu line of a one pixel pen, end point excluded: each step
+  /// shares the pen between the two pixels the line passes between.
+  /// Pixels are visited along the major axis in increasing order,
+  /// only inside the clip rectangle, and blended a run at a time.
+  /// Dashes follow the step from the start point, as aliased lines do.
+  /// </summary>
+  void antialiasedLine(int x1, int y1, int x2, int y2) {
+    int64_t dx = (int64_t)x2 - x1;
+    int64_t dy = (int64_t)y2 - y1;
+    bool steep = std::abs(dy) > std::abs(dx);
+
+    // Major axis u, minor axis v; step k is at u1 + k * direction.
+    int64_t u1 = steep ? y1 : x1;
+    int64_t v1 = steep ? x1 : y1;
+    int64_t du = steep ? dy : dx;
+    int64_t dv = steep ? dx : dy;
+    int64_t length = std::abs(du);
+
+    if (0 == length) {
+      return;
+    }
+
+    int64_t direction = du > 0 ? 1 : -1;
+    int64_t minorSign = dv < 0 ? -1 : 1;
+
+    WuSteps steps;
+    steps.set((uint64_t)length, (uint64_t)std::abs(dv));
+
+    // Minor axis positions (16.16) at ascending u, from the first step.
+    uint64_t offset = 0;
+    uint64_t remainder = 0;
+
+    auto walk = [&]() {
+      int64_t v = (v1 << FIXED_SHIFT) + minorSign * (int64_t)offset;
+
+      if (direction > 0) {
+        steps.next(offset, remainder);
+      }
+
+      else {
+        steps.previous(offset, remainder);
+      }
+
+      return v;
+    };
+
+    // Steps (ascending u) from first to last, within the clip rectangle.
+    int64_t lowest = direction > 0 ? u1 : u1 - length + 1;
+    int64_t first = max(lowest, (int64_t)(steep ? _clipTop : _clipLeft));
+    int64_t last = min(lowest + length, (int64_t)(steep ? _clipBottom : _clipRight));
+
+    // Along the minor axis, the pixel pairs only move one way, so the
+    // steps touching the clip rectangle are found by bisection.
+    auto pairAt = [&](int64_t u) {
+      uint64_t unused;
+      int64_t at = (int64_t)steps.at((uint64_t)((u - u1) * direction), unused);
+
+      return ((v1 << FIXED_SHIFT) + minorSign * at) >> FIXED_SHIFT;
+    };
+
+    int64_t minorLow = (int64_t)(steep ? _clipLeft : _clipTop) - 1;
+    int64_t minorHigh = (int64_t)(steep ? _clipRight : _clipBottom) - 1;
+    bool rising = steps.minor > 0 && minorSign == direction;
+
+    first = firstStep(first, last, [&](int64_t u) {
+      return rising ? pairAt(u) >= minorLow : pairAt(u) <= minorHigh;
+    });
+
+    last = firstStep(first, last, [&](int64_t u) {
+      return rising ? pairAt(u) > minorHigh : pairAt(u) < minorLow;
+    });
+
+    if (first >= last) {
+      return;
+    }
+
+    // Solid lines, but for the shallow ones: their runs along a row
+    // go faster through the mask kernels.
+    if (_dash->isSolid() && (steep || steps.minor * MIN_MASK > steps.major)) {
+      antialiasedPairs(steps, steep, u1, v1, direction, minorSign, first, last);
+      return;
+    }
+
+    if (steep) {
+      // Two pixels side by side on every row.
+      uint8_t alphas[2];
+
+      offset = steps.at((uint64_t)((first - u1) * direction), remainder);
+
+      for (int64_t u = first; u < last; ++u) {
+        int64_t v = walk();
+        int64_t fraction = v & (FIXED_ONE - 1);
+
+        alphas[0] = toAlpha(FIXED_ONE - fraction);
+        alphas[1] = toAlpha(fraction);
+        coverMask(u, v >> FIXED_SHIFT, alphas, 2, stepColour((u - u1) * direction));
+      }
+
+      return;
+    }
+
+    // Runs of columns sharing a pair of rows (and a colour): the row
+    // above in the mask, the row below in the second mask.
+    _mask.resize((size_t)(last - first));
+    _maskBelow.resize((size_t)(last - first));
+
+    int64_t runStart = first;
+    int64_t runRow = 0;
+    uint32_t runColour = _penColour;
+
+    offset = steps.at((uint64_t)((first - u1) * direction), remainder);
+
+    for (int64_t u = first; u <= last; ++u) {
+      int64_t v = 0;
+      uint32_t colour = _penColour;
+
+      if (u < last) {
+        v = walk();
+        colour = stepColour((u - u1) * direction);
+      }
+
+      if (u == last ||
+        (u > runStart && (v >> FIXED_SHIFT != runRow || colour != runColour))) {
+        coverMask(runRow, runStart, &_mask[(size_t)(runStart - first)], u - runStart, runColour);
+        coverMask(runRow + 1, runStart, &_maskBelow[(size_t)(runStart - first)], u - runStart, runColour);
+        runStart = u;
+      }
+
+      if (u == last) {
+        break;
+      }
+
+      int64_t fraction = v & (FIXED_ONE - 1);
+
+      runRow = v >> FIXED_SHIFT;
+      runColour = colour;
+      _mask[(size_t)(u - first)] = toAlpha(FIXED_ONE - fraction);
+      _maskBelow[(size_t)(u - first)] = toAlpha(fraction);
+    }
+  }
+
+  /// <summary>
+  /// Ellipse inscribed in a box (right and bottom excluded),
+  /// anti-aliased. The pen is as wide as in the aliased version:
+  /// a ring from inside to outside the edge of the ellipse.
+  /// </summary>
+  void antialiasedEllipse(int64_t left, int64_t top, int64_t right, int64_t bottom) {
+    int64_t cx = (left + right) << (FIXED_SHIFT - 1);
+    int64_t cy = (top + bottom) << (FIXED_SHIFT - 1);
+    int64_t rx = (right - left) << (FIXED_SHIFT - 1);
+    int64_t ry = (bottom - top) << (FIXED_SHIFT - 1);
+
+    int64_t outside = _hasPen ? ((int64_t)(_penWidth - 1) / 2) << FIXED_SHIFT : 0;
+    int64_t inside = _hasPen ? ((int64_t)_penWidth << FIXED_SHIFT) - outside : 0;
+
+    // Row y mirrors row mirrorY - y, and column x mirrors column
+    // mirrorX - x: only the top left quarter is worked out.
+    int64_t mirrorX = left + right - 1;
+    int64_t mirrorY = top + bottom - 1;
+
+    // Rows of the top half which, or whose mirror, are in the clip.
+    int64_t first = max((cy - ry - outside) >> FIXED_SHIFT,
+      min((int64_t)_clipTop, mirrorY - _clipBottom + 1));
+    int64_t last = min(mirrorY >> 1,
+      max((int64_t)_clipBottom - 1, mirrorY - _clipTop));
+
+    EllipseRows outer;
+    outer.start(cy, rx + outside, ry + outside);
+
+    EllipseRows inner;
+    inner.start(cy, rx - inside, ry - inside);
+
+    for (int64_t y = first; y <= last; ++y) {
+      // The row and its mirror, those inside the clip rectangle.
+      int64_t rows[2];
+      int count = 0;
+
+      for (int64_t row : { y, mirrorY - y }) {
+        if (row >= _clipTop && row < _clipBottom && (0 == count || row != rows[0])) {
+          rows[count++] = row;
+        }
+      }
+
+      if (0 == count) {
+        continue;
+      }
+
+      CoverageRow innerRow;
+      bool hasInner = inner.row(cx, y, innerRow);
+
+      CoverageRow outerRow;
+      bool hasOuter = _hasPen && outer.row(cx, y, outerRow);
+
+      if (hasOuter) {
+        // The fill, drawn next, covers the pen where it meets it.
+        coverEllipseRow(rows, count, mirrorX, outerRow, hasInner ? &innerRow : NULL,
+          _penColour, _hasBrush);
+      }
+
+      if (hasInner && _hasBrush) {
+        coverEllipseRow(rows, count, mirrorX, innerRow, NULL, _brushColour, false);
+      }
+    }
+  }
+
+  /// <summary>
+  /// Line of a pen wider than a pixel: what a square pen centred on
+  /// every pixel of the thin line covers. Each row of the thin line is
+  /// a run, and the runs only move one way, so a covered row is one
+  /// span, from the runs at both ends of the rows the pen reaches it
+  /// from. Only the steps of the thin line whose pen reaches the clip
+  /// rectangle are walked, then every row is drawn once.
+  /// </summary>
+  void wideLine(int x1, int y1, int x2, int y2) {
+    int64_t before = (_penWidth - 1) / 2;
+    int64_t after = _penWidth / 2;
+
+    LineSteps steps;
+    steps.set(x1, y1, x2, y2);
+
+    uint64_t first, last;
+
+    if (!steps.clip(
+      (int64_t)_clipLeft - after,
+      (int64_t)_clipTop - after,
+      (int64_t)_clipRight - 1 + before,
+      (int64_t)_clipBottom - 1 + before,
+      first,
+      last)) {
+      return;
+    }
+
+    uint64_t remainder;
+    int64_t minor = (int64_t)steps.minorOffset(first, remainder);
+
+    _lineRuns.clear();
+    int64_t firstRow = 0;
+    int64_t lastRow = 0;
+
+    for (uint64_t k = first; k <= last; ++k) {
+      int64_t x = steps.startX + steps.signX * (steps.steep ? minor : (int64_t)k);
+      int64_t y = steps.startY + steps.signY * (steps.steep ? (int64_t)k : minor);
+
+      if (_lineRuns.empty() || y != lastRow) {
+        if (_lineRuns.empty()) {
+          firstRow = y;
+        }
+
+        _lineRuns.push_back({ x, x });
+        lastRow = y;
+      }
+
+      else {
+        LineRun& run = _lineRuns.back();
+        run.left = min(run.left, x);
+        run.right = max(run.right, x);
+      }
+
+      remainder += steps.minor;
+
+      if (remainder >= steps.major) {
+        remainder -= steps.major;
+        ++minor;
+      }
+    }
+
+    if (steps.signY < 0) {
+      std::reverse(_lineRuns.begin(), _lineRuns.end());
+    }
+
+    int64_t top = min(firstRow, lastRow);
+    int64_t bottom = max(firstRow, lastRow);
+
+    int64_t from = max(top - before, (int64_t)_clipTop);
+    int64_t to = min(bottom + after, (int64_t)_clipBottom - 1);
+
+    for (int64_t row = from; row <= to; ++row) {
+      // Runs of the rows whose pen covers this one.
+      const LineRun& upper = _lineRuns[(size_t)(max(row - after, top) - top)];
+      const LineRun& lower = _lineRuns[(size_t)(min(row + before, bottom) - top)];
+
+      span(
+        row,
+        min(upper.left, lower.left) - before,
+        max(upper.right, lower.right) + after,
+        _penColour
+      );
+    }
+  }
+
+  /// <summary>
+  /// Ellipse of the aliased renderer, same pixels as the rows of
+  /// ellipseSpan but walked in integers: the outer and inner ellipses
+  /// of the pen go from the top down to the centre, and every step
+  /// draws its row and the mirror row below the centre, the fill
+  /// between the inner ends and the pen on both sides of it.
+  /// Only rows which are (or mirror) a row of the clip are drawn.
+  /// </summary>
+  void midpointEllipse(int64_t left, int64_t top, int64_t right, int64_t bottom) {
+    int64_t outside = _hasPen ? (_penWidth - 1) / 2 : 0;
+    int64_t inside = _hasPen ? _penWidth / 2 + 1 : 0;
+
+    int64_t centreX = left + right;
+    int64_t centreY = top + bottom;
+    int64_t radiusX = right - left + 1;
+    int64_t radiusY = bottom - top + 1;
+
+    // Row y mirrors row centreY - y.
+    int64_t first = max(top - outside,
+      min((int64_t)_clipTop, centreY - _clipBottom + 1));
+    int64_t last = min(centreY >> 1,
+      max((int64_t)_clipBottom - 1, centreY - _clipTop));
+
+    if (first > last) {
+      return;
+    }
+
+    EllipseWalk outer;
+    outer.start(radiusX + 2 * outside, radiusY + 2 * outside, 2 * first - centreY);
+
+    EllipseWalk inner;
+    inner.start(radiusX - 2 * inside, radiusY - 2 * inside, 2 * first - centreY);
+
+    for (int64_t y = first; y <= last; ++y, outer.next(), inner.next()) {
+      int64_t rows[2] = { y, centreY - y };
+      int count = rows[0] == rows[1] ? 1 : 2;
+
+      int64_t innerLeft = 0, innerRight = 0;
+      bool hasInner = inner.span(centreX, innerLeft, innerRight);
+
+      int64_t outerLeft = 0, outerRight = 0;
+      bool hasOuter = _hasPen && outer.span(centreX, outerLeft, outerRight);
+
+      for (int i = 0; i < count; ++i) {
+        if (hasInner && _hasBrush) {
+          span(rows[i], innerLeft, innerRight, _brushColour);
+        }
+
+        if (!hasOuter) {
+          continue;
+        }
+
+        if (hasInner) {
+          span(rows[i], outerLeft, innerLeft - 1, _penColour);
+          span(rows[i], innerRight + 1, outerRight, _penColour);
+        }
+
+        else {
+          span(rows[i], outerLeft, outerRight, _penColour);
+        }
+      }
+    }
+  }
+
+  /// <summary>
+  /// Pen colour of a phase of the dash pattern.
+  /// </summary>
+  uint32_t strokeColour(int phase) const {
+    return _dash->isOn(phase) ? _penColour : GAP_COLOUR;
+  }
+
+  /// <summary>
+  /// Pen colour of the pixel a number of steps from the start of a line.
+  /// </summary>
+  uint32_t stepColour(int64_t step) const {
+    return _dash->isSolid() ? _penColour : strokeColour(_dash->advance(0, step));
+  }
+
+  /// <summary>
+  /// Stroke count pixels in a straight line from (x, y), one step
+  /// being (dx, dy) along an axis, dash by dash. Only the dashes inside
+  /// the clip rectangle are walked; the phase skips the others.
+  /// </summary>
+  /// <returns>Phase of the pixel after the run.</returns>
+  int strokeRun(int64_t x, int64_t y, int dx, int dy, int64_t count, int phase) {
+    int after = _dash->advance(phase, count);
+
+    // Offsets of the run inside the clip rectangle.
+    int64_t low = 0, high = count - 1;
+
+    if (0 == dy) {
+      if (y < _clipTop || y >= _clipBottom) {
+        return after;
+      }
+
+      low = max(low, dx > 0 ? _clipLeft - x : x - (_clipRight - 1));
+      high = min(high, dx > 0 ? _clipRight - 1 - x : x - _clipLeft);
+    }
+
+    else {
+      if (x < _clipLeft || x >= _clipRight) {
+        return after;
+      }
+
+      low = max(low, dy > 0 ? _clipTop - y : y - (_clipBottom - 1));
+      high = min(high, dy > 0 ? _clipBottom - 1 - y : y - _clipTop);
+    }
+
+    if (low > high) {
+      return after;
+    }
+
+    x += dx * low;
+    y += dy * low;
+
+    _dash->walk(_dash->advance(phase, low), high - low + 1,
+      [&](int64_t offset, int64_t length, bool on) {
+      int64_t fromX = x + dx * offset;
+      int64_t fromY = y + dy * offset;
+      int64_t toX = x + dx * (offset + length - 1);
+      int64_t toY = y + dy * (offset + length - 1);
+
+      block(
+        min(fromX, toX),
+        min(fromY, toY),
+        max(fromX, toX),
+        max(fromY, toY),
+        on ? _penColour : GAP_COLOUR
+      );
+    });
+
+    return after;
+  }
+
+  /// <summary>
+  /// Outline pixels of a row of a dashed ellipse.
+  /// </summary>
+  /// <returns>False if the row misses the ellipse.</returns>
+  static bool outlineRow(double cx, double cy, double rx, double ry, int64_t y,
+    OutlineRow& row) {
+    int64_t outerLeft = 0, outerRight = 0;
+
+    if (!ellipseSpan(cx, cy, rx, ry, y, outerLeft, outerRight)) {
+      return false;
+    }
+
+    int64_t innerLeft = 0, innerRight = 0;
+    bool hasInner = ellipseSpan(cx, cy, rx - 1, ry - 1, y, innerLeft, innerRight);
+
+    // The centre column goes to the right part of rows which have
+    // no inside.
+    int64_t middle = (int64_t)std::ceil(cx);
+
+    row.y = y;
+    row.leftFrom = outerLeft;
+    row.leftTo = hasInner ? innerLeft - 1 : min(outerRight, middle - 1);
+    row.rightFrom = hasInner ? innerRight + 1 : max(outerLeft, middle);
+    row.rightTo = outerRight;
+
+    return true;
+  }
+
+  /// <summary>
+  /// Dashed ellipse of a one pixel pen, stroked clockwise from the
+  /// top: the right parts of the rows going down, the left parts going
+  /// up. Every row is walked, clipped or not, so the dashes never
+  /// depend on the clip; rows outside it only advance the phase.
+  /// The rows are worked out once, for the brush and both walks.
+  /// </summary>
+  void dashedEllipse(double cx, double cy, double rx, double ry) {
+    int64_t first = (int64_t)std::floor(cy - ry);
+    int64_t last = (int64_t)std::ceil(cy + ry);
+
+    OutlineRow row;
+    _outlineRows.clear();
+
+    for (int64_t y = first; y <= last; ++y) {
+      if (!outlineRow(cx, cy, rx, ry, y, row)) {
+        continue;
+      }
+
+      if (_hasBrush) {
+        span(y, row.leftTo + 1, row.rightFrom - 1, _brushColour);
+      }
+
+      _outlineRows.push_back(row);
+    }
+
+    int phase = 0;
+
+    // Right parts: outwards above the centre, inwards below it.
+    for (const OutlineRow& right : _outlineRows) {
+      bool above = right.y < cy;
+
+      phase = strokeRun(
+        above ? right.rightFrom : right.rightTo,
+        right.y,
+        above ? 1 : -1,
+        0,
+        right.rightTo - right.rightFrom + 1,
+        phase
+      );
+    }
+
+    // Left parts, going up: outwards below the centre, inwards above it.
+    for (auto left = _outlineRows.rbegin(); left != _outlineRows.rend(); ++left) {
+      bool above = left->y < cy;
+
+      phase = strokeRun(
+        above ? left->leftFrom : left->leftTo,
+        left->y,
+        above ? 1 : -1,
+        0,
+        left->leftTo - left->leftFrom + 1,
+        phase
+      );
+    }
+  }
+
+  /// <summary>
+  /// Sort a bounding box, and turn it inclusive.
+  /// </summary>
+  static void normalise(int64_t& left, int64_t& top, int64_t& right,
+    int64_t& bottom) {
+    if (left > right) {
+      std::swap(left, right);
+    }
+
+    if (top > bottom) {
+      std::swap(top, bottom);
+    }
+
+    --right;
+    --bottom;
+  }
+
+public:
+  /// <summary>
+  /// Draw into a framebuffer.
+  /// </summary>
+  /// <param name="framebuffer"></param>
+  SoftwareRenderTarget(Framebuffer& framebuffer) : _framebuffer(framebuffer),
+    _style(PS_NULL, 0, 0, NULL_BRUSH, 0) {
+    _antialiasing = false;
+    _dash = &DashPattern::of(PS_SOLID);
+    setClip(0, 0, framebuffer.width(), framebuffer.height());
+    setStyle(ShapeGraphic(PS_SOLID, 1, RGB(0, 0, 0), NULL_BRUSH, RGB(255, 255, 255)));
+  }
+
+public:
+  /// <summary>
+  /// Only draw inside a rectangle (right and bottom excluded),
+  /// itself clipped to the framebuffer.
+  /// </summary>
+  void setClip(int left, int top, int right, int bottom) {
+    _clipLeft = max(left, 0);
+    _clipTop = max(top, 0);
+    _clipRight = min(right, _framebuffer.width());
+    _clipBottom = min(bottom, _framebuffer.height());
+  }
+
+  /// <summary>
+  /// Draw thin lines and ellipses anti-aliased, or not.
+  /// </summary>
+  /// <param name="antialiasing"></param>
+  void setAntialiasing(bool antialiasing) {
+    _antialiasing = antialiasing;
+  }
+
+  bool isAntialiasing() const { return _antialiasing; }
+
+  void setStyle(const ShapeGraphic& graphic) override {
+    // Same style as the previous shape: nothing to resolve.
+    if (graphic == _style) {
+      return;
+    }
+
+    _style = graphic;
+    _hasPen = graphic.lineStyle() != PS_NULL;
+    _penWidth = max(graphic.lineWidth(), 1);
+    _penColour = Framebuffer::toPixel(graphic.lineColour());
+
+    // GDI only dashes one pixel pens; wider ones are solid.
+    _dash = &DashPattern::of(1 == _penWidth ? graphic.lineStyle() : PS_SOLID);
+
+    COLORREF brushColour = 0;
+    _hasBrush = graphic.brushColour(brushColour);
+    _brushColour = Framebuffer::toPixel(brushColour);
+  }
+
+  /// <summary>
+  /// Bresenham line, end point excluded. Wide pens cover what a
+  /// square of the pen width moved along it would, drawn as one span
+  /// per row.
+  /// </summary>
+  void line(int x1, int y1, int x2, int y2) override {
+    if (!_hasPen) {
+      return;
+    }
+
+    if (_antialiasing && 1 == _penWidth) {
+      antialiasedLine(x1, y1, x2, y2);
+      return;
+    }
+
+    if (_penWidth > 1) {
+      wideLine(x1, y1, x2, y2);
+      return;
+    }
+
+    // Only the steps inside the clip rectangle are walked.
+    LineSteps steps;
+    steps.set(x1, y1, x2, y2);
+
+    uint64_t first, last;
+
+    if (!steps.clip(_clipLeft, _clipTop, _clipRight - 1, _clipBottom - 1, first, last)) {
+      return;
+    }
+
+    uint64_t remainder;
+    int64_t minor = (int64_t)steps.minorOffset(first, remainder);
+    int phase = _dash->advance(0, (int64_t)first);
+
+    // Pixels of one colour in a row are filled as one span.
+    int64_t runRow = 0, runFrom = 0, runTo = -1;
+    uint32_t runColour = _penColour;
+
+    for (uint64_t k = first; k <= last; ++k) {
+      int64_t x = steps.startX + steps.signX * (steps.steep ? minor : (int64_t)k);
+      int64_t y = steps.startY + steps.signY * (steps.steep ? (int64_t)k : minor);
+      uint32_t colour = strokeColour(phase);
+
+      if (y != runRow || colour != runColour || runTo < runFrom) {
+        span(runRow, runFrom, runTo, runColour);
+        runRow = y;
+        runFrom = x;
+        runTo = x;
+        runColour = colour;
+      }
+
+      else {
+        runFrom = min(runFrom, x);
+        runTo = max(runTo, x);
+      }
+
+      phase = _dash->next(phase);
+      remainder += steps.minor;
+
+      if (remainder >= steps.major) {
+        remainder -= steps.major;
+        ++minor;
+      }
+    }
+
+    span(runRow, runFrom, runTo, runColour);
+  }
+
+  /// <summary>
+  /// Fill the inside, then draw the border with the pen
+  /// centred on the outermost pixels of the box.
+  /// </summary>
+  void rectangle(int x1, int y1, int x2, int y2) override {
+    int64_t left = x1, top = y1, right = x2, bottom = y2;
+    normalise(left, top, right, bottom);
+
+    // Without a pen, GDI fills one pixel less to the right and bottom.
+    if (_hasBrush && !_hasPen) {
+      block(left, top, right - 1, bottom - 1, _brushColour);
+    }
+
+    if (!_hasPen || left > right || top > bottom) {
+      return;
+    }
+
+    if (_hasBrush) {
+      block(left + 1, top + 1, right - 1, bottom - 1, _brushColour);
+    }
+
+    // Dashed one pixel pen: clockwise from the top left corner.
+    if (!_dash->isSolid()) {
+      int phase = strokeRun(left, top, 1, 0, right - left + 1, 0);
+
+      if (bottom > top) {
+        phase = strokeRun(right, top + 1, 0, 1, bottom - top, phase);
+
+        if (right > left) {
+          phase = strokeRun(right - 1, bottom, -1, 0, right - left, phase);
+          strokeRun(left, bottom - 1, 0, -1, bottom - top - 1, phase);
+        }
+      }
+
+      return;
+    }
+
+    int64_t outside = (_penWidth - 1) / 2;
+    int64_t inside = _penWidth / 2;
+
+    // Top and bottom bands, then what is left of both sides.
+    block(left - outside, top - outside, right + outside, top + inside, _penColour);
+    block(left - outside, bottom - inside, right + outside, bottom + outside, _penColour);
+
+    top += inside + 1;
+    bottom -= inside + 1;
+
+    block(left - outside, top, left + inside, bottom, _penColour);
+    block(right - inside, top, right + outside, bottom, _penColour);
+  }
+
+  /// <summary>
+  /// Fill the inside, then draw the border as the rows of the
+  /// outer ellipse not covered by the inner one.
+  /// </summary>
+  void ellipse(int x1, int y1, int x2, int y2) override {
+    int64_t left = x1, top = y1, right = x2, bottom = y2;
+    normalise(left, top, right, bottom);
+
+    if (left > right || top > bottom) {
+      return;
+    }
+
+    if (_antialiasing && _dash->isSolid() &&
+      max(right - left, bottom - top) / 2 + _penWidth < MAX_ANTIALIAS_RADIUS) {
+      antialiasedEllipse(left, top, right + 1, bottom + 1);
+      return;
+    }
+
+    double cx = (left + right) / 2.0;
+    double cy = (top + bottom) / 2.0;
+
+    // Pixels are unit squares: the ellipse touches the outer
+    // edges of the box, its radii reach half a pixel further.
+    double rx = (right - left + 1) / 2.0;
+    double ry = (bottom - top + 1) / 2.0;
+
+    if (_hasPen && !_dash->isSolid() &&
+      max(right - left, bottom - top) / 2 < MAX_DASHED_RADIUS) {
+      dashedEllipse(cx, cy, rx, ry);
+      return;
+    }
+
+    if (max(right - left, bottom - top) / 2 + _penWidth < MAX_MIDPOINT_RADIUS) {
+      midpointEllipse(left, top, right, bottom);
+      return;
+    }
+
+    double outside = _hasPen ? (_penWidth - 1) / 2 : 0;
+    double inside = _hasPen ? _penWidth / 2 + 1 : 0;
+
+    int64_t first = max((int64_t)std::floor(cy - ry - outside), (int64_t)_clipTop);
+    int64_t last = min((int64_t)std::ceil(cy + ry + outside), (int64_t)_clipBottom - 1);
+
+    for (int64_t y = first; y <= last; ++y) {
+      int64_t innerLeft = 0, innerRight = 0;
+      bool hasInner = ellipseSpan(cx, cy, rx - inside, ry - inside, y,
+        innerLeft, innerRight);
+
+      if (hasInner && _hasBrush) {
+        span(y, innerLeft, innerRight, _brushColour);
+      }
+
+      int64_t outerLeft = 0, outerRight = 0;
+
+      if (!_hasPen ||
+        !ellipseSpan(cx, cy, rx + outside, ry + outside, y, outerLeft, outerRight)) {
+        continue;
+      }
+
+      if (hasInner) {
+        span(y, outerLeft, innerLeft - 1, _penColour);
+        span(y, innerRight + 1, outerRight, _penColour);
+      }
+
+      else {
+        span(y, outerLeft, outerRight, _penColour);
+      }
+    }
+  }
+
+  void dot(int x, int y) override {
+    if (_hasPen) {
+      span(y, x, x, _penColour);
+    }
+
+    else if (_hasBrush) {
+      span(y, x, x, _brushColour);
+    }
+  }
+};
@@ -0,0 +1,660 @@
+#pragma once
+
+/// <summary>
+/// Kernels filling (or blending a colour over) a run of 32-bit pixels,
+/// the colour covering every pixel alike or each by its own share.
+///
+/// Every kernel comes as scalar code and, on x86, as SSE2 and AVX2
+/// code; the fastest one the CPU supports is picked at run time.
+/// All versions give exactly the same pixels.
+/// </summary>
+namespace SpanKernels {
+  typedef void (*SpanFunction)(uint32_t* pixels, size_t count, uint32_t colour);
+  typedef void (*MaskFunction)(uint32_t* pixels, const uint8_t* coverage,
+    size_t count, uint32_t colour);
+  typedef void (*MirrorFunction)(uint32_t* top, uint32_t* bottom, size_t span,
+    const uint8_t* coverage, size_t count, uint32_t colour);
+  typedef void (*ScatterFunction)(uint32_t* pixels, const size_t* offsets,
+    const uint8_t* coverage, size_t count, uint32_t colour);
+
+  /// <summary>
+  /// One set of kernels.
+  /// </summary>
+  struct Kernels {
+    const char* name;
+
+    // Set every pixel to colour.
+    SpanFunction fill;
+
+    // Blend colour (its alpha being the opacity) over every pixel.
+    SpanFunction blend;
+
+    // Blend opaque colour over pixel i with opacity coverage[i].
+    MaskFunction blendMask;
+
+    // Blend opaque colour over pixels i and span - i of rows top and
+    // bottom (which may be the same) with opacity coverage[i].
+    MirrorFunction blendMirrored;
+
+    // Blend opaque colour over pixel offsets[i] with opacity
+    // coverage[i]; no pixel comes twice.
+    ScatterFunction blendScattered;
+  };
+
+  /// <summary>
+  /// Divide a sum of 8-bit products (at most 255 * 255) by 255,
+  /// rounded, without a division.
+  /// </summary>
+  /// <param name="t"></param>
+  /// <returns></returns>
+  inline uint32_t divide255(uint32_t t) {
+    t += 128;
+    return (t + (t >> 8)) >> 8;
+  }
+
+  //
+  // Scalar.
+  //
+
+  void fillScalar(uint32_t* pixels, size_t count, uint32_t colour) {
+    for (size_t i = 0; i < count; ++i) {
+      pixels[i] = colour;
+    }
+  }
+
+  void blendScalar(uint32_t* pixels, size_t count, uint32_t colour) {
+    uint32_t alpha = colour >> 24;
+    uint32_t inverse = 255 - alpha;
+
+    // The result is as opaque as source-over makes it.
+    uint32_t source = colour | 0xFF000000;
+
+    for (size_t i = 0; i < count; ++i) {
+      uint32_t pixel = pixels[i];
+      uint32_t result = 0;
+
+      for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t s = (source >> shift) & 0xFF;
+        uint32_t d = (pixel >> shift) & 0xFF;
+
+        result |= divide255(s * alpha + d * inverse) << shift;
+      }
+
+      pixels[i] = result;
+    }
+  }
+
+  /// <summary>
+  /// Blend an opaque colour over one pixel with an opacity (0 to 255),
+  /// two channels per multiply: red and blue, then alpha and green,
+  /// each in 16 bits, which hold s * alpha + d * inverse + 128.
+  /// Same result as blendScalar.
+  /// </summary>
+  /// <param name="pixel"></param>
+  /// <param name="colour"></param>
+  /// <param name="alpha"></param>
+  /// <returns></returns>
+  inline uint32_t blendPixel(uint32_t pixel, uint32_t colour, uint32_t alpha) {
+    uint32_t source = colour | 0xFF000000;
+    uint32_t inverse = 255 - alpha;
+
+    uint32_t redBlue = (source & 0x00FF00FF) * alpha +
+      (pixel & 0x00FF00FF) * inverse + 0x00800080;
+    uint32_t alphaGreen = ((source >> 8) & 0x00FF00FF) * alpha +
+      ((pixel >> 8) & 0x00FF00FF) * inverse + 0x00800080;
+
+    // divide255 on both halves at once.
+    redBlue = ((redBlue + ((redBlue >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    alphaGreen = (alphaGreen + ((alphaGreen >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+
+    return redBlue | alphaGreen;
+  }
+
+  void blendMaskScalar(uint32_t* pixels, const uint8_t* coverage, size_t count,
+    uint32_t colour) {
+    for (size_t i = 0; i < count; ++i) {
+      pixels[i] = blendPixel(pixels[i], colour, coverage[i]);
+    }
+  }
+
+  void blendMirroredScalar(uint32_t* top, uint32_t* bottom, size_t span,
+    const uint8_t* coverage, size_t count, uint32_t colour) {
+    for (size_t i = 0; i < count; ++i) {
+      uint32_t alpha = coverage[i];
+
+      top[i] = blendPixel(top[i], colour, alpha);
+      top[span - i] = blendPixel(top[span - i], colour, alpha);
+
+      if (bottom != top) {
+        bottom[i] = blendPixel(bottom[i], colour, alpha);
+        bottom[span - i] = blendPixel(bottom[span - i], colour, alpha);
+      }
+    }
+  }
+
+  void blendScatteredScalar(uint32_t* pixels, const size_t* offsets,
+    const uint8_t* coverage, size_t count, uint32_t colour) {
+    for (size_t i = 0; i < count; ++i) {
+      uint32_t* pixel = pixels + offsets[i];
+      *pixel = blendPixel(*pixel, colour, coverage[i]);
+    }
+  }
+
+  const Kernels SCALAR = { "scalar", fillScalar, blendScalar, blendMaskScalar,
+    blendMirroredScalar, blendScatteredScalar };
+
+#ifdef PAINT_X86
+#ifdef _MSC_VER
+#define PAINT_TARGET_AVX2
+#else
+#define PAINT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+  //
+  // SSE2, 4 pixels per step.
+  //
+
+  void fillSse2(uint32_t* pixels, size_t count, uint32_t colour) {
+    if (count < 4) {
+      fillScalar(pixels, count, colour);
+      return;
+    }
+
+    __m128i value = _mm_set1_epi32((int)colour);
+
+    // Unaligned stores over the head and the tail, which may overlap
+    // the aligned ones: filling a pixel twice does no harm.
+    _mm_storeu_si128((__m128i*)pixels, value);
+    _mm_storeu_si128((__m128i*)(pixels + count - 4), value);
+
+    size_t i = ((16 - ((uintptr_t)pixels & 15)) & 15) / 4;
+
+    for (; i + 16 <= count; i += 16) {
+      _mm_store_si128((__m128i*)(pixels + i), value);
+      _mm_store_si128((__m128i*)(pixels + i + 4), value);
+      _mm_store_si128((__m128i*)(pixels + i + 8), value);
+      _mm_store_si128((__m128i*)(pixels + i + 12), value);
+    }
+
+    for (; i + 4 <= count; i += 4) {
+      _mm_store_si128((__m128i*)(pixels + i), value);
+    }
+  }
+
+  void blendSse2(uint32_t* pixels, size_t count, uint32_t colour) {
+    uint32_t alpha = colour >> 24;
+    __m128i zero = _mm_setzero_si128();
+
+    // Source term (s * alpha + 128) and weight of the destination,
+    // per 16-bit channel.
+    __m128i source = _mm_unpacklo_epi8(_mm_set1_epi32((int)(colour | 0xFF000000)), zero);
+    __m128i sourceTerm = _mm_add_epi16(
+      _mm_mullo_epi16(source, _mm_set1_epi16((short)alpha)),
+      _mm_set1_epi16(128)
+    );
+    __m128i inverse = _mm_set1_epi16((short)(255 - alpha));
+
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+      __m128i pixel = _mm_loadu_si128((const __m128i*)(pixels + i));
+
+      __m128i low = _mm_add_epi16(
+        _mm_mullo_epi16(_mm_unpacklo_epi8(pixel, zero), inverse),
+        sourceTerm
+      );
+      __m128i high = _mm_add_epi16(
+        _mm_mullo_epi16(_mm_unpackhi_epi8(pixel, zero), inverse),
+        sourceTerm
+      );
+
+      low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+      high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+      _mm_storeu_si128((__m128i*)(pixels + i), _mm_packus_epi16(low, high));
+    }
+
+    blendScalar(pixels + i, count - i, colour);
+  }
+
+  void blendMaskSse2(uint32_t* pixels, const uint8_t* coverage, size_t count,
+    uint32_t colour) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i source = _mm_unpacklo_epi8(_mm_set1_epi32((int)(colour | 0xFF000000)), zero);
+    __m128i full = _mm_set1_epi16(255);
+    __m128i half = _mm_set1_epi16(128);
+
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+      int shares;
+      memcpy(&shares, coverage + i, sizeof(shares));
+
+      // Every coverage byte spread over the four channels of its pixel.
+      __m128i alpha = _mm_unpacklo_epi8(_mm_cvtsi32_si128(shares), zero);
+      alpha = _mm_unpacklo_epi16(alpha, alpha);
+      __m128i lowAlpha = _mm_unpacklo_epi32(alpha, alpha);
+      __m128i highAlpha = _mm_unpackhi_epi32(alpha, alpha);
+
+      __m128i pixel = _mm_loadu_si128((const __m128i*)(pixels + i));
+
+      __m128i low = _mm_add_epi16(
+        _mm_add_epi16(
+          _mm_mullo_epi16(source, lowAlpha),
+          _mm_mullo_epi16(_mm_unpacklo_epi8(pixel, zero), _mm_sub_epi16(full, lowAlpha))
+        ),
+        half
+      );
+      __m128i high = _mm_add_epi16(
+        _mm_add_epi16(
+          _mm_mullo_epi16(source, highAlpha),
+          _mm_mullo_epi16(_mm_unpackhi_epi8(pixel, zero), _mm_sub_epi16(full, highAlpha))
+        ),
+        half
+      );
+
+      low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+      high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+      _mm_storeu_si128((__m128i*)(pixels + i), _mm_packus_epi16(low, high));
+    }
+
+    blendMaskScalar(pixels + i, coverage + i, count - i, colour);
+  }
+
+  // The four pixels of one coverage (an ellipse edge pixel on both
+  // rows, and their mirrors) gathered into one register: a row and
+  // itself come out the same, so the same row twice is blended once.
+  // Fully covered pixels only take stores, uncovered ones nothing.
+  void blendMirroredSse2(uint32_t* top, uint32_t* bottom, size_t span,
+    const uint8_t* coverage, size_t count, uint32_t colour) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i source = _mm_unpacklo_epi8(_mm_set1_epi32((int)(colour | 0xFF000000)), zero);
+    __m128i full = _mm_set1_epi16(255);
+    __m128i half = _mm_set1_epi16(128);
+    uint32_t opaque = colour | 0xFF000000;
+
+    for (size_t i = 0; i < count; ++i) {
+      uint32_t share = coverage[i];
+
+      if (0 == share) {
+        continue;
+      }
+
+      if (255 == share) {
+        top[i] = top[span - i] = bottom[i] = bottom[span - i] = opaque;
+        continue;
+      }
+
+      __m128i alpha = _mm_set1_epi16((short)share);
+      __m128i sourceTerm = _mm_add_epi16(_mm_mullo_epi16(source, alpha), half);
+      __m128i inverse = _mm_sub_epi16(full, alpha);
+
+      __m128i pixel = _mm_unpacklo_epi64(
+        _mm_unpacklo_epi32(_mm_cvtsi32_si128((int)top[i]), _mm_cvtsi32_si128((int)top[span - i])),
+        _mm_unpacklo_epi32(_mm_cvtsi32_si128((int)bottom[i]), _mm_cvtsi32_si128((int)bottom[span - i]))
+      );
+
+      __m128i low = _mm_add_epi16(
+        _mm_mullo_epi16(_mm_unpacklo_epi8(pixel, zero), inverse),
+        sourceTerm
+      );
+      __m128i high = _mm_add_epi16(
+        _mm_mullo_epi16(_mm_unpackhi_epi8(pixel, zero), inverse),
+        sourceTerm
+      );
+
+      low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+      high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+      __m128i result = _mm_packus_epi16(low, high);
+      top[i] = (uint32_t)_mm_cvtsi128_si32(result);
+      top[span - i] = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(result, 4));
+      bottom[i] = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(result, 8));
+      bottom[span - i] = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(result, 12));
+    }
+  }
+
+  // Pixels apart, as edges leave them: gathered four at a time into
+  // one register, blended as blendMaskSse2 does, and put back.
+  void blendScatteredSse2(uint32_t* pixels, const size_t* offsets,
+    const uint8_t* coverage, size_t count, uint32_t colour) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i source = _mm_unpacklo_epi8(_mm_set1_epi32((int)(colour | 0xFF000000)), zero);
+    __m128i full = _mm_set1_epi16(255);
+    __m128i half = _mm_set1_epi16(128);
+
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+      uint32_t* at[4] = {
+        pixels + offsets[i], pixels + offsets[i + 1],
+        pixels + offsets[i + 2], pixels + offsets[i + 3]
+      };
+
+      int shares;
+      memcpy(&shares, coverage + i, sizeof(shares));
+
+      __m128i alpha = _mm_unpacklo_epi8(_mm_cvtsi32_si128(shares), zero);
+      alpha = _mm_unpacklo_epi16(alpha, alpha);
+      __m128i lowAlpha = _mm_unpacklo_epi32(alpha, alpha);
+      __m128i highAlpha = _mm_unpackhi_epi32(alpha, alpha);
+
+      __m128i pixel = _mm_unpacklo_epi64(
+        _mm_unpacklo_epi32(_mm_cvtsi32_si128((int)*at[0]), _mm_cvtsi32_si128((int)*at[1])),
+        _mm_unpacklo_epi32(_mm_cvtsi32_si128((int)*at[2]), _mm_cvtsi32_si128((int)*at[3]))
+      );
+
+      __m128i low = _mm_add_epi16(
+        _mm_add_epi16(
+          _mm_mullo_epi16(source, lowAlpha),
+          _mm_mullo_epi16(_mm_unpacklo_epi8(pixel, zero), _mm_sub_epi16(full, lowAlpha))
+        ),
+        half
+      );
+      __m128i high = _mm_add_epi16(
+        _mm_add_epi16(
+          _mm_mullo_epi16(source, highAlpha),
+          _mm_mullo_epi16(_mm_unpackhi_epi8(pixel, zero), _mm_sub_epi16(full, highAlpha))
+        ),
+        half
+      );
+
+      low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+      high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+      __m128i result = _mm_packus_epi16(low, high);
+      *at[0] = (uint32_t)_mm_cvtsi128_si32(result);
+      *at[1] = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(result, 4));
+      *at[2] = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(result, 8));
+      *at[3] = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(result, 12));
+    }
+
+    blendScatteredScalar(pixels, offsets + i, coverage + i, count - i, colour);
+  }
+
+  const Kernels SSE2 = { "sse2", fillSse2, blendSse2, blendMaskSse2,
+    blendMirroredSse2, blendScatteredSse2 };
+
+  //
+  // AVX2, 8 pixels per step.
+  //
+
+  PAINT_TARGET_AVX2
+  void fillAvx2(uint32_t* pixels, size_t count, uint32_t colour) {
+    if (count < 8) {
+      fillSse2(pixels, count, colour);
+      return;
+    }
+
+    __m256i value = _mm256_set1_epi32((int)colour);
+
+    // Head and tail as in fillSse2.
+    _mm256_storeu_si256((__m256i*)pixels, value);
+    _mm256_storeu_si256((__m256i*)(pixels + count - 8), value);
+
+    size_t i = ((32 - ((uintptr_t)pixels & 31)) & 31) / 4;
+
+    for (; i + 32 <= count; i += 32) {
+      _mm256_store_si256((__m256i*)(pixels + i), value);
+      _mm256_store_si256((__m256i*)(pixels + i + 8), value);
+      _mm256_store_si256((__m256i*)(pixels + i + 16), value);
+      _mm256_store_si256((__m256i*)(pixels + i + 24), value);
+    }
+
+    for (; i + 8 <= count; i += 8) {
+      _mm256_store_si256((__m256i*)(pixels + i), value);
+    }
+  }
+
+  PAINT_TARGET_AVX2
+  void blendAvx2(uint32_t* pixels, size_t count, uint32_t colour) {
+    uint32_t alpha = colour >> 24;
+    __m256i zero = _mm256_setzero_si256();
+
+    __m256i source = _mm256_unpacklo_epi8(
+      _mm256_set1_epi32((int)(colour | 0xFF000000)),
+      zero
+    );
+    __m256i sourceTerm = _mm256_add_epi16(
+      _mm256_mullo_epi16(source, _mm256_set1_epi16((short)alpha)),
+      _mm256_set1_epi16(128)
+    );
+    __m256i inverse = _mm256_set1_epi16((short)(255 - alpha));
+
+    size_t i = 0;
+
+    // Unpack and pack both work within 128-bit lanes,
+    // so the pixels come back in order.
+    for (; i + 8 <= count; i += 8) {
+      __m256i pixel = _mm256_loadu_si256((const __m256i*)(pixels + i));
+
+      __m256i low = _mm256_add_epi16(
+        _mm256_mullo_epi16(_mm256_unpacklo_epi8(pixel, zero), inverse),
+        sourceTerm
+      );
+      __m256i high = _mm256_add_epi16(
+        _mm256_mullo_epi16(_mm256_unpackhi_epi8(pixel, zero), inverse),
+        sourceTerm
+      );
+
+      low = _mm256_srli_epi16(_mm256_add_epi16(low, _mm256_srli_epi16(low, 8)), 8);
+      high = _mm256_srli_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+
+      _mm256_storeu_si256((__m256i*)(pixels + i), _mm256_packus_epi16(low, high));
+    }
+
+    // The tail runs SSE2 code: leave the upper halves of the registers
+    // clear, or every SSE instruction after this waits on them.
+    _mm256_zeroupper();
+    blendSse2(pixels + i, count - i, colour);
+  }
+
+  PAINT_TARGET_AVX2
+  void blendMaskAvx2(uint32_t* pixels, const uint8_t* coverage, size_t count,
+    uint32_t colour) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i source = _mm256_unpacklo_epi8(
+      _mm256_set1_epi32((int)(colour | 0xFF000000)),
+      zero
+    );
+    __m256i full = _mm256_set1_epi16(255);
+    __m256i half = _mm256_set1_epi16(128);
+
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+      // Coverage of pixels 0-3 in the low lane, 4-7 in the high one,
+      // as the pixels unpack; then spread over the four channels.
+      __m256i alpha = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(coverage + i)));
+      alpha = _mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 16));
+      __m256i lowAlpha = _mm256_unpacklo_epi32(alpha, alpha);
+      __m256i highAlpha = _mm256_unpackhi_epi32(alpha, alpha);
+
+      __m256i pixel = _mm256_loadu_si256((const __m256i*)(pixels + i));
+
+      __m256i low = _mm256_add_epi16(
+        _mm256_add_epi16(
+          _mm256_mullo_epi16(source, lowAlpha),
+          _mm256_mullo_epi16(
+            _mm256_unpacklo_epi8(pixel, zero),
+            _mm256_sub_epi16(full, lowAlpha)
+          )
+        ),
+        half
+      );
+      __m256i high = _mm256_add_epi16(
+        _mm256_add_epi16(
+          _mm256_mullo_epi16(source, highAlpha),
+          _mm256_mullo_epi16(
+            _mm256_unpackhi_epi8(pixel, zero),
+            _mm256_sub_epi16(full, highAlpha)
+          )
+        ),
+        half
+      );
+
+      low = _mm256_srli_epi16(_mm256_add_epi16(low, _mm256_srli_epi16(low, 8)), 8);
+      high = _mm256_srli_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+
+      _mm256_storeu_si256((__m256i*)(pixels + i), _mm256_packus_epi16(low, high));
+    }
+
+    // Upper halves cleared before the SSE2 tail, as in blendAvx2.
+    _mm256_zeroupper();
+    blendMaskSse2(pixels + i, coverage + i, count - i, colour);
+  }
+
+  // Pixels apart fill one SSE2 register at a time, and AVX2 has no
+  // scatter: mirrored and scattered pixels keep to SSE2.
+  const Kernels AVX2 = { "avx2", fillAvx2, blendAvx2, blendMaskAvx2,
+    blendMirroredSse2, blendScatteredSse2 };
+
+  /// <summary>
+  /// CPUID registers of a leaf.
+  /// </summary>
+  /// <param name="leaf"></param>
+  /// <param name="registers">eax, ebx, ecx, edx</param>
+  inline void cpuid(int leaf, int registers[4]) {
+#ifdef _MSC_VER
+    __cpuidex(registers, leaf, 0);
+#else
+    __asm__ __volatile__("cpuid"
+      : "=a"(registers[0]), "=b"(registers[1]), "=c"(registers[2]), "=d"(registers[3])
+      : "a"(leaf), "c"(0));
+#endif
+  }
+
+  /// <summary>
+  /// Can this CPU (and OS) run the SSE2 kernels?
+  /// </summary>
+  /// <returns></returns>
+  bool hasSse2() {
+    int registers[4];
+    cpuid(1, registers);
+
+    return 0 != (registers[3] & (1 << 26));
+  }
+
+  /// <summary>
+  /// Can this CPU (and OS) run the AVX2 kernels?
+  /// The OS has to save the YMM registers too.
+  /// </summary>
+  /// <returns></returns>
+  bool hasAvx2() {
+    int registers[4];
+    cpuid(0, registers);
+
+    if (registers[0] < 7) {
+      return false;
+    }
+
+    cpuid(1, registers);
+
+    bool hasOsxsave = 0 != (registers[2] & (1 << 27));
+    bool hasAvx = 0 != (registers[2] & (1 << 28));
+
+    if (!hasOsxsave || !hasAvx) {
+      return false;
+    }
+
+#ifdef _MSC_VER
+    unsigned long long enabled = _xgetbv(0);
+#else
+    unsigned int low, high;
+    __asm__ __volatile__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+    unsigned long long enabled = ((unsigned long long)high << 32) | low;
+#endif
+
+    if ((enabled & 6) != 6) {
+      return false;
+    }
+
+    cpuid(7, registers);
+
+    return 0 != (registers[1] & (1 << 5));
+  }
+#endif
+
+  /// <summary>
+  /// Every kernel set this CPU can run, slowest first.
+  /// </summary>
+  /// <returns></returns>
+  std::vector<const Kernels*> available() {
+    std::vector<const Kernels*> result = { &SCALAR };
+
+#ifdef PAINT_X86
+    if (hasSse2()) {
+      result.push_back(&SSE2);
+
+      if (hasAvx2()) {
+        result.push_back(&AVX2);
+      }
+    }
+#endif
+
+    return result;
+  }
+
+  /// <summary>
+  /// The fastest kernel set this CPU can run, picked once.
+  /// </summary>
+  /// <returns></returns>
+  const Kernels& selected() {
+    static const Kernels* best = available().back();
+
+    return *best;
+  }
+
+  /// <summary>
+  /// Fill a run of pixels with the selected kernel.
+  /// </summary>
+  inline void fill(uint32_t* pixels, size_t count, uint32_t colour) {
+    selected().fill(pixels, count, colour);
+  }
+
+  /// <summary>
+  /// Blend a colour over a run of pixels with the selected kernel.
+  /// Fully opaque and fully transparent colours take shortcuts.
+  /// </summary>
+  inline void blend(uint32_t* pixels, size_t count, uint32_t colour) {
+    uint32_t alpha = colour >> 24;
+
+    if (255 == alpha) {
+      selected().fill(pixels, count, colour);
+    }
+
+    else if (alpha > 0) {
+      selected().blend(pixels, count, colour);
+    }
+  }
+
+  /// <summary>
+  /// Blend an opaque colour over a run of pixels, each by its own
+  /// coverage (0 to 255), with the selected kernel.
+  /// </summary>
+  inline void blendMask(uint32_t* pixels, const uint8_t* coverage, size_t count,
+    uint32_t colour) {
+    selected().blendMask(pixels, coverage, count, colour);
+  }
+
+  /// <summary>
+  /// Blend an opaque colour over pixels i and span - i of two rows (or
+  /// of one, given twice), each by coverage[i], with the selected
+  /// kernel.
+  /// </summary>
+  inline void blendMirrored(uint32_t* top, uint32_t* bottom, size_t span,
+    const uint8_t* coverage, size_t count, uint32_t colour) {
+    selected().blendMirrored(top, bottom, span, coverage, count, colour);
+  }
+
+  /// <summary>
+  /// Blend an opaque colour over pixels apart, pixel offsets[i] with
+  /// opacity coverage[i], with the selected kernel. No pixel may come
+  /// twice.
+  /// </summary>
+  inline void blendScattered(uint32_t* pixels, const size_t* offsets,
+    const uint8_t* coverage, size_t count, uint32_t colour) {
+    selected().blendScattered(pixels, offsets, coverage, count, colour);
+  }
+}
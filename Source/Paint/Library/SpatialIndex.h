@@ -0,0 +1,665 @@
+#pragma once
+
+/// <summary>
+/// Uniform grid over the bounds of the shapes of shapesVector, to find
+/// the topmost shape inside a selection without testing every shape.
+///
+/// Every shape gets a stacking order, growing as shapes are added or
+/// raised, so shapesVector is always sorted by it: the topmost shape
+/// found is located in the vector by bisection.
+///
+/// The cells built with the index are packed in arrays sorted by cell,
+/// so a column of cells is found by bisection. Shapes added or moved
+/// later go to cells of their own, kept exact; the packed cells may
+/// still list where moved or removed shapes were, which queries skip.
+/// Once those shapes are too many, everything is packed again, with a
+/// cell size chosen from the typical shape size.
+///
+/// Bigger shapes go to coarser grids, each with cells eight times as
+/// wide as the one below, so no shape spans more than a few cells.
+///
+/// The index only holds raw pointers: it must be told of every shape
+/// added, moved, raised or removed.
+/// </summary>
+class SpatialIndex {
+public:
+  /// <summary>
+  /// Cells are from 16 to 65536 pixels wide.
+  /// </summary>
+  static constexpr int MIN_CELL_SHIFT = 4;
+  static constexpr int MAX_CELL_SHIFT = 16;
+
+  /// <summary>
+  /// Shapes spanning more cells than this go to a coarser grid.
+  /// </summary>
+  static constexpr int64_t MAX_CELLS_PER_SHAPE = 16;
+
+  /// <summary>
+  /// Each grid has cells 2^LEVEL_SHIFT times as wide as the one below;
+  /// the coarsest one spans the whole int range in a few cells.
+  /// </summary>
+  static constexpr int LEVEL_SHIFT = 3;
+  static constexpr int LEVELS = (32 - MIN_CELL_SHIFT) / LEVEL_SHIFT + 1;
+
+  /// <summary>
+  /// Shapes sampled to choose the cell size, and shapes always allowed
+  /// out of the packed cells.
+  /// </summary>
+  static constexpr size_t SIZE_SAMPLES = 1024;
+
+private:
+  /// <summary>
+  /// An indexed shape, in a slot reused once the shape is removed.
+  /// </summary>
+  struct Entry {
+    IShape* shape;
+    RECT bounds;
+    uint64_t order;
+    uint8_t level;
+
+    // In the cells of the shapes added or moved since packing.
+    bool isPending;
+  };
+
+  /// <summary>
+  /// Inclusive range of cells of a grid.
+  /// </summary>
+  struct CellRange {
+    int level;
+    int64_t firstColumn;
+    int64_t firstRow;
+    int64_t lastColumn;
+    int64_t lastRow;
+
+    int64_t count() const {
+      return (lastColumn - firstColumn + 1) * (lastRow - firstRow + 1);
+    }
+  };
+
+  int _cellShift;
+  uint64_t _nextOrder;
+
+  std::vector<Entry> _entries;
+  std::vector<uint32_t> _freeSlots;
+  std::unordered_map<const IShape*, uint32_t> _slots;
+
+  // Packed cells: sorted keys, where the slots of each one start
+  // (one more at the end), and the slots.
+  std::vector<uint64_t> _keys;
+  std::vector<uint32_t> _starts;
+  std::vector<uint32_t> _packed;
+
+  // Shapes packed last time, and shapes added or moved since.
+  size_t _packedCount;
+  size_t _pendingCount;
+
+  // Cell key -> slots of the shapes added or moved since packing.
+  std::unordered_map<uint64_t, std::vector<uint32_t>> _pending;
+
+  // Shapes in each grid.
+  size_t _levelCounts[LEVELS];
+
+  // Slots gathered by a query.
+  std::vector<uint32_t> _candidates;
+
+public:
+  SpatialIndex() {
+    _cellShift = MIN_CELL_SHIFT;
+    _nextOrder = 0;
+    _packedCount = 0;
+    _pendingCount = 0;
+    std::fill(_levelCounts, _levelCounts + LEVELS, (size_t)0);
+  }
+
+public:
+  size_t size() const { return _slots.size(); }
+  int cellSize() const { return 1 << _cellShift; }
+
+  void clear() {
+    _entries.clear();
+    _freeSlots.clear();
+    _slots.clear();
+    _keys.clear();
+    _starts.clear();
+    _packed.clear();
+    _pending.clear();
+    _nextOrder = 0;
+    _packedCount = 0;
+    _pendingCount = 0;
+    std::fill(_levelCounts, _levelCounts + LEVELS, (size_t)0);
+  }
+
+  /// <summary>
+  /// Index a whole scene, bottom to top.
+  /// </summary>
+  /// <param name="shapes"></param>
+  void rebuild(const std::vector<std::shared_ptr<IShape>>& shapes) {
+    clear();
+
+    _entries.reserve(shapes.size());
+    _slots.reserve(shapes.size());
+
+    for (const std::shared_ptr<IShape>& shape : shapes) {
+      Entry entry;
+      entry.shape = shape.get();
+      entry.bounds = shape->bounds();
+      entry.order = _nextOrder++;
+      entry.level = 0;
+      entry.isPending = false;
+
+      _slots[entry.shape] = (uint32_t)_entries.size();
+      _entries.push_back(entry);
+    }
+
+    pack();
+  }
+
+  /// <summary>
+  /// Index a shape added on top of the others.
+  /// </summary>
+  /// <param name="shape"></param>
+  void insert(IShape* shape) {
+    Entry entry;
+    entry.shape = shape;
+    entry.bounds = shape->bounds();
+    entry.order = _nextOrder++;
+    entry.level = 0;
+    entry.isPending = false;
+
+    uint32_t slot;
+
+    if (_freeSlots.empty()) {
+      slot = (uint32_t)_entries.size();
+      _entries.push_back(entry);
+    }
+
+    else {
+      slot = _freeSlots.back();
+      _freeSlots.pop_back();
+      _entries[slot] = entry;
+    }
+
+    _slots[shape] = slot;
+    binPending(slot);
+  }
+
+  /// <summary>
+  /// Forget a shape.
+  /// </summary>
+  /// <param name="shape"></param>
+  void remove(const IShape* shape) {
+    auto found = _slots.find(shape);
+
+    if (found == _slots.end()) {
+      return;
+    }
+
+    uint32_t slot = found->second;
+    unbin(slot);
+
+    // Packed cells listing the slot skip it from now on.
+    _entries[slot].shape = NULL;
+    _freeSlots.push_back(slot);
+    _slots.erase(found);
+  }
+
+  /// <summary>
+  /// Take the new bounds of a shape that moved.
+  /// </summary>
+  /// <param name="shape"></param>
+  void update(IShape* shape) {
+    auto found = _slots.find(shape);
+
+    if (found == _slots.end()) {
+      return;
+    }
+
+    unbin(found->second);
+    _entries[found->second].bounds = shape->bounds();
+    binPending(found->second);
+  }
+
+  /// <summary>
+  /// Put a shape on top of the others.
+  /// </summary>
+  /// <param name="shape"></param>
+  void raise(const IShape* shape) {
+    auto found = _slots.find(shape);
+
+    if (found != _slots.end()) {
+      _entries[found->second].order = _nextOrder++;
+    }
+  }
+
+  /// <summary>
+  /// Topmost shape lying inside a selection, as IShape::in tells.
+  /// </summary>
+  /// <param name="shapes">The indexed scene, bottom to top.</param>
+  /// <param name="topLeft"></param>
+  /// <param name="rightBottom"></param>
+  /// <returns>Its index in shapes, -1 if none.</returns>
+  int topmost(const std::vector<std::shared_ptr<IShape>>& shapes,
+    const Point& topLeft, const Point& rightBottom) {
+    // Shapes inside have both points in the selection, so they
+    // overlap it.
+    if (topLeft.x() > rightBottom.x() || topLeft.y() > rightBottom.y()) {
+      return -1;
+    }
+
+    CellRange range = cellsOf(0, topLeft.x(), topLeft.y(), rightBottom.x(), rightBottom.y());
+
+    // Selections over more cells than there are shapes: the topmost
+    // shapes are tested first, as they are most likely inside.
+    if (range.count() > (int64_t)shapes.size()) {
+      for (int i = (int)shapes.size() - 1; i >= 0; --i) {
+        if (shapes[i]->in(topLeft, rightBottom)) {
+          return i;
+        }
+      }
+
+      return -1;
+    }
+
+    RECT area;
+    area.left = topLeft.x();
+    area.top = topLeft.y();
+    area.right = rightBottom.x();
+    area.bottom = rightBottom.y();
+
+    gather(area);
+
+    // Highest order first; a shape seen in several cells counts once.
+    std::sort(_candidates.begin(), _candidates.end(), [&](uint32_t a, uint32_t b) {
+      return _entries[a].order > _entries[b].order;
+    });
+    _candidates.erase(
+      std::unique(_candidates.begin(), _candidates.end()),
+      _candidates.end()
+    );
+
+    for (uint32_t slot : _candidates) {
+      if (_entries[slot].shape->in(topLeft, rightBottom)) {
+        return position(shapes, _entries[slot].order);
+      }
+    }
+
+    return -1;
+  }
+
+private:
+  int shiftOf(int level) const {
+    return _cellShift + level * LEVEL_SHIFT;
+  }
+
+  /// <summary>
+  /// Cells of a grid an area (inclusive) overlaps.
+  /// </summary>
+  CellRange cellsOf(int level, int64_t left, int64_t top, int64_t right, int64_t bottom) const {
+    int shift = shiftOf(level);
+
+    CellRange range;
+    range.level = level;
+    range.firstColumn = left >> shift;
+    range.firstRow = top >> shift;
+    range.lastColumn = max(right, left) >> shift;
+    range.lastRow = max(bottom, top) >> shift;
+
+    return range;
+  }
+
+  /// <summary>
+  /// Cells of a grid a box (right and bottom excluded) overlaps.
+  /// </summary>
+  CellRange cellsOf(int level, const RECT& bounds) const {
+    return cellsOf(level, bounds.left, bounds.top,
+      (int64_t)bounds.right - 1, (int64_t)bounds.bottom - 1);
+  }
+
+  /// <summary>
+  /// Finest grid where a box spans few enough cells.
+  /// </summary>
+  int levelOf(const RECT& bounds) const {
+    int level = 0;
+
+    while (level < LEVELS - 1 && cellsOf(level, bounds).count() > MAX_CELLS_PER_SHAPE) {
+      ++level;
+    }
+
+    return level;
+  }
+
+  /// <summary>
+  /// Key of a cell; keys sort by grid, column, then row.
+  /// </summary>
+  static uint64_t keyOf(int level, int64_t column, int64_t row) {
+    // Cells are at least 2^MIN_CELL_SHIFT wide, so both fit in 28 bits.
+    constexpr int64_t BIAS = (int64_t)1 << (31 - MIN_CELL_SHIFT);
+
+    return ((uint64_t)level << 56) |
+      ((uint64_t)(column + BIAS) << 28) |
+      (uint64_t)(row + BIAS);
+  }
+
+  static void drop(std::vector<uint32_t>& slots, uint32_t slot) {
+    auto found = std::find(slots.begin(), slots.end(), slot);
+
+    if (found != slots.end()) {
+      *found = slots.back();
+      slots.pop_back();
+    }
+  }
+
+  /// <summary>
+  /// Add a slot to the cells of the shapes added or moved since
+  /// packing, and pack again once they are too many.
+  /// </summary>
+  void binPending(uint32_t slot) {
+    Entry& entry = _entries[slot];
+
+    entry.level = (uint8_t)levelOf(entry.bounds);
+    entry.isPending = true;
+    ++_levelCounts[entry.level];
+    ++_pendingCount;
+
+    CellRange range = cellsOf(entry.level, entry.bounds);
+
+    for (int64_t column = range.firstColumn; column <= range.lastColumn; ++column) {
+      for (int64_t row = range.firstRow; row <= range.lastRow; ++row) {
+        _pending[keyOf(range.level, column, row)].push_back(slot);
+      }
+    }
+
+    if (_pendingCount > _packedCount / 2 + SIZE_SAMPLES) {
+      pack();
+    }
+  }
+
+  /// <summary>
+  /// Remove a slot from the cells it was added to since packing.
+  /// </summary>
+  void unbin(uint32_t slot) {
+    Entry& entry = _entries[slot];
+
+    if (entry.isPending) {
+      CellRange range = cellsOf(entry.level, entry.bounds);
+
+      for (int64_t column = range.firstColumn; column <= range.lastColumn; ++column) {
+        for (int64_t row = range.firstRow; row <= range.lastRow; ++row) {
+          auto cell = _pending.find(keyOf(range.level, column, row));
+
+          if (cell != _pending.end()) {
+            drop(cell->second, slot);
+
+            if (cell->second.empty()) {
+              _pending.erase(cell);
+            }
+          }
+        }
+      }
+
+      entry.isPending = false;
+      --_pendingCount;
+    }
+
+    --_levelCounts[entry.level];
+  }
+
+  /// <summary>
+  /// Choose the cell size from the shapes indexed, then pack them all
+  /// in sorted cells.
+  /// </summary>
+  void pack() {
+    std::vector<int64_t> extents;
+    size_t stride = max(_entries.size() / SIZE_SAMPLES, (size_t)1);
+
+    for (size_t i = 0; i < _entries.size(); i += stride) {
+      const Entry& entry = _entries[i];
+
+      if (entry.shape) {
+        extents.push_back(max(
+          (int64_t)entry.bounds.right - entry.bounds.left,
+          (int64_t)entry.bounds.bottom - entry.bounds.top
+        ));
+      }
+    }
+
+    // Cells as wide as the median shape: most shapes span up to four.
+    _cellShift = MIN_CELL_SHIFT;
+
+    if (!extents.empty()) {
+      std::nth_element(extents.begin(), extents.begin() + extents.size() / 2, extents.end());
+      int64_t median = extents[extents.size() / 2];
+
+      while (_cellShift < MAX_CELL_SHIFT && ((int64_t)1 << _cellShift) < median) {
+        ++_cellShift;
+      }
+    }
+
+    // Grid of every shape, and the cells each grid spans.
+    std::fill(_levelCounts, _levelCounts + LEVELS, (size_t)0);
+
+    CellRange spans[LEVELS];
+    size_t pairCounts[LEVELS] = {};
+
+    for (Entry& entry : _entries) {
+      if (!entry.shape) {
+        continue;
+      }
+
+      entry.level = (uint8_t)levelOf(entry.bounds);
+      entry.isPending = false;
+
+      CellRange range = cellsOf(entry.level, entry.bounds);
+      CellRange& span = spans[entry.level];
+
+      if (0 == _levelCounts[entry.level]++) {
+        span = range;
+      }
+
+      else {
+        span.firstColumn = min(span.firstColumn, range.firstColumn);
+        span.firstRow = min(span.firstRow, range.firstRow);
+        span.lastColumn = max(span.lastColumn, range.lastColumn);
+        span.lastRow = max(span.lastRow, range.lastRow);
+      }
+
+      pairCounts[entry.level] += (size_t)range.count();
+    }
+
+    _keys.clear();
+    _starts.clear();
+    _packed.clear();
+
+    // Grid by grid, as keys sort by grid first.
+    for (int level = 0; level < LEVELS; ++level) {
+      if (0 == _levelCounts[level]) {
+        continue;
+      }
+
+      if (spans[level].count() <= (int64_t)(pairCounts[level] + SIZE_SAMPLES)) {
+        packDense(level, spans[level], pairCounts[level]);
+      }
+
+      else {
+        packSparse(level, pairCounts[level]);
+      }
+    }
+
+    _starts.push_back((uint32_t)_packed.size());
+
+    _pending.clear();
+    _packedCount = _slots.size();
+    _pendingCount = 0;
+  }
+
+  /// <summary>
+  /// Pack the cells of a grid with a counting sort over all the cells
+  /// it spans, when they are not many more than the shapes in them.
+  /// </summary>
+  void packDense(int level, const CellRange& span, size_t pairCount) {
+    int64_t rows = span.lastRow - span.firstRow + 1;
+    std::vector<uint32_t> counts((size_t)span.count() + 1, 0);
+
+    auto forEachCell = [&](auto&& visit) {
+      for (uint32_t slot = 0; slot < _entries.size(); ++slot) {
+        const Entry& entry = _entries[slot];
+
+        if (!entry.shape || entry.level != level) {
+          continue;
+        }
+
+        CellRange range = cellsOf(level, entry.bounds);
+
+        for (int64_t column = range.firstColumn; column <= range.lastColumn; ++column) {
+          for (int64_t row = range.firstRow; row <= range.lastRow; ++row) {
+            visit((column - span.firstColumn) * rows + (row - span.firstRow), slot);
+          }
+        }
+      }
+    };
+
+    forEachCell([&](int64_t cell, uint32_t) { ++counts[(size_t)cell + 1]; });
+
+    size_t base = _packed.size();
+    _packed.resize(base + pairCount);
+
+    for (size_t cell = 0; cell + 1 < counts.size(); ++cell) {
+      if (counts[cell + 1] > 0) {
+        _keys.push_back(keyOf(level,
+          span.firstColumn + (int64_t)cell / rows,
+          span.firstRow + (int64_t)cell % rows));
+        _starts.push_back((uint32_t)(base + counts[cell]));
+      }
+
+      counts[cell + 1] += counts[cell];
+    }
+
+    forEachCell([&](int64_t cell, uint32_t slot) {
+      _packed[base + counts[(size_t)cell]++] = slot;
+    });
+  }
+
+  /// <summary>
+  /// Pack the cells of a grid by sorting its (cell, slot) pairs.
+  /// </summary>
+  void packSparse(int level, size_t pairCount) {
+    std::vector<std::pair<uint64_t, uint32_t>> pairs;
+    pairs.reserve(pairCount);
+
+    for (uint32_t slot = 0; slot < _entries.size(); ++slot) {
+      const Entry& entry = _entries[slot];
+
+      if (!entry.shape || entry.level != level) {
+        continue;
+      }
+
+      CellRange range = cellsOf(level, entry.bounds);
+
+      for (int64_t column = range.firstColumn; column <= range.lastColumn; ++column) {
+        for (int64_t row = range.firstRow; row <= range.lastRow; ++row) {
+          pairs.push_back({ keyOf(level, column, row), slot });
+        }
+      }
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+
+    for (size_t i = 0; i < pairs.size(); ++i) {
+      if (0 == i || pairs[i].first != pairs[i - 1].first) {
+        _keys.push_back(pairs[i].first);
+        _starts.push_back((uint32_t)_packed.size());
+      }
+
+      _packed.push_back(pairs[i].second);
+    }
+  }
+
+  /// <summary>
+  /// Slots of the shapes whose bounds overlap an area (inclusive),
+  /// from the cells of every grid it covers.
+  /// </summary>
+  void gather(const RECT& area) {
+    _candidates.clear();
+
+    auto add = [&](uint32_t slot) {
+      const Entry& entry = _entries[slot];
+
+      if (entry.shape &&
+        entry.bounds.left <= area.right && entry.bounds.right > area.left &&
+        entry.bounds.top <= area.bottom && entry.bounds.bottom > area.top) {
+        _candidates.push_back(slot);
+      }
+    };
+
+    for (int level = 0; level < LEVELS; ++level) {
+      if (0 == _levelCounts[level]) {
+        continue;
+      }
+
+      CellRange range = cellsOf(level, area.left, area.top, area.right, area.bottom);
+
+      for (int64_t column = range.firstColumn; column <= range.lastColumn; ++column) {
+        // The packed cells of a column are next to each other.
+        uint64_t last = keyOf(level, column, range.lastRow);
+        size_t cell = std::lower_bound(
+          _keys.begin(), _keys.end(), keyOf(level, column, range.firstRow)
+        ) - _keys.begin();
+
+        for (; cell < _keys.size() && _keys[cell] <= last; ++cell) {
+          for (uint32_t i = _starts[cell]; i < _starts[cell + 1]; ++i) {
+            add(_packed[i]);
+          }
+        }
+
+        if (_pending.empty()) {
+          continue;
+        }
+
+        for (int64_t row = range.firstRow; row <= range.lastRow; ++row) {
+          auto pending = _pending.find(keyOf(level, column, row));
+
+          if (pending != _pending.end()) {
+            for (uint32_t slot : pending->second) {
+              add(slot);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  /// <summary>
+  /// Index in shapes of the shape of an order, by bisection.
+  /// </summary>
+  int position(const std::vector<std::shared_ptr<IShape>>& shapes, uint64_t order) const {
+    size_t low = 0, high = shapes.size();
+
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+
+      if (orderOf(shapes[middle].get()) < order) {
+        low = middle + 1;
+      }
+
+      else {
+        high = middle;
+      }
+    }
+
+    if (low == shapes.size() || orderOf(shapes[low].get()) != order) {
+      throw std::runtime_error("(SpatialIndex) The scene and its index differ.");
+    }
+
+    return (int)low;
+  }
+
+  uint64_t orderOf(const IShape* shape) const {
+    auto found = _slots.find(shape);
+
+    if (found == _slots.end()) {
+      throw std::runtime_error("(SpatialIndex) The scene and its index differ.");
+    }
+
+    return _entries[found->second].order;
+  }
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+/// <summary>
+/// Creates and frees the state objects a render backend needs
+/// to draw a style (its pens; brushes are stock objects).
+/// </summary>
+class IStyleFactory {
+public:
+  IStyleFactory() {
+    // Do nothing.
+  }
+
+  virtual ~IStyleFactory() {
+    // Do nothing.
+  }
+
+public:
+  /// <summary>
+  /// Create the pen outlining shapes of a graphic.
+  /// </summary>
+  /// <param name="graphic"></param>
+  /// <returns>Opaque handle of the pen.</returns>
+  virtual void* createPen(const ShapeGraphic& graphic) = 0;
+
+  virtual void deletePen(void* pen) = 0;
+};
+
+/// <summary>
+/// Pens of a backend, created once per distinct line style, width and
+/// colour, and shared by every shape (and every frame) using them.
+/// </summary>
+class StyleCache {
+public:
+  /// <summary>
+  /// Pens kept between frames before the cache starts over.
+  /// </summary>
+  static constexpr size_t DEFAULT_CAPACITY = 1024;
+
+private:
+  /// <summary>
+  /// Part of a ShapeGraphic a pen depends on.
+  /// </summary>
+  struct PenKey {
+    int style;
+    int width;
+    COLORREF colour;
+
+    bool operator==(const PenKey& other) const {
+      return style == other.style && width == other.width &&
+        colour == other.colour;
+    }
+  };
+
+  struct PenKeyHash {
+    size_t operator()(const PenKey& key) const {
+      uint64_t bits = ((uint64_t)(uint32_t)key.style << 32) ^
+        ((uint64_t)(uint32_t)key.width << 24) ^ key.colour;
+
+      return std::hash<uint64_t>()(bits);
+    }
+  };
+
+  IStyleFactory& _factory;
+  size_t _capacity;
+  std::unordered_map<PenKey, void*, PenKeyHash> _pens;
+
+  uint64_t _created;
+  uint64_t _reused;
+
+public:
+  /// <summary>
+  /// Cache the pens of a backend.
+  /// </summary>
+  /// <param name="factory"></param>
+  /// <param name="capacity"></param>
+  StyleCache(IStyleFactory& factory, size_t capacity = DEFAULT_CAPACITY)
+    : _factory(factory) {
+    _capacity = capacity;
+    _created = 0;
+    _reused = 0;
+  }
+
+  StyleCache(const StyleCache&) = delete;
+  StyleCache& operator=(const StyleCache&) = delete;
+
+  ~StyleCache() {
+    clear();
+  }
+
+public:
+  /// <summary>
+  /// Number of pens held.
+  /// </summary>
+  /// <returns></returns>
+  size_t size() const { return _pens.size(); }
+
+  /// <summary>
+  /// Pens created, and lookups served without creating one.
+  /// </summary>
+  /// <returns></returns>
+  uint64_t created() const { return _created; }
+  uint64_t reused() const { return _reused; }
+
+  /// <summary>
+  /// Pen drawing a graphic, created on first use.
+  /// </summary>
+  /// <param name="graphic"></param>
+  /// <returns></returns>
+  void* pen(const ShapeGraphic& graphic) {
+    PenKey key = {
+      graphic.lineStyle(),
+      graphic.lineWidth(),
+      graphic.lineColour()
+    };
+
+    auto found = _pens.find(key);
+
+    if (found != _pens.end()) {
+      ++_reused;
+      return found->second;
+    }
+
+    void* pen = _factory.createPen(graphic);
+    _pens.emplace(key, pen);
+    ++_created;
+
+    return pen;
+  }
+
+  /// <summary>
+  /// Start over once more pens than the capacity are held.
+  /// Only call when no pen is in use (e.g. between frames).
+  /// </summary>
+  void trim() {
+    if (_pens.size() > _capacity) {
+      clear();
+    }
+  }
+
+  /// <summary>
+  /// Free every pen. Only call when no pen is in use.
+  /// </summary>
+  void clear() {
+    for (auto& entry : _pens) {
+      _factory.deletePen(entry.second);
+    }
+
+    _pens.clear();
+  }
+};
@@ -0,0 +1,228 @@
+#pragma once
+
+/// <summary>
+/// Replays a display list into a Framebuffer on every core.
+///
+/// The framebuffer is cut into square tiles. Commands are first binned
+/// by their bounds into the tiles they touch (each worker bins a
+/// contiguous slice of the list), then workers take the next tile
+/// until none is left and replay its commands, in list order, clipped
+/// to the tile. Tiles share no pixel, and a command clipped to a tile
+/// gives the same pixels it gives there unclipped, so the result is
+/// exactly the one of replaying the list in order on one thread.
+///
+/// The list holds document coordinates; a viewport maps them to the
+/// framebuffer, for binning and for drawing.
+/// </summary>
+class TileRenderer {
+public:
+  /// <summary>
+  /// Side of a tile, in pixels (64 x 64 x 4 bytes stays in cache).
+  /// </summary>
+  static constexpr int TILE_SIZE = 64;
+
+  /// <summary>
+  /// Below this many commands, a single thread renders.
+  /// </summary>
+  static constexpr size_t MIN_PARALLEL_COMMANDS = 512;
+
+private:
+  unsigned int _threadCount;
+  bool _antialiasing;
+
+  // Per worker, per tile: indices of the commands binned there.
+  // Kept from frame to frame to reuse the memory.
+  std::vector<std::vector<std::vector<uint32_t>>> _bins;
+
+  // Per worker: commands of its slice inside the area.
+  std::vector<size_t> _drawn;
+
+  /// <summary>
+  /// Run job(worker) on count workers, the calling thread included.
+  /// </summary>
+  /// <param name="count"></param>
+  /// <param name="job"></param>
+  template <typename Job>
+  static void runWorkers(unsigned int count, Job&& job) {
+    std::vector<std::thread> workers;
+
+    for (unsigned int i = 1; i < count; ++i) {
+      workers.emplace_back(job, i);
+    }
+
+    job(0);
+
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+  }
+
+public:
+  /// <summary>
+  /// Create a renderer.
+  /// </summary>
+  /// <param name="threadCount">0 means one worker per core.</param>
+  TileRenderer(unsigned int threadCount = 0) {
+    _threadCount = threadCount ? threadCount : ParallelSceneLoader::defaultThreadCount();
+    _antialiasing = false;
+  }
+
+  unsigned int threadCount() const { return _threadCount; }
+
+  /// <summary>
+  /// Render anti-aliased (see SoftwareRenderTarget), or not.
+  /// </summary>
+  /// <param name="antialiasing"></param>
+  void setAntialiasing(bool antialiasing) {
+    _antialiasing = antialiasing;
+  }
+
+  bool isAntialiasing() const { return _antialiasing; }
+
+  /// <summary>
+  /// Commands the last render replayed; the others were culled.
+  /// </summary>
+  /// <returns></returns>
+  size_t drawnCount() const {
+    size_t drawn = 0;
+
+    for (size_t count : _drawn) {
+      drawn += count;
+    }
+
+    return drawn;
+  }
+
+  /// <summary>
+  /// Clear an area of the framebuffer to background, then replay
+  /// the commands in order over it. Pixels outside the area are
+  /// left untouched.
+  /// </summary>
+  /// <param name="framebuffer"></param>
+  /// <param name="list"></param>
+  /// <param name="background">Pixel value (see Framebuffer::toPixel).</param>
+  /// <param name="area">Area to render (right and bottom excluded).</param>
+  /// <param name="detailSize">Commands no larger are drawn as a dot (see DisplayList).</param>
+  /// <param name="viewport">Where the document shows in the framebuffer.</param>
+  void render(Framebuffer& framebuffer, const DisplayList& list,
+    uint32_t background, const RECT& area, int detailSize = 0,
+    const Viewport& viewport = Viewport()) {
+    bool mapped = !viewport.isIdentity();
+
+    int areaLeft = max((int)area.left, 0);
+    int areaTop = max((int)area.top, 0);
+    int areaRight = min((int)area.right, framebuffer.width());
+    int areaBottom = min((int)area.bottom, framebuffer.height());
+
+    _drawn.clear();
+
+    if (areaLeft >= areaRight || areaTop >= areaBottom) {
+      return;
+    }
+
+    // Tiles stay aligned on the framebuffer grid; only those
+    // touching the area are rendered.
+    int firstColumn = areaLeft / TILE_SIZE;
+    int firstRow = areaTop / TILE_SIZE;
+    int columns = (areaRight - 1) / TILE_SIZE - firstColumn + 1;
+    int rows = (areaBottom - 1) / TILE_SIZE - firstRow + 1;
+    size_t tileCount = (size_t)columns * rows;
+
+    unsigned int threadCount = _threadCount;
+
+    if (list.size() < MIN_PARALLEL_COMMANDS) {
+      threadCount = 1;
+    }
+
+    threadCount = (unsigned int)min((size_t)threadCount, tileCount);
+
+    _bins.resize(threadCount);
+    _drawn.assign(threadCount, 0);
+
+    // Bin: worker i takes the i-th slice of the list.
+    runWorkers(threadCount, [&](unsigned int worker) {
+      std::vector<std::vector<uint32_t>>& bins = _bins[worker];
+
+      bins.resize(tileCount);
+
+      for (std::vector<uint32_t>& bin : bins) {
+        bin.clear();
+      }
+
+      size_t begin = list.size() * worker / threadCount;
+      size_t end = list.size() * (worker + 1) / threadCount;
+      size_t drawn = 0;
+
+      for (size_t i = begin; i < end; ++i) {
+        RECT bounds = mapped ? viewport.toClient(list.bounds(i)) : list.bounds(i);
+
+        if (bounds.right <= areaLeft || bounds.bottom <= areaTop ||
+          bounds.left >= areaRight || bounds.top >= areaBottom) {
+          continue;
+        }
+
+        ++drawn;
+
+        int left = max((int)bounds.left, areaLeft) / TILE_SIZE - firstColumn;
+        int top = max((int)bounds.top, areaTop) / TILE_SIZE - firstRow;
+        int right = (min((int)bounds.right, areaRight) - 1) / TILE_SIZE - firstColumn;
+        int bottom = (min((int)bounds.bottom, areaBottom) - 1) / TILE_SIZE - firstRow;
+
+        for (int row = top; row <= bottom; ++row) {
+          for (int column = left; column <= right; ++column) {
+            bins[(size_t)row * columns + column].push_back((uint32_t)i);
+          }
+        }
+      }
+
+      _drawn[worker] = drawn;
+    });
+
+    // Raster: workers take the next tile until none is left.
+    std::atomic<size_t> nextTile(0);
+
+    runWorkers(threadCount, [&](unsigned int) {
+      SoftwareRenderTarget target(framebuffer);
+      target.setAntialiasing(_antialiasing);
+      ViewportRenderTarget view(target, viewport);
+      size_t tile;
+
+      while ((tile = nextTile.fetch_add(1)) < tileCount) {
+        int column = firstColumn + (int)(tile % columns);
+        int row = firstRow + (int)(tile / columns);
+
+        int left = max(column * TILE_SIZE, areaLeft);
+        int top = max(row * TILE_SIZE, areaTop);
+        int right = min((column + 1) * TILE_SIZE, areaRight);
+        int bottom = min((row + 1) * TILE_SIZE, areaBottom);
+
+        for (int y = top; y < bottom; ++y) {
+          framebuffer.fillSpan(left, y, right - left, background);
+        }
+
+        target.setClip(left, top, right, bottom);
+
+        // Slices in order, so the commands come in list order.
+        for (const std::vector<std::vector<uint32_t>>& bins : _bins) {
+          for (uint32_t i : bins[tile]) {
+            list.replay(view, i, detailSize);
+          }
+        }
+      }
+    });
+  }
+
+  /// <summary>
+  /// Clear the whole framebuffer to background, then replay the
+  /// commands in order.
+  /// </summary>
+  /// <param name="framebuffer"></param>
+  /// <param name="list"></param>
+  /// <param name="background">Pixel value (see Framebuffer::toPixel).</param>
+  void render(Framebuffer& framebuffer, const DisplayList& list,
+    uint32_t background) {
+    RECT area = { 0, 0, framebuffer.width(), framebuffer.height() };
+
+    render(framebuffer, list, background, area);
+  }
+};
@@ -0,0 +1,329 @@
+#pragma once
+
+/// <summary>
+/// Zoom and pan of the canvas: where the document shows in the client
+/// area. Shapes keep their document coordinates; drawing maps them to
+/// the client area, and the mouse maps back.
+///
+/// The scale is 16.16 fixed point, and a point maps as
+/// client = document * scale + offset, the offset being where the
+/// document origin shows. Everything is computed in 64-bit integers,
+/// rounding down both ways.
+/// </summary>
+class Viewport {
+public:
+  static constexpr int SCALE_SHIFT = 16;
+  static constexpr int64_t SCALE_ONE = (int64_t)1 << SCALE_SHIFT;
+
+  /// <summary>
+  /// Zoom limits: from 1/16 to 32 times.
+  /// </summary>
+  static constexpr int64_t MIN_SCALE = SCALE_ONE / 16;
+  static constexpr int64_t MAX_SCALE = SCALE_ONE * 32;
+
+  /// <summary>
+  /// One zoom step multiplies (or divides) the scale by 5/4.
+  /// </summary>
+  static constexpr int64_t ZOOM_NUMERATOR = 5;
+  static constexpr int64_t ZOOM_DENOMINATOR = 4;
+
+  /// <summary>
+  /// Pixels mapped areas grow by on every side, for the rounding of
+  /// the coordinates and of the scaled pens.
+  /// </summary>
+  static constexpr int MARGIN = 2;
+
+private:
+  /// <summary>
+  /// Offsets stay within this, so no product overflows.
+  /// </summary>
+  static constexpr int64_t MAX_OFFSET = (int64_t)1 << 40;
+
+  int64_t _scale;
+  int64_t _offsetX;
+  int64_t _offsetY;
+
+  /// <summary>
+  /// Quotient rounded down (divisor positive).
+  /// </summary>
+  static int64_t floorDivide(int64_t dividend, int64_t divisor) {
+    return dividend >= 0 ?
+      dividend / divisor :
+      -((-dividend + divisor - 1) / divisor);
+  }
+
+  static int clampToInt(int64_t value) {
+    return (int)max(min(value, (int64_t)INT_MAX), (int64_t)INT_MIN);
+  }
+
+  static int64_t clampOffset(int64_t offset) {
+    return max(min(offset, MAX_OFFSET), -MAX_OFFSET);
+  }
+
+public:
+  /// <summary>
+  /// Document shown 1:1, its origin at the client origin.
+  /// </summary>
+  Viewport() {
+    reset();
+  }
+
+public:
+  void reset() {
+    _scale = SCALE_ONE;
+    _offsetX = 0;
+    _offsetY = 0;
+  }
+
+  /// <summary>
+  /// Client pixels per document pixel, 16.16.
+  /// </summary>
+  /// <returns></returns>
+  int64_t scale() const { return _scale; }
+
+  /// <summary>
+  /// Zoom, in percent (rounded).
+  /// </summary>
+  /// <returns></returns>
+  int percent() const {
+    return (int)((_scale * 100 + SCALE_ONE / 2) >> SCALE_SHIFT);
+  }
+
+  /// <summary>
+  /// Does the viewport leave coordinates as they are?
+  /// </summary>
+  /// <returns></returns>
+  bool isIdentity() const {
+    return SCALE_ONE == _scale && 0 == _offsetX && 0 == _offsetY;
+  }
+
+  bool operator==(const Viewport& other) const {
+    return _scale == other._scale && _offsetX == other._offsetX &&
+      _offsetY == other._offsetY;
+  }
+
+  bool operator!=(const Viewport& other) const {
+    return !(*this == other);
+  }
+
+  /// <summary>
+  /// Client coordinates of a document point.
+  /// </summary>
+  int toClientX(int x) const {
+    return clampToInt((((int64_t)x * _scale) >> SCALE_SHIFT) + _offsetX);
+  }
+
+  int toClientY(int y) const {
+    return clampToInt((((int64_t)y * _scale) >> SCALE_SHIFT) + _offsetY);
+  }
+
+  /// <summary>
+  /// Document coordinates of a client point: the last document pixel
+  /// mapped at or before it, so mapping back never passes the point.
+  /// </summary>
+  int toDocumentX(int x) const {
+    return clampToInt(floorDivide((((int64_t)x - _offsetX + 1) << SCALE_SHIFT) - 1, _scale));
+  }
+
+  int toDocumentY(int y) const {
+    return clampToInt(floorDivide((((int64_t)y - _offsetY + 1) << SCALE_SHIFT) - 1, _scale));
+  }
+
+  /// <summary>
+  /// Client area covering a document area (right and bottom excluded).
+  /// </summary>
+  /// <param name="area"></param>
+  /// <returns></returns>
+  RECT toClient(const RECT& area) const {
+    if (IsRectEmpty(&area)) {
+      return area;
+    }
+
+    RECT client;
+    client.left = toClientX(area.left) - MARGIN;
+    client.top = toClientY(area.top) - MARGIN;
+    client.right = toClientX(area.right) + MARGIN;
+    client.bottom = toClientY(area.bottom) + MARGIN;
+
+    return client;
+  }
+
+  /// <summary>
+  /// Document area covering a client area (right and bottom excluded):
+  /// every shape drawing there has bounds inside it.
+  /// </summary>
+  /// <param name="area"></param>
+  /// <returns></returns>
+  RECT toDocument(const RECT& area) const {
+    if (IsRectEmpty(&area)) {
+      return area;
+    }
+
+    RECT document;
+    document.left = toDocumentX(area.left - MARGIN);
+    document.top = toDocumentY(area.top - MARGIN);
+    document.right = toDocumentX(area.right - 1 + MARGIN) + 1;
+    document.bottom = toDocumentY(area.bottom - 1 + MARGIN) + 1;
+
+    return document;
+  }
+
+  /// <summary>
+  /// Width of a pen in the client area, at least a pixel.
+  /// </summary>
+  /// <param name="length"></param>
+  /// <returns></returns>
+  int toClientLength(int length) const {
+    if (length <= 0) {
+      return length;
+    }
+
+    return clampToInt(max(
+      ((int64_t)length * _scale + SCALE_ONE / 2) >> SCALE_SHIFT,
+      (int64_t)1
+    ));
+  }
+
+  /// <summary>
+  /// Document pixels a client length spans (rounded down).
+  /// </summary>
+  /// <param name="length"></param>
+  /// <returns></returns>
+  int toDocumentLength(int length) const {
+    return clampToInt(((int64_t)length << SCALE_SHIFT) / _scale);
+  }
+
+  /// <summary>
+  /// Document size up to which shapes may be drawn as a dot, for a
+  /// size in client pixels. Only while zoomed out: at 1:1 and closer
+  /// every shape is drawn in full, as a dot would show.
+  /// </summary>
+  /// <param name="size"></param>
+  /// <returns>0 to draw every shape in full.</returns>
+  int toDetailLength(int size) const {
+    return _scale < SCALE_ONE ? toDocumentLength(size) : 0;
+  }
+
+  /// <summary>
+  /// Change the scale, keeping the document point under a client
+  /// point where it is.
+  /// </summary>
+  /// <param name="x"></param>
+  /// <param name="y"></param>
+  /// <param name="scale">16.16, clamped to the zoom limits.</param>
+  void zoomAt(int x, int y, int64_t scale) {
+    scale = max(min(scale, MAX_SCALE), MIN_SCALE);
+
+    _offsetX = clampOffset(x - floorDivide((x - _offsetX) * scale, _scale));
+    _offsetY = clampOffset(y - floorDivide((y - _offsetY) * scale, _scale));
+    _scale = scale;
+  }
+
+  /// <summary>
+  /// Zoom in (steps above 0) or out around a client point.
+  /// </summary>
+  /// <param name="x"></param>
+  /// <param name="y"></param>
+  /// <param name="steps"></param>
+  void zoomBy(int x, int y, int steps) {
+    int64_t scale = _scale;
+
+    for (; steps > 0 && scale < MAX_SCALE; --steps) {
+      scale = scale * ZOOM_NUMERATOR / ZOOM_DENOMINATOR;
+    }
+
+    for (; steps < 0 && scale > MIN_SCALE; ++steps) {
+      scale = scale * ZOOM_DENOMINATOR / ZOOM_NUMERATOR;
+    }
+
+    zoomAt(x, y, scale);
+  }
+
+  /// <summary>
+  /// Move the document by some client pixels.
+  /// </summary>
+  /// <param name="dx"></param>
+  /// <param name="dy"></param>
+  void pan(int dx, int dy) {
+    _offsetX = clampOffset(_offsetX + dx);
+    _offsetY = clampOffset(_offsetY + dy);
+  }
+
+  /// <summary>
+  /// Client pixels the document moved by from another viewport
+  /// of the same scale.
+  /// </summary>
+  /// <param name="from"></param>
+  /// <param name="dx"></param>
+  /// <param name="dy"></param>
+  /// <returns>False if the scales differ, or the shift is too far.</returns>
+  bool shiftFrom(const Viewport& from, int& dx, int& dy) const {
+    int64_t shiftX = _offsetX - from._offsetX;
+    int64_t shiftY = _offsetY - from._offsetY;
+
+    if (_scale != from._scale ||
+      std::abs(shiftX) > INT_MAX || std::abs(shiftY) > INT_MAX) {
+      return false;
+    }
+
+    dx = (int)shiftX;
+    dy = (int)shiftY;
+
+    return true;
+  }
+};
+
+/// <summary>
+/// Render target drawing through a viewport into another target:
+/// coordinates and pen widths are mapped to the client area, the rest
+/// is passed on as is.
+/// </summary>
+class ViewportRenderTarget : public IRenderTarget {
+private:
+  IRenderTarget& _target;
+  const Viewport& _viewport;
+
+public:
+  /// <summary>
+  /// Draw into a target through a viewport; both outlive this one.
+  /// </summary>
+  /// <param name="target"></param>
+  /// <param name="viewport"></param>
+  ViewportRenderTarget(IRenderTarget& target, const Viewport& viewport)
+    : _target(target), _viewport(viewport) {
+    // Do nothing.
+  }
+
+public:
+  void setStyle(const ShapeGraphic& graphic) override {
+    ShapeGraphic scaled = graphic;
+    scaled.setLineWidth(_viewport.toClientLength(graphic.lineWidth()));
+
+    _target.setStyle(scaled);
+  }
+
+  void line(int x1, int y1, int x2, int y2) override {
+    _target.line(
+      _viewport.toClientX(x1), _viewport.toClientY(y1),
+      _viewport.toClientX(x2), _viewport.toClientY(y2)
+    );
+  }
+
+  void rectangle(int left, int top, int right, int bottom) override {
+    _target.rectangle(
+      _viewport.toClientX(left), _viewport.toClientY(top),
+      _viewport.toClientX(right), _viewport.toClientY(bottom)
+    );
+  }
+
+  void ellipse(int left, int top, int right, int bottom) override {
+    _target.ellipse(
+      _viewport.toClientX(left), _viewport.toClientY(top),
+      _viewport.toClientX(right), _viewport.toClientY(bottom)
+    );
+  }
+
+  void dot(int x, int y) override {
+    _target.dot(_viewport.toClientX(x), _viewport.toClientY(y));
+  }
+};
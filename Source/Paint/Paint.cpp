@@ -118,8 +118,14 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
   HANDLE_MSG(hWnd, WM_LBUTTONDOWN, EventHandler::OnLButtonDown);
   HANDLE_MSG(hWnd, WM_LBUTTONUP, EventHandler::OnLButtonUp);
   HANDLE_MSG(hWnd, WM_MOUSEMOVE, EventHandler::OnMouseMove);
+  HANDLE_MSG(hWnd, WM_MOUSEWHEEL, EventHandler::OnMouseWheel);
   HANDLE_MSG(hWnd, WM_SIZE, EventHandler::OnSize);
   HANDLE_MSG(hWnd, WM_HOTKEY, EventHandler::OnHotKey);
+  HANDLE_MSG(hWnd, WM_TIMER, EventHandler::OnTimer);
+
+  case BackgroundSaver::COMPLETED:
+    EventHandler::OnSceneSaved(hWnd);
+    break;
 
   default:
     return DefWindowProc(hWnd, message, wParam, lParam);
@@ -3,9 +3,34 @@
 #include "resource.h"
 
 // Library
+#include "Library/Platform.h"
 #include "Library/Tokeniser.h"
 #include "Library/ShapeGraphic.h"
+#include "Library/RenderTarget.h"
+#include "Library/Viewport.h"
+#include "Library/StyleCache.h"
+#include "Library/Clipping.h"
+#include "Library/GdiRenderTarget.h"
+#include "Library/SpanKernels.h"
+#include "Library/Framebuffer.h"
+#include "Library/DashPattern.h"
+#include "Library/SoftwareRenderTarget.h"
 #include "Library/Shapes.h"
+#include "Library/SpatialIndex.h"
+#include "Library/SceneParser.h"
+#include "Library/SceneWriter.h"
+#include "Library/MappedFile.h"
+#include "Library/ParallelSceneLoader.h"
+#include "Library/BinaryScene.h"
+#include "Library/CompactScene.h"
+#include "Library/SceneJournal.h"
+#include "Library/PagedScene.h"
+#include "Library/SceneSnapshot.h"
+#include "Library/BackgroundSaver.h"
+#include "Library/DisplayList.h"
+#include "Library/TileRenderer.h"
+#include "Library/RenderStats.h"
+#include "Library/SceneLayer.h"
 #include "Library/Geometric.h"
 #include "Library/Bitmap.h"
 
@@ -120,6 +145,11 @@ Point topLeft, rightBottom;
 /// </summary>
 Point firstPosition, secondPosition;
 
+/// <summary>
+/// Where the current move started.
+/// </summary>
+Point moveStartPosition;
+
 /// <summary>
 /// Default Shape graphic.
 /// </summary>
@@ -162,6 +192,125 @@ int shapeType = 0;        // 0 : Line
 /// </summary>
 std::vector<std::shared_ptr<IShape>> shapesVector;
 
+/// <summary>
+/// Where the shapes of shapesVector are, for selection; told of every
+/// change to it.
+/// </summary>
+SpatialIndex shapeIndex;
+
+//
+// These variables are used during saving.
+//
+//
+
+/// <summary>
+/// Path of the current scene, empty until opened or saved.
+/// </summary>
+std::wstring currentFilePath;
+
+/// <summary>
+/// Edits made since the current scene was last snapshotted.
+/// </summary>
+SceneJournal sceneJournal;
+
+/// <summary>
+/// Base layer of a huge scene, paged in from its file, NULL for normal
+/// scenes. Shapes drawn on top of it, or selected out of it, live in
+/// shapesVector.
+/// </summary>
+std::shared_ptr<PagedScene> pagedScene;
+
+/// <summary>
+/// Extra area (around the client area) kept decoded while paging.
+/// </summary>
+#define PAGED_SCENE_MARGIN 256
+
+/// <summary>
+/// Writes snapshots off the UI thread.
+/// </summary>
+BackgroundSaver backgroundSaver;
+
+/// <summary>
+/// Edits made to the scene so far, how many of them the running save
+/// holds, and how many the last save (or autosave) held: autosaving
+/// again is only worth it once the scene has moved past that.
+/// </summary>
+unsigned long long sceneEdits = 0;
+unsigned long long savingEdits = 0;
+unsigned long long autosavedEdits = 0;
+
+/// <summary>
+/// Autosave timer and its period (milliseconds).
+/// </summary>
+#define AUTOSAVE_TIMER 1
+#define AUTOSAVE_INTERVAL (5 * 60 * 1000)
+
+/// <summary>
+/// Default size, in pixels, up to which shapes are drawn as a dot
+/// while zoomed out.
+/// </summary>
+#define LEVEL_OF_DETAIL_SIZE 2
+
+/// <summary>
+/// Pixels the view pans by per notch of the mouse wheel.
+/// </summary>
+#define VIEW_PAN_STEP 48
+
+//
+// These variables are used during painting.
+//
+//
+
+/// <summary>
+/// Paint with the multi-threaded software renderer instead of GDI.
+/// </summary>
+bool isSoftwareRendering = false;
+
+/// <summary>
+/// Anti-alias lines and ellipses drawn by the software renderer.
+/// </summary>
+bool isAntialiasing = false;
+
+/// <summary>
+/// Shapes fitting in a square of this many pixels (pen included)
+/// are drawn as a single pixel of their colour while the view is
+/// zoomed out; at 1:1 and closer, and with 0, every shape is drawn
+/// in full.
+/// </summary>
+int levelOfDetailSize = LEVEL_OF_DETAIL_SIZE;
+
+/// <summary>
+/// Zoom and pan of the canvas. Shapes stay in document coordinates;
+/// painting maps them through it and the mouse maps back.
+/// </summary>
+Viewport viewport;
+
+/// <summary>
+/// GDI pens, shared by shapes of the same style across frames.
+/// </summary>
+GdiStyleFactory gdiStyleFactory;
+StyleCache gdiStyleCache(gdiStyleFactory);
+
+/// <summary>
+/// Software renderer, one worker per core.
+/// </summary>
+TileRenderer tileRenderer;
+
+/// <summary>
+/// Pixels re-rendered per frame.
+/// </summary>
+RenderStats renderStats;
+
+/// <summary>
+/// Committed shapes, rendered once and copied on every paint.
+/// </summary>
+SceneLayer sceneLayer;
+
+/// <summary>
+/// Draw commands of the scene layer, kept in sync with its shapes.
+/// </summary>
+DisplayList sceneDisplayList;
+
 //
 // These variables are used during moving/selection
 //
@@ -21,9 +21,32 @@
 #include <memory.h>
 #include <tchar.h>
 
+// SIMD intrinsics (x86 and x64 only)
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define PAINT_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
 // C++ Libraries
 #include <fstream>
 #include <vector>
+#include <unordered_map>
+#include <typeindex>
+#include <typeinfo>
 #include <string>
 #include <sstream>
-#include <memory>
\ No newline at end of file
+#include <memory>
+#include <string_view>
+#include <charconv>
+#include <stdexcept>
+#include <cstdint>
+#include <climits>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <list>
+#include <algorithm>
+#include <functional>
\ No newline at end of file
@@ -65,6 +65,11 @@
 #define ID_EDITMENU_DELETE              32804
 #define ID_HELP_H32805                  32805
 #define ID_HELP_HDSD                    32806
+#define ID_CONFIG_SOFTWARERENDER        32807
+#define ID_CONFIG_ANTIALIAS             32808
+#define ID_VIEW_ZOOMIN                  32809
+#define ID_VIEW_ZOOMOUT                 32810
+#define ID_VIEW_ZOOMRESET               32811
 #define IDC_STATIC                      -1
 
 // Next default values for new objects
@@ -73,7 +78,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NO_MFC                     1
 #define _APS_NEXT_RESOURCE_VALUE        138
-#define _APS_NEXT_COMMAND_VALUE         32807
+#define _APS_NEXT_COMMAND_VALUE         32812
 #define _APS_NEXT_CONTROL_VALUE         1001
 #define _APS_NEXT_SYMED_VALUE           133
 #endif
@@ -0,0 +1,852 @@
+//
+// Throughput of the library's hot paths, for comparing changes.
+// Built with the tests but not run by ctest: timings depend on the
+// machine, so nothing here passes or fails.
+//
+
+#include "Headless.h"
+#include "ReferenceEllipse.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <random>
+
+namespace {
+  /// <summary>
+  /// Fastest of several runs of a piece of work, in nanoseconds: the
+  /// minimum is the least disturbed by the rest of the machine.
+  /// </summary>
+  double fastest(int runs, const std::function<void()>& work) {
+    double best = 1e300;
+
+    for (int run = 0; run < runs; ++run) {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      work();
+      std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+      best = std::min(best, elapsed.count());
+    }
+
+    return best;
+  }
+
+  /// <summary>
+  /// A text scene of random shapes, one per line.
+  /// </summary>
+  std::string sceneText(size_t lines) {
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+    std::mt19937 random(1);
+    std::string text;
+
+    for (size_t i = 0; i < lines; ++i) {
+      std::shared_ptr<IShape> shape = factory->create(
+        (int)(random() % factory->prototypeSize()),
+        Point((int)(random() % 4000), (int)(random() % 4000)),
+        Point((int)(random() % 4000), (int)(random() % 4000)),
+        ShapeGraphic((int)(random() % 5), 1 + (int)(random() % 9),
+          random() % 0x1000000, DC_BRUSH, random() % 0x1000000)
+      );
+
+      SceneWriter::format(*factory, *shape, text);
+      text += '\n';
+    }
+
+    return text;
+  }
+
+  /// <summary>
+  /// Shapes up to 60 pixels across spread over a board, as drawn
+  /// by hand.
+  /// </summary>
+  std::vector<std::shared_ptr<IShape>> boardShapes(size_t count, int width, int height) {
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+    std::mt19937 random(2);
+    std::vector<std::shared_ptr<IShape>> shapes;
+
+    for (size_t i = 0; i < count; ++i) {
+      int x = (int)(random() % width);
+      int y = (int)(random() % height);
+
+      shapes.push_back(factory->create(
+        (int)(random() % factory->prototypeSize()),
+        Point(x, y),
+        Point(x + 4 + (int)(random() % 56), y + 4 + (int)(random() % 56)),
+        ShapeGraphic(PS_SOLID, 1 + (int)(random() % 3),
+          random() % 0x1000000, random() % 2 ? DC_BRUSH : NULL_BRUSH, random() % 0x1000000)
+      ));
+    }
+
+    return shapes;
+  }
+
+  /// <summary>
+  /// Anti-aliased against aliased ellipses, by size, pen and brush.
+  /// </summary>
+  void ellipses() {
+    std::printf("ellipses (ns each)            aliased  anti-aliased  ratio\n");
+
+    Framebuffer framebuffer(1100, 1100, 0xFFFFFFFF);
+    SoftwareRenderTarget target(framebuffer);
+
+    for (int brush : { NULL_BRUSH, DC_BRUSH }) {
+      for (int pen : { 1, 3 }) {
+        for (int size : { 16, 64, 256, 1024 }) {
+          target.setStyle(ShapeGraphic(PS_SOLID, pen, RGB(10, 20, 30), brush, RGB(200, 100, 50)));
+          double times[2];
+
+          for (bool antialiasing : { false, true }) {
+            target.setAntialiasing(antialiasing);
+            times[antialiasing] = fastest(size >= 1024 ? 100 : 1000, [&]() {
+              target.ellipse(20, 30, 20 + size, 30 + size * 3 / 4);
+            });
+          }
+
+          std::printf("  %-7s pen %d size %4d  %10.0f  %12.0f  %5.2f\n",
+            brush == DC_BRUSH ? "filled" : "outline", pen, size,
+            times[0], times[1], times[1] / times[0]);
+        }
+      }
+    }
+  }
+
+
+  /// <summary>
+  /// Aliased circles: the integer midpoint kernel against a square
+  /// root per row, by diameter, outlined and filled.
+  /// </summary>
+  void circles() {
+    std::printf("circles (ns each)            sqrt rows  midpoint  speed-up\n");
+
+    Framebuffer framebuffer(1100, 1100, 0xFFFFFFFF);
+    SoftwareRenderTarget target(framebuffer);
+    RECT whole = { 0, 0, 1100, 1100 };
+
+    uint32_t pen = Framebuffer::toPixel(RGB(10, 20, 30));
+    uint32_t brush = Framebuffer::toPixel(RGB(200, 100, 50));
+
+    for (bool filled : { false, true }) {
+      for (int size : { 8, 32, 128, 512 }) {
+        int runs = size >= 512 ? 200 : 2000;
+
+        double reference = fastest(runs, [&]() {
+          ReferenceEllipse::draw(framebuffer, whole, 20, 30, 20 + size, 30 + size,
+            1, pen, filled, brush);
+        });
+
+        target.setStyle(ShapeGraphic(PS_SOLID, 1, RGB(10, 20, 30),
+          filled ? DC_BRUSH : NULL_BRUSH, RGB(200, 100, 50)));
+
+        double midpoint = fastest(runs, [&]() {
+          target.ellipse(20, 30, 20 + size, 30 + size);
+        });
+
+        std::printf("  %-7s diameter %4d  %10.0f  %8.0f  %8.2f\n", filled ? "filled" : "outline",
+          size, reference, midpoint, reference / midpoint);
+      }
+    }
+  }
+
+  /// <summary>
+  /// Lines 400000 pixels long across a full HD frame, by pen: only the
+  /// part in the frame should cost anything.
+  /// </summary>
+  void longLines() {
+    std::printf("long lines (us for 1000)\n");
+
+    Framebuffer framebuffer(1920, 1080, 0xFFFFFFFF);
+    SoftwareRenderTarget target(framebuffer);
+
+    for (int pen : { 1, 5 }) {
+      for (int style : { PS_SOLID, PS_DASH }) {
+        for (bool antialiasing : { false, true }) {
+          target.setAntialiasing(antialiasing);
+          target.setStyle(ShapeGraphic(style, pen, RGB(10, 20, 30), NULL_BRUSH, 0));
+
+          double time = fastest(10, [&]() {
+            for (int i = 0; i < 1000; ++i) {
+              target.line(-200000, i, 200000, 1080 - i);
+            }
+          });
+
+          std::printf("  pen %d %-6s %-12s %10.0f\n", pen, style == PS_SOLID ? "solid" : "dashed",
+            antialiasing ? "anti-aliased" : "aliased", time / 1000);
+        }
+      }
+    }
+  }
+
+  /// <summary>
+  /// Anti-aliased against aliased at full HD: circles by diameter and
+  /// lines across the frame by slope, with a one pixel pen, then a
+  /// board of shapes as drawn by hand.
+  /// </summary>
+  void aa() {
+    std::printf("anti-aliasing (ns each)       aliased  anti-aliased  ratio\n");
+
+    Framebuffer framebuffer(1920, 1080, 0xFFFFFFFF);
+    SoftwareRenderTarget target(framebuffer);
+
+    auto compare = [&](const char* name, int size, int runs, int count,
+      const std::function<void()>& draw) {
+      double times[2];
+
+      for (bool antialiasing : { false, true }) {
+        target.setAntialiasing(antialiasing);
+        times[antialiasing] = fastest(runs, draw) / count;
+      }
+
+      std::printf("  %-12s %5d  %10.0f  %12.0f  %5.2f\n", name, size,
+        times[0], times[1], times[1] / times[0]);
+    };
+
+    for (bool filled : { false, true }) {
+      target.setStyle(ShapeGraphic(PS_SOLID, 1, RGB(10, 20, 30),
+        filled ? DC_BRUSH : NULL_BRUSH, RGB(200, 100, 50)));
+
+      for (int size : { 16, 64, 256, 1024 }) {
+        compare(filled ? "circle filled" : "circle", size, size >= 1024 ? 100 : 1000, 1, [&]() {
+          target.ellipse(20, 30, 20 + size, 30 + size);
+        });
+      }
+    }
+
+    // 100 lines 1900 pixels wide (or 1060 high), by rise per 100
+    // pixels across.
+    target.setStyle(ShapeGraphic(PS_SOLID, 1, RGB(10, 20, 30), NULL_BRUSH, 0));
+
+    for (int rise : { 2, 10, 50, 400 }) {
+      int dx = rise > 100 ? 1060 * 100 / rise : 1900;
+      int dy = dx * rise / 100;
+
+      compare("line", rise, 10, 100, [&]() {
+        for (int i = 0; i < 100; ++i) {
+          int x = rise > 100 ? 10 + i * 6 : 10;
+          int y = rise > 100 ? 10 : 10 + i;
+
+          target.line(x, y, x + dx, y + dy);
+        }
+      });
+    }
+
+    std::vector<std::shared_ptr<IShape>> shapes = boardShapes(100000, 1920, 1080);
+
+    compare("board", 100000, 3, (int)shapes.size(), [&]() {
+      for (const std::shared_ptr<IShape>& shape : shapes) {
+        shape->draw(target);
+      }
+    });
+  }
+
+  /// <summary>
+  /// 100k one pixel outlines up to 60 pixels across at full HD,
+  /// solid against dashed, by shape.
+  /// </summary>
+  void dashes() {
+    std::printf("100k outlines (ms)    solid  dashed  ratio\n");
+
+    Framebuffer framebuffer(1920, 1080, 0xFFFFFFFF);
+    SoftwareRenderTarget target(framebuffer);
+
+    std::mt19937 random(4);
+    std::vector<RECT> boxes(100000);
+
+    for (RECT& box : boxes) {
+      box.left = (LONG)(random() % 1900);
+      box.top = (LONG)(random() % 1060);
+      box.right = box.left + 4 + (LONG)(random() % 56);
+      box.bottom = box.top + 4 + (LONG)(random() % 56);
+    }
+
+    const char* const names[] = { "lines", "rectangles", "ellipses" };
+
+    for (int shape = 0; shape < 3; ++shape) {
+      double times[2];
+
+      for (int style : { PS_SOLID, PS_DASH }) {
+        target.setStyle(ShapeGraphic(style, 1, RGB(10, 20, 30), NULL_BRUSH, 0));
+
+        times[PS_DASH == style] = fastest(5, [&]() {
+          for (const RECT& box : boxes) {
+            switch (shape) {
+            case 0:
+              target.line(box.left, box.top, box.right, box.bottom);
+              break;
+            case 1:
+              target.rectangle(box.left, box.top, box.right, box.bottom);
+              break;
+            default:
+              target.ellipse(box.left, box.top, box.right, box.bottom);
+              break;
+            }
+          }
+        });
+      }
+
+      std::printf("  %-16s  %6.1f  %6.1f  %5.2f\n", names[shape],
+        times[0] / 1e6, times[1] / 1e6, times[1] / times[0]);
+    }
+  }
+
+  /// <summary>
+  /// 20k lines up to 100 pixels long at full HD, by pen width, drawn
+  /// as spans against a square stamped on every step as before (one
+  /// run of that, it is slow).
+  /// </summary>
+  void wideLines() {
+    std::printf("20k lines (ms)   spans  stamped  speed-up\n");
+
+    Framebuffer framebuffer(1920, 1080, 0xFFFFFFFF);
+    SoftwareRenderTarget target(framebuffer);
+
+    std::mt19937 random(21);
+    std::vector<RECT> lines(20000);
+
+    for (RECT& line : lines) {
+      line.left = (LONG)(random() % 1920);
+      line.top = (LONG)(random() % 1080);
+      line.right = line.left + (LONG)(random() % 201) - 100;
+      line.bottom = line.top + (LONG)(random() % 201) - 100;
+    }
+
+    for (int penWidth : { 2, 4, 8, 16 }) {
+      target.setStyle(ShapeGraphic(PS_SOLID, penWidth, RGB(10, 20, 30), NULL_BRUSH, 0));
+
+      double spans = fastest(5, [&]() {
+        for (const RECT& line : lines) {
+          target.line(line.left, line.top, line.right, line.bottom);
+        }
+      });
+
+      // A one pixel line shifted to every pixel of the square: the
+      // pixels stamping wrote.
+      target.setStyle(ShapeGraphic(PS_SOLID, 1, RGB(10, 20, 30), NULL_BRUSH, 0));
+      int before = (penWidth - 1) / 2;
+      int after = penWidth / 2;
+
+      double stamped = fastest(1, [&]() {
+        for (const RECT& line : lines) {
+          for (int i = -before; i <= after; ++i) {
+            for (int j = -before; j <= after; ++j) {
+              target.line(line.left + j, line.top + i, line.right + j, line.bottom + i);
+            }
+          }
+        }
+      });
+
+      std::printf("  width %2d      %6.1f   %6.1f     %5.1fx\n", penWidth,
+        spans / 1e6, stamped / 1e6, stamped / spans);
+    }
+  }
+
+  /// <summary>
+  /// SceneParser against the Tokeniser and stoi path file open used
+  /// before it, on scenes of 1k to 1M lines.
+  /// </summary>
+  void parsing() {
+    std::printf("parsing (ns per line)      legacy  SceneParser  speed-up\n");
+
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+
+    for (size_t lines : { 1000, 10000, 100000, 1000000 }) {
+      std::string text = sceneText(lines);
+      int runs = lines >= 1000000 ? 1 : 5;
+
+      double legacy = fastest(runs, [&]() {
+        std::istringstream in(text);
+        std::string buffer;
+        std::vector<std::shared_ptr<IShape>> shapes;
+
+        while (std::getline(in, buffer)) {
+          std::vector<std::string> tokens = Tokeniser::split(buffer, ": ");
+          shapes.push_back(factory->parse(tokens.at(0), tokens.at(1)));
+        }
+      });
+
+      double parser = fastest(runs, [&]() {
+        std::vector<std::shared_ptr<IShape>> shapes;
+        SceneParser::parse(text, shapes);
+      });
+
+      std::printf("  %8zu lines  %10.0f  %11.0f  %8.1f\n", lines,
+        legacy / lines, parser / lines, legacy / parser);
+    }
+  }
+
+  /// <summary>
+  /// A 1M line text scene file loaded on 1, 2, 4 ... threads, up to
+  /// one per core.
+  /// </summary>
+  void loading() {
+    std::printf("loading 1M lines (ms)   threads  time  speed-up\n");
+
+    std::wstring filePath = (std::filesystem::temp_directory_path() / L"paint-bench.txt").wstring();
+    std::ofstream(Platform::streamPath(filePath), std::ios::binary) << sceneText(1000000);
+
+    unsigned int cores = ParallelSceneLoader::defaultThreadCount();
+    double single = 0;
+
+    for (unsigned int threads = 1; ; threads = min(threads * 2, cores)) {
+      double time = fastest(3, [&]() {
+        std::vector<std::shared_ptr<IShape>> shapes;
+        ParallelSceneLoader::load(filePath, shapes, threads);
+      });
+
+      if (1 == threads) {
+        single = time;
+      }
+
+      std::printf("  %24u  %4.0f  %8.1f\n", threads, time / 1e6, single / time);
+
+      if (threads == cores) {
+        break;
+      }
+    }
+
+    DeleteFileW(filePath.c_str());
+  }
+
+  /// <summary>
+  /// Finding the shape type of a scene line: the factory's hash table
+  /// against the loop over prototypes and their type() strings it
+  /// replaced.
+  /// </summary>
+  void dispatch() {
+    std::printf("type dispatch (ns per line)   type() loop  find\n");
+
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+    std::vector<std::shared_ptr<IShape>> prototypes = {
+      std::make_shared<LineShape>(),
+      std::make_shared<RectangleShape>(),
+      std::make_shared<SquareShape>(),
+      std::make_shared<EllipseShape>(),
+      std::make_shared<CircleShape>()
+    };
+
+    // Names as they come out of the lines of a scene.
+    std::mt19937 random(5);
+    std::vector<std::string_view> names(100000);
+
+    for (std::string_view& name : names) {
+      name = factory->typeName((int)(random() % prototypes.size()));
+    }
+
+    int found = 0;
+
+    double loop = fastest(10, [&]() {
+      for (std::string_view name : names) {
+        for (size_t i = 0; i < prototypes.size(); ++i) {
+          if (prototypes[i]->type() == name) {
+            found += (int)i;
+            break;
+          }
+        }
+      }
+    });
+
+    double table = fastest(10, [&]() {
+      for (std::string_view name : names) {
+        found += factory->find(name);
+      }
+    });
+
+    std::printf("  %27.1f  %4.1f  (%d)\n", loop / names.size(), table / names.size(), found & 1);
+  }
+
+  /// <summary>
+  /// Saving 1M shapes: SceneWriter against toString into a text
+  /// stream, as file save did before it.
+  /// </summary>
+  void saving() {
+    std::printf("saving 1M shapes (ms)   toString  SceneWriter  speed-up\n");
+
+    std::vector<std::shared_ptr<IShape>> shapes;
+    SceneParser::parse(sceneText(1000000), shapes);
+
+    std::wstring filePath = (std::filesystem::temp_directory_path() / L"paint-bench.txt").wstring();
+
+    double stream = fastest(3, [&]() {
+      std::ofstream out(Platform::streamPath(filePath));
+
+      for (const std::shared_ptr<IShape>& shape : shapes) {
+        out << shape->toString() << '\n';
+      }
+    });
+
+    double writer = fastest(3, [&]() {
+      SceneWriter::save(filePath, shapes);
+    });
+
+    std::printf("  %31.0f  %11.0f  %8.1f\n", stream / 1e6, writer / 1e6, stream / writer);
+
+    DeleteFileW(filePath.c_str());
+  }
+
+  /// <summary>
+  /// Megapixels per second of each span kernel, by run length, over
+  /// runs in a 4 MB frame.
+  /// </summary>
+  void spans() {
+    std::printf("span kernels (Mpixel/s)   run   fill    blend    mask\n");
+
+    const size_t PIXELS = 1 << 20;
+    std::vector<uint32_t> pixels(PIXELS, 0xFF808080);
+    std::vector<uint8_t> coverage(PIXELS);
+
+    for (size_t i = 0; i < PIXELS; ++i) {
+      coverage[i] = (uint8_t)(i * 37);
+    }
+
+    for (const SpanKernels::Kernels* kernels : SpanKernels::available()) {
+      for (size_t run : { 16, 256, 4096 }) {
+        // Runs start one pixel apart from a vector boundary, as spans do.
+        auto perSecond = [&](auto&& kernel) {
+          double time = fastest(20, [&]() {
+            for (size_t start = 1; start + run <= PIXELS; start += run + 1) {
+              kernel(&pixels[start], run);
+            }
+          });
+
+          return (double)(PIXELS / (run + 1) * run) / time * 1e3;
+        };
+
+        double fill = perSecond([&](uint32_t* at, size_t count) {
+          kernels->fill(at, count, 0xFF204060);
+        });
+
+        double blend = perSecond([&](uint32_t* at, size_t count) {
+          kernels->blend(at, count, 0x80204060);
+        });
+
+        double mask = perSecond([&](uint32_t* at, size_t count) {
+          kernels->blendMask(at, &coverage[at - pixels.data()], count, 0xFF204060);
+        });
+
+        std::printf("  %-6s %17zu  %5.0f  %7.0f  %6.0f\n", kernels->name, run, fill, blend, mask);
+      }
+    }
+  }
+
+  /// <summary>
+  /// A 4K frame of 500k shapes: replayed in order on one thread, then
+  /// by TileRenderer on 1, 2, 4 ... threads, up to one per core.
+  /// </summary>
+  void tiles() {
+    std::printf("tiled 4K frame, 500k shapes (ms)   threads  time  speed-up\n");
+
+    const int width = 3840;
+    const int height = 2160;
+
+    DisplayList list;
+    list.sync(boardShapes(500000, width, height));
+
+    Framebuffer framebuffer(width, height, 0xFFFFFFFF);
+
+    double sequential = fastest(3, [&]() {
+      SoftwareRenderTarget target(framebuffer);
+      list.replay(target);
+    });
+
+    std::printf("  %-33s  %4.0f\n", "sequential", sequential / 1e6);
+
+    unsigned int cores = ParallelSceneLoader::defaultThreadCount();
+
+    for (unsigned int threads = 1; ; threads = min(threads * 2, cores)) {
+      TileRenderer renderer(threads);
+
+      double time = fastest(3, [&]() {
+        renderer.render(framebuffer, list, 0xFFFFFFFF);
+      });
+
+      std::printf("  %33u  %4.0f  %8.1f\n", threads, time / 1e6, sequential / time);
+
+      if (threads == cores) {
+        break;
+      }
+    }
+  }
+
+  /// <summary>
+  /// Dragging shapes over a full HD board of 2000: repainting the
+  /// whole frame on every mouse move against repainting the union of
+  /// the dragged shape's old and new bounds.
+  /// </summary>
+  void dirty() {
+    std::printf("dragging, 1000 moves      Mpixels    ms\n");
+
+    const int width = 1920;
+    const int height = 1080;
+
+    std::vector<std::shared_ptr<IShape>> shapes = boardShapes(2000, width, height);
+    DisplayList list;
+    list.sync(shapes);
+
+    Framebuffer framebuffer(width, height, 0xFFFFFFFF);
+    TileRenderer renderer(1);
+
+    for (bool whole : { true, false }) {
+      RenderStats stats;
+      std::mt19937 random(3);
+
+      double time = fastest(1, [&]() {
+        for (int move = 0; move < 1000; ++move) {
+          std::shared_ptr<IShape>& shape = shapes[random() % shapes.size()];
+          RECT before = shape->bounds();
+
+          shape->move((int)(random() % 21) - 10, (int)(random() % 21) - 10);
+          list.invalidate(shape.get());
+          list.sync(shapes);
+
+          RECT after = shape->bounds();
+          RECT area = { 0, 0, width, height };
+
+          if (!whole) {
+            area = { min(before.left, after.left), min(before.top, after.top),
+              max(before.right, after.right), max(before.bottom, after.bottom) };
+          }
+
+          stats.beginFrame();
+          stats.addArea(area);
+          renderer.render(framebuffer, list, 0xFFFFFFFF, area);
+        }
+      });
+
+      std::printf("  %-18s  %8.1f  %5.0f\n", whole ? "whole frame" : "dirty rectangle",
+        stats.totalPixels() / 1e6, time / 1e6);
+    }
+  }
+
+  /// <summary>
+  /// The display list of a 4K board of 500k shapes: recorded from the
+  /// shapes, synced again after one shape moved, saved, loaded back,
+  /// then replayed whole and culled to a quarter of the frame.
+  /// </summary>
+  void displayList() {
+    std::printf("display list, 500k shapes (ms)\n");
+
+    const int width = 3840;
+    const int height = 2160;
+
+    std::vector<std::shared_ptr<IShape>> shapes = boardShapes(500000, width, height);
+    std::wstring filePath = (std::filesystem::temp_directory_path() / L"paint-bench.psdl").wstring();
+
+    double record = fastest(3, [&]() {
+      DisplayList list;
+      list.sync(shapes);
+    });
+
+    DisplayList list;
+    list.sync(shapes);
+
+    double sync = fastest(3, [&]() {
+      shapes[shapes.size() / 2]->move(1, 1);
+      list.invalidate(shapes[shapes.size() / 2].get());
+      list.sync(shapes);
+    });
+
+    double save = fastest(3, [&]() {
+      list.save(filePath);
+    });
+
+    DisplayList loaded;
+    double load = fastest(3, [&]() {
+      loaded.load(filePath);
+    });
+
+    Framebuffer framebuffer(width, height, 0xFFFFFFFF);
+    SoftwareRenderTarget target(framebuffer);
+    size_t drawn = 0;
+
+    double replay = fastest(3, [&]() {
+      loaded.replay(target);
+    });
+
+    const RECT quarter = { 0, 0, width / 2, height / 2 };
+
+    double culled = fastest(3, [&]() {
+      drawn = loaded.replay(target, quarter);
+    });
+
+    std::printf("  %-28s  %6.1f\n", "record", record / 1e6);
+    std::printf("  %-28s  %6.1f\n", "sync after one move", sync / 1e6);
+    std::printf("  %-28s  %6.1f\n", "save", save / 1e6);
+    std::printf("  %-28s  %6.1f\n", "load", load / 1e6);
+    std::printf("  %-28s  %6.1f\n", "replay loaded list", replay / 1e6);
+    std::printf("  %-28s  %6.1f  (%zu of %zu drawn)\n", "replay a quarter, culled", culled / 1e6,
+      drawn, loaded.size());
+
+    DeleteFileW(filePath.c_str());
+  }
+
+  /// <summary>
+  /// A dense board of a million shapes seen at 1:4, most a few pixels
+  /// across on screen: frame time by detail size, and how far the
+  /// frame is from the one drawn in full.
+  /// </summary>
+  void detail() {
+    std::printf("1:4 4K frame, 1M shapes    ms  PSNR dB  differing %%\n");
+
+    const int width = 3840;
+    const int height = 2160;
+
+    DisplayList list;
+    list.sync(boardShapes(1000000, width * 4, height * 4));
+
+    Viewport viewport;
+    viewport.zoomAt(0, 0, Viewport::SCALE_ONE / 4);
+
+    TileRenderer renderer(1);
+    const RECT whole = { 0, 0, width, height };
+
+    Framebuffer full(width, height, 0);
+    renderer.render(full, list, 0xFFFFFFFF, whole, 0, viewport);
+
+    for (int size = 0; size <= 3; ++size) {
+      Framebuffer framebuffer(width, height, 0);
+      int detailSize = viewport.toDetailLength(size);
+
+      double time = fastest(3, [&]() {
+        renderer.render(framebuffer, list, 0xFFFFFFFF, whole, detailSize, viewport);
+      });
+
+      double squares = 0;
+      size_t differing = 0;
+
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          uint32_t first = full.pixel(x, y);
+          uint32_t second = framebuffer.pixel(x, y);
+
+          differing += first != second;
+
+          for (int shift = 0; shift < 24; shift += 8) {
+            double difference = (double)((first >> shift) & 0xFF) - ((second >> shift) & 0xFF);
+            squares += difference * difference;
+          }
+        }
+      }
+
+      double pixels = (double)width * height;
+      double psnr = squares > 0 ? 10 * std::log10(255.0 * 255.0 * 3 * pixels / squares) : INFINITY;
+
+      std::printf("  detail %d px  %13.0f  %7.1f  %11.2f\n", size, time / 1e6, psnr,
+        100.0 * differing / pixels);
+    }
+  }
+
+  /// <summary>
+  /// Selecting a shape on boards of 10k to 1M shapes, as busy as each
+  /// other: the scan over every shape against SpatialIndex, and the
+  /// time to build the index when a scene is loaded. A click also
+  /// raises the shape found to the top of shapesVector, which shifts
+  /// every shape above it: timed on its own.
+  /// </summary>
+  void selection() {
+    std::printf("selection (us per click)      build ms      scan  index   raise\n");
+
+    std::mt19937 random(6);
+
+    for (size_t count : { 10000, 100000, 1000000 }) {
+      int extent = (int)std::sqrt((double)count) * 40;
+      std::vector<std::shared_ptr<IShape>> shapes = boardShapes(count, extent, extent);
+
+      SpatialIndex index;
+      double build = fastest(3, [&]() {
+        index.rebuild(shapes);
+      });
+
+      std::vector<std::pair<Point, Point>> clicks;
+
+      for (int i = 0; i < 200; ++i) {
+        int x = (int)(random() % extent);
+        int y = (int)(random() % extent);
+        int size = 100 + (int)(random() % 300);
+        clicks.push_back({ Point(x, y), Point(x + size, y + size) });
+      }
+
+      int found = 0;
+
+      double scan = fastest(3, [&]() {
+        for (const std::pair<Point, Point>& click : clicks) {
+          for (int i = (int)shapes.size() - 1; i >= 0; --i) {
+            if (shapes[i]->in(click.first, click.second)) {
+              found += i;
+              break;
+            }
+          }
+        }
+      });
+
+      double indexed = fastest(3, [&]() {
+        for (const std::pair<Point, Point>& click : clicks) {
+          found += index.topmost(shapes, click.first, click.second);
+        }
+      });
+
+      // As the select handler does: erase, push back, raise in the index.
+      std::vector<int> selected;
+
+      for (const std::pair<Point, Point>& click : clicks) {
+        selected.push_back(index.topmost(shapes, click.first, click.second));
+      }
+
+      double raise = fastest(3, [&]() {
+        for (int i : selected) {
+          if (i >= 0) {
+            std::shared_ptr<IShape> shape = shapes[i];
+            shapes.erase(shapes.begin() + i);
+            shapes.push_back(shape);
+            index.raise(shape.get());
+          }
+        }
+      });
+
+      std::printf("  %8zu shapes  %10.1f  %8.1f  %5.1f  %6.1f  (%d)\n", count, build / 1e6,
+        scan / clicks.size() / 1e3, indexed / clicks.size() / 1e3,
+        raise / clicks.size() / 1e3, found & 1);
+    }
+  }
+
+  struct Section {
+    const char* name;
+    void (*run)();
+  };
+
+  const Section SECTIONS[] = {
+    { "ellipses", ellipses },
+    { "circles", circles },
+    { "longLines", longLines },
+    { "aa", aa },
+    { "dashes", dashes },
+    { "wideLines", wideLines },
+    { "parsing", parsing },
+    { "loading", loading },
+    { "dispatch", dispatch },
+    { "saving", saving },
+    { "spans", spans },
+    { "tiles", tiles },
+    { "dirty", dirty },
+    { "displayList", displayList },
+    { "detail", detail },
+    { "selection", selection },
+  };
+}
+
+/// <summary>
+/// Run the sections named on the command line, or all of them.
+/// </summary>
+int main(int argc, char* argv[]) {
+  for (const Section& section : SECTIONS) {
+    bool wanted = argc < 2;
+
+    for (int i = 1; i < argc; ++i) {
+      wanted = wanted || 0 == strcmp(argv[i], section.name);
+    }
+
+    if (wanted) {
+      section.run();
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,214 @@
+//
+// Cutting shapes far out of view down before they are drawn.
+//
+
+#include "Test.h"
+
+namespace {
+  const uint32_t WHITE = 0xFFFFFFFF;
+
+  /// <summary>
+  /// Every dash pattern repeats within this many pixels.
+  /// </summary>
+  const int64_t DASH_PERIOD = 24;
+
+  bool samePixels(const Framebuffer& first, const Framebuffer& second) {
+    return first.width() == second.width() && first.height() == second.height() &&
+      0 == memcmp(first.data(), second.data(),
+        (size_t)first.width() * first.height() * sizeof(uint32_t));
+  }
+}
+
+TEST(latticeCutKeepsTheLinesPixels) {
+  const int width = 160;
+  const int height = 120;
+  const int styles[] = { PS_SOLID, PS_DASH, PS_DOT, PS_DASHDOT, PS_DASHDOTDOT };
+
+  std::mt19937 random(24);
+  RECT box = { -40, -40, width + 40, height + 40 };
+  int cuts = 0;
+
+  for (int i = 0; i < 3000; ++i) {
+    // Across the frame along short slopes, on a whole pixel every few
+    // steps, and from far off into it with none until the ends.
+    int x = (int)(random() % width);
+    int y = (int)(random() % height);
+    int x1, y1, x2, y2;
+
+    if (i % 4 == 0) {
+      x1 = (int)(random() % (1 << 30)) - (1 << 29);
+      y1 = (int)(random() % (1 << 30)) - (1 << 29);
+      x2 = x;
+      y2 = y;
+    }
+
+    else {
+      int run = (int)(random() % 15) - 7;
+      int rise = (int)(random() % 15) - 7;
+      int before = (int)(random() % 100000);
+      int after = (int)(random() % 100000);
+
+      x1 = x - run * before;
+      y1 = y - rise * before;
+      x2 = x + run * after;
+      y2 = y + rise * after;
+    }
+
+    double enter, exit;
+
+    if (!Clipping::clipSegment(x1, y1, x2, y2,
+      box.left, box.top, box.right, box.bottom, enter, exit)) {
+      continue;
+    }
+
+    int64_t dx = (int64_t)x2 - x1;
+    int64_t dy = (int64_t)y2 - y1;
+    int64_t length = max(std::abs(dx), std::abs(dy));
+    int64_t from, to;
+
+    Clipping::latticeSteps(dx, dy, enter, exit, DASH_PERIOD, from, to);
+
+    // The part in the box is kept, whole periods from the start.
+    CHECK(from % DASH_PERIOD == 0);
+    CHECK(from <= enter * length && to >= exit * length);
+
+    int cutX1 = (int)(x1 + std::llround((double)dx * from / length));
+    int cutY1 = (int)(y1 + std::llround((double)dy * from / length));
+    int cutX2 = (int)(x1 + std::llround((double)dx * to / length));
+    int cutY2 = (int)(y1 + std::llround((double)dy * to / length));
+
+    // Both ends exactly on the line.
+    CHECK(((int64_t)cutX1 - x1) * dy == ((int64_t)cutY1 - y1) * dx);
+    CHECK(((int64_t)cutX2 - x1) * dy == ((int64_t)cutY2 - y1) * dx);
+
+    if (from > 0 || to < length) {
+      ++cuts;
+    }
+
+    ShapeGraphic graphic(styles[i % 5], 1, RGB(0, 0, 0), NULL_BRUSH, RGB(0, 0, 0));
+    Framebuffer whole(width, height, WHITE);
+    Framebuffer cut(width, height, WHITE);
+
+    {
+      SoftwareRenderTarget target(whole);
+      target.setStyle(graphic);
+      target.line(x1, y1, x2, y2);
+    }
+
+    SoftwareRenderTarget target(cut);
+    target.setStyle(graphic);
+    target.line(cutX1, cutY1, cutX2, cutY2);
+
+    // Cut ends are out of the box, or where the line ended anyway.
+    CHECK(samePixels(whole, cut));
+  }
+
+  CHECK(cuts > 1000);
+}
+
+TEST(outlineAroundTheBoxIsInsideTheEllipse) {
+  RECT box = { 0, 0, 100, 50 };
+
+  CHECK(Clipping::insideEllipse(box, -1000, -1000, 1100, 1050, 10));
+  CHECK(!Clipping::insideEllipse(box, 0, 0, 100, 50, 0));
+  CHECK(!Clipping::insideEllipse(box, 40, -1000, 60, 1050, 0));
+
+  // A circle of radius 80 round the centre of the box, whose corners
+  // are 55.9 from it: inside while the inset leaves more than that.
+  CHECK(Clipping::insideEllipse(box, -30, -55, 130, 105, 20));
+  CHECK(!Clipping::insideEllipse(box, -30, -55, 130, 105, 40));
+}
+
+TEST(linesToTheEndsOfIntDrawLikeShortOnes) {
+  const int width = 100;
+  const int height = 80;
+
+  // Through (50, 40) with a slope of 2 / 3, out to near INT_MIN and
+  // INT_MAX, or just past the frame: the same pixels in view.
+  const int far = 715827865;
+  const int near = 40;
+
+  for (int pen : { 1, 3 }) {
+    for (bool antialiasing : { false, true }) {
+      Framebuffer farLine(width, height, WHITE);
+      Framebuffer nearLine(width, height, WHITE);
+
+      for (Framebuffer* framebuffer : { &farLine, &nearLine }) {
+        int steps = framebuffer == &farLine ? far : near;
+        SoftwareRenderTarget target(*framebuffer);
+
+        target.setAntialiasing(antialiasing);
+        target.setStyle(ShapeGraphic(PS_SOLID, pen, RGB(0, 0, 0), NULL_BRUSH, RGB(0, 0, 0)));
+        target.line(50 - 3 * steps, 40 - 2 * steps, 50 + 3 * steps, 40 + 2 * steps);
+      }
+
+      CHECK(samePixels(farLine, nearLine));
+      CHECK(farLine.pixel(50, 40) != WHITE);
+    }
+  }
+
+  Framebuffer framebuffer(width, height, WHITE);
+  SoftwareRenderTarget target(framebuffer);
+
+  target.line(INT_MIN, INT_MIN, INT_MAX, INT_MAX);
+  target.line(INT_MIN, 20, INT_MAX, 20);
+
+  // The diagonal (INT_MIN and INT_MAX are the same distance from -1/2)
+  // and the row.
+  CHECK(framebuffer.pixel(30, 30) != WHITE || framebuffer.pixel(30, 31) != WHITE);
+  CHECK(framebuffer.pixel(70, 20) != WHITE);
+}
+
+TEST(farOffShapesTileLikeWholeDrawing) {
+  const int width = 320;
+  const int height = 240;
+
+  // Shapes from the canvas out to the ends of int.
+  std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+  std::vector<std::shared_ptr<IShape>> shapes;
+  std::mt19937 random(24);
+
+  for (int i = 0; i < 600; ++i) {
+    int64_t x = random() % width;
+    int64_t y = random() % height;
+    int64_t scale = (int64_t)1 << (random() % 32);
+    int64_t dx = ((int64_t)(random() % 200) - 100) * scale;
+    int64_t dy = ((int64_t)(random() % 200) - 100) * scale;
+
+    shapes.push_back(factory->create(
+      (int)(random() % Test::SHAPE_TYPES),
+      Point((int)x, (int)y),
+      Point(
+        (int)std::clamp(x + dx, (int64_t)INT_MIN, (int64_t)INT_MAX),
+        (int)std::clamp(y + dy, (int64_t)INT_MIN, (int64_t)INT_MAX)
+      ),
+      ShapeGraphic(
+        PS_SOLID + (int)(random() % 5),
+        1 + (random() % 3 == 0 ? (int)(random() % 9) : 0),
+        RGB(random() % 256, random() % 256, random() % 256),
+        random() % 2 ? DC_BRUSH : NULL_BRUSH,
+        RGB(random() % 256, random() % 256, random() % 256)
+      )
+    ));
+  }
+
+  DisplayList list;
+  list.sync(shapes);
+
+  for (bool antialiasing : { false, true }) {
+    Framebuffer sequential(width, height, WHITE);
+    Framebuffer tiled(width, height, 0);
+
+    {
+      SoftwareRenderTarget target(sequential);
+      target.setAntialiasing(antialiasing);
+      list.replay(target);
+    }
+
+    TileRenderer renderer(4);
+    renderer.setAntialiasing(antialiasing);
+    renderer.render(tiled, list, WHITE, RECT{ 0, 0, width, height });
+
+    CHECK(samePixels(sequential, tiled));
+  }
+}
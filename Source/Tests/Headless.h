@@ -0,0 +1,68 @@
+#pragma once
+
+//
+// The library headers that build without Windows, included the way
+// Paint.h includes them, for the tests and benchmarks. GDI, windows
+// and DIB sections (GdiRenderTarget, SceneLayer, Bitmap) are left out.
+//
+
+// C++ Libraries
+#include <fstream>
+#include <vector>
+#include <unordered_map>
+#include <typeindex>
+#include <typeinfo>
+#include <string>
+#include <sstream>
+#include <memory>
+#include <string_view>
+#include <charconv>
+#include <stdexcept>
+#include <cstdint>
+#include <climits>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <list>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <cstring>
+
+// SIMD intrinsics (x86 and x64 only)
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define PAINT_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// Library
+#include "Library/Platform.h"
+#include "Library/Tokeniser.h"
+#include "Library/ShapeGraphic.h"
+#include "Library/RenderTarget.h"
+#include "Library/Viewport.h"
+#include "Library/StyleCache.h"
+#include "Library/Clipping.h"
+#include "Library/SpanKernels.h"
+#include "Library/Framebuffer.h"
+#include "Library/DashPattern.h"
+#include "Library/SoftwareRenderTarget.h"
+#include "Library/Shapes.h"
+#include "Library/SpatialIndex.h"
+#include "Library/SceneParser.h"
+#include "Library/SceneWriter.h"
+#include "Library/MappedFile.h"
+#include "Library/ParallelSceneLoader.h"
+#include "Library/BinaryScene.h"
+#include "Library/CompactScene.h"
+#include "Library/SceneJournal.h"
+#include "Library/PagedScene.h"
+#include "Library/SceneSnapshot.h"
+#include "Library/BackgroundSaver.h"
+#include "Library/DisplayList.h"
+#include "Library/TileRenderer.h"
+#include "Library/RenderStats.h"
+#include "Library/Geometric.h"
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Headless.h"
+
+//
+// Aliased ellipses drawn the plain way, a square root per row, to check
+// and time the software renderer's integer midpoint kernel against.
+//
+
+namespace ReferenceEllipse {
+  /// <summary>
+  /// Ends of row y of an ellipse, both inclusive.
+  /// </summary>
+  /// <returns>False if the row misses the ellipse.</returns>
+  inline bool row(double cx, double cy, double rx, double ry, int64_t y,
+    int64_t& left, int64_t& right) {
+    if (rx < 0 || ry < 0) {
+      return false;
+    }
+
+    double dy = y - cy;
+
+    if (dy < -ry || dy > ry) {
+      return false;
+    }
+
+    double half = ry > 0 ? rx * std::sqrt(max(0.0, 1.0 - (dy / ry) * (dy / ry))) : rx;
+
+    left = (int64_t)std::ceil(cx - half - 1e-9);
+    right = (int64_t)std::floor(cx + half + 1e-9);
+
+    return left <= right;
+  }
+
+  /// <summary>
+  /// Ellipse in a box (right and bottom excluded), as GDI draws it with
+  /// a solid pen: the inside filled, then the pen on both sides of it.
+  /// </summary>
+  /// <param name="framebuffer"></param>
+  /// <param name="clip">Right and bottom excluded.</param>
+  /// <param name="penWidth">0 for no pen.</param>
+  /// <param name="pen">Pixel value of the pen.</param>
+  /// <param name="hasBrush"></param>
+  /// <param name="brush">Pixel value of the brush.</param>
+  inline void draw(Framebuffer& framebuffer, const RECT& clip,
+    int x1, int y1, int x2, int y2,
+    int penWidth, uint32_t pen, bool hasBrush, uint32_t brush) {
+    int64_t left = min(x1, x2), top = min(y1, y2);
+    int64_t right = max(x1, x2) - 1, bottom = max(y1, y2) - 1;
+
+    if (left > right || top > bottom) {
+      return;
+    }
+
+    int64_t clipLeft = max((int64_t)clip.left, (int64_t)0);
+    int64_t clipTop = max((int64_t)clip.top, (int64_t)0);
+    int64_t clipRight = min((int64_t)clip.right, (int64_t)framebuffer.width());
+    int64_t clipBottom = min((int64_t)clip.bottom, (int64_t)framebuffer.height());
+
+    auto span = [&](int64_t y, int64_t from, int64_t to, uint32_t colour) {
+      from = max(from, clipLeft);
+      to = min(to, clipRight - 1);
+
+      if (y >= clipTop && y < clipBottom && from <= to) {
+        framebuffer.fillSpan((int)from, (int)y, (int)(to - from + 1), colour);
+      }
+    };
+
+    double cx = (left + right) / 2.0;
+    double cy = (top + bottom) / 2.0;
+    double rx = (right - left + 1) / 2.0;
+    double ry = (bottom - top + 1) / 2.0;
+
+    double outside = penWidth > 0 ? (penWidth - 1) / 2 : 0;
+    double inside = penWidth > 0 ? penWidth / 2 + 1 : 0;
+
+    int64_t first = max((int64_t)std::floor(cy - ry - outside), clipTop);
+    int64_t last = min((int64_t)std::ceil(cy + ry + outside), clipBottom - 1);
+
+    for (int64_t y = first; y <= last; ++y) {
+      int64_t innerLeft = 0, innerRight = 0;
+      bool hasInner = row(cx, cy, rx - inside, ry - inside, y, innerLeft, innerRight);
+
+      if (hasInner && hasBrush) {
+        span(y, innerLeft, innerRight, brush);
+      }
+
+      int64_t outerLeft = 0, outerRight = 0;
+
+      if (0 == penWidth || !row(cx, cy, rx + outside, ry + outside, y, outerLeft, outerRight)) {
+        continue;
+      }
+
+      if (hasInner) {
+        span(y, outerLeft, innerLeft - 1, pen);
+        span(y, innerRight + 1, outerRight, pen);
+      }
+
+      else {
+        span(y, outerLeft, outerRight, pen);
+      }
+    }
+  }
+}
@@ -0,0 +1,779 @@
+//
+// Pixels drawn by the software renderer.
+//
+
+#include "Test.h"
+#include "ReferenceEllipse.h"
+
+namespace {
+  const uint32_t WHITE = 0xFFFFFFFF;
+  const uint32_t BLACK = Framebuffer::toPixel(RGB(0, 0, 0));
+
+  bool samePixels(const Framebuffer& first, const Framebuffer& second) {
+    return first.width() == second.width() && first.height() == second.height() &&
+      0 == memcmp(first.data(), second.data(),
+        (size_t)first.width() * first.height() * sizeof(uint32_t));
+  }
+
+  /// <summary>
+  /// How much black was blended over a white pixel, 0 to 255.
+  /// </summary>
+  int darkness(const Framebuffer& framebuffer, int x, int y) {
+    return 255 - (int)(framebuffer.pixel(x, y) & 0xFF);
+  }
+}
+
+TEST(thinLineExcludesItsEndPoint) {
+  Framebuffer framebuffer(16, 8, WHITE);
+  SoftwareRenderTarget target(framebuffer);
+
+  target.line(2, 5, 10, 5);
+
+  for (int x = 0; x < 16; ++x) {
+    CHECK(framebuffer.pixel(x, 5) == (x >= 2 && x < 10 ? BLACK : WHITE));
+    CHECK(framebuffer.pixel(x, 4) == WHITE);
+  }
+}
+
+TEST(rectangleHasOutlineAndFill) {
+  Framebuffer framebuffer(16, 16, WHITE);
+  SoftwareRenderTarget target(framebuffer);
+  uint32_t fill = Framebuffer::toPixel(RGB(0, 128, 255));
+
+  target.setStyle(ShapeGraphic(PS_SOLID, 1, RGB(0, 0, 0), DC_BRUSH, RGB(0, 128, 255)));
+  target.rectangle(2, 3, 12, 10);
+
+  // Outline on the first and last row and column (right and bottom
+  // excluded), brush inside, nothing outside.
+  CHECK(framebuffer.pixel(2, 3) == BLACK);
+  CHECK(framebuffer.pixel(11, 3) == BLACK);
+  CHECK(framebuffer.pixel(2, 9) == BLACK);
+  CHECK(framebuffer.pixel(11, 9) == BLACK);
+  CHECK(framebuffer.pixel(6, 3) == BLACK);
+  CHECK(framebuffer.pixel(2, 6) == BLACK);
+  CHECK(framebuffer.pixel(3, 4) == fill);
+  CHECK(framebuffer.pixel(10, 8) == fill);
+  CHECK(framebuffer.pixel(12, 6) == WHITE);
+  CHECK(framebuffer.pixel(6, 10) == WHITE);
+  CHECK(framebuffer.pixel(1, 2) == WHITE);
+}
+
+TEST(clippedDrawingMatchesWholeDrawing) {
+  const int width = 300;
+  const int height = 200;
+
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(10, 400, width, height);
+  DisplayList list;
+  list.sync(shapes);
+
+  for (bool antialiasing : { false, true }) {
+    Framebuffer whole(width, height, WHITE);
+    Framebuffer pieces(width, height, WHITE);
+
+    {
+      SoftwareRenderTarget target(whole);
+      target.setAntialiasing(antialiasing);
+      list.replay(target);
+    }
+
+    // Odd sized pieces, so clip edges cut through every kind of shape.
+    SoftwareRenderTarget target(pieces);
+    target.setAntialiasing(antialiasing);
+
+    for (int top = 0; top < height; top += 37) {
+      for (int left = 0; left < width; left += 41) {
+        target.setClip(left, top, left + 41, top + 37);
+        list.replay(target);
+      }
+    }
+
+    CHECK(samePixels(whole, pieces));
+  }
+}
+
+TEST(tiledRenderMatchesSequentialRender) {
+  const int width = 640;
+  const int height = 480;
+
+  // Enough commands for the renderer to use several threads.
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(11, 3000, width, height);
+  DisplayList list;
+  list.sync(shapes);
+
+  for (bool antialiasing : { false, true }) {
+    Framebuffer sequential(width, height, WHITE);
+
+    {
+      SoftwareRenderTarget target(sequential);
+      target.setAntialiasing(antialiasing);
+      list.replay(target);
+    }
+
+    // One thread, a few, and more than there are cores.
+    for (unsigned int threads : { 1, 3, 16 }) {
+      Framebuffer tiled(width, height, 0);
+
+      TileRenderer renderer(threads);
+      renderer.setAntialiasing(antialiasing);
+      renderer.render(tiled, list, WHITE, RECT{ 0, 0, width, height });
+
+      CHECK(samePixels(sequential, tiled));
+    }
+  }
+}
+
+TEST(tiledRenderOfAnAreaLeavesTheRestAlone) {
+  const int width = 400;
+  const int height = 300;
+  const RECT area = { 70, 45, 333, 250 };
+
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(12, 2000, width, height);
+  DisplayList list;
+  list.sync(shapes);
+
+  Framebuffer sequential(width, height, WHITE);
+
+  {
+    SoftwareRenderTarget target(sequential);
+    list.replay(target);
+  }
+
+  const uint32_t untouched = 0xFF123456;
+  Framebuffer tiled(width, height, untouched);
+
+  TileRenderer renderer(4);
+  renderer.render(tiled, list, WHITE, area);
+
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      bool inside = x >= area.left && x < area.right && y >= area.top && y < area.bottom;
+      CHECK(tiled.pixel(x, y) == (inside ? sequential.pixel(x, y) : untouched));
+    }
+  }
+}
+
+TEST(antialiasedEllipseMatchesGoldenImage) {
+  // A 13 by 9 ellipse outlined with a one pixel pen: how dark each
+  // pixel is, in hex.
+  const char* const golden[] = {
+    "00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00",
+    "00 00 00 0B 44 82 C1 EF C1 82 44 0B 00 00 00 00",
+    "00 00 4F EA C7 84 42 11 42 84 C7 EA 4F 00 00 00",
+    "00 46 E4 30 00 00 00 00 00 00 00 30 E4 46 00 00",
+    "00 CA 4B 00 00 00 00 00 00 00 00 00 4B CA 00 00",
+    "00 FA 07 00 00 00 00 00 00 00 00 00 07 FA 00 00",
+    "00 CA 4B 00 00 00 00 00 00 00 00 00 4B CA 00 00",
+    "00 46 E4 30 00 00 00 00 00 00 00 30 E4 46 00 00",
+    "00 00 4F EA C7 84 42 11 42 84 C7 EA 4F 00 00 00",
+    "00 00 00 0B 44 82 C1 EF C1 82 44 0B 00 00 00 00",
+    "00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00",
+    "00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00",
+  };
+
+  Framebuffer framebuffer(16, 12, WHITE);
+  SoftwareRenderTarget target(framebuffer);
+
+  target.setAntialiasing(true);
+  target.ellipse(1, 1, 14, 10);
+
+  for (int y = 0; y < 12; ++y) {
+    for (int x = 0; x < 16; ++x) {
+      CHECK(darkness(framebuffer, x, y) == (int)strtol(golden[y] + 3 * x, NULL, 16));
+    }
+  }
+}
+
+TEST(antialiasedEllipseCoversItsArea) {
+  const double pi = 3.14159265358979;
+
+  for (int width : { 57, 200, 641 }) {
+    int height = width * 2 / 3;
+    Framebuffer framebuffer(width + 4, height + 4, WHITE);
+    SoftwareRenderTarget target(framebuffer);
+
+    target.setAntialiasing(true);
+    target.setStyle(ShapeGraphic(PS_SOLID, 1, RGB(0, 0, 0), DC_BRUSH, RGB(0, 0, 0)));
+    target.ellipse(2, 2, 2 + width, 2 + height);
+
+    double covered = 0;
+
+    for (int y = 0; y < height + 4; ++y) {
+      for (int x = 0; x < width + 4; ++x) {
+        covered += darkness(framebuffer, x, y) / 255.0;
+      }
+    }
+
+    // Within a percent of the area of the box's inscribed ellipse.
+    double area = pi * width * height / 4;
+    CHECK(std::abs(covered - area) < area / 100);
+  }
+}
+
+TEST(ellipseIsSymmetric) {
+  const int size = 64;
+
+  // Odd and even sizes (a centre on a pixel or between two), with
+  // and without a brush, thin and wide pens, aliased or not.
+  for (int width : { 31, 40 }) {
+    for (int height : { 17, 26 }) {
+      for (int brush : { NULL_BRUSH, DC_BRUSH }) {
+        for (int pen : { 1, 4 }) {
+          for (bool antialiasing : { false, true }) {
+            Framebuffer framebuffer(size, size, WHITE);
+            SoftwareRenderTarget target(framebuffer);
+
+            target.setAntialiasing(antialiasing);
+            target.setStyle(ShapeGraphic(PS_SOLID, pen, RGB(0, 0, 0), brush, RGB(90, 90, 90)));
+            target.ellipse(10, 12, 10 + width, 12 + height);
+
+            // Column x mirrors column 10 + (10 + width) - 1 - x, rows alike.
+            for (int y = 0; y < size; ++y) {
+              for (int x = 0; x < size; ++x) {
+                int mirrorX = 19 + width - x;
+                int mirrorY = 23 + height - y;
+
+                if (mirrorX >= 0 && mirrorX < size && mirrorY >= 0 && mirrorY < size) {
+                  CHECK(framebuffer.pixel(x, y) == framebuffer.pixel(mirrorX, y));
+                  CHECK(framebuffer.pixel(x, y) == framebuffer.pixel(x, mirrorY));
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(everyShapeDrawsInsideItsBounds) {
+  const int width = 200;
+  const int height = 160;
+
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(13, 300, width, height);
+
+  for (bool antialiasing : { false, true }) {
+    for (const std::shared_ptr<IShape>& shape : shapes) {
+      Framebuffer framebuffer(width, height, WHITE);
+      SoftwareRenderTarget target(framebuffer);
+      target.setAntialiasing(antialiasing);
+      shape->draw(target);
+
+      RECT bounds = shape->bounds();
+
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          if (x < bounds.left || x >= bounds.right || y < bounds.top || y >= bounds.bottom) {
+            CHECK(framebuffer.pixel(x, y) == WHITE);
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(dirtyRectanglesRepaintLikeFullFrames) {
+  const int width = 640;
+  const int height = 480;
+  const RECT whole = { 0, 0, width, height };
+
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(14, 1500, width, height);
+  std::mt19937 random(14);
+
+  auto unite = [](const RECT& first, const RECT& second) {
+    return RECT{ min(first.left, second.left), min(first.top, second.top),
+      max(first.right, second.right), max(first.bottom, second.bottom) };
+  };
+
+  for (bool antialiasing : { false, true }) {
+    DisplayList list;
+    list.sync(shapes);
+
+    TileRenderer renderer(2);
+    renderer.setAntialiasing(antialiasing);
+
+    Framebuffer partial(width, height, 0);
+    renderer.render(partial, list, WHITE, whole);
+
+    RenderStats stats;
+    const int steps = 300;
+
+    // A replayed interaction: drag a shape, paste a copy on top of
+    // everything, delete one; repaint only the bounds that changed.
+    for (int step = 0; step < steps; ++step) {
+      size_t index = random() % shapes.size();
+      RECT dirty;
+
+      switch (step % 3) {
+      case 0: {
+        RECT before = shapes[index]->bounds();
+        shapes[index]->move((int)(random() % 41) - 20, (int)(random() % 41) - 20);
+        list.invalidate(shapes[index].get());
+        dirty = unite(before, shapes[index]->bounds());
+        break;
+      }
+
+      case 1:
+        shapes.push_back(shapes[index]->cloneShape());
+        shapes.back()->move(15, 15);
+        dirty = shapes.back()->bounds();
+        break;
+
+      default:
+        dirty = shapes[index]->bounds();
+        shapes.erase(shapes.begin() + index);
+        break;
+      }
+
+      list.sync(shapes);
+      stats.beginFrame();
+      stats.addArea(dirty);
+      renderer.render(partial, list, WHITE, dirty);
+
+      if (step % 50 == 49) {
+        Framebuffer full(width, height, 0);
+        renderer.render(full, list, WHITE, whole);
+
+        CHECK(samePixels(full, partial));
+      }
+    }
+
+    // Shapes are at most about 60 pixels across: a small part of the
+    // frame each time.
+    CHECK(stats.frames() == (uint64_t)steps);
+    CHECK(stats.totalPixels() * 20 < (uint64_t)steps * width * height);
+  }
+}
+
+TEST(incrementalSyncMatchesRecordingAgain) {
+  const int width = 400;
+  const int height = 300;
+
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(16, 2000, width, height);
+  std::vector<std::shared_ptr<IShape>> added = Test::randomShapes(17, 100, width, height);
+  std::mt19937 random(16);
+
+  DisplayList list;
+  list.sync(shapes);
+
+  for (int step = 0; step < 300; ++step) {
+    size_t index = random() % shapes.size();
+
+    // Insert anywhere, move in place, delete, raise to the top.
+    switch (step % 4) {
+    case 0:
+      shapes.insert(shapes.begin() + index, added[step % added.size()]->cloneShape());
+      break;
+    case 1:
+      shapes[index]->move((int)(random() % 41) - 20, (int)(random() % 41) - 20);
+      list.invalidate(shapes[index].get());
+      break;
+    case 2:
+      shapes.erase(shapes.begin() + index);
+      break;
+    default: {
+      std::shared_ptr<IShape> raised = shapes[index];
+      shapes.erase(shapes.begin() + index);
+      shapes.push_back(raised);
+      break;
+    }
+    }
+
+    list.sync(shapes);
+
+    if (step % 30 != 29) {
+      continue;
+    }
+
+    DisplayList recorded;
+    recorded.sync(shapes);
+
+    CHECK(list.size() == recorded.size());
+
+    // Style tables may be in another order: compare what they hold.
+    for (size_t i = 0; i < list.size() && i < recorded.size(); ++i) {
+      const DisplayList::Command& first = list.commands()[i];
+      const DisplayList::Command& second = recorded.commands()[i];
+
+      CHECK(first.opcode == second.opcode && first.extent == second.extent &&
+        first.x1 == second.x1 && first.y1 == second.y1 &&
+        first.x2 == second.x2 && first.y2 == second.y2);
+      CHECK(list.style(first) == recorded.style(second));
+      CHECK(0 == memcmp(&list.bounds(i), &recorded.bounds(i), sizeof(RECT)));
+    }
+
+    Framebuffer incremental(width, height, WHITE);
+    SoftwareRenderTarget incrementalTarget(incremental);
+    list.replay(incrementalTarget);
+
+    Framebuffer again(width, height, WHITE);
+    SoftwareRenderTarget againTarget(again);
+    recorded.replay(againTarget);
+
+    CHECK(samePixels(incremental, again));
+  }
+}
+
+TEST(renderStatsCountDrawnAndCulledCommands) {
+  std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+  std::vector<std::shared_ptr<IShape>> shapes;
+  ShapeGraphic graphic(PS_SOLID, 1, RGB(0, 0, 0), DC_BRUSH, RGB(255, 0, 0));
+
+  // Nine squares on a 500 x 500 board, one command each, and two lines
+  // across it.
+  for (int row = 0; row < 3; ++row) {
+    for (int column = 0; column < 3; ++column) {
+      shapes.push_back(factory->create(Test::RECTANGLE,
+        Point(column * 200, row * 200), Point(column * 200 + 20, row * 200 + 20), graphic));
+    }
+  }
+
+  shapes.push_back(factory->create(Test::LINE, Point(-1000, 100), Point(1000, 100), graphic));
+  shapes.push_back(factory->create(Test::LINE, Point(-1000, 450), Point(1000, 450), graphic));
+
+  DisplayList list;
+  list.sync(shapes);
+  CHECK(list.size() == 11);
+
+  // The top left 300 x 300: four squares and the first line.
+  const RECT area = { 0, 0, 300, 300 };
+  const RECT whole = { 0, 0, 500, 500 };
+  Framebuffer framebuffer(500, 500, WHITE);
+
+  {
+    SoftwareRenderTarget target(framebuffer);
+    RenderStats stats;
+
+    stats.beginFrame();
+    stats.addArea(area);
+
+    size_t drawn = list.replay(target, area);
+    stats.addShapes(drawn, list.size() - drawn);
+
+    CHECK(stats.frameDrawn() == 5);
+    CHECK(stats.frameCulled() == 6);
+    CHECK(stats.framePixels() == 300 * 300);
+  }
+
+  // The tiled renderer counts the same, one tile or many.
+  for (unsigned int threads : { 1, 4 }) {
+    TileRenderer renderer(threads);
+    RenderStats stats;
+
+    for (const RECT& rendered : { area, whole }) {
+      stats.beginFrame();
+      stats.addArea(rendered);
+
+      renderer.render(framebuffer, list, WHITE, rendered);
+      stats.addShapes(renderer.drawnCount(), list.size() - renderer.drawnCount());
+    }
+
+    CHECK(stats.frames() == 2);
+    CHECK(stats.frameDrawn() == 11);
+    CHECK(stats.frameCulled() == 0);
+    CHECK(stats.framePixels() == 500 * 500);
+    CHECK(stats.totalPixels() == 300 * 300 + 500 * 500);
+
+    stats.reset();
+    stats.beginFrame();
+    renderer.render(framebuffer, list, WHITE, area);
+    stats.addShapes(renderer.drawnCount(), list.size() - renderer.drawnCount());
+
+    CHECK(stats.frameDrawn() == 5);
+    CHECK(stats.frameCulled() == 6);
+  }
+}
+
+TEST(levelOfDetailOnlyChangesTinyCommands) {
+  const int width = 320;
+  const int height = 240;
+  const RECT whole = { 0, 0, width, height };
+
+  std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(18, 300, width, height);
+  std::mt19937 random(18);
+
+  // A dense scatter of shapes a few pixels across among the others.
+  for (const std::shared_ptr<IShape>& shape : Test::randomShapes(19, 3000, width, height)) {
+    Point first = shape->firstPoint();
+
+    shapes.insert(shapes.begin() + random() % shapes.size(), factory->create(
+      (int)(random() % Test::SHAPE_TYPES),
+      first,
+      Point(first.x() + (int)(random() % 5), first.y() + (int)(random() % 5)),
+      shape->graphic()
+    ));
+  }
+
+  DisplayList list;
+  list.sync(shapes);
+
+  for (bool antialiasing : { false, true }) {
+    TileRenderer renderer(2);
+    renderer.setAntialiasing(antialiasing);
+
+    Framebuffer sequential(width, height, WHITE);
+    SoftwareRenderTarget target(sequential);
+    target.setAntialiasing(antialiasing);
+    list.replay(target);
+
+    // Detail 0 draws every command in full.
+    Framebuffer full(width, height, 0);
+    renderer.render(full, list, WHITE, whole, 0);
+
+    CHECK(samePixels(full, sequential));
+
+    for (int detailSize = 1; detailSize <= 3; ++detailSize) {
+      Framebuffer detailed(width, height, 0);
+      renderer.render(detailed, list, WHITE, whole, detailSize);
+
+      // Pixels may only change where a command drawn as a dot reaches.
+      std::vector<bool> tiny((size_t)width * height, false);
+
+      for (size_t i = 0; i < list.size(); ++i) {
+        int extent = list.commands()[i].extent;
+
+        if (extent > 0 && extent <= detailSize) {
+          const RECT& bounds = list.bounds(i);
+
+          for (int y = max((int)bounds.top, 0); y < min((int)bounds.bottom, height); ++y) {
+            for (int x = max((int)bounds.left, 0); x < min((int)bounds.right, width); ++x) {
+              tiny[(size_t)y * width + x] = true;
+            }
+          }
+        }
+      }
+
+      int changed = 0;
+
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          if (detailed.pixel(x, y) != full.pixel(x, y)) {
+            CHECK(tiny[(size_t)y * width + x]);
+            ++changed;
+          }
+        }
+      }
+
+      CHECK(changed > 0);
+    }
+  }
+
+  // The view maps the detail size to the document only while zoomed out.
+  Viewport viewport;
+  CHECK(0 == viewport.toDetailLength(2));
+
+  viewport.zoomAt(0, 0, Viewport::SCALE_ONE / 4);
+  CHECK(8 == viewport.toDetailLength(2));
+
+  viewport.zoomAt(0, 0, Viewport::SCALE_ONE * 4);
+  CHECK(0 == viewport.toDetailLength(2));
+}
+
+TEST(dashWalkMatchesPatternPixelByPixel) {
+  for (int style : { PS_SOLID, PS_DASH, PS_DOT, PS_DASHDOT, PS_DASHDOTDOT }) {
+    const DashPattern& dash = DashPattern::of(style);
+
+    for (int phase = 0; phase < dash.period(); ++phase) {
+      for (int64_t count : { 0, 1, 2, 5, 23, 24, 25, 100 }) {
+        std::vector<bool> walked;
+
+        int after = dash.walk(phase, count, [&](int64_t offset, int64_t length, bool on) {
+          CHECK(offset == (int64_t)walked.size());
+          CHECK(length > 0);
+          walked.insert(walked.end(), (size_t)length, on);
+        });
+
+        // The same pixels, one table step at a time.
+        int step = phase;
+
+        CHECK(walked.size() == (size_t)count);
+
+        for (size_t i = 0; i < walked.size(); ++i) {
+          CHECK(walked[i] == dash.isOn(step));
+          step = dash.next(step);
+        }
+
+        CHECK(after == step);
+        CHECK(after == dash.advance(phase, count));
+      }
+    }
+  }
+}
+
+TEST(dashesRunOnAlongLinesAndRoundRectangles) {
+  const uint32_t RED = Framebuffer::toPixel(RGB(255, 0, 0));
+
+  for (int style : { PS_DASH, PS_DOT, PS_DASHDOT, PS_DASHDOTDOT }) {
+    const DashPattern& dash = DashPattern::of(style);
+    Framebuffer framebuffer(120, 80, BLACK);
+    SoftwareRenderTarget target(framebuffer);
+
+    target.setStyle(ShapeGraphic(style, 1, RGB(255, 0, 0), NULL_BRUSH, 0));
+    target.line(3, 70, 110, 70);
+    target.rectangle(2, 3, 50, 40);
+
+    // Gaps are painted white, over the black background.
+    auto expected = [&](int64_t step) {
+      return dash.isOn(dash.advance(0, step)) ? RED : WHITE;
+    };
+
+    for (int x = 3; x < 110; ++x) {
+      CHECK(framebuffer.pixel(x, 70) == expected(x - 3));
+    }
+
+    // Clockwise from the top left corner, the pattern going on round
+    // the corners.
+    std::vector<std::pair<int, int>> outline;
+
+    for (int x = 2; x <= 49; ++x) outline.emplace_back(x, 3);
+    for (int y = 4; y <= 39; ++y) outline.emplace_back(49, y);
+    for (int x = 48; x >= 2; --x) outline.emplace_back(x, 39);
+    for (int y = 38; y >= 4; --y) outline.emplace_back(2, y);
+
+    for (size_t i = 0; i < outline.size(); ++i) {
+      CHECK(framebuffer.pixel(outline[i].first, outline[i].second) == expected((int64_t)i));
+    }
+  }
+}
+
+TEST(dashedEllipseCoversTheSolidOutline) {
+  for (int style : { PS_DASH, PS_DOT, PS_DASHDOT, PS_DASHDOTDOT }) {
+    const DashPattern& dash = DashPattern::of(style);
+    int period = dash.period();
+    int on = 0;
+
+    for (int phase = 0; phase < period; ++phase) {
+      on += dash.isOn(phase);
+    }
+
+    for (bool antialiasing : { false, true }) {
+      Framebuffer solid(200, 150, 0);
+      Framebuffer dashed(200, 150, 0);
+
+      {
+        SoftwareRenderTarget target(solid);
+        target.setStyle(ShapeGraphic(PS_SOLID, 1, RGB(255, 0, 0), NULL_BRUSH, 0));
+        target.ellipse(10, 12, 187, 139);
+      }
+
+      SoftwareRenderTarget target(dashed);
+      target.setAntialiasing(antialiasing);
+      target.setStyle(ShapeGraphic(style, 1, RGB(255, 0, 0), NULL_BRUSH, 0));
+      target.ellipse(10, 12, 187, 139);
+
+      // Dashes and gaps land on the pixels of the solid outline, and
+      // in the pattern's proportion.
+      int outline = 0;
+      int dashes = 0;
+
+      for (int y = 0; y < 150; ++y) {
+        for (int x = 0; x < 200; ++x) {
+          CHECK((0 != solid.pixel(x, y)) == (0 != dashed.pixel(x, y)));
+          if (0 != solid.pixel(x, y)) {
+            ++outline;
+            dashes += dashed.pixel(x, y) == solid.pixel(x, y);
+          }
+        }
+      }
+
+      CHECK(std::abs((double)dashes / outline - (double)on / period) < 0.05);
+    }
+  }
+}
+
+TEST(wideLineCoversTheStampedSquares) {
+  const int width = 160;
+  const int height = 120;
+  std::mt19937 random(21);
+
+  for (int i = 0; i < 4000; ++i) {
+    int penWidth = 2 + (int)(random() % 12);
+    int x1 = (int)(random() % 260) - 50, y1 = (int)(random() % 220) - 50;
+    int x2 = (int)(random() % 260) - 50, y2 = (int)(random() % 220) - 50;
+
+    RECT clip;
+    clip.left = (LONG)(random() % width);
+    clip.top = (LONG)(random() % height);
+    clip.right = clip.left + 1 + (LONG)(random() % (width - clip.left));
+    clip.bottom = clip.top + 1 + (LONG)(random() % (height - clip.top));
+
+    Framebuffer spans(width, height, WHITE);
+    SoftwareRenderTarget target(spans);
+    target.setStyle(ShapeGraphic(PS_SOLID, penWidth, RGB(0, 0, 0), NULL_BRUSH, 0));
+    target.setClip(clip.left, clip.top, clip.right, clip.bottom);
+    target.line(x1, y1, x2, y2);
+
+    // A square of the pen width on every step of the thin line.
+    Framebuffer stamped(width, height, WHITE);
+    int before = (penWidth - 1) / 2;
+    int after = penWidth / 2;
+    int x = x1, y = y1;
+    int dx = std::abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+    int dy = -std::abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+    int error = dx + dy;
+
+    while (x != x2 || y != y2) {
+      int left = max(x - before, (int)clip.left);
+      int right = min(x + after, (int)clip.right - 1);
+
+      for (int row = max(y - before, (int)clip.top); row <= min(y + after, (int)clip.bottom - 1); ++row) {
+        if (left <= right) {
+          stamped.fillSpan(left, row, right - left + 1, BLACK);
+        }
+      }
+
+      int doubled = 2 * error;
+
+      if (doubled >= dy) {
+        error += dy;
+        x += sx;
+      }
+
+      if (doubled <= dx) {
+        error += dx;
+        y += sy;
+      }
+    }
+
+    CHECK(samePixels(spans, stamped));
+  }
+}
+
+TEST(midpointEllipseMatchesSquareRootRows) {
+  const int size = 160;
+  std::mt19937 random(22);
+
+  // Odd and even, round and flat, degenerate boxes; every pen width
+  // GDI grows inwards and outwards, with and without pen and brush,
+  // through random clips.
+  for (int i = 0; i < 6000; ++i) {
+    int width = 1 + (int)(random() % (i < 3000 ? 12 : 140));
+    int height = random() % 8 ? 1 + (int)(random() % (i < 3000 ? 12 : 140)) : width;
+    int left = (int)(random() % size) - width / 2;
+    int top = (int)(random() % size) - height / 2;
+    int penWidth = (int)(random() % 7);
+    bool hasBrush = 0 == random() % 2 || 0 == penWidth;
+
+    RECT clip = { 0, 0, size, size };
+
+    if (random() % 2) {
+      clip.left = (LONG)(random() % size);
+      clip.top = (LONG)(random() % size);
+      clip.right = clip.left + 1 + (LONG)(random() % size);
+      clip.bottom = clip.top + 1 + (LONG)(random() % size);
+    }
+
+    Framebuffer expected(size, size, WHITE);
+    ReferenceEllipse::draw(expected, clip, left, top, left + width, top + height,
+      penWidth, BLACK, hasBrush, Framebuffer::toPixel(RGB(0, 0, 255)));
+
+    Framebuffer actual(size, size, WHITE);
+    SoftwareRenderTarget target(actual);
+    target.setClip(clip.left, clip.top, clip.right, clip.bottom);
+    target.setStyle(ShapeGraphic(penWidth ? PS_SOLID : PS_NULL, penWidth, RGB(0, 0, 0),
+      hasBrush ? DC_BRUSH : NULL_BRUSH, RGB(0, 0, 255)));
+    target.ellipse(left, top, left + width, top + height);
+
+    CHECK(samePixels(expected, actual));
+  }
+}
@@ -0,0 +1,610 @@
+//
+// Saving and loading scenes.
+//
+
+#include "Test.h"
+
+#include <future>
+
+namespace {
+  /// <summary>
+  /// Shapes as text scene lines, to compare scenes.
+  /// </summary>
+  std::string describe(const std::vector<std::shared_ptr<IShape>>& shapes) {
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+    std::string text;
+
+    for (const std::shared_ptr<IShape>& shape : shapes) {
+      SceneWriter::format(*factory, *shape, text);
+      text += '\n';
+    }
+
+    return text;
+  }
+
+  /// <summary>
+  /// Load a scene in the format its content tells.
+  /// </summary>
+  std::vector<std::shared_ptr<IShape>> loadScene(const std::wstring& filePath) {
+    std::vector<std::shared_ptr<IShape>> shapes;
+
+    if (BinaryScene::isBinaryFile(filePath)) {
+      BinaryScene::load(filePath, shapes);
+    }
+
+    else if (CompactScene::isCompactFile(filePath)) {
+      CompactScene::load(filePath, shapes);
+    }
+
+    else {
+      ParallelSceneLoader::load(filePath, shapes);
+    }
+
+    return shapes;
+  }
+
+  std::string readBytes(const std::wstring& filePath) {
+    std::ifstream in(Platform::streamPath(filePath), std::ios::binary);
+
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  bool exists(const std::wstring& filePath) {
+    return std::ifstream(Platform::streamPath(filePath)).good();
+  }
+
+  void touch(const std::wstring& filePath) {
+    std::ofstream(Platform::streamPath(filePath)) << "\n";
+  }
+
+  /// <summary>
+  /// Render the part of a document a viewport shows, as the scene
+  /// layer does.
+  /// </summary>
+  void renderView(Framebuffer& framebuffer, const std::vector<std::shared_ptr<IShape>>& shapes,
+    const Viewport& viewport) {
+    DisplayList list;
+    list.sync(shapes);
+
+    TileRenderer renderer(1);
+    renderer.render(framebuffer, list, 0xFFFFFFFF,
+      RECT{ 0, 0, framebuffer.width(), framebuffer.height() }, 0, viewport);
+  }
+}
+
+TEST(writerMatchesToStringByteForByte) {
+  // Past the writer's flush size, and the ends of every field.
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(6, 60000, 100000, 100000);
+  std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+
+  for (int type = 0; type < Test::SHAPE_TYPES; ++type) {
+    shapes.push_back(factory->create(type, Point(INT_MIN, INT_MAX), Point(-1, 0),
+      ShapeGraphic(PS_DASHDOTDOT, INT_MAX, RGB(255, 255, 255), NULL_BRUSH, 0)));
+  }
+
+  std::wstring writerPath = Test::tempPath(L"writer.txt");
+  std::wstring streamPath = Test::tempPath(L"stream.txt");
+
+  SceneWriter::save(writerPath, shapes);
+
+  {
+    // As file save wrote scenes before SceneWriter.
+    std::ofstream out(Platform::streamPath(streamPath));
+
+    for (const std::shared_ptr<IShape>& shape : shapes) {
+      out << shape->toString() << '\n';
+    }
+  }
+
+  std::string written = readBytes(writerPath);
+  CHECK(written.size() > (2 << 20));
+  CHECK(written == readBytes(streamPath));
+
+  DeleteFileW(writerPath.c_str());
+  DeleteFileW(streamPath.c_str());
+}
+
+TEST(backgroundSaveWritesTheSceneAsItWas) {
+  for (const wchar_t* extension : { L".txt", L".psb", L".psz" }) {
+    std::wstring filePath = Test::tempPath(std::wstring(L"saver") + extension);
+    std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(9, 50000, 4000, 4000);
+    std::string expected = describe(shapes);
+
+    // The worker is held until the document has changed under it.
+    std::promise<void> edited;
+    std::shared_future<void> gate = edited.get_future().share();
+
+    BackgroundSaver saver;
+    saver.start(NULL, filePath,
+      [snapshot = SceneSnapshot(NULL, shapes), gate](const std::wstring& tempPath) {
+      gate.wait();
+      snapshot.write(tempPath);
+    }, false);
+
+    std::vector<std::shared_ptr<IShape>> added = Test::randomShapes(10, 64, 4000, 4000);
+
+    for (size_t edit = 0; edit < 3000; ++edit) {
+      shapes.push_back(added[edit % added.size()]->cloneShape());
+      shapes[edit % shapes.size()]->move(3, -2);
+
+      if (edit % 3 == 0) {
+        shapes.erase(shapes.begin());
+      }
+    }
+
+    CHECK(saver.isBusy() && !saver.isDone());
+    CHECK(describe(shapes) != expected);
+
+    edited.set_value();
+    saver.finish();
+
+    CHECK(!saver.isBusy());
+    CHECK(describe(loadScene(filePath)) == expected);
+
+    // The temporary copy was moved over the file.
+    std::filesystem::path path(filePath);
+    CHECK(!exists((path.parent_path() / (L"~" + path.filename().wstring())).wstring()));
+
+    DeleteFileW(filePath.c_str());
+  }
+}
+
+TEST(saveDropsJournalAndAutosaveButAutosaveDoesNot) {
+  std::wstring filePath = Test::tempPath(L"autosave.txt");
+  std::wstring journalPath = SceneJournal::journalPath(filePath);
+  std::wstring autosavePath = BackgroundSaver::autosavePath(filePath);
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(12, 100, 500, 500);
+
+  touch(filePath);
+  touch(journalPath);
+
+  BackgroundSaver saver;
+  saver.start(NULL, autosavePath, SceneSnapshot(NULL, shapes), true);
+  saver.finish();
+
+  CHECK(saver.isAutosave());
+  CHECK(exists(journalPath));
+  CHECK(describe(loadScene(autosavePath)) == describe(shapes));
+
+  saver.start(NULL, filePath, SceneSnapshot(NULL, shapes), false);
+  saver.finish();
+
+  CHECK(!exists(journalPath));
+  CHECK(!exists(autosavePath));
+  CHECK(describe(loadScene(filePath)) == describe(shapes));
+
+  DeleteFileW(filePath.c_str());
+}
+
+TEST(newerAutosaveIsOfferedBackOnOpen) {
+  std::wstring filePath = Test::tempPath(L"recover.txt");
+  std::wstring autosavePath = BackgroundSaver::autosavePath(filePath);
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(19, 200, 500, 500);
+  std::string saved = describe(shapes);
+
+  BackgroundSaver saver;
+  saver.start(NULL, filePath, SceneSnapshot(NULL, shapes), false);
+  saver.finish();
+
+  CHECK(!BackgroundSaver::hasNewerAutosave(filePath));
+
+  // Edits autosaved, then the program closed without saving.
+  shapes.erase(shapes.begin(), shapes.begin() + 50);
+  shapes.push_back(shapes.back()->cloneShape());
+  shapes.back()->move(7, 7);
+
+  saver.start(NULL, autosavePath, SceneSnapshot(NULL, shapes), true);
+  saver.finish();
+
+  // File times may be too coarse to tell the two apart: set them.
+  std::filesystem::file_time_type autosaved = std::filesystem::last_write_time(autosavePath);
+  std::filesystem::last_write_time(filePath, autosaved - std::chrono::hours(1));
+
+  // Opening the file offers the autosave, which holds the edits.
+  CHECK(BackgroundSaver::hasNewerAutosave(filePath));
+  CHECK(describe(loadScene(autosavePath)) == describe(shapes));
+  CHECK(describe(loadScene(filePath)) == saved);
+
+  // The file written again since, by another program: not offered.
+  std::filesystem::last_write_time(filePath, autosaved + std::chrono::hours(1));
+  CHECK(!BackgroundSaver::hasNewerAutosave(filePath));
+
+  // The file gone: the autosave is all there is.
+  DeleteFileW(filePath.c_str());
+  CHECK(BackgroundSaver::hasNewerAutosave(filePath));
+
+  // The recovered scene saved back drops its autosave.
+  saver.start(NULL, filePath, SceneSnapshot(NULL, loadScene(autosavePath)), false);
+  saver.finish();
+
+  CHECK(!exists(autosavePath));
+  CHECK(!BackgroundSaver::hasNewerAutosave(filePath));
+  CHECK(describe(loadScene(filePath)) == describe(shapes));
+
+  DeleteFileW(filePath.c_str());
+}
+
+TEST(failedSaveIsReported) {
+  std::wstring filePath = Test::tempPath(L"missing-directory/scene.txt");
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(13, 10, 100, 100);
+
+  BackgroundSaver saver;
+  saver.start(NULL, filePath, SceneSnapshot(NULL, shapes), false);
+
+  CHECK_THROWS(saver.finish());
+  CHECK(!saver.isBusy());
+}
+
+TEST(binarySceneRoundTripsAndRejectsOtherVersions) {
+  std::wstring filePath = Test::tempPath(L"binary.psb");
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(14, 5000, 3000, 3000);
+
+  BinaryScene::save(filePath, shapes);
+  CHECK(describe(loadScene(filePath)) == describe(shapes));
+
+  {
+    MappedFile file(filePath);
+    const BinaryScene::Header* header = BinaryScene::validate(file);
+    CHECK(header->version == BinaryScene::VERSION);
+
+    // Every record is in its tiles' buckets, or the large shapes'.
+    const BinaryScene::TileIndex* tiles = BinaryScene::tileIndex(file);
+    CHECK(tiles->entryCount >= header->shapeCount);
+  }
+
+  // Version 1 is the only one.
+  std::string bytes = readBytes(filePath);
+
+  for (uint32_t version : { 0u, 2u, 3u }) {
+    memcpy(&bytes[offsetof(BinaryScene::Header, version)], &version, sizeof(version));
+    std::ofstream(Platform::streamPath(filePath), std::ios::binary) << bytes;
+
+    std::vector<std::shared_ptr<IShape>> loaded;
+    CHECK_THROWS(BinaryScene::load(filePath, loaded));
+  }
+
+  DeleteFileW(filePath.c_str());
+}
+
+TEST(compactSceneRoundTrips) {
+  std::wstring filePath = Test::tempPath(L"compact.psz");
+  std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+
+  // Deltas from one shape to the next up to the whole range of int.
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(28, 5000, 3000, 3000);
+
+  for (int type = 0; type < Test::SHAPE_TYPES; ++type) {
+    shapes.push_back(factory->create(type, Point(INT_MIN, INT_MAX), Point(INT_MAX, INT_MIN),
+      ShapeGraphic(PS_DASHDOTDOT, INT_MAX, RGB(255, 255, 255), NULL_BRUSH, 0)));
+    shapes.push_back(factory->create(type, Point(INT_MAX, INT_MIN), Point(0, 0),
+      ShapeGraphic(PS_SOLID, 1, 0, DC_BRUSH, RGB(255, 255, 255))));
+  }
+
+  CompactScene::save(filePath, shapes);
+  CHECK(CompactScene::isCompactFile(filePath));
+  CHECK(describe(loadScene(filePath)) == describe(shapes));
+
+  // Cut short, it is not taken for a shorter scene.
+  std::string bytes = readBytes(filePath);
+  bytes.resize(bytes.size() / 2);
+  std::ofstream(Platform::streamPath(filePath), std::ios::binary) << bytes;
+
+  std::vector<std::shared_ptr<IShape>> loaded;
+  CHECK_THROWS(CompactScene::load(filePath, loaded));
+
+  DeleteFileW(filePath.c_str());
+}
+
+TEST(journalReplaysEditsOntoItsSnapshot) {
+  std::wstring filePath = Test::tempPath(L"journal.txt");
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(15, 2000, 1000, 1000);
+  std::vector<std::shared_ptr<IShape>> added = Test::randomShapes(16, 50, 1000, 1000);
+
+  SceneWriter::save(filePath, shapes);
+
+  SceneJournal journal;
+  journal.attach(filePath);
+
+  std::mt19937 random(15);
+  size_t records = 0;
+
+  // Edits as the controllers record them, applied to the document too;
+  // flushed now and then, as every save does.
+  for (int edit = 0; edit < 400; ++edit) {
+    switch (random() % 4) {
+    case 0: {
+      std::shared_ptr<IShape> shape = added[random() % added.size()]->cloneShape();
+      shapes.push_back(shape);
+      journal.recordCreate(*shape);
+      break;
+    }
+    case 1: {
+      int dx = (int)(random() % 21) - 10, dy = (int)(random() % 21) - 10;
+      shapes.back()->move(dx, dy);
+      journal.recordMove(dx, dy);
+      break;
+    }
+    case 2:
+      shapes.pop_back();
+      journal.recordDelete();
+      break;
+    default: {
+      size_t index = random() % shapes.size();
+      std::shared_ptr<IShape> raised = shapes[index];
+      shapes.erase(shapes.begin() + index);
+      shapes.push_back(raised);
+      journal.recordRaise(index);
+      break;
+    }
+    }
+
+    ++records;
+
+    if (edit % 50 == 49) {
+      journal.flush();
+      CHECK(!journal.hasPending());
+    }
+  }
+
+  journal.flush();
+
+  std::vector<std::shared_ptr<IShape>> loaded = loadScene(filePath);
+  CHECK(SceneJournal::replay(filePath, loaded) == records);
+  CHECK(describe(loaded) == describe(shapes));
+
+  // A new snapshot drops the journal.
+  journal.reset();
+  CHECK(!exists(SceneJournal::journalPath(filePath)));
+
+  DeleteFileW(filePath.c_str());
+}
+
+TEST(staleJournalIsDroppedAndDeleted) {
+  std::wstring filePath = Test::tempPath(L"stale.txt");
+  std::wstring journalPath = SceneJournal::journalPath(filePath);
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(17, 300, 1000, 1000);
+
+  SceneWriter::save(filePath, shapes);
+
+  SceneJournal journal;
+  journal.attach(filePath);
+  journal.recordDelete();
+  journal.flush();
+
+  // The snapshot rewritten behind the journal's back, to the same
+  // size: one digit changed.
+  std::string bytes = readBytes(filePath);
+  size_t digit = bytes.find_first_of("0123456789");
+  bytes[digit] = bytes[digit] == '1' ? '2' : '1';
+  std::ofstream(Platform::streamPath(filePath), std::ios::binary) << bytes;
+
+  std::vector<std::shared_ptr<IShape>> loaded = loadScene(filePath);
+  std::string before = describe(loaded);
+
+  CHECK(0 == SceneJournal::replay(filePath, loaded));
+  CHECK(describe(loaded) == before);
+  CHECK(!exists(journalPath));
+
+  // A journal without a stamp is dropped the same way.
+  std::ofstream(Platform::streamPath(journalPath), std::ios::binary) << "d\n";
+
+  CHECK(0 == SceneJournal::replay(filePath, loaded));
+  CHECK(describe(loaded) == before);
+  CHECK(!exists(journalPath));
+
+  DeleteFileW(filePath.c_str());
+}
+
+TEST(corruptJournalRecordThrows) {
+  std::wstring filePath = Test::tempPath(L"corrupt.txt");
+  std::wstring journalPath = SceneJournal::journalPath(filePath);
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(18, 20, 1000, 1000);
+
+  SceneWriter::save(filePath, shapes);
+
+  for (const char* record : { "m 3 x", "m", "r 20", "r -1", "q 1", "+ hexagon: 1, 2" }) {
+    SceneJournal journal;
+    journal.attach(filePath);
+    journal.recordMove(1, 1);
+    journal.flush();
+
+    std::ofstream(Platform::streamPath(journalPath), std::ios::binary | std::ios::app)
+      << record << '\n';
+
+    std::vector<std::shared_ptr<IShape>> loaded = loadScene(filePath);
+    CHECK_THROWS(SceneJournal::replay(filePath, loaded));
+
+    DeleteFileW(journalPath.c_str());
+  }
+
+  // Edits past the start of the scene.
+  SceneJournal journal;
+  journal.attach(filePath);
+
+  for (size_t i = 0; i <= shapes.size(); ++i) {
+    journal.recordDelete();
+  }
+
+  journal.recordMove(1, 1);
+  journal.flush();
+
+  std::vector<std::shared_ptr<IShape>> loaded = loadScene(filePath);
+  CHECK_THROWS(SceneJournal::replay(filePath, loaded));
+
+  DeleteFileW(journalPath.c_str());
+  DeleteFileW(filePath.c_str());
+}
+
+TEST(journalNeedsCompactionPastHalfTheScene) {
+  std::wstring filePath = Test::tempPath(L"compaction.txt");
+  SceneJournal journal;
+
+  // Nothing is recorded unattached.
+  journal.recordDelete();
+  CHECK(!journal.hasPending());
+
+  // Small scenes: not before 1024 records, pending or written.
+  journal.attach(filePath, 1000);
+  CHECK(!journal.needsCompaction(100));
+
+  for (int i = 0; i < 23; ++i) {
+    journal.recordMove(1, 0);
+  }
+
+  CHECK(!journal.needsCompaction(100));
+  journal.recordMove(1, 0);
+  CHECK(journal.needsCompaction(100));
+
+  // Big scenes: once the records reach half the shapes.
+  CHECK(!journal.needsCompaction(2050));
+  CHECK(journal.needsCompaction(2048));
+
+  // A fresh snapshot starts the count over.
+  journal.reset();
+  CHECK(!journal.needsCompaction(0));
+}
+
+TEST(pagedOpenRendersAndSelectsLikeFullLoad) {
+  std::wstring filePath = Test::tempPath(L"paged.psb");
+  std::wstring copyPath = Test::tempPath(L"paged-copy.txt");
+  std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+
+  // Some shapes span the board, to fill the bucket of large shapes.
+  std::vector<std::shared_ptr<IShape>> full = Test::randomShapes(27, 30000, 6000, 6000);
+  ShapeGraphic graphic(PS_SOLID, 2, RGB(0, 0, 255), NULL_BRUSH, 0);
+
+  for (int i = 0; i < 40; ++i) {
+    full.insert(full.begin() + i * 700, factory->create(i % Test::SHAPE_TYPES,
+      Point(i * 10, i * 20), Point(6000 - i * 30, 5000 + i * 5), graphic));
+  }
+
+  BinaryScene::save(filePath, full);
+
+  // A budget of a few tiles, so they are dropped and decoded again.
+  std::shared_ptr<PagedScene> paged = std::make_shared<PagedScene>(filePath,
+    2000 * PagedScene::BYTES_PER_SHAPE);
+  std::vector<std::shared_ptr<IShape>> above;
+  SpatialIndex aboveIndex;
+  SpatialIndex fullIndex;
+  fullIndex.rebuild(full);
+
+  SceneJournal journal;
+  journal.attach(filePath);
+
+  auto checkView = [&](int x, int y) {
+    Viewport viewport;
+    viewport.pan(-x, -y);
+
+    // The paged layer around the view, then the shapes above it.
+    RECT area = { -256, -256, 400 + 256, 300 + 256 };
+    std::vector<std::shared_ptr<IShape>> shown = paged->visible(viewport.toDocument(area));
+    shown.insert(shown.end(), above.begin(), above.end());
+
+    Framebuffer expected(400, 300, 0);
+    Framebuffer actual(400, 300, 0);
+    renderView(expected, full, viewport);
+    renderView(actual, shown, viewport);
+
+    CHECK(0 == memcmp(expected.data(), actual.data(), 400 * 300 * sizeof(uint32_t)));
+  };
+
+  std::mt19937 random(27);
+
+  for (int step = 0; step < 600; ++step) {
+    int x = (int)(random() % 6200) - 100;
+    int y = (int)(random() % 6200) - 100;
+    int size = (int)(random() % (0 == random() % 30 ? 7000 : 150));
+    Point topLeft(x, y), rightBottom(x + size, y + size);
+
+    // Selection over the full load, as the controllers make it.
+    int i = fullIndex.topmost(full, topLeft, rightBottom);
+
+    if (i >= 0) {
+      std::shared_ptr<IShape> selected = full[i];
+      full.erase(full.begin() + i);
+      full.push_back(selected);
+      fullIndex.raise(selected.get());
+    }
+
+    // And over the paged one: above it first, then taken from it.
+    int64_t position = -1;
+    int j = aboveIndex.topmost(above, topLeft, rightBottom);
+
+    if (j >= 0) {
+      position = (int64_t)(paged->shapeCount() + j);
+
+      std::shared_ptr<IShape> selected = above[j];
+      above.erase(above.begin() + j);
+      above.push_back(selected);
+      aboveIndex.raise(selected.get());
+    }
+
+    else {
+      int64_t record = paged->topmost(topLeft, rightBottom);
+
+      if (record >= 0) {
+        position = (int64_t)paged->positionOf((uint32_t)record);
+        above.push_back(paged->take((uint32_t)record));
+        aboveIndex.insert(above.back().get());
+      }
+    }
+
+    CHECK(position == i);
+
+    if (i < 0) {
+      continue;
+    }
+
+    CHECK(full.back()->toString() == above.back()->toString());
+    journal.recordRaise((size_t)i);
+
+    // Then move or delete it on both.
+    if (0 == step % 3) {
+      full.back()->move(15, -7);
+      fullIndex.update(full.back().get());
+      above.back()->move(15, -7);
+      aboveIndex.update(above.back().get());
+      journal.recordMove(15, -7);
+    }
+
+    else if (1 == step % 7) {
+      fullIndex.remove(full.back().get());
+      full.pop_back();
+      aboveIndex.remove(above.back().get());
+      above.pop_back();
+      journal.recordDelete();
+    }
+
+    if (0 == step % 20) {
+      checkView(x - 200, y - 150);
+    }
+  }
+
+  CHECK(paged->shapeCount() + above.size() == full.size());
+  CHECK(!paged->taken().empty());
+
+  // The journal counts positions in the whole document.
+  journal.flush();
+
+  std::vector<std::shared_ptr<IShape>> replayed = loadScene(filePath);
+  SceneJournal::replay(filePath, replayed);
+  CHECK(describe(replayed) == describe(full));
+
+  // Saved elsewhere, and over the file the layer still maps.
+  SceneSnapshot(paged, above).write(copyPath);
+  CHECK(describe(loadScene(copyPath)) == describe(full));
+
+  BackgroundSaver saver;
+  saver.start(NULL, filePath, SceneSnapshot(paged, above), false);
+  saver.finish();
+
+  CHECK(describe(loadScene(filePath)) == describe(full));
+  CHECK(!exists(SceneJournal::journalPath(filePath)));
+
+  // The layer still shows the document it was opened with.
+  checkView(1000, 1000);
+
+  paged.reset();
+  DeleteFileW(filePath.c_str());
+  DeleteFileW(copyPath.c_str());
+}
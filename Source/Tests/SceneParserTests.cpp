@@ -0,0 +1,277 @@
+//
+// Reading text scene lines.
+//
+
+#include "Test.h"
+
+namespace {
+  /// <summary>
+  /// Parse a line the way file open did before SceneParser: split on
+  /// ": ", then through each shape's parse (Tokeniser and stoi).
+  /// </summary>
+  std::shared_ptr<IShape> legacyParse(const std::string& line) {
+    std::vector<std::string> tokens = Tokeniser::split(line, ": ");
+
+    return ShapeFactory::getInstance()->parse(tokens.at(0), tokens.at(1));
+  }
+
+  /// <summary>
+  /// A kind of shape the factory does not know of until registered.
+  /// </summary>
+  class FrameShape : public RectangleShape {
+  public:
+    FrameShape() {
+    }
+
+    FrameShape(const Point& topLeft, const Point& rightBottom,
+      const ShapeGraphic& graphic) : RectangleShape(topLeft, rightBottom, graphic) {
+    }
+
+    std::string type() override {
+      return "frame";
+    }
+
+    std::shared_ptr<IShape> createShape(const Point& topLeft,
+      const Point& rightBottom, const ShapeGraphic& graphic) override {
+      return std::make_shared<FrameShape>(topLeft, rightBottom, graphic);
+    }
+  };
+
+  /// <summary>
+  /// A kind of shape never registered.
+  /// </summary>
+  class SketchShape : public RectangleShape {
+  public:
+    SketchShape() {
+    }
+
+    SketchShape(const Point& topLeft, const Point& rightBottom,
+      const ShapeGraphic& graphic) : RectangleShape(topLeft, rightBottom, graphic) {
+    }
+
+    std::string type() override {
+      return "sketch";
+    }
+
+    std::shared_ptr<IShape> createShape(const Point& topLeft,
+      const Point& rightBottom, const ShapeGraphic& graphic) override {
+      return std::make_shared<SketchShape>(topLeft, rightBottom, graphic);
+    }
+  };
+
+  /// <summary>
+  /// Makes rectangles rather than shapes of its own type.
+  /// </summary>
+  class BrokenShape : public RectangleShape {
+  public:
+    std::string type() override {
+      return "broken";
+    }
+  };
+
+  /// <summary>
+  /// Text scene of the shapes, one per line.
+  /// </summary>
+  std::string sceneText(const std::vector<std::shared_ptr<IShape>>& shapes) {
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+    std::string text;
+
+    for (const std::shared_ptr<IShape>& shape : shapes) {
+      SceneWriter::format(*factory, *shape, text);
+      text += '\n';
+    }
+
+    return text;
+  }
+
+  /// <summary>
+  /// Line of the error parsing a buffer gives, 0 if it parses.
+  /// </summary>
+  size_t errorLine(const std::string& buffer, unsigned int threadCount) {
+    std::vector<std::shared_ptr<IShape>> shapes;
+
+    try {
+      ParallelSceneLoader::parse(buffer, shapes, threadCount);
+    }
+
+    catch (const SceneParseError& error) {
+      return error.line();
+    }
+
+    return 0;
+  }
+
+  /// <summary>
+  /// Column of the error a line gives, 0 if it parses.
+  /// </summary>
+  size_t errorColumn(const std::string& line) {
+    try {
+      SceneParser::parseLine(line);
+    }
+
+    catch (const SceneParseError& error) {
+      return error.column();
+    }
+
+    return 0;
+  }
+}
+
+TEST(parserMatchesLegacyParse) {
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(1, 2000, 100000, 100000);
+
+  for (const std::shared_ptr<IShape>& shape : shapes) {
+    std::string line = shape->toString();
+
+    CHECK(SceneParser::parseLine(line)->toString() == line);
+    CHECK(legacyParse(line)->toString() == line);
+  }
+
+  // Whole range of int, and a CRLF line ending.
+  std::string extremes = "rectangle: -2147483648,2147483647 0,-1 4,9,16777215,5,0";
+  CHECK(SceneParser::parseLine(extremes + "\r")->toString() == extremes);
+}
+
+TEST(malformedLinesReportLineAndColumn) {
+  CHECK(errorColumn("line 1,2 3,4 0,1,0,5,0") == 1);
+  CHECK(errorColumn("triangle: 1,2 3,4 0,1,0,5,0") == 1);
+  CHECK(errorColumn("line: 1,2 3,4 0,1,0,5") == 22);
+  CHECK(errorColumn("line: 1,x 3,4 0,1,0,5,0") == 9);
+  CHECK(errorColumn("line: 1,2  3,4 0,1,0,5,0") == 11);
+  CHECK(errorColumn("line: 1,2 3,4 0,1,0,5,0 ") == 24);
+  CHECK(errorColumn("line: 1,2 3,99999999999 0,1,0,5,0") == 13);
+
+  // Line numbers count empty lines too.
+  std::string buffer =
+    "line: 1,2 3,4 0,1,0,5,0\n"
+    "\n"
+    "ellipse: 1,2 3,4 0,1,0,5,0\r\n"
+    "ellipse: 1,2 3,4 0,1,0,5\n";
+  std::vector<std::shared_ptr<IShape>> shapes;
+  size_t line = 0;
+
+  try {
+    SceneParser::parse(buffer, shapes);
+  }
+
+  catch (const SceneParseError& error) {
+    line = error.line();
+  }
+
+  CHECK(4 == line);
+  CHECK(2 == shapes.size());
+}
+
+TEST(rejectsNumbersStoiAccepted) {
+  // stoi skipped leading white space (spaces split the fields, but not
+  // tabs), took a '+' and stopped at the first character that was not
+  // a digit; the parser takes digits (and a '-') only.
+  const char* const lines[] = {
+    "line: 1,\t2 3,4 0,1,0,5,0",
+    "line: +1,2 3,4 0,1,0,5,0",
+    "line: 1,2 3,4 0,+1,0,5,0",
+    "line: 1,2 3,4 0,1,0x10,5,0",
+    "line: 1,2 3,4 0,1,0,5,0.5",
+  };
+
+  for (const char* line : lines) {
+    CHECK(legacyParse(line) != NULL);
+    CHECK_THROWS(SceneParser::parseLine(line));
+  }
+}
+
+TEST(parallelParseMatchesSequentialParse) {
+  // Past the size parsed on one thread, with empty and CRLF lines.
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(3, 40000, 100000, 100000);
+  std::string text = sceneText(shapes);
+
+  text.insert(text.find('\n', text.size() / 3), "\n");
+  text.insert(text.find('\n', text.size() / 2), "\r");
+  CHECK(text.size() > ParallelSceneLoader::MIN_PARALLEL_SIZE);
+
+  std::vector<std::shared_ptr<IShape>> sequential;
+  SceneParser::parse(text, sequential);
+  CHECK(sceneText(sequential) == sceneText(shapes));
+
+  for (unsigned int threads : { 2, 3, 8, 64 }) {
+    std::vector<std::shared_ptr<IShape>> parallel;
+    ParallelSceneLoader::parse(text, parallel, threads);
+
+    CHECK(sceneText(parallel) == sceneText(shapes));
+  }
+}
+
+TEST(parallelParseReportsTheFirstErrorsLine) {
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(4, 40000, 100000, 100000);
+  std::string text = sceneText(shapes);
+
+  // Break lines 29000 and 35000 (1-based), after an empty line 101.
+  auto lineStart = [&](size_t line) {
+    size_t position = 0;
+
+    for (size_t i = 1; i < line; ++i) {
+      position = text.find('\n', position) + 1;
+    }
+
+    return position;
+  };
+
+  text.insert(lineStart(35000), "x");
+  text.insert(lineStart(29000), "x");
+  text.insert(lineStart(101), "\n");
+
+  CHECK(29001 == errorLine(text, 1));
+
+  for (unsigned int threads : { 2, 3, 8, 64 }) {
+    CHECK(29001 == errorLine(text, threads));
+  }
+}
+
+TEST(findResolvesEveryTypeName) {
+  std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+
+  for (int tag = 0; tag < factory->prototypeSize(); ++tag) {
+    CHECK(factory->find(factory->typeName(tag)) == tag);
+  }
+
+  CHECK(factory->find("line") == Test::LINE);
+  CHECK(factory->find("circle") == Test::CIRCLE);
+
+  for (const char* name : { "", "lin", "lines", "Line", "line:", "triangle" }) {
+    CHECK(factory->find(name) < 0);
+  }
+}
+
+TEST(registeredShapeIsReadAndWritten) {
+  std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+  int tag = factory->registerShape(std::make_shared<FrameShape>());
+
+  CHECK(factory->find("frame") == tag);
+  CHECK_THROWS(factory->registerShape(std::make_shared<FrameShape>()));
+
+  std::string line = "frame: 1,2 30,40 0,1,255,5,65280";
+  std::shared_ptr<IShape> shape = SceneParser::parseLine(line);
+
+  CHECK(factory->tagOf(*shape) == tag);
+  CHECK(sceneText({ shape }) == line + "\n");
+
+  // The shapes known before keep their tags.
+  CHECK(factory->find("circle") == Test::CIRCLE);
+}
+
+TEST(unregisteredShapeIsRefused) {
+  std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+  SketchShape sketch(Point(1, 2), Point(30, 40), ShapeGraphic(PS_SOLID, 1, 0, NULL_BRUSH, 0));
+  std::string text;
+
+  CHECK_THROWS(factory->tagOf(sketch));
+  CHECK_THROWS(SceneWriter::format(*factory, sketch, text));
+  CHECK_THROWS(factory->typeName(-1));
+  CHECK_THROWS(factory->typeName(factory->prototypeSize()));
+
+  // Shapes which do not make their own type back from two points.
+  int size = factory->prototypeSize();
+  CHECK_THROWS(factory->registerShape(std::make_shared<BrokenShape>()));
+  CHECK(factory->prototypeSize() == size);
+  CHECK(factory->find("broken") < 0);
+}
@@ -0,0 +1,169 @@
+//
+// The SIMD span kernels against the scalar ones.
+//
+
+#include "Test.h"
+
+namespace {
+  /// <summary>
+  /// Pixels around the run a kernel is given, which it must not touch.
+  /// </summary>
+  const size_t GUARD = 40;
+
+  /// <summary>
+  /// Run a kernel set and the scalar one over copies of the same
+  /// pixels; true if every pixel, the guards included, comes out the
+  /// same.
+  /// </summary>
+  template <typename Run>
+  bool sameAsScalar(const SpanKernels::Kernels& kernels,
+    const std::vector<uint32_t>& pixels, size_t offset, size_t count, Run&& run) {
+    std::vector<uint32_t> expected = pixels;
+    std::vector<uint32_t> actual = pixels;
+
+    run(SpanKernels::SCALAR, &expected[GUARD + offset], count);
+    run(kernels, &actual[GUARD + offset], count);
+
+    return expected == actual;
+  }
+}
+
+TEST(everyKernelSetIsListed) {
+  std::vector<const SpanKernels::Kernels*> kernels = SpanKernels::available();
+
+  CHECK(kernels.front() == &SpanKernels::SCALAR);
+  CHECK(kernels.back() == &SpanKernels::selected());
+
+  for (const SpanKernels::Kernels* set : kernels) {
+    std::printf("     %s\n", set->name);
+  }
+}
+
+TEST(kernelsMatchScalarOnEveryRun) {
+  std::mt19937 random(11);
+
+  for (const SpanKernels::Kernels* set : SpanKernels::available()) {
+    // Every length through a few vectors, from every alignment.
+    for (size_t count = 0; count <= 70; ++count) {
+      for (size_t offset = 0; offset < 8; ++offset) {
+        std::vector<uint32_t> pixels(count + 8 + 2 * GUARD);
+        std::vector<uint8_t> coverage(count + 1);
+
+        for (uint32_t& pixel : pixels) {
+          pixel = (uint32_t)random();
+        }
+
+        for (uint8_t& share : coverage) {
+          // Runs of the ends of the range, as edges have.
+          uint32_t pick = random() % 4;
+          share = (uint8_t)(pick == 0 ? 0 : pick == 1 ? 255 : random());
+        }
+
+        uint32_t colour = (uint32_t)random();
+
+        CHECK(sameAsScalar(*set, pixels, offset, count, [&](const SpanKernels::Kernels& kernels,
+          uint32_t* run, size_t length) {
+          kernels.fill(run, length, colour);
+        }));
+
+        CHECK(sameAsScalar(*set, pixels, offset, count, [&](const SpanKernels::Kernels& kernels,
+          uint32_t* run, size_t length) {
+          kernels.blend(run, length, colour);
+        }));
+
+        CHECK(sameAsScalar(*set, pixels, offset, count, [&](const SpanKernels::Kernels& kernels,
+          uint32_t* run, size_t length) {
+          kernels.blendMask(run, coverage.data(), length, colour | 0xFF000000);
+        }));
+      }
+    }
+  }
+}
+
+TEST(mirroredAndScatteredKernelsMatchScalar) {
+  std::mt19937 random(12);
+  const size_t width = 90;
+
+  for (const SpanKernels::Kernels* set : SpanKernels::available()) {
+    for (size_t count = 0; count <= 40; ++count) {
+      std::vector<uint32_t> pixels(width * 3);
+      std::vector<uint8_t> coverage(count + 1);
+
+      for (uint32_t& pixel : pixels) {
+        pixel = (uint32_t)random();
+      }
+
+      for (uint8_t& share : coverage) {
+        uint32_t pick = random() % 4;
+        share = (uint8_t)(pick == 0 ? 0 : pick == 1 ? 255 : random());
+      }
+
+      uint32_t colour = (uint32_t)random() | 0xFF000000;
+
+      // Edges of two rows and their mirrors, meeting in the middle or
+      // not; then a single row, given as both.
+      size_t span = 2 * count - 1 + random() % 3;
+
+      for (size_t bottom : { 2 * width, width }) {
+        std::vector<uint32_t> expected = pixels;
+        std::vector<uint32_t> actual = pixels;
+
+        if (count > 0) {
+          SpanKernels::SCALAR.blendMirrored(&expected[width + 1], &expected[bottom + 1], span,
+            coverage.data(), count, colour);
+          set->blendMirrored(&actual[width + 1], &actual[bottom + 1], span,
+            coverage.data(), count, colour);
+        }
+
+        CHECK(expected == actual);
+      }
+
+      // Pixels anywhere, in any order.
+      std::vector<size_t> offsets(pixels.size());
+
+      for (size_t i = 0; i < offsets.size(); ++i) {
+        offsets[i] = i;
+      }
+
+      std::shuffle(offsets.begin(), offsets.end(), random);
+
+      std::vector<uint32_t> expected = pixels;
+      std::vector<uint32_t> actual = pixels;
+
+      SpanKernels::SCALAR.blendScattered(expected.data(), offsets.data(), coverage.data(),
+        count, colour);
+      set->blendScattered(actual.data(), offsets.data(), coverage.data(), count, colour);
+
+      CHECK(expected == actual);
+    }
+  }
+}
+
+TEST(kernelsMatchScalarForEveryAlphaAndChannel) {
+  // Every channel value, under every alpha.
+  std::vector<uint32_t> pixels(256 * 64 + 2 * GUARD);
+  std::vector<uint8_t> coverage(pixels.size());
+  size_t count = pixels.size() - 2 * GUARD;
+
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    pixels[i] = (uint32_t)(i % 256) * 0x01010101u ^ (uint32_t)(i / 256) * 0x00402010u;
+  }
+
+  for (const SpanKernels::Kernels* set : SpanKernels::available()) {
+    for (uint32_t alpha = 0; alpha < 256; ++alpha) {
+      uint32_t colour = alpha << 24 | (alpha * 0x9E3779B1u & 0xFFFFFF);
+
+      std::fill(coverage.begin(), coverage.end(), (uint8_t)alpha);
+
+      CHECK(sameAsScalar(*set, pixels, 0, count, [&](const SpanKernels::Kernels& kernels,
+        uint32_t* run, size_t length) {
+        kernels.blend(run, length, colour);
+      }));
+
+      CHECK(sameAsScalar(*set, pixels, 0, count, [&](const SpanKernels::Kernels& kernels,
+        uint32_t* run, size_t length) {
+        kernels.blendMask(run, coverage.data(), length, colour | 0xFF000000);
+      }));
+    }
+  }
+}
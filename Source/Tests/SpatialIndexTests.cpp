@@ -0,0 +1,151 @@
+//
+// Selection through SpatialIndex against the scan over every shape.
+//
+
+#include "Test.h"
+
+namespace {
+  /// <summary>
+  /// Topmost shape inside a selection, the way selection found it
+  /// before the index: from the top down, every shape tested.
+  /// </summary>
+  int linearTopmost(const std::vector<std::shared_ptr<IShape>>& shapes,
+    const Point& topLeft, const Point& rightBottom) {
+    for (int i = (int)shapes.size() - 1; i >= 0; --i) {
+      if (shapes[i]->in(topLeft, rightBottom)) {
+        return i;
+      }
+    }
+
+    return -1;
+  }
+
+  /// <summary>
+  /// A shape up to size pixels across, one in 500 much bigger, so
+  /// every grid of the index gets some.
+  /// </summary>
+  std::shared_ptr<IShape> randomShape(std::mt19937& random, int extent, int size) {
+    int x = (int)(random() % extent);
+    int y = (int)(random() % extent);
+    int width = 1 + (int)(random() % size);
+    int height = 1 + (int)(random() % size);
+
+    if (0 == random() % 500) {
+      width *= 200;
+      height *= 200;
+    }
+
+    return ShapeFactory::getInstance()->create(
+      (int)(random() % Test::SHAPE_TYPES),
+      Point(x, y),
+      Point(x + width, y + height),
+      ShapeGraphic(PS_SOLID, 1 + (int)(random() % 4), 0, NULL_BRUSH, 0)
+    );
+  }
+}
+
+TEST(topmostMatchesLinearScanThroughEdits) {
+  std::mt19937 random(25);
+  std::vector<std::shared_ptr<IShape>> shapes;
+  SpatialIndex index;
+
+  for (int i = 0; i < 3000; ++i) {
+    shapes.push_back(randomShape(random, 2000, 60));
+  }
+
+  index.rebuild(shapes);
+
+  // Edits as the controllers make them: create, delete, move, paste,
+  // and selecting raises the shape found to the top.
+  for (int step = 0; step < 60000; ++step) {
+    int edit = (int)(random() % 10);
+
+    if (edit < 3) {
+      shapes.push_back(randomShape(random, 2000, 60));
+      index.insert(shapes.back().get());
+    }
+
+    else if (edit < 4 && !shapes.empty()) {
+      index.remove(shapes.back().get());
+      shapes.pop_back();
+    }
+
+    else if (edit < 5 && !shapes.empty()) {
+      shapes.back()->move((int)(random() % 41) - 20, (int)(random() % 41) - 20);
+      index.update(shapes.back().get());
+    }
+
+    else if (edit < 6 && !shapes.empty()) {
+      shapes.push_back(shapes.back()->cloneShape());
+      shapes.back()->move(10, 10);
+      index.insert(shapes.back().get());
+    }
+
+    else {
+      int x = (int)(random() % 2100) - 50;
+      int y = (int)(random() % 2100) - 50;
+      int size = (int)(random() % (0 == random() % 20 ? 3000 : 200));
+      Point topLeft(x, y), rightBottom(x + size, y + size);
+
+      int expected = linearTopmost(shapes, topLeft, rightBottom);
+      CHECK(index.topmost(shapes, topLeft, rightBottom) == expected);
+
+      if (expected >= 0) {
+        std::shared_ptr<IShape> selected = shapes[expected];
+        shapes.erase(shapes.begin() + expected);
+        shapes.push_back(selected);
+        index.raise(selected.get());
+      }
+    }
+
+    // Start over, as loading another scene does.
+    if (30000 == step) {
+      shapes.clear();
+      index.clear();
+    }
+  }
+
+  CHECK(index.size() == shapes.size());
+}
+
+TEST(topmostFindsShapesOutToTheEndsOfInt) {
+  std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+  std::vector<std::shared_ptr<IShape>> shapes;
+  ShapeGraphic graphic(PS_SOLID, 3, 0, NULL_BRUSH, 0);
+  std::mt19937 random(26);
+
+  // Enough small shapes below for queries to go through the cells
+  // rather than test every shape.
+  for (int i = 0; i < 5000; ++i) {
+    shapes.push_back(randomShape(random, 4000, 40));
+    shapes.back()->move(0, 1000);
+  }
+
+  const int first = (int)shapes.size();
+
+  shapes.push_back(factory->create(Test::RECTANGLE, Point(INT_MIN + 10, INT_MIN + 10),
+    Point(INT_MIN + 50, INT_MIN + 50), graphic));
+  shapes.push_back(factory->create(Test::ELLIPSE, Point(INT_MAX - 50, INT_MAX - 50),
+    Point(INT_MAX - 10, INT_MAX - 10), graphic));
+  shapes.push_back(factory->create(Test::LINE, Point(INT_MIN + 5, 0), Point(INT_MAX - 5, 0), graphic));
+  shapes.push_back(factory->create(Test::CIRCLE, Point(100, 100), Point(140, 140), graphic));
+
+  SpatialIndex index;
+  index.rebuild(shapes);
+
+  CHECK(index.topmost(shapes, Point(INT_MIN, INT_MIN), Point(INT_MIN + 100, INT_MIN + 100)) == first);
+  CHECK(index.topmost(shapes, Point(INT_MAX - 100, INT_MAX - 100), Point(INT_MAX, INT_MAX)) == first + 1);
+  CHECK(index.topmost(shapes, Point(INT_MIN, -1), Point(INT_MAX, 1)) == first + 2);
+  CHECK(index.topmost(shapes, Point(90, 90), Point(150, 150)) == first + 3);
+  CHECK(index.topmost(shapes, Point(INT_MIN, INT_MIN), Point(INT_MAX, INT_MAX)) == first + 3);
+  CHECK(index.topmost(shapes, Point(-2000, -2000), Point(-1000, -1000)) == -1);
+
+  // And small selections among the others.
+  for (int i = 0; i < 2000; ++i) {
+    int x = (int)(random() % 4000);
+    int y = 1000 + (int)(random() % 4000);
+    Point topLeft(x, y), rightBottom(x + 60, y + 60);
+
+    CHECK(index.topmost(shapes, topLeft, rightBottom) == linearTopmost(shapes, topLeft, rightBottom));
+  }
+}
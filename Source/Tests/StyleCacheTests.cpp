@@ -0,0 +1,150 @@
+//
+// Pens created and reused by StyleCache, through a counting backend.
+//
+
+#include "Test.h"
+
+namespace {
+  /// <summary>
+  /// Backend whose pens are numbers; counts what it creates and frees.
+  /// </summary>
+  class CountingStyleFactory : public IStyleFactory {
+  public:
+    int created = 0;
+    int deleted = 0;
+
+    void* createPen(const ShapeGraphic&) override {
+      return (void*)(uintptr_t)++created;
+    }
+
+    void deletePen(void*) override {
+      ++deleted;
+    }
+  };
+
+  /// <summary>
+  /// Takes its pen from a cache on every style change, and counts the
+  /// pen changes, as GdiRenderTarget selects them.
+  /// </summary>
+  class CountingRenderTarget : public IRenderTarget {
+  private:
+    StyleCache& _styles;
+    bool _hasStyle = false;
+    ShapeGraphic _style;
+    void* _pen = NULL;
+
+  public:
+    int styleChanges = 0;
+    int penChanges = 0;
+
+    CountingRenderTarget(StyleCache& styles) : _styles(styles) {
+    }
+
+    void setStyle(const ShapeGraphic& graphic) override {
+      if (_hasStyle && graphic == _style) {
+        return;
+      }
+
+      _hasStyle = true;
+      _style = graphic;
+      ++styleChanges;
+
+      void* pen = _styles.pen(graphic);
+
+      if (pen != _pen) {
+        _pen = pen;
+        ++penChanges;
+      }
+    }
+
+    void line(int, int, int, int) override {}
+    void rectangle(int, int, int, int) override {}
+    void ellipse(int, int, int, int) override {}
+    void dot(int, int) override {}
+  };
+
+  /// <summary>
+  /// Shapes in a few styles, in runs of one style, as a board drawn
+  /// with a handful of tools.
+  /// </summary>
+  std::vector<std::shared_ptr<IShape>> shapesInStyles(size_t count,
+    const std::vector<ShapeGraphic>& styles, size_t run) {
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+    std::vector<std::shared_ptr<IShape>> shapes;
+
+    for (const std::shared_ptr<IShape>& shape : Test::randomShapes(15, count, 800, 600)) {
+      shapes.push_back(factory->create((int)(shapes.size() % Test::SHAPE_TYPES),
+        shape->firstPoint(), shape->secondPoint(), styles[shapes.size() / run % styles.size()]));
+    }
+
+    return shapes;
+  }
+}
+
+TEST(onePenPerStyleAcrossFrames) {
+  // Eight styles, but two pairs differ only by brush: six pens.
+  std::vector<ShapeGraphic> styles = {
+    ShapeGraphic(PS_SOLID, 1, RGB(0, 0, 0), NULL_BRUSH, 0),
+    ShapeGraphic(PS_SOLID, 1, RGB(0, 0, 0), DC_BRUSH, RGB(255, 0, 0)),
+    ShapeGraphic(PS_SOLID, 3, RGB(0, 0, 0), NULL_BRUSH, 0),
+    ShapeGraphic(PS_DASH, 1, RGB(0, 0, 0), NULL_BRUSH, 0),
+    ShapeGraphic(PS_DASH, 1, RGB(0, 0, 0), GRAY_BRUSH, 0),
+    ShapeGraphic(PS_DOT, 1, RGB(0, 0, 255), NULL_BRUSH, 0),
+    ShapeGraphic(PS_SOLID, 1, RGB(0, 0, 255), DC_BRUSH, RGB(0, 255, 0)),
+    ShapeGraphic(PS_SOLID, 2, RGB(200, 0, 0), DC_BRUSH, RGB(0, 255, 0)),
+  };
+
+  const size_t count = 20000;
+  const size_t run = 40;
+
+  DisplayList list;
+  list.sync(shapesInStyles(count, styles, run));
+
+  CountingStyleFactory factory;
+
+  {
+    StyleCache cache(factory);
+
+    for (int frame = 0; frame < 3; ++frame) {
+      CountingRenderTarget target(cache);
+      list.replay(target);
+      cache.trim();
+
+      // Pens are made by the first frame only, and the state only
+      // changes between runs of one style.
+      CHECK(factory.created == 6);
+      CHECK(target.styleChanges == (int)(count / run));
+      CHECK(target.penChanges <= target.styleChanges);
+    }
+
+    CHECK(cache.size() == 6);
+    CHECK(cache.created() == 6);
+    CHECK(cache.reused() == 3 * count / run - 6);
+    CHECK(factory.deleted == 0);
+  }
+
+  CHECK(factory.deleted == factory.created);
+}
+
+TEST(trimStartsOverPastCapacity) {
+  CountingStyleFactory factory;
+  StyleCache cache(factory, 4);
+
+  for (int width = 1; width <= 4; ++width) {
+    cache.pen(ShapeGraphic(PS_SOLID, width, 0, NULL_BRUSH, 0));
+  }
+
+  // At capacity: kept.
+  cache.trim();
+  CHECK(cache.size() == 4);
+  CHECK(factory.deleted == 0);
+
+  cache.pen(ShapeGraphic(PS_SOLID, 5, 0, NULL_BRUSH, 0));
+  cache.trim();
+  CHECK(cache.size() == 0);
+  CHECK(factory.deleted == 5);
+
+  // And makes pens again afterwards.
+  cache.pen(ShapeGraphic(PS_SOLID, 1, 0, NULL_BRUSH, 0));
+  CHECK(factory.created == 6);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Headless.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+/// <summary>
+/// Minimal test harness. TEST(name) registers a case; a failed CHECK
+/// is reported and the case goes on. Every test file is its own
+/// executable, which returns non-zero if any check failed.
+/// </summary>
+namespace Test {
+  struct Case {
+    const char* name;
+    void (*run)();
+  };
+
+  inline std::vector<Case>& cases() {
+    static std::vector<Case> all;
+    return all;
+  }
+
+  inline int& failures() {
+    static int count = 0;
+    return count;
+  }
+
+  struct Registrar {
+    Registrar(const char* name, void (*run)()) {
+      cases().push_back({ name, run });
+    }
+  };
+
+  inline void fail(const char* file, int line, const char* expression) {
+    std::printf("  %s:%d: CHECK(%s) failed\n", file, line, expression);
+    ++failures();
+  }
+
+  /// <summary>
+  /// Shape tags, in ShapeFactory registration order.
+  /// </summary>
+  enum { LINE, RECTANGLE, SQUARE, ELLIPSE, CIRCLE, SHAPE_TYPES };
+
+  /// <summary>
+  /// Random shapes around (and past the edges of) a canvas.
+  /// </summary>
+  inline std::vector<std::shared_ptr<IShape>> randomShapes(unsigned int seed,
+    size_t count, int width, int height) {
+    const int styles[] = { PS_SOLID, PS_DASH, PS_DOT, PS_DASHDOT, PS_DASHDOTDOT };
+    const int brushes[] = { NULL_BRUSH, DC_BRUSH, GRAY_BRUSH };
+
+    std::mt19937 random(seed);
+    std::shared_ptr<ShapeFactory> factory = ShapeFactory::getInstance();
+    std::vector<std::shared_ptr<IShape>> shapes;
+
+    for (size_t i = 0; i < count; ++i) {
+      int x = (int)(random() % (width + 80)) - 40;
+      int y = (int)(random() % (height + 80)) - 40;
+      int w = (int)(random() % 120) - 60;
+      int h = (int)(random() % 120) - 60;
+
+      shapes.push_back(factory->create(
+        (int)(random() % SHAPE_TYPES),
+        Point(x, y),
+        Point(x + w, y + h),
+        ShapeGraphic(
+          styles[random() % 5],
+          1 + (random() % 4 == 0 ? (int)(random() % 9) : 0),
+          RGB(random() % 256, random() % 256, random() % 256),
+          brushes[random() % 3],
+          RGB(random() % 256, random() % 256, random() % 256)
+        )
+      ));
+    }
+
+    return shapes;
+  }
+
+  /// <summary>
+  /// Path of a scratch file in the temporary directory.
+  /// </summary>
+  /// <param name="name"></param>
+  /// <returns></returns>
+  inline std::wstring tempPath(const std::wstring& name) {
+    return (std::filesystem::temp_directory_path() / (L"paint-test-" + name)).wstring();
+  }
+
+  /// <summary>
+  /// Run every case; an exception fails the case.
+  /// </summary>
+  /// <returns>Process exit code.</returns>
+  inline int runAll() {
+    for (const Case& test : cases()) {
+      int before = failures();
+
+      try {
+        test.run();
+      }
+
+      catch (const std::exception& error) {
+        std::printf("  %s: threw %s\n", test.name, error.what());
+        ++failures();
+      }
+
+      std::printf("%s %s\n", failures() == before ? "ok  " : "FAIL", test.name);
+    }
+
+    return failures() > 0 ? 1 : 0;
+  }
+}
+
+#define TEST(name) \
+  static void name(); \
+  static Test::Registrar name##Registrar(#name, name); \
+  static void name()
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      Test::fail(__FILE__, __LINE__, #condition); \
+    } \
+  } while (0)
+
+#define CHECK_THROWS(expression) \
+  do { \
+    bool thrown = false; \
+    try { \
+      expression; \
+    } \
+    catch (const std::exception&) { \
+      thrown = true; \
+    } \
+    if (!thrown) { \
+      Test::fail(__FILE__, __LINE__, "throws " #expression); \
+    } \
+  } while (0)
+
+int main() {
+  return Test::runAll();
+}
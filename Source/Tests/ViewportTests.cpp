@@ -0,0 +1,121 @@
+//
+// Zoom and pan through Viewport: mapping both ways, and drawing
+// through it.
+//
+
+#include "Test.h"
+
+namespace {
+  const uint32_t WHITE = 0xFFFFFFFF;
+
+  /// <summary>
+  /// A viewport zoomed some steps in or out around a point, then panned.
+  /// </summary>
+  Viewport randomViewport(std::mt19937& random) {
+    Viewport viewport;
+
+    viewport.zoomBy((int)(random() % 2000) - 1000, (int)(random() % 2000) - 1000,
+      (int)(random() % 31) - 15);
+    viewport.pan((int)(random() % 20001) - 10000, (int)(random() % 20001) - 10000);
+
+    return viewport;
+  }
+}
+
+TEST(clientPointMapsToTheDocumentPixelUnderIt) {
+  std::mt19937 random(23);
+
+  for (int i = 0; i < 20000; ++i) {
+    Viewport viewport = randomViewport(random);
+    int x = (int)(random() % 4001) - 2000;
+    int y = (int)(random() % 4001) - 2000;
+
+    // The last document pixel mapped at or before the point.
+    int documentX = viewport.toDocumentX(x);
+    int documentY = viewport.toDocumentY(y);
+
+    CHECK(viewport.toClientX(documentX) <= x && viewport.toClientX(documentX + 1) > x);
+    CHECK(viewport.toClientY(documentY) <= y && viewport.toClientY(documentY + 1) > y);
+  }
+}
+
+TEST(zoomKeepsThePointUnderTheCursor) {
+  std::mt19937 random(24);
+
+  for (int i = 0; i < 20000; ++i) {
+    Viewport viewport = randomViewport(random);
+    int x = (int)(random() % 4001) - 2000;
+    int y = (int)(random() % 4001) - 2000;
+
+    int documentX = viewport.toDocumentX(x);
+    int documentY = viewport.toDocumentY(y);
+
+    // The point is known to a client pixel, so to the document pixels
+    // one spans at either scale.
+    int slack = 1 + viewport.toDocumentLength(1);
+    viewport.zoomBy(x, y, (int)(random() % 9) - 4);
+    slack += viewport.toDocumentLength(1);
+
+    CHECK(std::abs(viewport.toDocumentX(x) - documentX) <= slack);
+    CHECK(std::abs(viewport.toDocumentY(y) - documentY) <= slack);
+  }
+
+  // Zoomed back to 1:1, the view is where it started.
+  Viewport viewport;
+  viewport.zoomAt(0, 0, Viewport::SCALE_ONE / 4);
+  viewport.zoomAt(0, 0, Viewport::SCALE_ONE);
+  CHECK(viewport.isIdentity());
+}
+
+TEST(tiledRenderThroughViewportsMatchesReplay) {
+  const int width = 300;
+  const int height = 200;
+
+  std::vector<std::shared_ptr<IShape>> shapes = Test::randomShapes(23, 4000, 1200, 800);
+  DisplayList list;
+  list.sync(shapes);
+
+  // From 7% to 1455%, panned over the shapes.
+  for (int steps = -12; steps <= 12; steps += 3) {
+    Viewport viewport;
+    viewport.zoomBy(0, 0, steps);
+    viewport.pan(-viewport.toClientLength(400), -viewport.toClientLength(300));
+
+    for (bool antialiasing : { false, true }) {
+      Framebuffer expected(width, height, WHITE);
+
+      {
+        SoftwareRenderTarget target(expected);
+        target.setAntialiasing(antialiasing);
+        ViewportRenderTarget view(target, viewport);
+        list.replay(view);
+      }
+
+      Framebuffer tiled(width, height, 0);
+      TileRenderer renderer(4);
+      renderer.setAntialiasing(antialiasing);
+      renderer.render(tiled, list, WHITE, RECT{ 0, 0, width, height }, 0, viewport);
+
+      CHECK(0 == memcmp(expected.data(), tiled.data(), (size_t)width * height * sizeof(uint32_t)));
+
+      // Culled to the document area of a part of the view, the part
+      // is drawn the same.
+      const RECT part = { 70, 40, 190, 130 };
+      Framebuffer culled(width, height, WHITE);
+
+      {
+        SoftwareRenderTarget target(culled);
+        target.setAntialiasing(antialiasing);
+        target.setClip(part.left, part.top, part.right, part.bottom);
+        ViewportRenderTarget view(target, viewport);
+        list.replay(view, viewport.toDocument(part));
+      }
+
+      for (int y = part.top; y < part.bottom; ++y) {
+        for (int x = part.left; x < part.right; ++x) {
+          CHECK(culled.pixel(x, y) == expected.pixel(x, y));
+        }
+      }
+    }
+  }
+}